@@ -0,0 +1,152 @@
+//
+// Created by Coonger on 2024/12/16.
+//
+// Rows_event 按字段类型编码的开销，以及转换热路径上的几个基础函数：
+// base64_decode、decimal2bin、str_to_datetime、stringToTimestamp
+//
+// 用法: field_bench [--benchmark_filter=...]
+//
+#include <benchmark/benchmark.h>
+
+#include <cstring>
+
+#include "schemas.h"
+#include "transform_manager.h"
+#include "sql/field_types.h"
+#include "utils/base64.h"
+#include "utils/decimal.h"
+#include "utils/my_time.h"
+#include "data_handler.h"  // 依赖前面引入的 loft 命名空间和 base64
+
+namespace {
+
+constexpr int ROWS_PER_EVENT = 64;  // 一个 Rows_event 里累积的字段数，避免 buf 无限增长
+
+/**
+ * @brief 单列表的一条记录，processData 的输入
+ */
+struct SingleField
+{
+  std::vector<uint8> record;
+  mysql::FieldRef    field;
+  const loft::kvPair *pair = nullptr;
+};
+
+SingleField single_field(const bench::Column &column, bench::Value value)
+{
+  SingleField result;
+
+  loft::RedoRecordBuilder         builder;
+  loft::RedoRecordBuilder::Header header;
+  header.msg_time = header.tx_time = "2024-08-01 14:32:41.000117";
+  bench::Row row;
+  row.emplace_back(0, std::move(value));
+  result.record = builder.dml(header, "bench", "t_bench", "I", {column}, {}, row);
+  result.pair   = loft::GetDML(result.record.data())->new_data()->Get(0);
+  result.field  = mysql::make_field(column.name.c_str(),
+      column.length,
+      column.is_unsigned,
+      column.nullable,
+      0,
+      type_map.at(column.type),
+      0,
+      column.precision);
+  return result;
+}
+
+void BM_RowsEventField(benchmark::State &state, bench::Column column, bench::Value value)
+{
+  SingleField       input   = single_field(column, std::move(value));
+  FieldDataHandler *handler = DataHandlerFactory::getHandler(input.pair->value_type());
+
+  size_t bytes = 0;
+  for (auto _ : state) {
+    Rows_event row(Table_id(DML_TABLE_ID), 1, 1, Log_event_type::WRITE_ROWS_EVENT, 0);
+    row.setBefore(false);
+    for (int i = 0; i < ROWS_PER_EVENT; i++) {
+      handler->processData(input.pair, input.field.get(), &row);
+    }
+    bytes = row.get_data_size();
+    benchmark::DoNotOptimize(bytes);
+  }
+  state.SetItemsProcessed(state.iterations() * ROWS_PER_EVENT);
+  state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(bytes));
+}
+
+using RB = loft::RedoRecordBuilder;
+
+BENCHMARK_CAPTURE(BM_RowsEventField, int, bench::Column{"c0", "INT", 11}, RB::Value::of_long(123456));
+BENCHMARK_CAPTURE(BM_RowsEventField, bigint, bench::Column{"c0", "BIGINT", 20}, RB::Value::of_long(1LL << 40));
+BENCHMARK_CAPTURE(BM_RowsEventField, double, bench::Column{"c0", "DOUBLE", 22, 6}, RB::Value::of_double(3.141592));
+BENCHMARK_CAPTURE(BM_RowsEventField, decimal, bench::Column{"c0", "DECIMAL", 10, 5},
+    RB::Value::of_string("12345.67891"));
+BENCHMARK_CAPTURE(BM_RowsEventField, varchar, bench::Column{"c0", "VARCHAR", 255},
+    RB::Value::of_string(RB::encode_string(std::string(200, 'v'))));
+BENCHMARK_CAPTURE(BM_RowsEventField, json, bench::Column{"c0", "JSON"},
+    RB::Value::of_string(RB::encode_string(bench::json_document())));
+BENCHMARK_CAPTURE(BM_RowsEventField, datetime, bench::Column{"c0", "DATETIME", 26, 6},
+    RB::Value::of_string(RB::encode_string("2024-08-01 14:32:41.000054")));
+BENCHMARK_CAPTURE(BM_RowsEventField, timestamp, bench::Column{"c0", "TIMESTAMP", 26, 6},
+    RB::Value::of_string(RB::encode_string("2024-08-01 14:32:41.000054")));
+BENCHMARK_CAPTURE(BM_RowsEventField, year, bench::Column{"c0", "YEAR", 4}, RB::Value::of_long(2024));
+
+void BM_Base64Decode(benchmark::State &state)
+{
+  std::string encoded = RB::encode_string(std::string(state.range(0), 'b'));
+  std::vector<char> dst(base64_needed_decoded_length(encoded.size()));
+  for (auto _ : state) {
+    int64_t len = base64_decode(encoded.data(), encoded.size(), dst.data(), nullptr, 0);
+    benchmark::DoNotOptimize(len);
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(encoded.size()));
+}
+
+BENCHMARK(BM_Base64Decode)->Arg(64)->Arg(1024)->Arg(16384);
+
+void BM_Decimal2Bin(benchmark::State &state)
+{
+  constexpr int precision = 10;
+  constexpr int frac      = 5;
+
+  Rows_event row(Table_id(DML_TABLE_ID), 1, 1, Log_event_type::WRITE_ROWS_EVENT, 0);
+  decimal_t  t;
+  row.double2demi(12345.67891, t, precision, frac);
+  uchar out[16];
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(decimal2bin(&t, out, precision, frac));
+  }
+  delete[] t.buf;
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_Decimal2Bin);
+
+void BM_StrToDatetime(benchmark::State &state)
+{
+  const char *value = "2024-08-01 14:32:41.000054";
+  size_t      len   = strlen(value);
+  for (auto _ : state) {
+    MYSQL_TIME ltime;
+    str_to_datetime(value, len, &ltime);
+    benchmark::DoNotOptimize(ltime);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_StrToDatetime);
+
+void BM_StringToTimestamp(benchmark::State &state)
+{
+  std::string value = "2024-08-01 14:32:41.000117";
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(LogFormatTransformManager::stringToTimestamp(value));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_StringToTimestamp);
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,505 @@
+//
+// Created by Coonger on 2024/12/18.
+//
+// 并发骨架在争用下的表现：SimpleQueue、TaskQueue、ResultQueue、ThreadPoolExecutor。
+// 参数是 生产者数 / 消费者数 / payload 字节数 / 突发大小（0 表示匀速，N 表示每发 N 条停 200us），输出：
+//   - items_per_second：每轮 producers * ITEMS_PER_PRODUCER 条全部被消费的吞吐
+//   - p50_ns / p99_ns / p999_ns：从入队到被消费者取走的交接延迟
+//   - cpu_cores：这段时间整个进程用掉的 CPU 时间 / 墙钟时间
+// BM_Idle* 只启动消费者，不生产，cpu_cores 就是空闲时每秒烧掉的 CPU
+//
+// 用法: queue_bench [--benchmark_filter=...]
+//
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <latch>
+#include <thread>
+#include <vector>
+
+#include "common/init_setting.h"
+#include "common/metrics.h"
+#include "common/simple_queue.h"
+#include "common/task_queue.h"
+#include "common/thread_pool_executor.h"
+#include "log_file.h"
+
+namespace {
+
+constexpr size_t ITEMS_PER_PRODUCER = 1 << 14;
+constexpr auto   BURST_PAUSE        = std::chrono::microseconds(200);
+constexpr auto   IDLE_WINDOW        = std::chrono::milliseconds(100);
+
+struct Item
+{
+  std::vector<unsigned char> payload;
+  uint64                     enqueue_ns = 0;  // 0 表示让消费者退出
+};
+
+struct Params
+{
+  int    producers;
+  int    consumers;
+  size_t payload;
+  int    burst;
+
+  explicit Params(const benchmark::State &state)
+      : producers(static_cast<int>(state.range(0))),
+        consumers(static_cast<int>(state.range(1))),
+        payload(static_cast<size_t>(state.range(2))),
+        burst(static_cast<int>(state.range(3)))
+  {}
+
+  size_t total() const { return producers * ITEMS_PER_PRODUCER; }
+};
+
+uint64 now_ns()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+double cpu_seconds()
+{
+  timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+Item make_item(size_t payload) { return Item{std::vector<unsigned char>(payload, 0x5a), now_ns()}; }
+
+/// 每发 burst 条停一下，模拟上游按事务成批到达
+void pace(const Params &params, size_t i)
+{
+  if (params.burst > 0 && (i + 1) % params.burst == 0) {
+    std::this_thread::sleep_for(BURST_PAUSE);
+  }
+}
+
+/**
+ * @brief 一轮测量：启动 producers / consumers 个线程，同时放行，全部结束后记录时间和 CPU
+ */
+class Round
+{
+public:
+  explicit Round(common::Histogram &latency) : latency_(latency) {}
+
+  template <typename Producer, typename Consumer>
+  void run(benchmark::State &state, const Params &params, Producer &&producer, Consumer &&consumer)
+  {
+    std::latch               start(1);
+    std::vector<std::thread> threads;
+    for (int c = 0; c < params.consumers; c++) {
+      threads.emplace_back([&, c] {
+        start.wait();
+        consumer(c);
+      });
+    }
+    for (int p = 0; p < params.producers; p++) {
+      threads.emplace_back([&, p] {
+        start.wait();
+        producer(p);
+      });
+    }
+
+    double cpu_start  = cpu_seconds();
+    auto   wall_start = std::chrono::steady_clock::now();
+    start.count_down();
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+    cpu_ += cpu_seconds() - cpu_start;
+    wall_ += wall;
+    state.SetIterationTime(wall);
+  }
+
+  void handoff(uint64 enqueue_ns) { latency_.record(now_ns() - enqueue_ns); }
+
+  void report(benchmark::State &state, size_t items_per_round)
+  {
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(items_per_round));
+    state.counters["p50_ns"]    = static_cast<double>(latency_.percentile(0.5));
+    state.counters["p99_ns"]    = static_cast<double>(latency_.percentile(0.99));
+    state.counters["p999_ns"]   = static_cast<double>(latency_.percentile(0.999));
+    state.counters["cpu_cores"] = wall_ > 0 ? cpu_ / wall_ : 0;
+  }
+
+private:
+  common::Histogram &latency_;
+  double             cpu_  = 0;
+  double             wall_ = 0;
+};
+
+/// 生产者数 x 消费者数 x payload x 突发
+void queue_args(benchmark::internal::Benchmark *b)
+{
+  b->ArgNames({"producers", "consumers", "payload", "burst"});
+  for (int producers : {1, 2, 4, 8}) {
+    for (int consumers : {1, 4}) {
+      for (int payload : {64, 4096}) {
+        for (int burst : {0, 256}) {
+          b->Args({producers, consumers, payload, burst});
+        }
+      }
+    }
+  }
+  b->UseManualTime();
+}
+
+/******************************************************************************
+                     SimpleQueue：一把互斥锁，pop 不阻塞，消费者空了就 yield
+******************************************************************************/
+
+void BM_SimpleQueue(benchmark::State &state)
+{
+  Params            params(state);
+  common::Histogram latency;
+  Round             round(latency);
+
+  for (auto _ : state) {
+    common::SimpleQueue<Item> queue;
+    std::atomic<size_t>       consumed{0};
+    round.run(
+        state,
+        params,
+        [&](int) {
+          for (size_t i = 0; i < ITEMS_PER_PRODUCER; i++) {
+            queue.push(make_item(params.payload));
+            pace(params, i);
+          }
+        },
+        [&](int) {
+          Item item;
+          while (consumed.load(std::memory_order_relaxed) < params.total()) {
+            if (queue.pop(item) != 0) {
+              std::this_thread::yield();
+              continue;
+            }
+            round.handoff(item.enqueue_ns);
+            consumed.fetch_add(1, std::memory_order_relaxed);
+          }
+        });
+  }
+  round.report(state, params.total());
+}
+BENCHMARK(BM_SimpleQueue)->Apply(queue_args);
+
+/******************************************************************************
+                     TaskQueue：无锁环形队列，阻塞的 write / read，容量和 LogFileManager 一致
+******************************************************************************/
+
+void BM_TaskQueue(benchmark::State &state)
+{
+  Params            params(state);
+  common::Histogram latency;
+  Round             round(latency);
+
+  for (auto _ : state) {
+    TaskQueue<Item>  queue(10000);
+    std::atomic<int> producers_left{params.producers};
+    round.run(
+        state,
+        params,
+        [&](int) {
+          for (size_t i = 0; i < ITEMS_PER_PRODUCER; i++) {
+            queue.write(make_item(params.payload));
+            pace(params, i);
+          }
+          // 最后一个生产者给每个消费者发一个结束标记
+          if (producers_left.fetch_sub(1) == 1) {
+            for (int c = 0; c < params.consumers; c++) {
+              queue.write(Item{});
+            }
+          }
+        },
+        [&](int) {
+          Item item;
+          while (queue.read(item) && item.enqueue_ns != 0) {
+            round.handoff(item.enqueue_ns);
+          }
+        });
+  }
+  round.report(state, params.total());
+}
+BENCHMARK(BM_TaskQueue)->Apply(queue_args);
+
+/**
+ * @brief 收集线程的用法：生产者按突发大小 push_bulk，唯一的消费者 pop_bulk 一次取走一批
+ */
+void BM_TaskQueueBulk(benchmark::State &state)
+{
+  Params            params(state);
+  common::Histogram latency;
+  Round             round(latency);
+
+  const size_t chunk = params.burst > 0 ? params.burst : 64;
+  for (auto _ : state) {
+    TaskQueue<Item>     queue(10000);
+    std::atomic<size_t> consumed{0};
+    round.run(
+        state,
+        params,
+        [&](int) {
+          std::vector<Item> items;
+          for (size_t i = 0; i < ITEMS_PER_PRODUCER; i += chunk) {
+            size_t n = std::min(chunk, ITEMS_PER_PRODUCER - i);
+            items.clear();
+            for (size_t k = 0; k < n; k++) {
+              items.push_back(make_item(params.payload));
+            }
+            queue.push_bulk(items.data(), n);
+            if (params.burst > 0) {
+              std::this_thread::sleep_for(BURST_PAUSE);
+            }
+          }
+        },
+        [&](int) {
+          std::vector<Item> batch;
+          while (consumed.load(std::memory_order_relaxed) < params.total()) {
+            batch.clear();
+            size_t n = queue.pop_bulk(batch, DEFAULT_BATCH_MAX_SIZE);
+            if (n == 0) {
+              std::this_thread::yield();
+              continue;
+            }
+            for (const Item &item : batch) {
+              round.handoff(item.enqueue_ns);
+            }
+            consumed.fetch_add(n, std::memory_order_relaxed);
+          }
+        });
+  }
+  round.report(state, params.total());
+}
+BENCHMARK(BM_TaskQueueBulk)
+    ->ArgNames({"producers", "consumers", "payload", "burst"})
+    ->ArgsProduct({{1, 2, 4, 8}, {1}, {64, 4096}, {0, 256}})
+    ->UseManualTime();
+
+/******************************************************************************
+                     ResultQueue：转换线程乱序 add_result，写线程按序号取
+******************************************************************************/
+
+/**
+ * @brief 和 ResultQueue::process_writes 相同的等待逻辑，取到下一个序号的 batch 后不写文件
+ */
+std::unique_ptr<LogFileManager::BatchResult> take_next(LogFileManager::ResultQueue &queue)
+{
+  std::unique_lock<std::mutex> lock(queue.mutex_);
+  if (!queue.cv_.wait_for(lock, std::chrono::milliseconds(100), [&queue] {
+        return *queue.stop_flag_ || queue.pending_results_.count(queue.next_write_sequence_) > 0;
+      })) {
+    return nullptr;
+  }
+  auto it = queue.pending_results_.find(queue.next_write_sequence_);
+  if (it == queue.pending_results_.end()) {
+    return nullptr;
+  }
+  auto result = std::move(it->second);
+  queue.pending_results_.erase(it);
+  queue.next_write_sequence_++;
+  return result;
+}
+
+void BM_ResultQueue(benchmark::State &state)
+{
+  Params            params(state);
+  common::Histogram latency;
+  Round             round(latency);
+
+  for (auto _ : state) {
+    LogFileManager::ResultQueue queue;
+    std::atomic<bool>           stop{false};
+    std::atomic<size_t>         next_sequence{0};
+    std::vector<uint64>         enqueue_ns(params.total());
+    queue.stop_flag_ = &stop;
+    round.run(
+        state,
+        params,
+        [&](int) {
+          for (size_t i = 0; i < ITEMS_PER_PRODUCER; i++) {
+            size_t sequence = next_sequence.fetch_add(1);
+            auto   result   = std::make_unique<LogFileManager::BatchResult>(sequence);
+            result->ckps.emplace_back(params.payload, 'x');
+            enqueue_ns[sequence] = now_ns();
+            queue.add_result(std::move(result));
+            pace(params, i);
+          }
+        },
+        [&](int) {
+          size_t written = 0;
+          while (written < params.total()) {
+            if (auto result = take_next(queue)) {
+              round.handoff(enqueue_ns[result->sequence]);
+              written++;
+            }
+          }
+        });
+  }
+  round.report(state, params.total());
+}
+BENCHMARK(BM_ResultQueue)
+    ->ArgNames({"producers", "consumers", "payload", "burst"})
+    ->ArgsProduct({{1, 2, 4, 8}, {1}, {64, 4096}, {0, 256}})
+    ->UseManualTime();
+
+/******************************************************************************
+                     ThreadPoolExecutor：生产者 execute，consumers 个核心线程执行
+******************************************************************************/
+
+class HandoffTask : public common::Runnable
+{
+public:
+  HandoffTask(Item &&item, Round &round, std::latch &done) : item_(std::move(item)), round_(round), done_(done) {}
+
+  void run() override
+  {
+    round_.handoff(item_.enqueue_ns);
+    done_.count_down();
+  }
+
+private:
+  Item        item_;
+  Round      &round_;
+  std::latch &done_;
+};
+
+void BM_ThreadPoolExecutor(benchmark::State &state)
+{
+  Params            params(state);
+  common::Histogram latency;
+  Round             round(latency);
+
+  common::ThreadPoolExecutor executor;
+  executor.init("QueueBench", params.consumers, params.consumers, 60 * 1000);
+  for (auto _ : state) {
+    std::latch done(static_cast<std::ptrdiff_t>(params.total()));
+    // 消费者是线程池自己的线程，这里只等全部任务执行完
+    Params producers_only = params;
+    producers_only.consumers = 1;
+    round.run(
+        state,
+        producers_only,
+        [&](int) {
+          for (size_t i = 0; i < ITEMS_PER_PRODUCER; i++) {
+            executor.execute(std::make_unique<HandoffTask>(make_item(params.payload), round, done));
+            pace(params, i);
+          }
+        },
+        [&](int) { done.wait(); });
+  }
+  executor.shutdown();
+  executor.await_termination();
+  round.report(state, params.total());
+}
+BENCHMARK(BM_ThreadPoolExecutor)->Apply(queue_args);
+
+/******************************************************************************
+                     空闲开销：只有消费者，没有数据
+******************************************************************************/
+
+void report_idle(benchmark::State &state, double cpu, double wall)
+{
+  state.counters["cpu_cores"] = wall > 0 ? cpu / wall : 0;
+}
+
+/**
+ * @brief 消费者阻塞在 TaskQueue::read 上：先自旋、yield，然后在 futex 上休眠
+ */
+void BM_IdleTaskQueue(benchmark::State &state)
+{
+  const int consumers = static_cast<int>(state.range(0));
+  double    cpu = 0, wall = 0;
+  for (auto _ : state) {
+    TaskQueue<Item>          queue(10000);
+    std::vector<std::thread> threads;
+    double                   cpu_start  = cpu_seconds();
+    auto                     wall_start = std::chrono::steady_clock::now();
+    for (int c = 0; c < consumers; c++) {
+      threads.emplace_back([&queue] {
+        Item item;
+        queue.read(item);
+      });
+    }
+    std::this_thread::sleep_for(IDLE_WINDOW);
+    double cpu_end  = cpu_seconds();
+    auto   wall_end = std::chrono::steady_clock::now();
+    for (int c = 0; c < consumers; c++) {
+      queue.write(Item{});
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    cpu += cpu_end - cpu_start;
+    wall += std::chrono::duration<double>(wall_end - wall_start).count();
+    state.SetIterationTime(std::chrono::duration<double>(wall_end - wall_start).count());
+  }
+  report_idle(state, cpu, wall);
+}
+BENCHMARK(BM_IdleTaskQueue)->ArgName("consumers")->Arg(1)->Arg(4)->Arg(16)->UseManualTime()->Iterations(5);
+
+/**
+ * @brief 空闲的线程池：核心线程在条件变量上休眠
+ */
+void BM_IdleThreadPoolExecutor(benchmark::State &state)
+{
+  const int                  threads = static_cast<int>(state.range(0));
+  common::ThreadPoolExecutor executor;
+  executor.init("IdleBench", threads, threads, 60 * 1000);
+  double cpu = 0, wall = 0;
+  for (auto _ : state) {
+    double cpu_start  = cpu_seconds();
+    auto   wall_start = std::chrono::steady_clock::now();
+    std::this_thread::sleep_for(IDLE_WINDOW);
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+    cpu += cpu_seconds() - cpu_start;
+    wall += elapsed;
+    state.SetIterationTime(elapsed);
+  }
+  executor.shutdown();
+  executor.await_termination();
+  report_idle(state, cpu, wall);
+}
+BENCHMARK(BM_IdleThreadPoolExecutor)->ArgName("threads")->Arg(1)->Arg(4)->Arg(16)->UseManualTime()->Iterations(5);
+
+/**
+ * @brief 没有 batch 时的写线程：每 100ms 超时醒来检查一次 stop_flag_
+ */
+void BM_IdleResultQueue(benchmark::State &state)
+{
+  double cpu = 0, wall = 0;
+  for (auto _ : state) {
+    LogFileManager::ResultQueue queue;
+    std::atomic<bool>           stop{false};
+    queue.stop_flag_ = &stop;
+
+    double      cpu_start  = cpu_seconds();
+    auto        wall_start = std::chrono::steady_clock::now();
+    std::thread writer([&] {
+      while (!stop.load()) {
+        take_next(queue);
+      }
+    });
+    std::this_thread::sleep_for(IDLE_WINDOW);
+    double cpu_end  = cpu_seconds();
+    auto   wall_end = std::chrono::steady_clock::now();
+    {
+      std::lock_guard<std::mutex> lock(queue.mutex_);
+      stop = true;
+      queue.cv_.notify_all();
+    }
+    writer.join();
+    cpu += cpu_end - cpu_start;
+    wall += std::chrono::duration<double>(wall_end - wall_start).count();
+    state.SetIterationTime(std::chrono::duration<double>(wall_end - wall_start).count());
+  }
+  report_idle(state, cpu, wall);
+}
+BENCHMARK(BM_IdleResultQueue)->UseManualTime()->Iterations(5);
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,121 @@
+//
+// Created by Coonger on 2024/12/16.
+//
+// 基准用到的几种代表性表结构，每种 schema 一条 INSERT
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "redo_builder.h"
+
+namespace bench {
+
+using Column = loft::RedoRecordBuilder::Column;
+using Value  = loft::RedoRecordBuilder::Value;
+using Row    = loft::RedoRecordBuilder::Row;
+
+enum class Schema
+{
+  ALL_INT,       // 16 列 INT / BIGINT
+  WIDE_VARCHAR,  // 主键 + 8 列 VARCHAR(255)，每列 200 字节
+  JSON,          // 主键 + 1 列约 1KB 的 JSON
+  DECIMAL,       // 主键 + 8 列 DECIMAL(10,5)
+  TEMPORAL,      // 主键 + DATETIME(6) / TIMESTAMP(6) / TIME / YEAR
+};
+
+inline std::vector<Column> schema_columns(Schema schema)
+{
+  std::vector<Column> columns;
+  auto add = [&columns](const char *type, int length, int precision) {
+    columns.push_back(Column{"c" + std::to_string(columns.size()), type, length, precision});
+  };
+
+  add("INT", 11, 0);
+  switch (schema) {
+    case Schema::ALL_INT:
+      for (int i = 1; i < 16; i++) {
+        add(i % 2 == 0 ? "INT" : "BIGINT", i % 2 == 0 ? 11 : 20, 0);
+      }
+      break;
+    case Schema::WIDE_VARCHAR:
+      for (int i = 0; i < 8; i++) {
+        add("VARCHAR", 255, 0);
+      }
+      break;
+    case Schema::JSON: add("JSON", 0, 0); break;
+    case Schema::DECIMAL:
+      for (int i = 0; i < 8; i++) {
+        add("DECIMAL", 10, 5);
+      }
+      break;
+    case Schema::TEMPORAL:
+      add("DATETIME", 26, 6);
+      add("TIMESTAMP", 26, 6);
+      add("TIME", 8, 0);
+      add("YEAR", 4, 0);
+      break;
+  }
+  return columns;
+}
+
+inline std::string json_document()
+{
+  std::string doc = "{\"id\": 1, \"tags\": [";
+  for (int i = 0; i < 40; i++) {
+    doc += (i == 0 ? "" : ", ") + std::string("\"tag-") + std::to_string(i) + "\"";
+  }
+  doc += "], \"profile\": {\"name\": \"loft\", \"city\": \"hangzhou\", \"score\": 98.5}, \"note\": \"";
+  doc += std::string(600, 'n');
+  doc += "\"}";
+  return doc;
+}
+
+inline Row schema_row(Schema schema, const std::vector<Column> &columns, int64 id)
+{
+  Row row;
+  row.emplace_back(0, Value::of_long(id));
+  for (size_t i = 1; i < columns.size(); i++) {
+    const std::string &type = columns[i].type;
+    if (type == "INT") {
+      row.emplace_back(i, Value::of_long(id * 31 + static_cast<int64>(i)));
+    } else if (type == "BIGINT") {
+      row.emplace_back(i, Value::of_long(id * 1000003 + (1LL << 40)));
+    } else if (type == "VARCHAR") {
+      row.emplace_back(i, Value::of_string(loft::RedoRecordBuilder::encode_string(std::string(200, 'a' + i))));
+    } else if (type == "JSON") {
+      row.emplace_back(i, Value::of_string(loft::RedoRecordBuilder::encode_string(json_document())));
+    } else if (type == "DECIMAL") {
+      row.emplace_back(i, Value::of_string("12345.6789" + std::to_string(i % 10)));
+    } else if (type == "DATETIME" || type == "TIMESTAMP") {
+      row.emplace_back(i, Value::of_string(loft::RedoRecordBuilder::encode_string("2024-08-01 14:32:41.000054")));
+    } else if (type == "TIME") {
+      row.emplace_back(i, Value::of_string(loft::RedoRecordBuilder::encode_string("14:32:41")));
+    } else if (type == "YEAR") {
+      row.emplace_back(i, Value::of_long(2024));
+    }
+  }
+  (void)schema;
+  return row;
+}
+
+/// 一条 schema 对应的 INSERT 记录（不带长度前缀）
+inline std::vector<uint8> insert_record(loft::RedoRecordBuilder &builder, Schema schema, int64 id)
+{
+  loft::RedoRecordBuilder::Header header;
+  header.scn         = 54348795023361 + id;
+  header.seq         = 1;
+  header.lsn         = 279711 + id;
+  header.last_commit = id;
+  header.tx_seq      = id + 1;
+  header.msg_time    = "2024-08-01 14:32:41.000117";
+  header.tx_time     = "2024-08-01 14:32:39.000068";
+  header.check_point = std::to_string(id + 1) + "-1-" + std::to_string(header.scn);
+
+  auto columns = schema_columns(schema);
+  return builder.dml(header, "bench", "t_bench", "I", columns, {}, schema_row(schema, columns, id));
+}
+
+}  // namespace bench
@@ -0,0 +1,69 @@
+//
+// Created by Coonger on 2024/12/16.
+//
+// transformDML 在几种代表性表结构上的吞吐，以及单独构造 Table_map_event 的开销。
+// records/s 看 items_per_second，bytes/s 按输入的 FlatBuffer 记录大小计算
+//
+// 用法: transform_bench [--benchmark_filter=...]
+//
+#include <benchmark/benchmark.h>
+
+#include "schemas.h"
+#include "events/rows_event.h"
+#include "sql/field_types.h"
+#include "transform_manager.h"
+
+namespace {
+
+void BM_TransformDML(benchmark::State &state, bench::Schema schema)
+{
+  loft::RedoRecordBuilder builder;
+  std::vector<uint8>      record = bench::insert_record(builder, schema, 1);
+  const loft::DML        *dml    = loft::GetDML(record.data());
+
+  LogFormatTransformManager transformer;
+  for (auto _ : state) {
+    auto events = transformer.transformDML(dml);
+    benchmark::DoNotOptimize(events.data());
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(record.size()));
+}
+
+BENCHMARK_CAPTURE(BM_TransformDML, all_int, bench::Schema::ALL_INT);
+BENCHMARK_CAPTURE(BM_TransformDML, wide_varchar, bench::Schema::WIDE_VARCHAR);
+BENCHMARK_CAPTURE(BM_TransformDML, json, bench::Schema::JSON);
+BENCHMARK_CAPTURE(BM_TransformDML, decimal, bench::Schema::DECIMAL);
+BENCHMARK_CAPTURE(BM_TransformDML, temporal, bench::Schema::TEMPORAL);
+
+void BM_TableMapEvent(benchmark::State &state, bench::Schema schema)
+{
+  std::vector<mysql::FieldRef> field_vec;
+  size_t                       null_bit = 0;
+  for (const bench::Column &column : bench::schema_columns(schema)) {
+    enum_field_types type = type_map.at(column.type);
+    field_vec.emplace_back(mysql::make_field(column.name.c_str(),
+        column.length,
+        column.is_unsigned,
+        column.nullable,
+        null_bit,
+        type,
+        0,
+        column.precision));
+  }
+
+  const char *db  = "bench";
+  const char *tbl = "t_bench";
+  for (auto _ : state) {
+    Table_map_event event(Table_id(DML_TABLE_ID), field_vec.size(), db, strlen(db), tbl, strlen(tbl), field_vec, 0);
+    benchmark::DoNotOptimize(event.get_data_size());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_CAPTURE(BM_TableMapEvent, all_int, bench::Schema::ALL_INT);
+BENCHMARK_CAPTURE(BM_TableMapEvent, temporal, bench::Schema::TEMPORAL);
+
+}  // namespace
+
+BENCHMARK_MAIN();
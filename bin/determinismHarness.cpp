@@ -0,0 +1,483 @@
+//
+// Created by Coonger on 2024/12/17.
+//
+// 差分确定性测试：同一份输入分别走串行路径（transform()，经 MYSQL_BIN_LOG 逐条写）和批处理路径
+// （transformBatch，BatchProcessor::write_to_buffer 之后由写线程或 BinlogSequencer 落盘），
+// 在多组线程数 / batch 大小 / 写入模式 / 调度方式 / 输出后端 / 落盘策略下逐字节比较生成的 binlog 文件。
+// 激进的性能模式只有在这里全部一致后才能打开
+//
+// 比较分两轮：
+//   1. 文件足够大、不切换：每组配置都和串行路径的输出比较（串行的 transform() 不会切换文件）
+//   2. --rotate_kb 很小、频繁切换：每组配置都和第一组配置的输出比较，覆盖 Rotate_event 和切换点
+// FORMAT_DESCRIPTION_EVENT 的 header 时间戳和 create_timestamp、ROTATE_EVENT 的 header 时间戳
+// 取的是打开 / 切换文件时的系统时间，比较前置零
+//
+// 用法: determinismHarness [--input=FILE --ddl=N | --records=N --seed=N --tables=N] [--threads=1,4]
+//         [--batch_sizes=1,64,0] [--submit_batches=64] [--write_modes=serial,parallel]
+//         [--schedulers=fifo,partitioned] [--pipelines=threaded,coroutine] [--executors=thread_pool]
+//         [--backends=fstream,fd,mmap] [--durability=none,sync] [--zero_copy=0,1] [--rotate_kb=N] [--keep_dir=DIR]
+// 列表里的 0 表示默认值；全部一致时退出码为 0，有差异时为 2
+//
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/init_setting.h"
+#include "binlog_inspect.h"
+#include "log_file.h"
+#include "redo_generator.h"
+
+namespace {
+
+using Record = std::pair<std::vector<unsigned char>, bool>;  // (FlatBuffer, is_ddl)
+
+struct HarnessConfig
+{
+  std::string                input;
+  size_t                     ddl = 0;
+  loft::RedoGeneratorOptions generator;
+  std::vector<uint64>        threads        = {1, 4};
+  std::vector<uint64>        batch_sizes    = {1, 64, 0};
+  std::vector<uint64>        submit_batches = {64};
+  std::vector<std::string>   write_modes    = {"serial", "parallel"};
+  std::vector<std::string>   schedulers     = {"fifo", "partitioned"};
+  std::vector<std::string>   pipelines      = {"threaded", "coroutine"};
+  std::vector<std::string>   executors      = {"thread_pool"};
+  std::vector<std::string>   backends       = {"fstream", "fd", "mmap"};
+  std::vector<std::string>   durability     = {"none", "sync"};
+  std::vector<uint64>        zero_copy      = {0, 1};
+  uint64                     rotate_size    = 64ULL << 10;
+  std::string                keep_dir;  // 非空时保留第一个不一致的输出
+};
+
+/// 一组要比较的配置
+struct RunConfig
+{
+  int         threads;
+  size_t      batch_size;
+  size_t      submit_batch;
+  std::string write_mode;
+  std::string scheduler;
+  std::string pipeline;
+  std::string executor;
+  std::string backend;
+  std::string durability;
+  bool        zero_copy;
+
+  std::string to_string() const
+  {
+    char buf[320];
+    snprintf(buf, sizeof(buf),
+        "threads=%d batch_size=%zu submit_batch=%zu write_mode=%s scheduler=%s pipeline=%s executor=%s backend=%s "
+        "durability=%s zero_copy=%d",
+        threads, batch_size, submit_batch, write_mode.c_str(), scheduler.c_str(), pipeline.c_str(),
+        executor.c_str(), backend.c_str(), durability.c_str(), zero_copy ? 1 : 0);
+    return buf;
+  }
+};
+
+void usage(const char *program)
+{
+  fprintf(stderr,
+      "usage: %s [--input=FILE --ddl=N | --records=N --seed=N --tables=N] [--threads=LIST]\n"
+      "         [--batch_sizes=LIST] [--submit_batches=LIST] [--write_modes=serial,parallel]\n"
+      "         [--schedulers=fifo,partitioned] [--pipelines=threaded,coroutine]\n"
+      "         [--executors=thread_pool,work_stealing] [--backends=fstream,fd,io_uring,mmap]\n"
+      "         [--durability=none,flush,sync] [--zero_copy=0,1] [--rotate_kb=N] [--keep_dir=DIR]\n",
+      program);
+}
+
+std::vector<std::string> split(const std::string &list)
+{
+  std::vector<std::string> items;
+  for (size_t begin = 0, end; begin < list.size(); begin = end + 1) {
+    end = list.find(',', begin);
+    end = end == std::string::npos ? list.size() : end;
+    items.push_back(list.substr(begin, end - begin));
+  }
+  return items;
+}
+
+std::vector<uint64> split_numbers(const std::string &list)
+{
+  std::vector<uint64> numbers;
+  for (const std::string &item : split(list)) {
+    numbers.push_back(std::strtoull(item.c_str(), nullptr, 10));
+  }
+  return numbers;
+}
+
+/// 列表里每一项都在 names 里
+bool all_of(const std::vector<std::string> &items, std::initializer_list<const char *> names)
+{
+  return !items.empty() && std::all_of(items.begin(), items.end(), [&](const std::string &item) {
+    return std::any_of(names.begin(), names.end(), [&](const char *name) { return item == name; });
+  });
+}
+
+bool parse_args(int argc, char *argv[], HarnessConfig &config)
+{
+  config.generator.records      = 20000;
+  config.generator.output_bytes = 0;
+
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    const char *eq  = strchr(arg, '=');
+    if (strncmp(arg, "--", 2) != 0 || eq == nullptr) {
+      return false;
+    }
+    std::string key(arg + 2, eq);
+    const char *value = eq + 1;
+
+    bool ok = true;
+    if (key == "input") {
+      config.input = value;
+    } else if (key == "ddl") {
+      config.ddl = std::strtoull(value, nullptr, 10);
+    } else if (key == "records") {
+      config.generator.records = std::strtoull(value, nullptr, 10);
+    } else if (key == "seed") {
+      config.generator.seed = std::strtoull(value, nullptr, 10);
+    } else if (key == "tables") {
+      config.generator.tables = std::atoi(value);
+    } else if (key == "threads") {
+      config.threads = split_numbers(value);
+      ok             = !config.threads.empty();
+    } else if (key == "batch_sizes") {
+      config.batch_sizes = split_numbers(value);
+      ok                 = !config.batch_sizes.empty();
+    } else if (key == "submit_batches") {
+      config.submit_batches = split_numbers(value);
+      ok = !config.submit_batches.empty() && std::find(config.submit_batches.begin(), config.submit_batches.end(), 0) ==
+                                                 config.submit_batches.end();
+    } else if (key == "write_modes") {
+      config.write_modes = split(value);
+      ok                 = all_of(config.write_modes, {"serial", "parallel"});
+    } else if (key == "schedulers") {
+      config.schedulers = split(value);
+      ok                = all_of(config.schedulers, {"fifo", "partitioned"});
+    } else if (key == "pipelines") {
+      config.pipelines = split(value);
+      ok               = all_of(config.pipelines, {"threaded", "coroutine"});
+    } else if (key == "executors") {
+      config.executors = split(value);
+      ok               = all_of(config.executors, {"thread_pool", "work_stealing"});
+    } else if (key == "backends") {
+      config.backends = split(value);
+      ok              = all_of(config.backends, {"fstream", "fd", "io_uring", "mmap"});
+    } else if (key == "durability") {
+      config.durability = split(value);
+      ok                = all_of(config.durability, {"none", "flush", "sync"});
+    } else if (key == "zero_copy") {
+      config.zero_copy = split_numbers(value);
+      ok               = !config.zero_copy.empty();
+    } else if (key == "rotate_kb") {
+      config.rotate_size = std::strtoull(value, nullptr, 10) << 10;
+    } else if (key == "keep_dir") {
+      config.keep_dir = value;
+    } else {
+      ok = false;
+    }
+    if (!ok) {
+      fprintf(stderr, "invalid argument: %s\n", arg);
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief 读入长度前缀的 redo 文件，或者用 RedoGenerator 在内存里生成同样的流
+ */
+bool load_records(const HarnessConfig &config, std::vector<Record> &records)
+{
+  if (!config.input.empty()) {
+    RedoLogFileReader reader;
+    auto [data, size] = reader.readFromFile(config.input);
+    if (data == nullptr) {
+      return false;
+    }
+    size_t offset = 0;
+    while (offset + sizeof(uint32) <= size) {
+      uint32 len = 0;
+      memcpy(&len, data.get() + offset, sizeof(len));
+      offset += sizeof(len);
+      if (offset + len > size) {
+        fprintf(stderr, "truncated record in %s at offset %zu\n", config.input.c_str(), offset);
+        return false;
+      }
+      auto *begin = reinterpret_cast<unsigned char *>(data.get() + offset);
+      records.emplace_back(std::vector<unsigned char>(begin, begin + len), records.size() < config.ddl);
+      offset += len;
+    }
+    return true;
+  }
+
+  loft::RedoGenerator generator(config.generator);
+  RC                  rc = generator.init();
+  if (rc != RC::SUCCESS) {
+    fprintf(stderr, "invalid generator options: %s\n", strrc(rc));
+    return false;
+  }
+  std::vector<uint8> record;
+  bool               is_ddl = false;
+  while (generator.next(record, is_ddl)) {
+    records.emplace_back(std::vector<unsigned char>(record.begin(), record.end()), is_ddl);
+  }
+  return true;
+}
+
+bool make_temp_dir(std::filesystem::path &dir)
+{
+  dir = loft::make_temp_dir("loft-determinism");
+  if (dir.empty()) {
+    perror("mkdtemp");
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief 参考输出：每条记录同步调用 transform()，和 testOnlyInsert 改成批量提交之前的用法一致
+ */
+bool run_serial(const std::vector<Record> &records, const std::filesystem::path &dir, uint64 file_size)
+{
+  auto manager = std::make_unique<LogFileManager>();
+  RC   rc      = manager->init(dir.c_str(), DEFAULT_BINLOG_FILE_NAME_PREFIX, file_size);
+  if (rc != RC::SUCCESS) {
+    fprintf(stderr, "failed to init LogFileManager: %s\n", strrc(rc));
+    return false;
+  }
+  manager->last_file(*manager->get_file_writer());
+
+  for (const auto &[data, is_ddl] : records) {
+    std::vector<unsigned char> buf = data;
+    rc                             = manager->transform(std::move(buf), is_ddl);
+    if (rc != RC::SUCCESS) {
+      fprintf(stderr, "serial transform failed: %s\n", strrc(rc));
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief 按 run 的配置用 transformBatch 提交全部记录，等所有批次完成后关闭
+ */
+bool run_batch(const std::vector<Record> &records, const RunConfig &run, const std::filesystem::path &dir,
+    uint64 file_size)
+{
+  LogFileOptions options;
+  options.min_workers           = run.threads;
+  options.max_workers           = run.threads;
+  options.autoscale_interval_ms = 0;
+  options.worker_threads        = run.threads;
+  options.partitions            = run.threads;
+  options.transform_stages      = run.threads;
+  options.zero_copy             = run.zero_copy;
+  options.write_mode = run.write_mode == "parallel" ? BinlogWriteMode::PARALLEL : BinlogWriteMode::SERIAL;
+  options.scheduler  = run.scheduler == "partitioned" ? SchedulerType::PARTITIONED : SchedulerType::FIFO;
+  options.pipeline   = run.pipeline == "coroutine" ? PipelineMode::COROUTINE : PipelineMode::THREADED;
+  options.executor   = run.executor == "work_stealing" ? ExecutorType::WORK_STEALING : ExecutorType::THREAD_POOL;
+  options.backend    = run.backend == "fd"         ? BinlogBackend::FD
+                       : run.backend == "io_uring" ? BinlogBackend::IO_URING
+                       : run.backend == "mmap"     ? BinlogBackend::MMAP
+                                                   : BinlogBackend::FSTREAM;
+  options.durability = run.durability == "flush"  ? BinlogDurability::FLUSH
+                       : run.durability == "sync" ? BinlogDurability::SYNC
+                                                  : BinlogDurability::NONE;
+  if (run.batch_size > 0) {
+    options.batch_max_size = run.batch_size;
+    options.batch_min_size = std::min(options.batch_min_size, run.batch_size);
+  }
+
+  auto manager = std::make_unique<LogFileManager>(options);
+  RC   rc      = manager->init(dir.c_str(), DEFAULT_BINLOG_FILE_NAME_PREFIX, file_size);
+  if (rc != RC::SUCCESS) {
+    fprintf(stderr, "failed to init LogFileManager: %s\n", strrc(rc));
+    return false;
+  }
+  manager->last_file(*manager->get_file_writer());
+
+  // 和 pipelineHarness 一样，DDL 单独成批
+  std::vector<BatchHandle> handles;
+  std::vector<Task>        batch;
+  auto                     submit = [&] {
+    if (batch.empty()) {
+      return;
+    }
+    BatchHandle handle = manager->transformBatch(batch);
+    while (handle->done() && handle->status() == RC::SPEED_LIMIT) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));  // 等写线程归还预算
+      handle = manager->transformBatch(batch);
+    }
+    handles.push_back(std::move(handle));
+    batch.clear();
+  };
+  for (const auto &[data, is_ddl] : records) {
+    if (!batch.empty() && (batch.size() >= run.submit_batch || is_ddl != batch.back().is_ddl_)) {
+      submit();
+    }
+    batch.emplace_back(std::vector<unsigned char>(data), is_ddl);
+  }
+  submit();
+  manager->flush();
+
+  bool ok = true;
+  for (auto &handle : handles) {
+    RC result = handle->wait();
+    if (result != RC::SUCCESS) {
+      fprintf(stderr, "batch failed: %s\n", strrc(result));
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+/**
+ * @brief 比较两个目录下的 binlog 文件，不一致时输出第一个不同的文件和偏移
+ */
+bool compare_dirs(const std::filesystem::path &expected_dir, const std::filesystem::path &actual_dir)
+{
+  std::vector<std::filesystem::path> expected = loft::binlog_files(expected_dir);
+  std::vector<std::filesystem::path> actual   = loft::binlog_files(actual_dir);
+  if (expected.size() != actual.size()) {
+    fprintf(stderr, "  file count differs: expected %zu, actual %zu\n", expected.size(), actual.size());
+    return false;
+  }
+
+  for (size_t i = 0; i < expected.size(); i++) {
+    if (expected[i].filename() != actual[i].filename()) {
+      fprintf(stderr, "  file name differs: expected %s, actual %s\n",
+          expected[i].filename().c_str(), actual[i].filename().c_str());
+      return false;
+    }
+    std::vector<char> a = loft::read_file(expected[i]);
+    std::vector<char> b = loft::read_file(actual[i]);
+    loft::normalize_binlog(a);
+    loft::normalize_binlog(b);
+    if (a == b) {
+      continue;
+    }
+    auto   mismatch = std::mismatch(a.begin(), a.end(), b.begin(), b.end());
+    size_t offset   = mismatch.first - a.begin();
+    fprintf(stderr, "  %s differs at offset %zu (expected size %zu, actual size %zu)\n",
+        expected[i].filename().c_str(), offset, a.size(), b.size());
+    return false;
+  }
+  return true;
+}
+
+std::vector<RunConfig> expand(const HarnessConfig &config)
+{
+  std::vector<RunConfig> runs;
+  for (uint64 threads : config.threads)
+    for (uint64 batch_size : config.batch_sizes)
+      for (uint64 submit_batch : config.submit_batches)
+        for (const std::string &write_mode : config.write_modes)
+          for (const std::string &scheduler : config.schedulers)
+            for (const std::string &pipeline : config.pipelines)
+              for (const std::string &executor : config.executors)
+                for (const std::string &backend : config.backends)
+                  for (const std::string &durability : config.durability)
+                    for (uint64 zero_copy : config.zero_copy) {
+                      int n = threads > 0 ? static_cast<int>(threads)
+                                          : static_cast<int>(std::thread::hardware_concurrency());
+                      runs.push_back(RunConfig{n, batch_size, submit_batch, write_mode, scheduler, pipeline, executor,
+                          backend, durability, zero_copy != 0});
+                    }
+  return runs;
+}
+
+/**
+ * @brief 不一致时把两份输出挪到 keep_dir 下，方便用 mysqlbinlog 对照
+ */
+void keep_outputs(const std::string &keep_dir, const std::filesystem::path &expected, const std::filesystem::path &actual)
+{
+  if (keep_dir.empty() || std::filesystem::exists(keep_dir)) {
+    return;
+  }
+  std::filesystem::create_directories(keep_dir);
+  std::filesystem::copy(expected, std::filesystem::path(keep_dir) / "expected");
+  std::filesystem::copy(actual, std::filesystem::path(keep_dir) / "actual");
+  fprintf(stderr, "  outputs kept in %s\n", keep_dir.c_str());
+}
+
+}  // namespace
+
+int main(int argc, char *argv[])
+{
+  HarnessConfig config;
+  if (!parse_args(argc, argv, config)) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  std::vector<Record> records;
+  if (!load_records(config, records)) {
+    return 1;
+  }
+  std::vector<RunConfig> runs = expand(config);
+  printf("records=%zu configs=%zu\n", records.size(), runs.size());
+
+  std::filesystem::path reference_dir;
+  if (!make_temp_dir(reference_dir) || !run_serial(records, reference_dir, DEFAULT_BINLOG_FILE_SIZE)) {
+    return 1;
+  }
+  if (loft::binlog_files(reference_dir).size() != 1) {
+    fprintf(stderr, "serial reference rotated, use a smaller input\n");
+    return 1;
+  }
+
+  size_t failures = 0;
+  // 第 1 轮：不切换文件，和串行路径比较
+  for (const RunConfig &run : runs) {
+    std::filesystem::path dir;
+    if (!make_temp_dir(dir)) {
+      return 1;
+    }
+    bool same = run_batch(records, run, dir, DEFAULT_BINLOG_FILE_SIZE) && compare_dirs(reference_dir, dir);
+    printf("%s serial-reference %s\n", same ? "OK  " : "FAIL", run.to_string().c_str());
+    if (!same) {
+      keep_outputs(config.keep_dir, reference_dir, dir);
+      failures++;
+    }
+    std::filesystem::remove_all(dir);
+  }
+  std::filesystem::remove_all(reference_dir);
+
+  // 第 2 轮：频繁切换文件，和第一组配置比较
+  std::filesystem::path rotate_reference;
+  if (!make_temp_dir(rotate_reference)) {
+    return 1;
+  }
+  if (!run_batch(records, runs.front(), rotate_reference, config.rotate_size)) {
+    fprintf(stderr, "rotation reference failed: %s\n", runs.front().to_string().c_str());
+    return 1;
+  }
+  printf("rotation reference: %zu files, %s\n", loft::binlog_files(rotate_reference).size(),
+      runs.front().to_string().c_str());
+  for (size_t i = 1; i < runs.size(); i++) {
+    std::filesystem::path dir;
+    if (!make_temp_dir(dir)) {
+      return 1;
+    }
+    bool same = run_batch(records, runs[i], dir, config.rotate_size) && compare_dirs(rotate_reference, dir);
+    printf("%s rotation %s\n", same ? "OK  " : "FAIL", runs[i].to_string().c_str());
+    if (!same) {
+      keep_outputs(config.keep_dir, rotate_reference, dir);
+      failures++;
+    }
+    std::filesystem::remove_all(dir);
+  }
+  std::filesystem::remove_all(rotate_reference);
+
+  printf("%zu of %zu comparisons differ\n", failures, runs.size() * 2 - 1);
+  return failures == 0 ? 0 : 2;
+}
@@ -0,0 +1,180 @@
+//
+// Created by Coonger on 2024/12/4.
+//
+// 对比 binlog 输出流后端（fstream / fd / io_uring / mmap）的追加写吞吐：
+// 按写线程的方式，每个 batch 写 BATCH_SIZE 条 event 后 flush，每 sync_every 个 batch sync 一次
+//
+// 用法: ostreamBenchmark [--dir=DIR] [--total_mb=N] [--event_size=N] [--sync_every=N]
+//
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "binlog.h"
+#include "uring_ostream.h"
+
+namespace {
+
+constexpr size_t BATCH_SIZE = 4096;  // 和 LogFileManager::BATCH_SIZE 一致
+
+struct BenchConfig
+{
+  std::string dir        = DEFAULT_BINLOG_FILE_DIR;
+  size_t      total_mb   = 512;
+  size_t      event_size = 200;
+  size_t      sync_every = 16;  // 0 表示只在最后 sync 一次
+};
+
+struct BenchResult
+{
+  double seconds    = 0;
+  double mb_per_sec = 0;
+  bool   ok         = true;
+};
+
+std::unique_ptr<Binlog_file_ostream> make_ostream(BinlogBackend backend, const char *path, size_t max_size)
+{
+  RC rc;
+  std::unique_ptr<Binlog_file_ostream> out;
+  switch (backend) {
+    case BinlogBackend::FSTREAM: out = std::make_unique<Binlog_ofile>(path, rc); break;
+    case BinlogBackend::FD: out = std::make_unique<Binlog_fd_ofile>(path, rc); break;
+    case BinlogBackend::IO_URING: out = std::make_unique<Binlog_uring_ofile>(path, rc); break;
+    case BinlogBackend::MMAP:
+      out = std::make_unique<Binlog_mmap_ofile>(path, max_size, BinlogDurability::NONE, rc);
+      break;
+  }
+  return rc == RC::IOERR_OPEN ? nullptr : std::move(out);
+}
+
+BenchResult run(
+    BinlogBackend backend, const std::string &path, size_t total_bytes, size_t event_size, size_t sync_every)
+{
+  std::filesystem::remove(path);
+  BenchResult result;
+  auto        out = make_ostream(backend, path.c_str(), total_bytes);
+  if (out == nullptr) {
+    result.ok = false;
+    return result;
+  }
+
+  std::vector<uchar> event(event_size, 0x5a);
+  const size_t       events = total_bytes / event_size;
+
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < events; ++i) {
+    result.ok &= out->write(event.data(), event.size());
+    if ((i + 1) % BATCH_SIZE == 0) {
+      out->flush();
+      if (sync_every > 0 && ((i + 1) / BATCH_SIZE) % sync_every == 0) {
+        result.ok &= out->sync() == RC::SUCCESS;
+      }
+    }
+  }
+  result.ok &= out->sync() == RC::SUCCESS;
+  out->close();
+  auto end = std::chrono::steady_clock::now();
+
+  result.seconds    = std::chrono::duration<double>(end - start).count();
+  result.mb_per_sec = static_cast<double>(events * event_size) / (1 << 20) / result.seconds;
+  std::filesystem::remove(path);
+  return result;
+}
+
+void usage(const char *program)
+{
+  fprintf(stderr, "usage: %s [--dir=DIR] [--total_mb=N] [--event_size=N] [--sync_every=N]\n", program);
+}
+
+/// 整个 value 都是十进制数字才算合法，strtoull 会把 "abc" 当成 0、把 "-1" 绕成很大的数
+bool parse_number(const char *value, size_t &out)
+{
+  if (*value < '0' || *value > '9') {
+    return false;
+  }
+  char *end = nullptr;
+  errno     = 0;
+  out       = std::strtoull(value, &end, 10);
+  return errno == 0 && *end == '\0';
+}
+
+bool parse_args(int argc, char *argv[], BenchConfig &config)
+{
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    const char *eq  = strchr(arg, '=');
+    if (strncmp(arg, "--", 2) != 0 || eq == nullptr) {
+      return false;
+    }
+    std::string key(arg + 2, eq);
+    const char *value = eq + 1;
+
+    bool ok = true;
+    if (key == "dir") {
+      config.dir = value;
+      ok         = !config.dir.empty();
+    } else if (key == "total_mb") {
+      ok = parse_number(value, config.total_mb) && config.total_mb > 0 && config.total_mb <= (SIZE_MAX >> 20);
+    } else if (key == "event_size") {
+      ok = parse_number(value, config.event_size) && config.event_size > 0;
+    } else if (key == "sync_every") {
+      ok = parse_number(value, config.sync_every);
+    } else {
+      ok = false;
+    }
+    if (!ok) {
+      fprintf(stderr, "invalid argument: %s\n", arg);
+      return false;
+    }
+  }
+  if (config.event_size > config.total_mb << 20) {
+    fprintf(stderr, "event_size is larger than total_mb\n");
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[])
+{
+  if (argc == 2 && strcmp(argv[1], "--help") == 0) {
+    usage(argv[0]);
+    return 0;
+  }
+  BenchConfig config;
+  if (!parse_args(argc, argv, config)) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  std::filesystem::create_directories(config.dir);
+  std::string path = config.dir + "/ostream_bench.bin";
+
+  printf("total=%zuMB event_size=%zuB batch=%zu sync_every=%zu batches, io_uring %s\n", config.total_mb,
+      config.event_size, BATCH_SIZE, config.sync_every,
+      Binlog_uring_ofile::is_supported() ? "supported" : "unsupported");
+
+  const std::pair<const char *, BinlogBackend> backends[] = {
+      {"fstream", BinlogBackend::FSTREAM},
+      {"fd", BinlogBackend::FD},
+      {"io_uring", BinlogBackend::IO_URING},
+      {"mmap", BinlogBackend::MMAP},
+  };
+  for (const auto &[name, backend] : backends) {
+    BenchResult r = run(backend, path, config.total_mb << 20, config.event_size, config.sync_every);
+    if (!r.ok) {
+      printf("%-10s failed\n", name);
+      continue;
+    }
+    printf("%-10s %8.3f s %10.1f MB/s\n", name, r.seconds, r.mb_per_sec);
+  }
+  return 0;
+}
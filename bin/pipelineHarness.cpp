@@ -0,0 +1,461 @@
+//
+// Created by Coonger on 2024/12/17.
+//
+// 端到端吞吐和延迟压测：把 redo 文件全部读进内存，按 submit_batch 条一批用 transformBatch 提交，
+// 等全部落盘后输出 JSON：
+//   - records/s、输入和输出的 MB/s
+//   - 收集、转换、写入各阶段的利用率（LogFileManager::stage_stats() 的忙碌时间 / 墙钟时间 / 线程数）
+//   - 记录延迟的 p50 / p99 / p999：从提交到所在批次的完成回调
+//   - 用 -DLOFT_ALLOC_ACCOUNTING=ON 编译时，各阶段每条记录的分配字节数和次数、结束时的存活字节数和峰值
+// 输入文件的格式和 redoGenerator 的输出一致，开头 ddl 条是 DDL
+//
+// 用法: pipelineHarness --input=FILE[,FILE...] [--ddl=N] [--threads=N] [--batch_size=N] [--submit_batch=N]
+//         [--backend=fstream|fd|io_uring|mmap] [--write_mode=serial|parallel] [--durability=none|flush|sync]
+//         [--executor=thread_pool|work_stealing] [--scheduler=fifo|partitioned] [--pipeline=threaded|coroutine]
+//         [--zero_copy=0|1] [--file_size_mb=N] [--output_dir=DIR] [--json=PATH] [--trace=PATH]
+//
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/alloc_accounting.h"
+#include "common/init_setting.h"
+#include "log_file.h"
+
+namespace {
+
+struct HarnessConfig
+{
+  std::vector<std::string> inputs;
+  size_t                   ddl          = 0;  // 每个输入文件开头的 DDL 条数
+  int                      threads      = 0;  // 0 表示取 CPU 核数
+  size_t                   batch_size   = 0;  // 收集线程 batch 大小的上限，0 表示用默认值
+  size_t                   submit_batch = 256;
+  uint64                   file_size    = DEFAULT_BINLOG_FILE_SIZE;
+  std::string              output_dir;
+  std::string              json;
+  LogFileOptions           options;
+  const char              *backend    = "fstream";  // 下面几个是 options 里枚举的名字，输出到 JSON
+  const char              *write_mode = "serial";
+  const char              *durability = "none";
+  const char              *executor   = "thread_pool";
+  const char              *scheduler  = "fifo";
+  const char              *pipeline   = "threaded";
+};
+
+/**
+ * @brief 完成回调里收集的延迟样本，一批记录共用一个样本
+ */
+class LatencyRecorder
+{
+public:
+  void add(uint64 latency_ns, size_t records)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    samples_.emplace_back(latency_ns, records);
+    completed_ += records;
+    cv_.notify_all();
+  }
+
+  void fail(size_t records)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    failed_ += records;
+    completed_ += records;
+    cv_.notify_all();
+  }
+
+  void wait(size_t records)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [&] { return completed_ >= records; });
+  }
+
+  size_t failed()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return failed_;
+  }
+
+  /// 按记录数加权的分位数，q 在 [0, 1]
+  uint64 percentile(double q)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (samples_.empty()) {
+      return 0;
+    }
+    std::sort(samples_.begin(), samples_.end());
+    size_t total = 0;
+    for (const auto &[latency, count] : samples_) {
+      total += count;
+    }
+    auto   rank       = static_cast<size_t>(q * static_cast<double>(total - 1));
+    size_t cumulative = 0;
+    for (const auto &[latency, count] : samples_) {
+      cumulative += count;
+      if (cumulative > rank) {
+        return latency;
+      }
+    }
+    return samples_.back().first;
+  }
+
+private:
+  std::mutex                             mutex_;
+  std::condition_variable                cv_;
+  std::vector<std::pair<uint64, size_t>> samples_;  // (延迟, 记录数)
+  size_t                                 completed_ = 0;
+  size_t                                 failed_    = 0;
+};
+
+void usage(const char *program)
+{
+  fprintf(stderr,
+      "usage: %s --input=FILE[,FILE...] [--ddl=N] [--threads=N] [--batch_size=N] [--submit_batch=N]\n"
+      "         [--backend=fstream|fd|io_uring|mmap] [--write_mode=serial|parallel] [--durability=none|flush|sync]\n"
+      "         [--executor=thread_pool|work_stealing] [--scheduler=fifo|partitioned] [--pipeline=threaded|coroutine]\n"
+      "         [--zero_copy=0|1] [--file_size_mb=N] [--output_dir=DIR] [--json=PATH] [--trace=PATH]\n",
+      program);
+}
+
+/// 在 names 里查找 value，找到时把 choices 里对应的值写到 out
+template <typename E, size_t N>
+bool parse_choice(const char *value, const char *const (&names)[N], const E (&choices)[N], E &out, const char *&name)
+{
+  for (size_t i = 0; i < N; i++) {
+    if (strcmp(value, names[i]) == 0) {
+      out  = choices[i];
+      name = names[i];
+      return true;
+    }
+  }
+  return false;
+}
+
+bool parse_args(int argc, char *argv[], HarnessConfig &config)
+{
+  static const char *const      BACKENDS[]       = {"fstream", "fd", "io_uring", "mmap"};
+  static const BinlogBackend    BACKEND_VALUES[] = {
+      BinlogBackend::FSTREAM, BinlogBackend::FD, BinlogBackend::IO_URING, BinlogBackend::MMAP};
+  static const char *const      WRITE_MODES[]       = {"serial", "parallel"};
+  static const BinlogWriteMode  WRITE_MODE_VALUES[] = {BinlogWriteMode::SERIAL, BinlogWriteMode::PARALLEL};
+  static const char *const      DURABILITIES[]      = {"none", "flush", "sync"};
+  static const BinlogDurability DURABILITY_VALUES[] = {
+      BinlogDurability::NONE, BinlogDurability::FLUSH, BinlogDurability::SYNC};
+  static const char *const   EXECUTORS[]       = {"thread_pool", "work_stealing"};
+  static const ExecutorType  EXECUTOR_VALUES[] = {ExecutorType::THREAD_POOL, ExecutorType::WORK_STEALING};
+  static const char *const   SCHEDULERS[]       = {"fifo", "partitioned"};
+  static const SchedulerType SCHEDULER_VALUES[] = {SchedulerType::FIFO, SchedulerType::PARTITIONED};
+  static const char *const   PIPELINES[]       = {"threaded", "coroutine"};
+  static const PipelineMode  PIPELINE_VALUES[] = {PipelineMode::THREADED, PipelineMode::COROUTINE};
+
+  LogFileOptions &options = config.options;
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    const char *eq  = strchr(arg, '=');
+    if (strncmp(arg, "--", 2) != 0 || eq == nullptr) {
+      return false;
+    }
+    std::string key(arg + 2, eq);
+    const char *value = eq + 1;
+
+    bool ok = true;
+    if (key == "input") {
+      std::string list = value;
+      for (size_t begin = 0, end; begin < list.size(); begin = end + 1) {
+        end = list.find(',', begin);
+        end = end == std::string::npos ? list.size() : end;
+        config.inputs.push_back(list.substr(begin, end - begin));
+      }
+    } else if (key == "ddl") {
+      config.ddl = std::strtoull(value, nullptr, 10);
+    } else if (key == "threads") {
+      config.threads = std::atoi(value);
+    } else if (key == "batch_size") {
+      config.batch_size = std::strtoull(value, nullptr, 10);
+    } else if (key == "submit_batch") {
+      config.submit_batch = std::max<size_t>(1, std::strtoull(value, nullptr, 10));
+    } else if (key == "file_size_mb") {
+      config.file_size = std::strtoull(value, nullptr, 10) << 20;
+    } else if (key == "output_dir") {
+      config.output_dir = value;
+    } else if (key == "json") {
+      config.json = value;
+    } else if (key == "trace") {
+      options.trace_file = value;
+    } else if (key == "zero_copy") {
+      options.zero_copy = std::atoi(value) != 0;
+    } else if (key == "backend") {
+      ok = parse_choice(value, BACKENDS, BACKEND_VALUES, options.backend, config.backend);
+    } else if (key == "write_mode") {
+      ok = parse_choice(value, WRITE_MODES, WRITE_MODE_VALUES, options.write_mode, config.write_mode);
+    } else if (key == "durability") {
+      ok = parse_choice(value, DURABILITIES, DURABILITY_VALUES, options.durability, config.durability);
+    } else if (key == "executor") {
+      ok = parse_choice(value, EXECUTORS, EXECUTOR_VALUES, options.executor, config.executor);
+    } else if (key == "scheduler") {
+      ok = parse_choice(value, SCHEDULERS, SCHEDULER_VALUES, options.scheduler, config.scheduler);
+    } else if (key == "pipeline") {
+      ok = parse_choice(value, PIPELINES, PIPELINE_VALUES, options.pipeline, config.pipeline);
+    } else {
+      ok = false;
+    }
+    if (!ok) {
+      fprintf(stderr, "invalid argument: %s\n", arg);
+      return false;
+    }
+  }
+  return !config.inputs.empty();
+}
+
+/**
+ * @brief 读入一个长度前缀的 redo 文件，按 submit_batch 条切成提交批次
+ */
+bool load_input(const std::string &path, const HarnessConfig &config, std::vector<std::vector<Task>> &batches,
+    size_t &records, uint64 &bytes)
+{
+  RedoLogFileReader reader;
+  auto [data, size] = reader.readFromFile(path);
+  if (data == nullptr) {
+    return false;
+  }
+
+  // DDL 单独成批，不和 DML 混在一个提交里
+  size_t offset = 0;
+  size_t index  = 0;
+  while (offset + sizeof(uint32) <= size) {
+    uint32 len = 0;
+    memcpy(&len, data.get() + offset, sizeof(len));
+    offset += sizeof(len);
+    if (offset + len > size) {
+      fprintf(stderr, "truncated record in %s at offset %zu\n", path.c_str(), offset);
+      return false;
+    }
+
+    bool is_ddl = index < config.ddl;
+    if (batches.empty() || batches.back().size() >= config.submit_batch || is_ddl != batches.back().back().is_ddl_) {
+      batches.emplace_back();
+      batches.back().reserve(config.submit_batch);
+    }
+    auto *begin = reinterpret_cast<unsigned char *>(data.get() + offset);
+    batches.back().emplace_back(std::vector<unsigned char>(begin, begin + len), is_ddl);
+
+    offset += len;
+    bytes += len;
+    records++;
+    index++;
+  }
+  return true;
+}
+
+uint64 binlog_bytes(const std::filesystem::path &dir)
+{
+  uint64 bytes = 0;
+  for (const auto &entry : std::filesystem::directory_iterator(dir)) {
+    std::string name = entry.path().filename().string();
+    if (entry.is_regular_file() && name.rfind(DEFAULT_BINLOG_FILE_NAME_PREFIX, 0) == 0 &&
+        entry.path().extension() != ".index") {
+      bytes += entry.file_size();
+    }
+  }
+  return bytes;
+}
+
+/**
+ * @brief 各阶段在压测期间的分配，按记录数平均；没有打开分配统计时输出 null
+ */
+std::string allocation_report(const std::vector<AllocStats> &before, size_t records)
+{
+  if (!alloc_accounting_enabled()) {
+    return "null";
+  }
+  std::string report = "{";
+  char        buf[256];
+  for (size_t i = 0; i < static_cast<size_t>(AllocStage::COUNT); i++) {
+    AllocStats after = alloc_stats(static_cast<AllocStage>(i));
+    double     n     = std::max<size_t>(records, 1);
+    snprintf(buf, sizeof(buf),
+        "%s\"%s\": {\"bytes_per_record\": %.1f, \"allocs_per_record\": %.3f, \"live_bytes\": %lld, "
+        "\"peak_bytes\": %lld}",
+        i == 0 ? "" : ", ",
+        alloc_stage_name(static_cast<AllocStage>(i)),
+        (after.allocated_bytes - before[i].allocated_bytes) / n,
+        (after.allocations - before[i].allocations) / n,
+        (long long)after.live_bytes,
+        (long long)after.peak_bytes);
+    report += buf;
+  }
+  return report + "}";
+}
+
+}  // namespace
+
+int main(int argc, char *argv[])
+{
+  HarnessConfig config;
+  if (!parse_args(argc, argv, config)) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  int             threads = config.threads > 0 ? config.threads : static_cast<int>(std::thread::hardware_concurrency());
+  LogFileOptions &options = config.options;
+  // 画扩展曲线时转换线程数要固定，关掉自动调整
+  options.min_workers           = threads;
+  options.max_workers           = threads;
+  options.autoscale_interval_ms = 0;
+  options.worker_threads        = threads;
+  options.partitions            = threads;
+  options.transform_stages      = threads;
+  if (config.batch_size > 0) {
+    options.batch_max_size = config.batch_size;
+    options.batch_min_size = std::min(options.batch_min_size, config.batch_size);
+  }
+
+  // 输出目录：没有指定时用一个临时目录，结束后删除
+  bool                  temporary_dir = config.output_dir.empty();
+  std::filesystem::path output_dir;
+  if (temporary_dir) {
+    char tmpl[] = "/tmp/loft-harness-XXXXXX";
+    if (mkdtemp(tmpl) == nullptr) {
+      perror("mkdtemp");
+      return 1;
+    }
+    output_dir = tmpl;
+  } else {
+    output_dir = config.output_dir;
+    std::filesystem::create_directories(output_dir);
+    if (!std::filesystem::is_empty(output_dir)) {
+      fprintf(stderr, "output dir %s is not empty\n", output_dir.c_str());
+      return 1;
+    }
+  }
+
+  std::vector<std::vector<Task>> batches;
+  size_t                         records     = 0;
+  uint64                         input_bytes = 0;
+  for (const std::string &input : config.inputs) {
+    AllocStageScope ingest(AllocStage::INGEST);  // 读进来的 Task 就是生产者交给流水线的输入
+    if (!load_input(input, config, batches, records, input_bytes)) {
+      fprintf(stderr, "failed to load %s\n", input.c_str());
+      return 1;
+    }
+  }
+
+  auto manager = std::make_unique<LogFileManager>(options);
+  RC   rc      = manager->init(output_dir.c_str(), DEFAULT_BINLOG_FILE_NAME_PREFIX, config.file_size);
+  if (rc != RC::SUCCESS) {
+    fprintf(stderr, "failed to init LogFileManager: %s\n", strrc(rc));
+    return 1;
+  }
+  manager->last_file(*manager->get_file_writer());
+
+  std::vector<AllocStats> allocs_before;
+  for (size_t i = 0; i < static_cast<size_t>(AllocStage::COUNT); i++) {
+    allocs_before.push_back(alloc_stats(static_cast<AllocStage>(i)));
+  }
+
+  LatencyRecorder latency;
+  auto            start = std::chrono::steady_clock::now();
+  for (auto &batch : batches) {
+    size_t count = batch.size();
+    for (int attempt = 0;; attempt++) {
+      if (attempt > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));  // 等写线程归还预算
+      }
+      auto submit_time = std::chrono::steady_clock::now();
+      rc = manager->transformBatch(batch, [&latency, submit_time, count](RC result) {
+        if (result == RC::SPEED_LIMIT) {
+          return;  // 没有提交成功，外层会重试
+        }
+        if (result != RC::SUCCESS) {
+          latency.fail(count);
+          return;
+        }
+        latency.add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - submit_time).count(),
+            count);
+      });
+      if (rc != RC::SPEED_LIMIT) {
+        break;
+      }
+    }
+  }
+  manager->flush();
+  latency.wait(records);
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  LogFileManager::StageStats stats       = manager->stage_stats();
+  std::string                allocations = allocation_report(allocs_before, records);
+  manager.reset();  // 关闭文件后再统计输出大小
+  uint64 output_bytes = binlog_bytes(output_dir);
+  if (temporary_dir) {
+    std::filesystem::remove_all(output_dir);
+  }
+
+  double wall_ns = seconds * 1e9;
+  FILE  *out     = config.json.empty() ? stdout : fopen(config.json.c_str(), "w");
+  if (out == nullptr) {
+    perror("fopen");
+    return 1;
+  }
+  fprintf(out,
+      "{\n"
+      "  \"config\": {\"inputs\": %zu, \"threads\": %d, \"batch_size\": %zu, \"submit_batch\": %zu, "
+      "\"backend\": \"%s\", \"write_mode\": \"%s\", \"durability\": \"%s\", \"executor\": \"%s\", "
+      "\"scheduler\": \"%s\", \"pipeline\": \"%s\", \"zero_copy\": %s},\n"
+      "  \"records\": %zu,\n"
+      "  \"failed_records\": %zu,\n"
+      "  \"events\": %zu,\n"
+      "  \"seconds\": %.6f,\n"
+      "  \"records_per_sec\": %.1f,\n"
+      "  \"input_bytes\": %llu,\n"
+      "  \"output_bytes\": %llu,\n"
+      "  \"input_mb_per_sec\": %.2f,\n"
+      "  \"output_mb_per_sec\": %.2f,\n"
+      "  \"utilization\": {\"collector\": %.3f, \"transform\": %.3f, \"writer\": %.3f},\n"
+      "  \"latency_us\": {\"p50\": %.1f, \"p99\": %.1f, \"p999\": %.1f, \"max\": %.1f},\n"
+      "  \"allocations\": %s\n"
+      "}\n",
+      config.inputs.size(),
+      threads,
+      options.batch_max_size,
+      config.submit_batch,
+      config.backend,
+      config.write_mode,
+      config.durability,
+      config.executor,
+      config.scheduler,
+      config.pipeline,
+      options.zero_copy ? "true" : "false",
+      records,
+      latency.failed(),
+      stats.written_events,
+      seconds,
+      records / seconds,
+      (unsigned long long)input_bytes,
+      (unsigned long long)output_bytes,
+      input_bytes / 1048576.0 / seconds,
+      output_bytes / 1048576.0 / seconds,
+      stats.collector_busy_ns / wall_ns,
+      stats.transform_busy_ns / (wall_ns * threads),
+      stats.writer_busy_ns / wall_ns,
+      latency.percentile(0.5) / 1e3,
+      latency.percentile(0.99) / 1e3,
+      latency.percentile(0.999) / 1e3,
+      latency.percentile(1.0) / 1e3,
+      allocations.c_str());
+  if (out != stdout) {
+    fclose(out);
+  }
+  return latency.failed() == 0 ? 0 : 2;
+}
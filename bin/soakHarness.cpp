@@ -0,0 +1,481 @@
+//
+// Created by Coonger on 2024/12/17.
+//
+// 长时间浸泡测试：用 RedoGenerator 持续生成流量，按“突发 burst_s 秒 + 空闲 idle_s 秒”循环跑几个小时，
+// 让 log_files_ / file_ckp_ 的增长、ThreadPoolExecutor 在空闲时缩容再扩容的线程创建退出都反复发生。
+// 每个空闲期结束时（流水线已经排空、线程已经缩回去）采样 RSS、fd 数、线程数，每个突发期统计吞吐：
+//   - 预热 warmup_cycles 轮之后，取接下来 baseline_cycles 轮作为基线（RSS / fd / 线程取最大值，吞吐取中位数）
+//   - 之后每一轮和基线比较：RSS 增长超过 max_rss_growth_mb、fd 或线程数增长超过 max_fd_growth /
+//     max_thread_growth、最近 baseline_cycles 轮吞吐的中位数比基线低 max_throughput_drop 以上，立即失败
+// 磁盘上只保留最新的 retain_files 个 binlog 文件，LogFileManager 里登记的文件不动
+//
+// 用法: soakHarness [--duration_min=N] [--burst_s=N] [--idle_s=N] [--burst_rate=N] [--submit_batch=N]
+//         [--warmup_cycles=N] [--baseline_cycles=N] [--max_rss_growth_mb=N] [--max_fd_growth=N]
+//         [--max_thread_growth=N] [--max_throughput_drop=0..1] [--seed=N] [--tables=N]
+//         [--write_mode=serial|parallel] [--durability=none|flush|sync] [--executor=thread_pool|work_stealing]
+//         [--scheduler=fifo|partitioned] [--pipeline=threaded|coroutine] [--zero_copy=0|1]
+//         [--file_size_mb=N] [--retain_files=N] [--output_dir=DIR] [--samples=PATH]
+// 没有漂移时退出码为 0，有漂移时为 2
+//
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/init_setting.h"
+#include "log_file.h"
+#include "redo_generator.h"
+
+namespace {
+
+struct SoakConfig
+{
+  double                     duration_s          = 2 * 3600;
+  double                     burst_s             = 60;
+  double                     idle_s              = 30;
+  uint64                     burst_rate          = 0;  // 突发期每秒提交的记录数上限，0 表示不限制
+  size_t                     submit_batch        = 256;
+  size_t                     warmup_cycles       = 3;
+  size_t                     baseline_cycles     = 3;
+  int64                      max_rss_growth_kb   = 64 << 10;
+  int64                      max_fd_growth       = 8;
+  int64                      max_thread_growth   = 4;
+  double                     max_throughput_drop = 0.2;
+  uint64                     file_size           = 64ULL << 20;
+  size_t                     retain_files        = 8;
+  std::string                output_dir;
+  std::string                samples;
+  loft::RedoGeneratorOptions generator;
+  LogFileOptions             options;
+};
+
+/// 一轮结束时的采样
+struct CycleSample
+{
+  size_t cycle;
+  double elapsed_s;
+  int64  rss_kb;
+  int64  fds;
+  int64  threads;
+  double records_per_sec;  // 突发期提交的记录从第一条提交到全部完成的吞吐
+  uint64 records;
+};
+
+/**
+ * @brief 完成回调里累计已完成和失败的记录数
+ */
+class CompletionCounter
+{
+public:
+  void add(size_t records, bool failed)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    completed_ += records;
+    failed_ += failed ? records : 0;
+    cv_.notify_all();
+  }
+
+  void wait(uint64 records)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [&] { return completed_ >= records; });
+  }
+
+  uint64 failed()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return failed_;
+  }
+
+private:
+  std::mutex              mutex_;
+  std::condition_variable cv_;
+  uint64                  completed_ = 0;
+  uint64                  failed_    = 0;
+};
+
+void usage(const char *program)
+{
+  fprintf(stderr,
+      "usage: %s [--duration_min=N] [--burst_s=N] [--idle_s=N] [--burst_rate=N] [--submit_batch=N]\n"
+      "         [--warmup_cycles=N] [--baseline_cycles=N] [--max_rss_growth_mb=N] [--max_fd_growth=N]\n"
+      "         [--max_thread_growth=N] [--max_throughput_drop=0..1] [--seed=N] [--tables=N]\n"
+      "         [--write_mode=serial|parallel] [--durability=none|flush|sync] [--executor=thread_pool|work_stealing]\n"
+      "         [--scheduler=fifo|partitioned] [--pipeline=threaded|coroutine] [--zero_copy=0|1]\n"
+      "         [--file_size_mb=N] [--retain_files=N] [--output_dir=DIR] [--samples=PATH]\n",
+      program);
+}
+
+/// 在 names 里查找 value，找到时把 choices 里对应的值写到 out
+template <typename E, size_t N>
+bool parse_choice(const char *value, const char *const (&names)[N], const E (&choices)[N], E &out)
+{
+  for (size_t i = 0; i < N; i++) {
+    if (strcmp(value, names[i]) == 0) {
+      out = choices[i];
+      return true;
+    }
+  }
+  return false;
+}
+
+bool parse_args(int argc, char *argv[], SoakConfig &config)
+{
+  static const char *const      WRITE_MODES[]       = {"serial", "parallel"};
+  static const BinlogWriteMode  WRITE_MODE_VALUES[] = {BinlogWriteMode::SERIAL, BinlogWriteMode::PARALLEL};
+  static const char *const      DURABILITIES[]      = {"none", "flush", "sync"};
+  static const BinlogDurability DURABILITY_VALUES[] = {
+      BinlogDurability::NONE, BinlogDurability::FLUSH, BinlogDurability::SYNC};
+  static const char *const   EXECUTORS[]       = {"thread_pool", "work_stealing"};
+  static const ExecutorType  EXECUTOR_VALUES[] = {ExecutorType::THREAD_POOL, ExecutorType::WORK_STEALING};
+  static const char *const   SCHEDULERS[]       = {"fifo", "partitioned"};
+  static const SchedulerType SCHEDULER_VALUES[] = {SchedulerType::FIFO, SchedulerType::PARTITIONED};
+  static const char *const   PIPELINES[]       = {"threaded", "coroutine"};
+  static const PipelineMode  PIPELINE_VALUES[] = {PipelineMode::THREADED, PipelineMode::COROUTINE};
+
+  LogFileOptions &options = config.options;
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    const char *eq  = strchr(arg, '=');
+    if (strncmp(arg, "--", 2) != 0 || eq == nullptr) {
+      return false;
+    }
+    std::string key(arg + 2, eq);
+    const char *value = eq + 1;
+
+    bool ok = true;
+    if (key == "duration_min") {
+      config.duration_s = std::strtod(value, nullptr) * 60;
+    } else if (key == "burst_s") {
+      config.burst_s = std::strtod(value, nullptr);
+      ok             = config.burst_s > 0;
+    } else if (key == "idle_s") {
+      config.idle_s = std::strtod(value, nullptr);
+    } else if (key == "burst_rate") {
+      config.burst_rate = std::strtoull(value, nullptr, 10);
+    } else if (key == "submit_batch") {
+      config.submit_batch = std::max<size_t>(1, std::strtoull(value, nullptr, 10));
+    } else if (key == "warmup_cycles") {
+      config.warmup_cycles = std::strtoull(value, nullptr, 10);
+    } else if (key == "baseline_cycles") {
+      config.baseline_cycles = std::max<size_t>(1, std::strtoull(value, nullptr, 10));
+    } else if (key == "max_rss_growth_mb") {
+      config.max_rss_growth_kb = std::strtoll(value, nullptr, 10) << 10;
+    } else if (key == "max_fd_growth") {
+      config.max_fd_growth = std::strtoll(value, nullptr, 10);
+    } else if (key == "max_thread_growth") {
+      config.max_thread_growth = std::strtoll(value, nullptr, 10);
+    } else if (key == "max_throughput_drop") {
+      config.max_throughput_drop = std::strtod(value, nullptr);
+    } else if (key == "seed") {
+      config.generator.seed = std::strtoull(value, nullptr, 10);
+    } else if (key == "tables") {
+      config.generator.tables = std::atoi(value);
+    } else if (key == "file_size_mb") {
+      config.file_size = std::strtoull(value, nullptr, 10) << 20;
+    } else if (key == "retain_files") {
+      config.retain_files = std::max<size_t>(2, std::strtoull(value, nullptr, 10));
+    } else if (key == "output_dir") {
+      config.output_dir = value;
+    } else if (key == "samples") {
+      config.samples = value;
+    } else if (key == "zero_copy") {
+      options.zero_copy = std::atoi(value) != 0;
+    } else if (key == "write_mode") {
+      ok = parse_choice(value, WRITE_MODES, WRITE_MODE_VALUES, options.write_mode);
+    } else if (key == "durability") {
+      ok = parse_choice(value, DURABILITIES, DURABILITY_VALUES, options.durability);
+    } else if (key == "executor") {
+      ok = parse_choice(value, EXECUTORS, EXECUTOR_VALUES, options.executor);
+    } else if (key == "scheduler") {
+      ok = parse_choice(value, SCHEDULERS, SCHEDULER_VALUES, options.scheduler);
+    } else if (key == "pipeline") {
+      ok = parse_choice(value, PIPELINES, PIPELINE_VALUES, options.pipeline);
+    } else {
+      ok = false;
+    }
+    if (!ok) {
+      fprintf(stderr, "invalid argument: %s\n", arg);
+      return false;
+    }
+  }
+  return true;
+}
+
+/// /proc/self/status 里某一行的数值，如 VmRSS（kB）、Threads
+int64 proc_status(const char *field)
+{
+  std::ifstream in("/proc/self/status");
+  std::string   line;
+  size_t        len = strlen(field);
+  while (std::getline(in, line)) {
+    if (line.compare(0, len, field) == 0 && line.size() > len && line[len] == ':') {
+      return std::strtoll(line.c_str() + len + 1, nullptr, 10);
+    }
+  }
+  return -1;
+}
+
+int64 open_fds()
+{
+  std::error_code ec;
+  int64           count = 0;
+  for (auto it = std::filesystem::directory_iterator("/proc/self/fd", ec);
+       !ec && it != std::filesystem::directory_iterator(); it.increment(ec)) {
+    count++;
+  }
+  return count;
+}
+
+/**
+ * @brief 删除较旧的 binlog 文件，只保留最新的 retain 个，几个小时的流量不至于写满磁盘
+ */
+void purge_old_files(const std::filesystem::path &dir, size_t retain)
+{
+  std::vector<std::filesystem::path> files;
+  for (const auto &entry : std::filesystem::directory_iterator(dir)) {
+    std::string name = entry.path().filename().string();
+    if (entry.is_regular_file() && name.rfind(DEFAULT_BINLOG_FILE_NAME_PREFIX, 0) == 0 &&
+        entry.path().extension() != ".index") {
+      files.push_back(entry.path());
+    }
+  }
+  if (files.size() <= retain) {
+    return;
+  }
+  std::sort(files.begin(), files.end());
+  for (size_t i = 0; i + retain < files.size(); i++) {
+    std::error_code ec;
+    std::filesystem::remove(files[i], ec);
+  }
+}
+
+double median(std::vector<double> values)
+{
+  if (values.empty()) {
+    return 0;
+  }
+  std::sort(values.begin(), values.end());
+  return values[values.size() / 2];
+}
+
+/**
+ * @brief 和基线比较，有漂移时把原因写到 reason
+ */
+bool check_drift(const SoakConfig &config, const std::vector<CycleSample> &samples, std::string &reason)
+{
+  size_t begin = config.warmup_cycles;
+  size_t end   = begin + config.baseline_cycles;
+  if (samples.size() <= end) {
+    return true;  // 还在预热或者建立基线
+  }
+
+  CycleSample         baseline{};
+  std::vector<double> baseline_rates;
+  for (size_t i = begin; i < end; i++) {
+    baseline.rss_kb  = std::max(baseline.rss_kb, samples[i].rss_kb);
+    baseline.fds     = std::max(baseline.fds, samples[i].fds);
+    baseline.threads = std::max(baseline.threads, samples[i].threads);
+    baseline_rates.push_back(samples[i].records_per_sec);
+  }
+  double baseline_rate = median(baseline_rates);
+
+  std::vector<double> recent_rates;
+  for (size_t i = samples.size() - config.baseline_cycles; i < samples.size(); i++) {
+    recent_rates.push_back(samples[i].records_per_sec);
+  }
+  double recent_rate = median(recent_rates);
+
+  const CycleSample &last = samples.back();
+  char               buf[256];
+  if (last.rss_kb - baseline.rss_kb > config.max_rss_growth_kb) {
+    snprintf(buf, sizeof(buf), "rss grew from %lld kB to %lld kB",
+        (long long)baseline.rss_kb, (long long)last.rss_kb);
+  } else if (last.fds - baseline.fds > config.max_fd_growth) {
+    snprintf(buf, sizeof(buf), "open fds grew from %lld to %lld", (long long)baseline.fds, (long long)last.fds);
+  } else if (last.threads - baseline.threads > config.max_thread_growth) {
+    snprintf(buf, sizeof(buf), "threads grew from %lld to %lld",
+        (long long)baseline.threads, (long long)last.threads);
+  } else if (recent_rate < baseline_rate * (1 - config.max_throughput_drop)) {
+    snprintf(buf, sizeof(buf), "throughput dropped from %.1f to %.1f records/s", baseline_rate, recent_rate);
+  } else {
+    return true;
+  }
+  reason = buf;
+  return false;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[])
+{
+  SoakConfig config;
+  if (!parse_args(argc, argv, config)) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  bool                  temporary_dir = config.output_dir.empty();
+  std::filesystem::path output_dir;
+  if (temporary_dir) {
+    char tmpl[] = "/tmp/loft-soak-XXXXXX";
+    if (mkdtemp(tmpl) == nullptr) {
+      perror("mkdtemp");
+      return 1;
+    }
+    output_dir = tmpl;
+  } else {
+    output_dir = config.output_dir;
+    std::filesystem::create_directories(output_dir);
+    if (!std::filesystem::is_empty(output_dir)) {
+      fprintf(stderr, "output dir %s is not empty\n", output_dir.c_str());
+      return 1;
+    }
+  }
+
+  FILE *samples_out = nullptr;
+  if (!config.samples.empty() && (samples_out = fopen(config.samples.c_str(), "w")) == nullptr) {
+    perror("fopen");
+    return 1;
+  }
+
+  // 不限制条数和大小，next() 一直有数据；生成器的状态大小固定，长时间运行不会自己涨内存
+  config.generator.records      = 0;
+  config.generator.output_bytes = 0;
+  loft::RedoGenerator generator(config.generator);
+  RC                  rc = generator.init();
+  if (rc != RC::SUCCESS) {
+    fprintf(stderr, "invalid generator options: %s\n", strrc(rc));
+    return 1;
+  }
+
+  // 线程数自动调整保持打开，空闲期缩容、突发期扩容，线程反复创建和退出
+  auto manager = std::make_unique<LogFileManager>(config.options);
+  rc           = manager->init(output_dir.c_str(), DEFAULT_BINLOG_FILE_NAME_PREFIX, config.file_size);
+  if (rc != RC::SUCCESS) {
+    fprintf(stderr, "failed to init LogFileManager: %s\n", strrc(rc));
+    return 1;
+  }
+  manager->last_file(*manager->get_file_writer());
+
+  CompletionCounter  completions;
+  uint64             submitted = 0;
+  std::vector<Task>  batch;
+  std::vector<uint8> record;
+  bool               is_ddl = false;
+  batch.reserve(config.submit_batch);
+
+  auto submit = [&] {
+    size_t count = batch.size();
+    for (int attempt = 0;; attempt++) {
+      if (attempt > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));  // 等写线程归还预算
+      }
+      rc = manager->transformBatch(batch, [&completions, count](RC result) {
+        if (result != RC::SPEED_LIMIT) {
+          completions.add(count, result != RC::SUCCESS);
+        }
+      });
+      if (rc != RC::SPEED_LIMIT) {
+        break;
+      }
+    }
+    submitted += count;
+    batch.clear();
+  };
+
+  std::vector<CycleSample> samples;
+  std::string              reason;
+  bool                     stable = true;
+  auto                     start  = std::chrono::steady_clock::now();
+  auto                     elapsed = [&] {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  };
+
+  for (size_t cycle = 0; stable && elapsed() < config.duration_s; cycle++) {
+    // 突发期：按 burst_rate 或者尽快提交，DDL 单独成批
+    uint64 burst_begin_records = submitted;
+    auto   burst_begin         = std::chrono::steady_clock::now();
+    auto   burst_end           = burst_begin + std::chrono::duration<double>(config.burst_s);
+    while (std::chrono::steady_clock::now() < burst_end) {
+      if (!generator.next(record, is_ddl)) {
+        fprintf(stderr, "generator stopped unexpectedly\n");
+        return 1;
+      }
+      if (!batch.empty() && is_ddl != batch.back().is_ddl_) {
+        submit();
+      }
+      batch.emplace_back(std::vector<unsigned char>(record.begin(), record.end()), is_ddl);
+      if (batch.size() < config.submit_batch) {
+        continue;
+      }
+      submit();
+      if (config.burst_rate > 0) {
+        auto due = burst_begin + std::chrono::duration<double>(
+                                     static_cast<double>(submitted - burst_begin_records) / config.burst_rate);
+        std::this_thread::sleep_until(std::min(due, burst_end));
+      }
+    }
+    if (!batch.empty()) {
+      submit();
+    }
+    manager->flush();
+    completions.wait(submitted);
+    uint64 burst_records = submitted - burst_begin_records;
+    double burst_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - burst_begin).count();
+
+    // 空闲期：什么都不提交，结束时流水线早已排空，线程池也应该缩回去了
+    std::this_thread::sleep_for(std::chrono::duration<double>(config.idle_s));
+    purge_old_files(output_dir, config.retain_files);
+
+    CycleSample sample{cycle, elapsed(), proc_status("VmRSS"), open_fds(), proc_status("Threads"),
+        burst_records / burst_seconds, submitted};
+    samples.push_back(sample);
+    printf("cycle=%zu elapsed_s=%.0f rss_kb=%lld fds=%lld threads=%lld records_per_sec=%.1f records=%llu\n",
+        sample.cycle, sample.elapsed_s, (long long)sample.rss_kb, (long long)sample.fds, (long long)sample.threads,
+        sample.records_per_sec, (unsigned long long)sample.records);
+    fflush(stdout);
+    if (samples_out != nullptr) {
+      fprintf(samples_out,
+          "{\"cycle\": %zu, \"elapsed_s\": %.3f, \"rss_kb\": %lld, \"fds\": %lld, \"threads\": %lld, "
+          "\"records_per_sec\": %.1f, \"records\": %llu}\n",
+          sample.cycle, sample.elapsed_s, (long long)sample.rss_kb, (long long)sample.fds,
+          (long long)sample.threads, sample.records_per_sec, (unsigned long long)sample.records);
+      fflush(samples_out);
+    }
+
+    stable = check_drift(config, samples, reason);
+  }
+
+  uint64 failed = completions.failed();
+  manager.reset();
+  if (samples_out != nullptr) {
+    fclose(samples_out);
+  }
+  if (temporary_dir) {
+    std::filesystem::remove_all(output_dir);
+  }
+
+  if (samples.size() <= config.warmup_cycles + config.baseline_cycles) {
+    printf("warning: only %zu cycles, not enough to establish a baseline\n", samples.size());
+  }
+  if (failed > 0) {
+    printf("FAIL: %llu records failed\n", (unsigned long long)failed);
+    return 2;
+  }
+  if (!stable) {
+    printf("FAIL: %s\n", reason.c_str());
+    return 2;
+  }
+  printf("OK: %zu cycles, %llu records, no drift\n", samples.size(), (unsigned long long)submitted);
+  return 0;
+}
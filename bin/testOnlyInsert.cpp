@@ -1,6 +1,7 @@
 //
 // Created by Coonger on 2024/11/8.
 //
+#include <thread>
 #include <vector>
 
 #include "common/init_setting.h"
@@ -35,7 +36,25 @@ int main()
   logFileManager->last_file(*fileWriter);  // fileWrite 自动写下一个文件了，而且也打开了文件流了
 
 
-  std::vector<std::future<RC>> futures;  // 存储所有的future
+  // 批量提交：每攒够 SUBMIT_BATCH 条记录提交一次，整批共用一个完成句柄，句柄在整批落盘后完成
+  constexpr size_t SUBMIT_BATCH = 4096;
+  std::vector<BatchHandle> handles;
+  std::vector<Task> records;
+  records.reserve(SUBMIT_BATCH);
+
+  auto submit = [&] {
+    if (records.empty()) {
+      return;
+    }
+    // 内存预算不足时句柄立即以 SPEED_LIMIT 完成，records 没有被移走，等写线程消化一会儿再原样重试
+    BatchHandle handle = logFileManager->transformBatch(records);
+    while (handle->done() && handle->status() == RC::SPEED_LIMIT) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      handle = logFileManager->transformBatch(records);
+    }
+    handles.push_back(std::move(handle));
+    records.clear();
+  };
 
   // 处理DDL
   int DDLEPOCH = 3;
@@ -43,8 +62,9 @@ int main()
     auto sql_len = bufferReader->read<uint32_t>();
     std::vector<unsigned char> buf(sql_len);
     bufferReader->memcpy<unsigned char*>(buf.data(), sql_len);
-    futures.push_back(logFileManager->transformAsync(std::move(buf), true));
+    records.emplace_back(std::move(buf), true);
   }
+  submit();
 
   // 跳过第四条
   bufferReader->forward(bufferReader->read<uint32_t>());
@@ -55,14 +75,18 @@ int main()
     auto sql_len = bufferReader->read<uint32_t>();
     std::vector<unsigned char> buf(sql_len);
     bufferReader->memcpy<unsigned char*>(buf.data(), sql_len);
-    futures.push_back(logFileManager->transformAsync(std::move(buf), false));
+    records.emplace_back(std::move(buf), false);
+    if (records.size() == SUBMIT_BATCH) {
+      submit();
+    }
   }
+  submit();
 
-  // 等待所有提交任务完成，只保证所有任务都投放到了 ring_buffer_里，并没有保证 转换完成和写入到文件中
-  for (auto& future : futures) {
-    RC result = future.get();
+  // 等待所有批次写入 binlog 并落盘
+  for (auto &handle : handles) {
+    RC result = handle->wait();
     if (result != RC::SUCCESS) {
-      LOG_ERROR("Transform task failed");
+      LOG_ERROR("Transform batch failed. rc=%s", strrc(result));
     }
   }
 
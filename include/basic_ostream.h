@@ -8,11 +8,25 @@
 #include <cassert>
 #include <fstream>
 #include <memory>
+#include <string>
+#include <vector>
+
+#include <sys/uio.h>  // struct iovec
 
 // #include "constants.h"
 #include "common/rc.h"
 #include "common/type_def.h"
 
+/**
+ * @brief binlog 的落盘策略，决定每个 batch 写完后（flush）要不要把数据刷到磁盘
+ */
+enum class BinlogDurability
+{
+  NONE,   /// 只交给 page cache，关闭文件时才落盘
+  FLUSH,  /// 启动回写但不等待（mmap 为 msync MS_ASYNC，fd 为 sync_file_range；fstream / io_uring 不做额外处理）
+  SYNC,   /// 等待落盘（msync MS_SYNC / fdatasync）
+};
+
 /**
    Basic_ostream 抽象类提供 write(), seek(), sync(), flush()
    接口，用于写入数据到 buffer 中
@@ -27,10 +41,42 @@ public:
   virtual RC       flush()                                     = 0;
   virtual my_off_t get_position()                              = 0;
 
+  /**
+   * @brief 向量写，默认逐段调用 write()；fd 后端重写成 writev(2)
+   */
+  virtual bool writev(const struct iovec *iov, int iovcnt)
+  {
+    for (int i = 0; i < iovcnt; ++i) {
+      if (!write(static_cast<const uchar *>(iov[i].iov_base), iov[i].iov_len)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
   virtual ~Basic_ostream() = default;
 };
 
-class Binlog_ofile : public Basic_ostream
+/**
+   Binlog_file_ostream 是 MYSQL_BIN_LOG 写文件用的输出流，在 Basic_ostream 的基础上
+   补充 is_empty() 和 close()，fstream、fd、io_uring 三种后端都实现这个接口
+*/
+class Binlog_file_ostream : public Basic_ostream
+{
+public:
+  virtual bool is_empty() const = 0;
+  virtual void close()          = 0;
+
+  /**
+   * @brief 对上次回写之后写入的数据启动异步回写，不等待完成，用于 BinlogDurability::FLUSH
+   * @details 默认什么都不做：fstream 拿不到 fd，io_uring 的写本身就是异步提交的
+   */
+  virtual RC start_writeback() { return RC::SUCCESS; }
+
+  ~Binlog_file_ostream() override = default;
+};
+
+class Binlog_ofile : public Binlog_file_ostream
 {
 public:
   Binlog_ofile(const char *binlog_name, RC &rc);
@@ -45,7 +91,7 @@ public:
   // Helper functions
   my_off_t get_position() override { return m_position_; };
 
-  bool is_empty() const { return m_position_ == 0; }
+  bool is_empty() const override { return m_position_ == 0; }
 
   bool is_open() const { return m_pipeline_head_ != nullptr; }
 
@@ -63,7 +109,7 @@ public:
     return true;
   }
 
-  void close()
+  void close() override
   {
     if (m_pipeline_head_) {
       m_pipeline_head_->close();
@@ -76,3 +122,135 @@ private:
   my_off_t                      m_position_;
   std::unique_ptr<std::fstream> m_pipeline_head_;
 };
+
+/**
+   Binlog_fd_ofile 直接用 write(2) 追加写，没有用户态缓冲，sync() 即 fdatasync
+*/
+class Binlog_fd_ofile : public Binlog_file_ostream
+{
+public:
+  Binlog_fd_ofile(const char *binlog_name, RC &rc);
+
+  ~Binlog_fd_ofile() override { close(); }
+
+  bool     write(const uchar *buffer, my_off_t length) override;
+  bool     writev(const struct iovec *iov, int iovcnt) override;
+  RC       seek(my_off_t position) override;
+  RC       sync() override;
+  RC       flush() override { return RC::SUCCESS; }
+  my_off_t get_position() override { return m_position_; }
+
+  bool is_empty() const override { return m_position_ == 0; }
+  void close() override;
+  /// sync_file_range(SYNC_FILE_RANGE_WRITE) [m_writeback_, m_position_)
+  RC   start_writeback() override;
+
+private:
+  int         m_fd_        = -1;
+  my_off_t    m_position_  = 0;
+  my_off_t    m_writeback_ = 0;  // 之前的内容已经启动过回写
+  std::string m_file_name_;
+};
+
+/**
+   Binlog_mmap_ofile 把整个文件 fallocate 到 max_size 后映射进内存，write() 直接 memcpy 到映射区：
+   1. 映射长度至少比已有内容多 WRITE_THRESHOLD，切换文件时 Rotate event 写在这段预留的尾部空间里
+   2. flush() 按照 BinlogDurability 对 [上次落盘位置, 当前位置) 做 msync，sync() 总是 MS_SYNC
+   3. close() 解除映射后把文件截断到实际写入的大小
+   适合 tmpfs、NVMe 这类 page cache 写入远快于 write(2) 系统调用的目录
+*/
+class Binlog_mmap_ofile : public Binlog_file_ostream
+{
+public:
+  Binlog_mmap_ofile(const char *binlog_name, my_off_t max_size, BinlogDurability durability, RC &rc);
+
+  ~Binlog_mmap_ofile() override { close(); }
+
+  bool     write(const uchar *buffer, my_off_t length) override;
+  RC       seek(my_off_t position) override;
+  RC       sync() override;
+  RC       flush() override;
+  my_off_t get_position() override { return m_position_; }
+
+  bool is_empty() const override { return m_position_ == 0; }
+  void close() override;
+
+private:
+  /// msync [m_synced_, m_position_)，起点向下对齐到页
+  RC msync_dirty(int flags);
+
+private:
+  int              m_fd_       = -1;
+  uchar           *m_map_      = nullptr;
+  my_off_t         m_map_len_  = 0;
+  my_off_t         m_position_ = 0;
+  my_off_t         m_synced_   = 0;  // 之前的内容已经 msync 过
+  BinlogDurability m_durability_;
+  std::string      m_file_name_;
+};
+
+/**
+   Memory_ostream 把 event 序列化到内存里，position 从 base_position 开始计算，
+   这样 write_common_header() 算出来的 log_pos 就是该 event 在文件里的真实位置
+*/
+class Memory_ostream : public Basic_ostream
+{
+public:
+  explicit Memory_ostream(my_off_t base_position = 0) : m_base_position_(base_position) {}
+
+  ~Memory_ostream() override = default;
+
+  bool write(const uchar *buffer, my_off_t length) override
+  {
+    m_buffer_.insert(m_buffer_.end(), buffer, buffer + length);
+    return true;
+  }
+  RC       seek(my_off_t position) override { return RC::UNIMPLEMENTED; }
+  RC       sync() override { return RC::SUCCESS; }
+  RC       flush() override { return RC::SUCCESS; }
+  my_off_t get_position() override { return m_base_position_ + m_buffer_.size(); }
+
+  const std::vector<uchar> &buffer() const { return m_buffer_; }
+
+private:
+  my_off_t           m_base_position_;
+  std::vector<uchar> m_buffer_;
+};
+
+/**
+   Binlog_pfile 用于并发定位写：
+   1. open 时把文件 fallocate 到 max_size，避免并发 pwrite 时反复扩展文件元数据
+   2. 多个 worker 各自把已分配好 offset 的 event 写到互不重叠的区间
+   3. close 时 fdatasync，并把文件截断到实际写入的大小
+   use_mmap 时把文件映射进内存，worker 直接 memcpy 到自己的区间，省掉 pwrite 的系统调用
+*/
+class Binlog_pfile
+{
+public:
+  Binlog_pfile(const char *binlog_name, my_off_t prealloc_size, RC &rc, bool use_mmap = false);
+  ~Binlog_pfile();
+
+  bool pwrite(const uchar *buffer, my_off_t length, my_off_t offset);
+  bool pwritev(const struct iovec *iov, int iovcnt, my_off_t offset);
+
+  RC sync();
+  /**
+   * @brief 按照落盘策略把 [offset, offset + length) 刷到磁盘
+   */
+  RC sync_range(my_off_t offset, my_off_t length, BinlogDurability durability);
+  /**
+   * @brief 封存文件：fdatasync 后截断到 final_size 并关闭
+   */
+  RC close(my_off_t final_size);
+
+  /// 打开时文件已有的字节数，继续写一个旧文件时从这里开始
+  my_off_t initial_size() const { return m_initial_size_; }
+  const char *filename() const { return m_file_name_.c_str(); }
+
+private:
+  int         m_fd_ = -1;
+  my_off_t    m_initial_size_ = 0;
+  uchar      *m_map_          = nullptr;
+  my_off_t    m_map_len_      = 0;
+  std::string m_file_name_;
+};
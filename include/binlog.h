@@ -43,10 +43,22 @@ public:
   // TODO 暂时不考虑 prepare, commit, rollback 函数
 };
 
+/**
+ * @brief binlog 文件输出流的实现方式
+ */
+enum class BinlogBackend
+{
+  FSTREAM,   /// std::fstream，用户态缓冲
+  FD,        /// 直接 write(2)
+  IO_URING,  /// io_uring + 注册缓冲区，内核不支持时回退到 FD
+  MMAP,      /// 文件 fallocate 到 max_size 后映射，直接 memcpy，适合 tmpfs / NVMe
+};
+
 // 暂时不考虑 index 文件、lock
 class MYSQL_BIN_LOG : TC_LOG {
   public:
-    MYSQL_BIN_LOG(const char *file_name, uint64_t file_size, RC &rc);
+    MYSQL_BIN_LOG(const char *file_name, uint64_t file_size, RC &rc, BinlogBackend backend = BinlogBackend::FSTREAM,
+        BinlogDurability durability = BinlogDurability::NONE);
     ~MYSQL_BIN_LOG() override = default;
 
 public:
@@ -54,12 +66,23 @@ public:
   RC open() override;   // 构造函数
   RC close() override;
 
-  void flush() { m_binlog_file_->flush(); }
+  /**
+   * @brief 一个 batch 写完后调用：把缓冲的数据交给内核，并按照落盘策略刷盘
+   */
+  RC flush();
+
+  /**
+   * @brief 不论落盘策略，把已写的数据交给内核并等待落盘
+   */
+  RC sync();
 
   //********************* file write operation *************************
   bool write(const uchar *buffer, my_off_t length) {
     return m_binlog_file_->write(buffer, length);
   }
+  bool writev(const struct iovec *iov, int iovcnt) {
+    return m_binlog_file_->writev(iov, iovcnt);
+  }
   bool write_event_to_binlog(AbstractEvent *ev);
 
   bool     remain_bytes_safe(uint32 event_len) { return m_binlog_file_->get_position() + event_len + WRITE_THRESHOLD < max_size_; }
@@ -84,5 +107,7 @@ private:
 
   my_off_t bytes_written_;  // binlog 文件当前写入大小
 
-  std::unique_ptr<Binlog_ofile> m_binlog_file_;
+  BinlogBackend                        backend_;
+  BinlogDurability                     durability_;
+  std::unique_ptr<Binlog_file_ostream> m_binlog_file_;
 };
@@ -0,0 +1,34 @@
+//
+// Created by Coonger on 2024/12/18.
+//
+
+#pragma once
+
+#include <filesystem>
+#include <vector>
+
+namespace loft {
+
+/**
+ * @brief 测试和差分 harness 共用的 binlog 输出检查工具：建临时目录、列出并读取 binlog 文件、
+ * 把来自系统时间的字段置零后再逐字节比较
+ */
+
+/**
+ * @brief 在 /tmp 下创建 prefix-XXXXXX 临时目录
+ * @return 创建失败时返回空路径
+ */
+std::filesystem::path make_temp_dir(const char *prefix);
+
+/// 目录下的 binlog 文件，不含 index 文件，按文件名排序
+std::vector<std::filesystem::path> binlog_files(const std::filesystem::path &dir);
+
+std::vector<char> read_file(const std::filesystem::path &path);
+
+/**
+ * @brief 逐个 event 把系统时间相关的字段置零：FORMAT_DESCRIPTION_EVENT 的 header 时间戳和 create_timestamp，
+ * ROTATE_EVENT 的 header 时间戳。其他 event 的时间戳来自源端的提交时间，不处理；解析不下去的尾部原样保留
+ */
+void normalize_binlog(std::vector<char> &data);
+
+}  // namespace loft
@@ -0,0 +1,107 @@
+//
+// Created by Coonger on 2024/12/2.
+//
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "basic_ostream.h"
+#include "log_file.h"
+
+namespace loft {
+
+/**
+ * @brief 并发写 binlog 的定序器
+ * @details 单写线程模式下，写线程要逐条检查 remain_bytes_safe、填充 LOG_POS_OFFSET、拷贝字节，
+ * 吞吐被一个线程卡住。这里把写入拆成两步：
+ *   1. 定序（仍在写线程里，按 batch 顺序执行）：只读每条 event 的长度做前缀和，
+ *      得到每条 event 所在的 [file_no, offset]，顺带确定切换文件的位置，写好 rotate event 和新文件的 magic + fde
+ *   2. 写入（线程池 worker 执行）：worker 自己填充 log_pos，把一段连续的 event 用一次 pwritev 写到预分配好的文件里
+ * 同一个文件的多个 batch 写的是互不重叠的区间，因此不需要加锁；文件被切走且所有在途写入完成后，才 fdatasync 并截断到实际大小。
+ */
+class BinlogSequencer
+{
+public:
+  explicit BinlogSequencer(LogFileManager *manager);
+  ~BinlogSequencer();
+
+  DISALLOW_COPY_AND_MOVE(BinlogSequencer);
+
+  /**
+   * @brief 为一个已按序到达的 batch 分配 offset，并把写入任务投递到线程池
+   */
+  RC dispatch(std::unique_ptr<LogFileManager::BatchResult> result);
+
+  /**
+   * @brief 等待所有已投递的写入任务完成
+   */
+  void drain();
+
+  /**
+   * @brief drain 之后封存当前文件：fdatasync，截断到实际大小
+   */
+  RC close();
+
+  uint64 get_bytes_written() const { return position_.load(); }
+
+  /// 第一次写失败的错误码，没有失败时是 RC::SUCCESS
+  RC status() const { return failure_.load(std::memory_order_acquire); }
+
+private:
+  /**
+   * @brief 一个正在被并发写入的 binlog 文件
+   * @details refs_ 初始为 1，代表定序器自己持有的引用；每个涉及该文件的写任务再加 1。
+   * 切换文件时定序器释放自己的引用，最后一个释放引用的线程负责封存文件
+   */
+  struct OutputFile
+  {
+    uint32                        file_no = 0;
+    std::unique_ptr<Binlog_pfile> file;
+    std::atomic<size_t>           refs{1};
+    my_off_t                      end_pos = 0;  // 封存时的文件大小，切换文件时确定
+  };
+
+  /**
+   * @brief 一个写任务在某个文件里负责的连续区间：batch 中下标 [begin, end) 的 event 从 offset 开始连续存放
+   */
+  struct Segment
+  {
+    std::shared_ptr<OutputFile> file;
+    my_off_t                    offset = 0;
+    size_t                      begin  = 0;
+    size_t                      end    = 0;
+  };
+
+  /// 第一次 dispatch 时接管 LogFileManager 当前打开的文件，没有就新建一个
+  RC attach();
+  RC open_file(uint32 file_no, const char *file_path, bool write_header);
+  RC rotate(const std::string &checkpoint);
+  void release(const std::shared_ptr<OutputFile> &file);
+
+  /// worker 执行：填充 log_pos 并 pwritev
+  void write_segments(LogFileManager::BatchResult *result, const std::vector<Segment> &segments);
+
+  /// 不需要或者不能再写出去的 batch：直接以 rc 完成，归还预算
+  void finish_unwritten(LogFileManager::BatchResult &result, RC rc);
+
+private:
+  LogFileManager *manager_;
+  bool            attached_ = false;
+
+  std::shared_ptr<OutputFile> current_;         // 当前正在分配 offset 的文件
+  std::atomic<uint64>         position_{0};     // 当前文件下一条 event 的起始 offset
+
+  // 某个区间写失败后文件里留下了空洞，之后的 offset 都不再可信：不再投递新的写任务，后续 batch 都以这个错误码完成
+  std::atomic<RC> failure_{RC::SUCCESS};
+
+  std::mutex              inflight_mutex_;
+  std::condition_variable inflight_cv_;
+  size_t                  inflight_jobs_ = 0;  // 已投递但未完成的写任务数
+};
+
+}  // namespace loft
@@ -0,0 +1,76 @@
+//
+// Created by Coonger on 2024/12/14.
+//
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+#include "type_def.h"
+
+namespace common {
+
+/**
+ * @brief 根据到达速率和转换耗时调整收集线程的 batch 大小
+ * @details 固定 4096 条一个 batch 时，低速写入下每条记录都要等到收集线程超时才被处理，
+ * 高速写入下又可能攒不满就被取走。这里维护两个指数滑动平均：
+ *   - rate：记录到达速率（条/秒），由收集线程按 到达总数 / 时间 观测
+ *   - batch_time：一个 batch 的转换耗时，由转换线程每转换完一个 batch 上报
+ * 目标大小 target = rate × min(max_latency, batch_time)，再限制在 [min_batch, max_batch]：
+ * 一个 batch 转换的这段时间里到达的记录正好组成下一个 batch，转换线程既不空等、也不用频繁投递小 batch；
+ * 转换跟不上（rate × 单条耗时 > 1）时 batch_time 随 batch 变大而变大，target 一直涨到 max_batch 来摊薄投递开销，
+ * 负载低时 target 缩到 min_batch，再由 max_latency 保证等待时间的上限。
+ */
+class AdaptiveBatcher
+{
+public:
+  using Clock = std::chrono::steady_clock;
+
+  AdaptiveBatcher(size_t min_batch, size_t max_batch, std::chrono::microseconds max_latency);
+
+  AdaptiveBatcher(const AdaptiveBatcher &)            = delete;
+  AdaptiveBatcher &operator=(const AdaptiveBatcher &) = delete;
+
+  /**
+   * @brief 收集线程上报截至 now 一共到达了多少条记录，只能在一个线程里调用
+   */
+  void observe_arrivals(uint64 total_arrivals, Clock::time_point now);
+
+  /**
+   * @brief 转换完一个 batch 后上报耗时，可以在多个线程里调用
+   */
+  void record_batch(size_t records, std::chrono::nanoseconds elapsed);
+
+  /// 当前的目标 batch 大小，攒够这么多就应该投递
+  size_t target() const { return target_.load(std::memory_order_relaxed); }
+
+  size_t                    max_batch() const { return max_batch_; }
+  std::chrono::microseconds max_latency() const { return max_latency_; }
+
+  /// 到达速率（条/秒）
+  double arrival_rate() const;
+  /// 一个 batch 的平均转换耗时（微秒）
+  double batch_time_us() const;
+
+private:
+  /// 调用者持有 mutex_
+  void update_target();
+
+private:
+  const size_t                    min_batch_;
+  const size_t                    max_batch_;
+  const std::chrono::microseconds max_latency_;
+
+  std::atomic<size_t> target_;
+
+  mutable std::mutex mutex_;
+  double             rate_          = 0;  // 条/秒
+  double             batch_time_us_ = 0;
+  uint64             last_arrivals_ = 0;
+  Clock::time_point  last_observe_;
+  bool               observed_ = false;
+};
+
+}  // namespace common
@@ -0,0 +1,91 @@
+//
+// Created by Coonger on 2024/12/18.
+//
+
+#pragma once
+
+#include "type_def.h"
+
+namespace common {
+
+/**
+ * @defgroup AllocAccounting
+ * @brief 按流水线阶段统计堆分配，定位追赶时 RSS 上涨是哪个阶段造成的
+ * @details 用 -DLOFT_ALLOC_ACCOUNTING=ON 编译时替换全局的 operator new / delete：每块内存前面多放 16 字节，
+ * 记下大小和分配时所在的阶段，释放时记回同一个阶段，即使释放发生在另一个线程、另一个阶段里。
+ * 阶段由当前线程上最内层的 AllocStageScope 决定，不在任何 scope 里的分配记到 OTHER。
+ * 只统计 operator new，不统计 malloc 和按对齐分配的 new（alignas 大于 16 的类型）。
+ * 没有打开时 AllocStageScope 是空操作，alloc_stats() 全部返回 0
+ */
+
+enum class AllocStage : uint8
+{
+  OTHER,   /// 不在任何阶段里
+  INGEST,  /// 提交记录：Task 的数据、完成句柄
+  SCHEMA,  /// DDL 转换：表结构、Field 对象
+  EVENT,   /// DML 转换：Rows_event 的行数据缓冲区
+  RESULT,  /// event 序列化成 BatchResult
+  WRITER,  /// 写 binlog：iovec、文件切换
+  COUNT,
+};
+
+const char *alloc_stage_name(AllocStage stage);
+
+struct AllocStats
+{
+  uint64 allocated_bytes = 0;  /// 累计分配的字节数
+  uint64 allocations     = 0;  /// 累计分配次数
+  int64  live_bytes      = 0;  /// 当前还没有释放的字节数
+  int64  peak_bytes      = 0;  /// live_bytes 的最大值
+};
+
+/// 编译时是否打开了分配统计
+constexpr bool alloc_accounting_enabled()
+{
+#ifdef LOFT_ALLOC_ACCOUNTING
+  return true;
+#else
+  return false;
+#endif
+}
+
+AllocStats alloc_stats(AllocStage stage);
+
+namespace detail {
+
+inline AllocStage &current_alloc_stage()
+{
+  thread_local AllocStage stage = AllocStage::OTHER;
+  return stage;
+}
+
+}  // namespace detail
+
+/**
+ * @brief 作用域内当前线程的分配记到 stage 上，可以嵌套，退出时恢复外层的阶段
+ * @details 和 TraceSpan 一样不能跨 co_await
+ * @ingroup AllocAccounting
+ */
+class AllocStageScope
+{
+public:
+#ifdef LOFT_ALLOC_ACCOUNTING
+  explicit AllocStageScope(AllocStage stage) : previous_(detail::current_alloc_stage())
+  {
+    detail::current_alloc_stage() = stage;
+  }
+  ~AllocStageScope() { detail::current_alloc_stage() = previous_; }
+#else
+  explicit AllocStageScope(AllocStage) {}
+#endif
+
+  AllocStageScope(const AllocStageScope &)            = delete;
+  AllocStageScope &operator=(const AllocStageScope &) = delete;
+
+#ifdef LOFT_ALLOC_ACCOUNTING
+private:
+  AllocStage previous_;
+#endif
+};
+
+}  // namespace common
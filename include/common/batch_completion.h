@@ -0,0 +1,66 @@
+//
+// Created by Coonger on 2024/12/10.
+//
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#include "rc.h"
+#include "type_def.h"
+
+namespace common {
+
+/**
+ * @brief 一次批量提交的完成句柄
+ * @details 一批记录共用一个句柄，每条记录不再单独分配 promise / future。
+ * 写线程每写完（并按要求落盘）一部分记录就调用 finish(count, rc)，全部记录完成后：
+ *   - wait() 返回，结果是遇到的第一个错误，没有错误就是 RC::SUCCESS
+ *   - 构造时传入的回调在完成 finish 的那个线程（通常是写线程）上被调用一次，回调里不要做重活
+ */
+class BatchCompletion
+{
+public:
+  using Callback = std::function<void(RC)>;
+
+  explicit BatchCompletion(size_t records, Callback callback = nullptr);
+
+  BatchCompletion(const BatchCompletion &)            = delete;
+  BatchCompletion &operator=(const BatchCompletion &) = delete;
+
+  /**
+   * @brief 阻塞到整批记录都完成
+   */
+  RC wait();
+
+  /**
+   * @brief 最多等待 timeout
+   * @return 整批记录都完成返回 true
+   */
+  bool wait_for(std::chrono::milliseconds timeout);
+
+  bool   done() const;
+  /// 还没完成时返回 RC::SUCCESS 以外的错误只表示已经有记录失败
+  RC     status() const;
+  size_t remaining() const;
+
+  /**
+   * @brief count 条记录已经完成，rc 是这些记录的结果
+   */
+  void finish(size_t count, RC rc);
+
+private:
+  mutable std::mutex      mutex_;
+  std::condition_variable cv_;
+  size_t                  remaining_;
+  RC                      rc_ = RC::SUCCESS;
+  Callback                callback_;
+};
+
+using BatchHandle = std::shared_ptr<BatchCompletion>;
+
+}  // namespace common
@@ -0,0 +1,202 @@
+//
+// Created by Coonger on 2024/12/13.
+//
+
+#pragma once
+
+#include <coroutine>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include "coroutine.h"
+
+namespace common {
+
+/**
+ * @brief 协程之间的有界通道
+ * @ingroup Coroutine
+ * @details co_await send(value) 在缓冲区满时挂起发送方，co_await recv() 在缓冲区空时挂起接收方，
+ * 对端取走 / 放入元素后把挂起的一方投递到 executor 上恢复，阶段之间的背压因此不占用线程。
+ * 支持多个发送方和多个接收方。close() 之后：
+ *   - send 返回 false，元素被丢弃
+ *   - recv 先取完缓冲区里剩下的元素，之后返回 std::nullopt
+ * @tparam T 元素类型，要求可移动
+ */
+template <typename T>
+class Channel
+{
+public:
+  Channel(Executor *executor, size_t capacity) : executor_(executor), capacity_(capacity) {}
+
+  Channel(const Channel &)            = delete;
+  Channel &operator=(const Channel &) = delete;
+
+  class SendAwaiter
+  {
+  public:
+    SendAwaiter(Channel *channel, T &&value) : channel_(channel), value_(std::move(value)) {}
+
+    bool await_ready() const noexcept { return false; }
+
+    bool await_suspend(std::coroutine_handle<> handle)
+    {
+      handle_ = handle;
+      return channel_->suspend_send(this);
+    }
+
+    /// @return 通道已关闭、元素没有送出时返回 false
+    bool await_resume() const noexcept { return sent_; }
+
+  private:
+    friend class Channel;
+
+    Channel                *channel_;
+    T                       value_;
+    bool                    sent_ = false;
+    std::coroutine_handle<> handle_;
+  };
+
+  class RecvAwaiter
+  {
+  public:
+    explicit RecvAwaiter(Channel *channel) : channel_(channel) {}
+
+    bool await_ready() const noexcept { return false; }
+
+    bool await_suspend(std::coroutine_handle<> handle)
+    {
+      handle_ = handle;
+      return channel_->suspend_recv(this);
+    }
+
+    /// @return 通道已关闭且没有剩余元素时返回 std::nullopt
+    std::optional<T> await_resume() { return std::move(value_); }
+
+  private:
+    friend class Channel;
+
+    Channel                *channel_;
+    std::optional<T>        value_;
+    std::coroutine_handle<> handle_;
+  };
+
+  SendAwaiter send(T value) { return SendAwaiter(this, std::move(value)); }
+  RecvAwaiter recv() { return RecvAwaiter(this); }
+
+  /**
+   * @brief 关闭通道，唤醒所有挂起的发送方和接收方
+   */
+  void close()
+  {
+    std::vector<std::coroutine_handle<>> wakeups;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (closed_) {
+        return;
+      }
+      closed_ = true;
+      for (SendAwaiter *sender : senders_) {
+        wakeups.push_back(sender->handle_);
+      }
+      for (RecvAwaiter *receiver : receivers_) {
+        wakeups.push_back(receiver->handle_);
+      }
+      senders_.clear();
+      receivers_.clear();
+    }
+    for (auto handle : wakeups) {
+      resume_on(executor_, handle);
+    }
+  }
+
+  bool closed() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return closed_;
+  }
+
+  size_t size() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return buffer_.size();
+  }
+
+private:
+  /// @return true 表示发送方需要挂起等待
+  bool suspend_send(SendAwaiter *sender)
+  {
+    std::coroutine_handle<> wakeup;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (closed_) {
+        return false;
+      }
+      if (!receivers_.empty()) {
+        // 有接收方在等，直接交给它，不经过缓冲区
+        RecvAwaiter *receiver = receivers_.front();
+        receivers_.pop_front();
+        receiver->value_ = std::move(sender->value_);
+        wakeup           = receiver->handle_;
+      } else if (buffer_.size() < capacity_) {
+        buffer_.push_back(std::move(sender->value_));
+      } else {
+        senders_.push_back(sender);
+        return true;
+      }
+      sender->sent_ = true;
+    }
+    if (wakeup) {
+      resume_on(executor_, wakeup);
+    }
+    return false;
+  }
+
+  /// @return true 表示接收方需要挂起等待
+  bool suspend_recv(RecvAwaiter *receiver)
+  {
+    std::coroutine_handle<> wakeup;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!buffer_.empty()) {
+        receiver->value_ = std::move(buffer_.front());
+        buffer_.pop_front();
+        // 腾出了一个位置，挂起的发送方可以放进来
+        if (!senders_.empty()) {
+          SendAwaiter *sender = senders_.front();
+          senders_.pop_front();
+          buffer_.push_back(std::move(sender->value_));
+          sender->sent_ = true;
+          wakeup        = sender->handle_;
+        }
+      } else if (!senders_.empty()) {
+        // 容量为 0 时发送方直接把元素交给接收方
+        SendAwaiter *sender = senders_.front();
+        senders_.pop_front();
+        receiver->value_ = std::move(sender->value_);
+        sender->sent_    = true;
+        wakeup           = sender->handle_;
+      } else if (!closed_) {
+        receivers_.push_back(receiver);
+        return true;
+      }
+    }
+    if (wakeup) {
+      resume_on(executor_, wakeup);
+    }
+    return false;
+  }
+
+private:
+  Executor *executor_;
+  size_t    capacity_;
+
+  mutable std::mutex        mutex_;
+  std::deque<T>             buffer_;
+  std::deque<SendAwaiter *> senders_;    // 缓冲区满时挂起的发送方
+  std::deque<RecvAwaiter *> receivers_;  // 缓冲区空时挂起的接收方
+  bool                      closed_ = false;
+};
+
+}  // namespace common
@@ -0,0 +1,81 @@
+//
+// Created by Coonger on 2024/12/15.
+//
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+
+#include "type_def.h"
+
+namespace common {
+
+/**
+ * @brief 按吞吐爬山调整转换线程的并发度
+ * @details 线程池原来固定 1 个核心线程、最多 4 个线程，只按队列长度扩容：4 核机器上会和收集、写线程抢 CPU，
+ * 96 核机器上又用不满。这里每个采样区间统计一次转换吞吐（条/秒），和上一个区间比较后移动并发度：
+ *   - 吞吐上升：沿原方向继续走，连续上升时步长翻倍，从下限爬到上百个线程只需要几个区间
+ *   - 吞吐下降：掉头，步长回到 1
+ *   - 吞吐持平：多出来的线程没有用，刚加过线程就退回加之前的并发度，否则减一个；已经在下限时加一个试探
+ *   - 写线程是瓶颈（等待写出的 batch 在增长，且比 worker 还多）：减一个，转换得再快也只是堆在内存里
+ *   - 区间内 worker 没有积压：负载决定吞吐，和并发度无关，保持不动，也不作为下次比较的基线
+ * 并发度始终在 [min_workers, max_workers] 之间，初始值为 min_workers。
+ * observe_backlog、update 只能在一个线程里调用（收集线程），limit 等读接口可以在任意线程调用
+ */
+class ConcurrencyController
+{
+public:
+  using Clock = std::chrono::steady_clock;
+
+  ConcurrencyController(int min_workers, int max_workers, std::chrono::milliseconds interval);
+
+  ConcurrencyController(const ConcurrencyController &)            = delete;
+  ConcurrencyController &operator=(const ConcurrencyController &) = delete;
+
+  /**
+   * @brief 投递任务前上报 worker 是否还有没取走的任务
+   */
+  void observe_backlog(bool waiting) { backlog_ |= waiting; }
+
+  /**
+   * @brief 满一个采样区间时按吞吐调整并发度
+   *
+   * @param completed  截至 now 一共转换完的记录数
+   * @param unwritten  已经转换完、还没写出的 batch 数
+   * @return true 表示并发度变了，调用者需要把 limit() 设置到线程池上
+   */
+  bool update(uint64 completed, uint64 unwritten, Clock::time_point now);
+
+  /// 当前的并发度
+  int limit() const { return limit_.load(std::memory_order_relaxed); }
+
+  int min_workers() const { return min_workers_; }
+  int max_workers() const { return max_workers_; }
+
+  /// 上一个区间的吞吐（条/秒）
+  double throughput() const { return throughput_.load(std::memory_order_relaxed); }
+  /// 上一个区间平均每个 worker 的吞吐（条/秒）
+  double worker_throughput() const { return worker_throughput_.load(std::memory_order_relaxed); }
+
+private:
+  const int                       min_workers_;
+  const int                       max_workers_;
+  const std::chrono::milliseconds interval_;
+
+  std::atomic<int>    limit_;
+  std::atomic<double> throughput_{0};
+  std::atomic<double> worker_throughput_{0};
+
+  bool              started_ = false;
+  bool              backlog_ = false;  // 这个区间里是否观测到积压
+  Clock::time_point last_sample_;
+  uint64            last_completed_ = 0;
+  uint64            last_unwritten_ = 0;
+  double            baseline_       = 0;  // 上一个有积压的区间的吞吐，0 表示没有基线
+  int               direction_      = 1;  // 上一次移动的方向
+  int               previous_limit_ = 0;  // 上一次移动前的并发度
+  int               step_           = 1;
+};
+
+}  // namespace common
@@ -0,0 +1,132 @@
+//
+// Created by Coonger on 2024/12/13.
+//
+
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+
+#include "executor.h"
+
+namespace common {
+
+/**
+ * @brief 协程相关的基础设施
+ * @defgroup Coroutine
+ * @details 流水线的每个阶段写成一个协程，阶段之间用 Channel 连接，协程挂起时不占用线程。
+ * 协程总是在一个 Executor 上恢复：唤醒对方时把 resume 投递到执行器，而不是在当前线程里直接恢复，
+ * 这样不会在持锁时递归执行别的阶段，也不会因为互相唤醒而把栈越压越深。
+ */
+
+/**
+ * @brief 在 executor 上恢复协程，执行器拒绝（已关闭）时就地恢复
+ * @ingroup Coroutine
+ */
+inline void resume_on(Executor *executor, std::coroutine_handle<> handle)
+{
+  if (executor == nullptr || executor->execute([handle] { handle.resume(); }) != 0) {
+    handle.resume();
+  }
+}
+
+/**
+ * @brief co_await schedule_on(executor) 把当前协程切换到 executor 的线程上继续执行
+ * @ingroup Coroutine
+ */
+struct ScheduleAwaiter
+{
+  Executor *executor;
+
+  bool await_ready() const noexcept { return false; }
+  void await_suspend(std::coroutine_handle<> handle) const { resume_on(executor, handle); }
+  void await_resume() const noexcept {}
+};
+
+inline ScheduleAwaiter schedule_on(Executor *executor) { return ScheduleAwaiter{executor}; }
+
+/**
+ * @brief 不需要返回值的独立协程，创建后立即开始执行，执行完自行销毁
+ * @ingroup Coroutine
+ * @details 调用者负责保证协程用到的对象活得比协程久，通常是在析构前等待各阶段都退出。
+ * 协程里抛出的异常无法传递给任何人，直接终止进程
+ */
+class Fiber
+{
+public:
+  struct promise_type
+  {
+    Fiber               get_return_object() noexcept { return {}; }
+    std::suspend_never  initial_suspend() const noexcept { return {}; }
+    std::suspend_never  final_suspend() const noexcept { return {}; }
+    void                return_void() const noexcept {}
+    void                unhandled_exception() const noexcept { std::terminate(); }
+  };
+};
+
+/**
+ * @brief 自动复位的事件，只允许一个协程等待
+ * @ingroup Coroutine
+ * @details 生产者线程调用 set()，没有等待者时只置位，代价是一次原子读；
+ * 有等待者时把它投递到 executor 上恢复。co_await wait() 遇到已置位的事件时清除并直接继续
+ */
+class AsyncEvent
+{
+public:
+  explicit AsyncEvent(Executor *executor) : executor_(executor) {}
+
+  AsyncEvent(const AsyncEvent &)            = delete;
+  AsyncEvent &operator=(const AsyncEvent &) = delete;
+
+  void set()
+  {
+    void *state = state_.load(std::memory_order_acquire);
+    while (state != signaled()) {
+      if (state == nullptr) {
+        if (state_.compare_exchange_weak(state, signaled(), std::memory_order_acq_rel)) {
+          return;
+        }
+      } else if (state_.compare_exchange_weak(state, nullptr, std::memory_order_acq_rel)) {
+        resume_on(executor_, std::coroutine_handle<>::from_address(state));
+        return;
+      }
+    }
+  }
+
+  struct Awaiter
+  {
+    AsyncEvent *event;
+
+    bool await_ready() const noexcept { return false; }
+
+    /// 已置位时返回 false，不挂起
+    bool await_suspend(std::coroutine_handle<> handle) const
+    {
+      void *state = event->state_.load(std::memory_order_acquire);
+      while (true) {
+        if (state == event->signaled()) {
+          if (event->state_.compare_exchange_weak(state, nullptr, std::memory_order_acq_rel)) {
+            return false;
+          }
+        } else if (event->state_.compare_exchange_weak(state, handle.address(), std::memory_order_acq_rel)) {
+          return true;
+        }
+      }
+    }
+
+    void await_resume() const noexcept {}
+  };
+
+  Awaiter wait() { return Awaiter{this}; }
+
+private:
+  /// 置位状态用事件自己的地址表示，不会和协程帧地址冲突
+  void *signaled() const { return const_cast<AsyncEvent *>(this); }
+
+private:
+  Executor          *executor_;
+  std::atomic<void *> state_{nullptr};  // nullptr：未置位；signaled()：已置位；其他：等待者的协程句柄
+};
+
+}  // namespace common
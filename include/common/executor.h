@@ -0,0 +1,116 @@
+//
+// Created by Coonger on 2024/12/8.
+//
+
+#pragma once
+
+#include <functional>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+
+#include "runnable.h"
+#include "thread_util.h"
+#include "type_def.h"
+
+namespace common {
+
+/**
+ * @brief 任务执行器接口
+ * @ingroup ThreadPool
+ * @details 调用方只依赖 execute / shutdown / await_termination，
+ * 具体是 ThreadPoolExecutor 还是 WorkStealingExecutor 在创建时决定
+ */
+class Executor
+{
+public:
+  Executor()          = default;
+  virtual ~Executor() = default;
+
+  /**
+   * @brief 提交一个任务，不一定可以立即执行
+   *
+   * @param task 任务
+   * @return int 成功放入队列返回0
+   */
+  virtual int execute(std::unique_ptr<Runnable> &&task) = 0;
+
+  /**
+   * @brief 提交一个任务，不一定可以立即执行
+   *
+   * @param callable 任务
+   * @return int 成功放入队列返回0
+   */
+  int execute(const std::function<void()> &callable)
+  {
+    return execute(std::unique_ptr<Runnable>(new RunnableAdaptor(callable)));
+  }
+
+  /**
+   * @brief 提交一个任务，返回可以等待结果的 future
+   * @details 任务的返回值或抛出的异常都通过 future 传回；执行器已关闭时返回的 future 里是 std::runtime_error
+   */
+  template <typename F>
+  auto submit(F &&func) -> std::future<std::invoke_result_t<std::decay_t<F>>>;
+
+  /**
+   * @brief 关闭执行器，不再接受新任务，已提交的任务会继续执行完
+   */
+  virtual int shutdown() = 0;
+
+  /**
+   * @brief 等待执行器处理完所有任务并退出
+   */
+  virtual int await_termination() = 0;
+
+  /**
+   * @brief 当前线程个数
+   */
+  virtual int pool_size() const = 0;
+
+  /**
+   * @brief 处理过的任务个数
+   */
+  virtual int64 task_count() const = 0;
+
+  /**
+   * @brief 线程启动时绑定到这些 CPU 上，跨 NUMA 节点时按节点轮流分给各线程。要在 init 之前调用
+   */
+  void set_thread_cpus(const std::vector<int> &cpus) { placement_.assign(cpus); }
+
+protected:
+  CpuPlacement placement_;  /// 线程启动时领取的 CPU
+};
+
+/**
+ * @brief 把 packaged_task 适配成 Runnable，submit() 用它来避免再包一层 std::function
+ */
+template <typename R>
+class PackagedRunnable : public Runnable
+{
+public:
+  explicit PackagedRunnable(std::packaged_task<R()> &&task) : task_(std::move(task)) {}
+
+  void run() override { task_(); }
+
+private:
+  std::packaged_task<R()> task_;
+};
+
+template <typename F>
+auto Executor::submit(F &&func) -> std::future<std::invoke_result_t<std::decay_t<F>>>
+{
+  using R = std::invoke_result_t<std::decay_t<F>>;
+
+  std::packaged_task<R()> task(std::forward<F>(func));
+  std::future<R>          future = task.get_future();
+  if (execute(std::make_unique<PackagedRunnable<R>>(std::move(task))) != 0) {
+    std::promise<R> rejected;
+    rejected.set_exception(std::make_exception_ptr(std::runtime_error("executor is not running")));
+    return rejected.get_future();
+  }
+  return future;
+}
+
+}  // namespace common
@@ -23,6 +23,35 @@
 
 #define CORE_THREAD_NUM 1
 
+// *** pipeline memory budget ***
+// ingest、transform、reorder 三个阶段共享的内存预算，0 表示不限制
+#define DEFAULT_MEMORY_BUDGET (512ULL * 1024 * 1024)
+// transformAsync 等待 credit 的最长时间，超时返回 RC::SPEED_LIMIT
+#define DEFAULT_ADMISSION_TIMEOUT_MS 1000
+
+// *** dependency tracking ***
+// WRITESET 依赖追踪记住的行哈希个数上限，同 MySQL binlog_transaction_dependency_history_size 的默认值
+#define DEFAULT_WRITESET_HISTORY_SIZE 25000
+
+// *** adaptive batching ***
+// 收集线程一个 batch 的条数范围，实际大小由 AdaptiveBatcher 按到达速率和转换耗时决定
+#define DEFAULT_BATCH_MIN_SIZE 64
+#define DEFAULT_BATCH_MAX_SIZE 4096
+// 一条记录从入队到被投递转换的最长等待时间
+#define DEFAULT_BATCH_MAX_LATENCY_US 5000
+
+// *** worker autoscaling ***
+// ConcurrencyController 比较吞吐的采样区间，太短时一个区间只有几个 batch，吞吐抖动比调整带来的变化还大
+#define DEFAULT_AUTOSCALE_INTERVAL_MS 500
+
+// *** metrics ***
+// node_exporter 默认每 15 秒抓一次，textfile 写得比这更频繁没有意义
+#define DEFAULT_METRICS_INTERVAL_MS 15000
+
+// *** tracing ***
+// 每个 span 40 字节，每个线程最多占 2.5MB
+#define DEFAULT_TRACE_EVENTS_PER_THREAD (1 << 16)
+
 // arbitrary
 #define DML_TABLE_ID 13
 
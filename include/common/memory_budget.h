@@ -0,0 +1,88 @@
+//
+// Created by Coonger on 2024/12/7.
+//
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+#include "type_def.h"
+
+namespace common {
+
+/**
+ * @brief 整条流水线共享的内存预算，按字节记账的 credit 流控
+ * @details TaskQueue 只限制了条数，ResultQueue 的乱序缓冲和线程池的任务队列都没有上限，
+ * 写线程跟不上时（例如追赶历史日志）内存会一直涨。这里把 ingest -> transform -> reorder 三个阶段
+ * 持有的字节都记到同一个预算上：
+ *   1. 生产者在 transformAsync 里为输入 buf 申请 credit，预算不足时阻塞等待，超时返回 RC::SPEED_LIMIT
+ *   2. 转换线程用 force_acquire 为输出记账、释放已不再引用的输入，永不阻塞
+ *   3. 写线程把一个 batch 写完后归还它持有的全部 credit，唤醒等待的生产者
+ * 只有生产者会等待，而归还 credit 的写线程不依赖生产者，所以不会死锁；
+ * 转换阶段可能短暂超出预算，超出量不会超过在途 batch 的输出大小。
+ */
+class MemoryBudget
+{
+public:
+  /**
+   * @param capacity 预算字节数，0 表示不限制（只记账）
+   */
+  explicit MemoryBudget(size_t capacity) : capacity_(capacity) {}
+
+  MemoryBudget(const MemoryBudget &)            = delete;
+  MemoryBudget &operator=(const MemoryBudget &) = delete;
+
+  /**
+   * @brief 申请 bytes 字节，预算不足时最多等待 timeout
+   * @details 比整个预算还大的单个申请在预算空闲时放行，避免永远等不到
+   * @return 超时或已 close() 返回 false，此时没有占用任何 credit
+   */
+  bool acquire(size_t bytes, std::chrono::milliseconds timeout);
+
+  /**
+   * @brief 不等待地申请，预算不足时直接返回 false
+   */
+  bool try_acquire(size_t bytes);
+
+  /**
+   * @brief 无条件记账，用于不能阻塞的阶段
+   */
+  void force_acquire(size_t bytes);
+
+  /**
+   * @brief 归还 credit，并唤醒等待的生产者
+   */
+  void release(size_t bytes);
+
+  /**
+   * @brief 唤醒所有等待者并让后续的 acquire 立即失败，用于 shutdown
+   */
+  void close();
+
+  size_t capacity() const { return capacity_; }
+  size_t used() const { return used_.load(std::memory_order_relaxed); }
+  /// 历史最高占用
+  size_t peak() const { return peak_.load(std::memory_order_relaxed); }
+  /// acquire 因预算不足而等待过的次数
+  uint64 stalls() const { return stalls_.load(std::memory_order_relaxed); }
+
+private:
+  bool admissible(size_t bytes) const;
+  void add_locked(size_t bytes);
+
+private:
+  const size_t capacity_;
+
+  std::mutex              mutex_;
+  std::condition_variable cv_;
+  bool                    closed_ = false;
+
+  std::atomic<size_t> used_{0};
+  std::atomic<size_t> peak_{0};
+  std::atomic<uint64> stalls_{0};
+};
+
+}  // namespace common
@@ -0,0 +1,250 @@
+//
+// Created by Coonger on 2024/12/17.
+//
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "rc.h"
+#include "type_def.h"
+
+namespace common {
+
+/**
+ * @defgroup Metrics
+ * @brief 流水线各阶段的指标：计数器、仪表、直方图，导出成 Prometheus 文本格式
+ * @details 更新指标只有 relaxed 原子操作，不加锁；注册和导出在 MetricsRegistry 的锁里进行。
+ * 热路径上应该在初始化时拿到指标的指针，之后直接更新，不要每次都按名字查找
+ */
+
+/// 指标的标签，按给定的顺序输出
+using MetricLabels = std::vector<std::pair<std::string, std::string>>;
+
+namespace detail {
+
+/// 每个线程固定用一个分片，线程第一次更新指标时轮流分配
+inline size_t metric_shard(size_t shards)
+{
+  static std::atomic<size_t> next{0};
+  thread_local size_t        shard = next.fetch_add(1, std::memory_order_relaxed);
+  return shard % shards;
+}
+
+}  // namespace detail
+
+/**
+ * @brief 单调递增的计数器，按线程分片
+ * @ingroup Metrics
+ * @details 每个分片独占一个 cache line，多个转换线程同时累加时不会在同一个 cache line 上来回争抢，
+ * 读取时把所有分片加起来
+ */
+class Counter
+{
+public:
+  static constexpr size_t SHARDS = 16;
+
+  void add(uint64 n = 1) { shards_[detail::metric_shard(SHARDS)].value.fetch_add(n, std::memory_order_relaxed); }
+
+  uint64 value() const
+  {
+    uint64 sum = 0;
+    for (const Shard &shard : shards_) {
+      sum += shard.value.load(std::memory_order_relaxed);
+    }
+    return sum;
+  }
+
+private:
+  struct alignas(64) Shard
+  {
+    std::atomic<uint64> value{0};
+  };
+
+  std::array<Shard, SHARDS> shards_;
+};
+
+/**
+ * @brief 可增可减的瞬时值
+ * @ingroup Metrics
+ */
+class Gauge
+{
+public:
+  void  set(int64 v) { value_.store(v, std::memory_order_relaxed); }
+  void  add(int64 n) { value_.fetch_add(n, std::memory_order_relaxed); }
+  int64 value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<int64> value_{0};
+};
+
+/**
+ * @brief HDR 风格的直方图：对数分段、段内线性
+ * @ingroup Metrics
+ * @details 小于 16 的值各占一个桶；之后每个 2 的幂区间再均分成 16 个桶，相对误差不超过 1/16，
+ * 覆盖整个 uint64 只要 976 个桶。记录的是整数（纳秒、字节），导出时乘以 scale 换算成 Prometheus 的单位，
+ * 比如纳秒记录、按秒导出时 scale 为 1e-9。导出的 le 边界是 2 的幂，从 1 到 2^max_exponent
+ */
+class Histogram
+{
+public:
+  static constexpr int    SUB_BUCKET_BITS = 4;
+  static constexpr uint64 SUB_BUCKETS     = 1ULL << SUB_BUCKET_BITS;
+  static constexpr size_t BUCKETS         = SUB_BUCKETS + (64 - SUB_BUCKET_BITS) * SUB_BUCKETS;
+
+  explicit Histogram(double scale = 1, int max_exponent = 40) : scale_(scale), max_exponent_(max_exponent) {}
+
+  void record(uint64 value)
+  {
+    buckets_[bucket_of(value)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(value, std::memory_order_relaxed);
+  }
+
+  void record_duration(std::chrono::nanoseconds elapsed)
+  {
+    record(elapsed.count() > 0 ? static_cast<uint64>(elapsed.count()) : 0);
+  }
+
+  uint64 count() const { return count_.load(std::memory_order_relaxed); }
+  uint64 sum() const { return sum_.load(std::memory_order_relaxed); }
+  double scale() const { return scale_; }
+  int    max_exponent() const { return max_exponent_; }
+
+  /**
+   * @brief 分位数的近似值：所在桶里的最大值（未乘 scale），q 在 [0, 1]，没有样本时返回 0
+   */
+  uint64 percentile(double q) const;
+
+  /// 落在 [0, 2^exponent) 里的样本数
+  uint64 count_below_power(int exponent) const;
+
+  static size_t bucket_of(uint64 value);
+  /// 桶的上界（不含）
+  static uint64 bucket_upper(size_t bucket);
+
+private:
+  double                                   scale_;
+  int                                      max_exponent_;
+  std::array<std::atomic<uint64>, BUCKETS> buckets_{};
+  std::atomic<uint64>                      count_{0};
+  std::atomic<uint64>                      sum_{0};
+};
+
+enum class MetricType
+{
+  COUNTER,
+  GAUGE,
+  HISTOGRAM,
+};
+
+/**
+ * @brief 指标的注册表，负责按名字和标签管理指标、导出 Prometheus 文本格式
+ * @ingroup Metrics
+ * @details 同一个名字和标签重复注册时返回已有的指标。同名的指标是一个 family，类型必须一致，
+ * 不一致时打日志并返回 nullptr。已有的计数值（比如 LogFileManager 的进度计数、线程池的队列长度）
+ * 用 callback 注册，导出时调用，回调里访问的对象要比注册表活得久，或者在它们销毁前停止导出
+ */
+class MetricsRegistry
+{
+public:
+  MetricsRegistry() = default;
+
+  MetricsRegistry(const MetricsRegistry &)            = delete;
+  MetricsRegistry &operator=(const MetricsRegistry &) = delete;
+
+  Counter   *counter(const std::string &name, const std::string &help, const MetricLabels &labels = {});
+  Gauge     *gauge(const std::string &name, const std::string &help, const MetricLabels &labels = {});
+  Histogram *histogram(const std::string &name, const std::string &help, double scale = 1,
+      const MetricLabels &labels = {});
+
+  /**
+   * @brief 注册一个导出时才取值的指标，type 只能是 COUNTER 或 GAUGE
+   */
+  bool callback(const std::string &name, const std::string &help, MetricType type, std::function<double()> fn,
+      const MetricLabels &labels = {});
+
+  /**
+   * @brief 按 Prometheus 文本格式（0.0.4）输出所有指标
+   */
+  std::string to_prometheus() const;
+
+  /**
+   * @brief 写成 node_exporter textfile collector 读取的文件
+   * @details 先写 path.tmp 再 rename，collector 不会读到写了一半的文件
+   */
+  RC write_textfile(const std::string &path) const;
+
+private:
+  struct Metric
+  {
+    std::string                label_body;  // 已经转义、格式化好的 k="v",k2="v2"，没有标签时为空
+    std::unique_ptr<Counter>   counter;
+    std::unique_ptr<Gauge>     gauge;
+    std::unique_ptr<Histogram> histogram;
+    std::function<double()>    fn;
+  };
+
+  struct Family
+  {
+    std::string        help;
+    MetricType         type;
+    std::deque<Metric> metrics;  // deque 保证已经返回的指针不失效
+  };
+
+  Metric *find_or_create(const std::string &name, const std::string &help, MetricType type,
+      const MetricLabels &labels, bool &created);
+
+private:
+  mutable std::mutex            mutex_;
+  std::map<std::string, Family> families_;  // 按名字排序，导出的顺序稳定
+};
+
+/**
+ * @brief 后台线程按固定间隔把注册表写成 textfile
+ * @ingroup Metrics
+ */
+class MetricsExporter
+{
+public:
+  MetricsExporter(const MetricsRegistry &registry, std::string path, std::chrono::milliseconds interval);
+  ~MetricsExporter();
+
+  MetricsExporter(const MetricsExporter &)            = delete;
+  MetricsExporter &operator=(const MetricsExporter &) = delete;
+
+  void start();
+
+  /**
+   * @brief 停止后台线程，并写最后一次，结束前的计数不会丢
+   */
+  void stop();
+
+private:
+  void run();
+
+private:
+  const MetricsRegistry    &registry_;
+  std::string               path_;
+  std::chrono::milliseconds interval_;
+
+  std::mutex              mutex_;
+  std::condition_variable cv_;
+  bool                    stopping_ = false;
+  std::thread             thread_;
+};
+
+}  // namespace common
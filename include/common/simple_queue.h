@@ -32,7 +32,7 @@ public:
   int size() const override;
 
 private:
-  std::mutex             mutex_;
+  mutable std::mutex     mutex_;
   std::queue<value_type> queue_;
 };
 
@@ -60,7 +60,8 @@ int SimpleQueue<T>::pop(T &value)
 template <typename T>
 int SimpleQueue<T>::size() const
 {
-  return queue_.size();
+  std::lock_guard<std::mutex> lock(mutex_);
+  return static_cast<int>(queue_.size());
 }
 
 }  // namespace common
@@ -0,0 +1,74 @@
+//
+// Created by Coonger on 2024/12/9.
+//
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#include "executor.h"
+
+namespace common {
+
+/**
+ * @brief 一组提交到同一个执行器上的任务，可以整体等待
+ * @ingroup ThreadPool
+ * @details 典型用法是等待一批 BatchProcessor 全部执行完，而不必关闭线程池：
+ * @code
+ *   TaskGroup group(executor);
+ *   for (...) group.run([...] { ... });
+ *   group.wait();
+ * @endcode
+ * 析构时会等待组内的任务全部结束，保证任务里不会访问到已销毁的 group
+ */
+class TaskGroup
+{
+public:
+  explicit TaskGroup(Executor *executor) : executor_(executor) {}
+  ~TaskGroup();
+
+  TaskGroup(const TaskGroup &)            = delete;
+  TaskGroup &operator=(const TaskGroup &) = delete;
+
+  /**
+   * @brief 提交一个属于这个组的任务
+   * @return int 成功放入队列返回0，执行器已关闭时返回非0，此时任务不计入组内
+   */
+  int run(std::unique_ptr<Runnable> &&task);
+  int run(const std::function<void()> &callable);
+
+  /**
+   * @brief 等待组内已提交的任务全部执行完
+   */
+  void wait();
+
+  /**
+   * @brief 最多等待 timeout
+   * @return 组内任务全部执行完返回 true
+   */
+  bool wait_for(std::chrono::milliseconds timeout);
+
+  /**
+   * @brief 已提交还没执行完的任务个数
+   */
+  int64 pending() const;
+
+private:
+  class GroupRunnable;
+
+  /// 组内一个任务执行完
+  void done();
+
+private:
+  Executor *executor_;
+
+  mutable std::mutex      mutex_;
+  std::condition_variable cv_;
+  int64                   pending_ = 0;
+};
+
+}  // namespace common
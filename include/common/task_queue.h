@@ -2,13 +2,17 @@
 // Created by Coonger on 2024/11/21.
 //
 
-#include <string>
-#include <vector>
+#pragma once
 
-#include <condition_variable>
-#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
 #include <vector>
 
+#include "batch_completion.h"
+#include "thread_util.h"
+#include "trace.h"
 #include "type_def.h"
 
 // struct Task {
@@ -25,6 +29,9 @@ struct Task
 {
   std::vector<unsigned char> data_;  // 直接使用 vector 存储原始数据
   bool                       is_ddl_;
+  common::BatchHandle        completion_;  // 通过 transformBatch 提交时，所属批次的完成句柄
+  int64                      last_committed_  = 0;   // WRITESET 依赖追踪算出的逻辑时钟，
+  int64                      sequence_number_ = 0;   // sequence_number_ 为 0 表示沿用源端记录里的值
 
   Task() : is_ddl_(false) {}
 
@@ -33,63 +40,283 @@ struct Task
 };
 
 /**
- * @brief 生产者任务队列
+ * @brief 生产者任务队列：有界无锁 MPMC 环形队列
+ * @details 参考 Dmitry Vyukov 的 bounded MPMC queue：每个槽位带一个 sequence，
+ * 生产者和消费者各自只 CAS 一个位置计数（enqueue_pos_ / dequeue_pos_），互不争抢同一把锁。
+ *   - 槽位 sequence == pos      ：空闲，可以写入第 pos 个元素
+ *   - 槽位 sequence == pos + 1  ：第 pos 个元素已写好，可以读取
+ *   - 读完后 sequence 置为 pos + capacity，等待下一轮写入
+ * push_bulk / pop_bulk 先检查连续 n 个槽位的状态，再用一次 CAS 把位置计数推进 n，
+ * 收集线程一次就能取走一个 batch。
+ * 阻塞版本的 write / read / push_bulk 先自旋一小段，再在 C++20 atomic wait（Linux 上是 futex）上休眠，
+ * 只有存在休眠者时对端才会调用 notify，没有竞争时不进内核。
+ * @tparam T 元素类型，要求可默认构造、可移动赋值
  */
 template <typename T>
 class TaskQueue
 {
 public:
-  explicit TaskQueue(size_t capacity) : capacity_(capacity), head_(0), tail_(0), size_(0), buffer_(capacity) {}
-
-  // 写入任务
-  //  bool write(const T &task) {
-  //    std::unique_lock<std::mutex> lock(mutex_);
-  //    cond_not_full_.wait(lock, [this] { return size_ < capacity_; }); // 等待有空位
-  //
-  //    buffer_[tail_] = task;
-  //    tail_ = (tail_ + 1) % capacity_;
-  //    ++size_;
-  //
-  //    cond_not_empty_.notify_one(); // 通知有新任务
-  //    return true;
-  //  }
-
-  // 添加移动版本的写入方法
-  bool write(T &&task)
+  /**
+   * @param capacity 队列容量，会向上取整到 2 的幂
+   */
+  explicit TaskQueue(size_t capacity)
   {
-    std::unique_lock<std::mutex> lock(mutex_);
-    cond_not_full_.wait(lock, [this] { return size_ < capacity_; });
+    size_t cap = 2;
+    while (cap < capacity) {
+      cap <<= 1;
+    }
+    capacity_ = cap;
+    mask_     = cap - 1;
+    cells_    = std::make_unique<Cell[]>(cap);
+    for (size_t i = 0; i < cap; ++i) {
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
 
-    buffer_[tail_] = std::move(task);
-    tail_          = (tail_ + 1) % capacity_;
-    ++size_;
+  TaskQueue(const TaskQueue &)            = delete;
+  TaskQueue &operator=(const TaskQueue &) = delete;
 
-    cond_not_empty_.notify_one();
-    return true;
+  /**
+   * @brief 把槽位数组迁移到 node 节点上，一般是消费者（收集线程）所在的节点
+   */
+  int bind_memory_node(int node) { return common::memory_bind_numa_node(cells_.get(), sizeof(Cell) * capacity_, node); }
+
+  /**
+   * @brief 写入一个任务，队列满时先自旋再休眠，直到写入成功；不会失败，需要限流时用 try_write
+   */
+  void write(T &&task)
+  {
+    for (int spin = 0; !try_write(std::move(task)); ++spin) {
+      backoff(spin, not_full_epoch_, full_waiters_, [this] { return !full(); });
+    }
   }
 
-  // 读取任务
-  bool read(T &task)
+  /**
+   * @brief 不等待地写入一个任务
+   * @return 队列满时返回 false，task 保持不变
+   */
+  bool try_write(T &&task) { return try_push_bulk(&task, 1) == 1; }
+
+  /**
+   * @brief 写入 count 个任务，全部写入前会阻塞
+   */
+  void push_bulk(T *tasks, size_t count)
+  {
+    push_bulk(tasks, count, [](size_t) {});
+  }
+
+  /**
+   * @brief 写入 count 个任务，每写入一段就调用 on_pushed(n)
+   * @details count 可能比容量还大，消费者要靠 on_pushed 及时知道已经有数据可取，否则双方会互相等待
+   */
+  template <typename OnPushed>
+  void push_bulk(T *tasks, size_t count, OnPushed &&on_pushed)
+  {
+    size_t done = 0;
+    for (int spin = 0; done < count; ++spin) {
+      size_t pushed = try_push_bulk(tasks + done, count - done);
+      if (pushed > 0) {
+        done += pushed;
+        spin = 0;
+        on_pushed(pushed);
+        continue;
+      }
+      backoff(spin, not_full_epoch_, full_waiters_, [this] { return !full(); });
+    }
+  }
+
+  /**
+   * @brief 不等待地写入至多 count 个任务，一次 CAS 占下连续的空闲槽位
+   * @return 实际写入的个数，写入的是 tasks 的前缀
+   */
+  size_t try_push_bulk(T *tasks, size_t count)
   {
-    std::unique_lock<std::mutex> lock(mutex_);
-    cond_not_empty_.wait(lock, [this] { return size_ > 0; });  // 等待有任务
+    size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    size_t n   = 0;
+    while (true) {
+      n = 0;
+      while (n < count && n < capacity_) {
+        size_t    seq  = cells_[(pos + n) & mask_].sequence.load(std::memory_order_acquire);
+        intptr_t  diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + n);
+        if (diff != 0) {
+          break;
+        }
+        ++n;
+      }
+      if (n == 0) {
+        size_t seq = cells_[pos & mask_].sequence.load(std::memory_order_acquire);
+        if (static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos) < 0) {
+          return 0;  // 满了
+        }
+        pos = enqueue_pos_.load(std::memory_order_relaxed);  // 被别的生产者抢先了
+        continue;
+      }
+      if (enqueue_pos_.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed)) {
+        break;
+      }
+    }
 
-    task  = buffer_[head_];
-    head_ = (head_ + 1) % capacity_;
-    --size_;
+    for (size_t i = 0; i < n; ++i) {
+      Cell &cell = cells_[(pos + i) & mask_];
+      cell.data  = std::move(tasks[i]);
+      cell.sequence.store(pos + i + 1, std::memory_order_release);
+    }
+    wake(not_empty_epoch_, empty_waiters_);
+    return n;
+  }
 
-    cond_not_full_.notify_one();  // 通知有空位
+  /**
+   * @brief 读取一个任务，队列空时先自旋再休眠，直到读到为止
+   */
+  bool read(T &task)
+  {
+    for (int spin = 0; !try_read(task); ++spin) {
+      backoff(spin, not_empty_epoch_, empty_waiters_, [this] { return !empty(); });
+    }
     return true;
   }
 
+  /**
+   * @brief 不等待地读取一个任务
+   */
+  bool try_read(T &task)
+  {
+    T *out = &task;
+    return pop_cells(1, [&out](T &&item) { *out = std::move(item); }) == 1;
+  }
+
+  /**
+   * @brief 不等待地取走至多 max_count 个任务，追加到 out 的末尾
+   * @return 实际取走的个数
+   */
+  size_t pop_bulk(std::vector<T> &out, size_t max_count)
+  {
+    return pop_cells(max_count, [&out](T &&item) { out.push_back(std::move(item)); });
+  }
+
+  /**
+   * @brief 队列里元素个数的近似值
+   */
+  size_t size() const
+  {
+    size_t tail = enqueue_pos_.load(std::memory_order_relaxed);
+    size_t head = dequeue_pos_.load(std::memory_order_relaxed);
+    return tail > head ? tail - head : 0;
+  }
+
+  size_t capacity() const { return capacity_; }
+
 private:
-  size_t         capacity_;
-  size_t         head_;
-  size_t         tail_;
-  size_t         size_;
-  std::vector<T> buffer_;
-
-  std::mutex              mutex_;
-  std::condition_variable cond_not_empty_;
-  std::condition_variable cond_not_full_;
+  struct Cell
+  {
+    std::atomic<size_t> sequence{0};
+    T                   data;
+  };
+
+  static constexpr int SPIN_LIMIT  = 64;  // 自旋多少轮后 yield
+  static constexpr int YIELD_LIMIT = 80;  // 再 yield 多少轮后休眠
+
+  template <typename Sink>
+  size_t pop_cells(size_t max_count, Sink &&sink)
+  {
+    size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+    size_t n   = 0;
+    while (true) {
+      n = 0;
+      while (n < max_count && n < capacity_) {
+        size_t   seq  = cells_[(pos + n) & mask_].sequence.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + n + 1);
+        if (diff != 0) {
+          break;
+        }
+        ++n;
+      }
+      if (n == 0) {
+        size_t seq = cells_[pos & mask_].sequence.load(std::memory_order_acquire);
+        if (static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1) < 0) {
+          return 0;  // 空的
+        }
+        pos = dequeue_pos_.load(std::memory_order_relaxed);  // 被别的消费者抢先了
+        continue;
+      }
+      if (dequeue_pos_.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed)) {
+        break;
+      }
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+      Cell &cell = cells_[(pos + i) & mask_];
+      sink(std::move(cell.data));
+      cell.data = T();  // 及时释放任务持有的内存
+      cell.sequence.store(pos + i + capacity_, std::memory_order_release);
+    }
+    wake(not_full_epoch_, full_waiters_);
+    return n;
+  }
+
+  bool empty() const
+  {
+    size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+    size_t seq = cells_[pos & mask_].sequence.load(std::memory_order_acquire);
+    return static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1) < 0;
+  }
+
+  bool full() const
+  {
+    size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    size_t seq = cells_[pos & mask_].sequence.load(std::memory_order_acquire);
+    return static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos) < 0;
+  }
+
+  /**
+   * @brief 等待对端：先自旋、再 yield，最后登记为休眠者并在 epoch 上休眠
+   * @details 登记 waiters 和检查条件之间、对端发布数据和检查 waiters 之间都有 seq_cst fence，
+   * 两边至少有一方能看到对方，不会丢失唤醒
+   */
+  template <typename Ready>
+  void backoff(int spin, std::atomic<uint32> &epoch, std::atomic<int> &waiters, Ready &&ready)
+  {
+    if (spin < SPIN_LIMIT) {
+#if defined(__x86_64__) || defined(__i386__)
+      __builtin_ia32_pause();
+#endif
+      return;
+    }
+    if (spin < YIELD_LIMIT) {
+      std::this_thread::yield();
+      return;
+    }
+
+    uint32 current = epoch.load(std::memory_order_acquire);
+    waiters.fetch_add(1, std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!ready()) {
+      // 休眠说明对端跟不上，在 trace 里能看到生产者或收集线程卡在队列上
+      common::TraceSpan span(&epoch == &not_full_epoch_ ? "task_queue_full" : "task_queue_empty", "queue");
+      epoch.wait(current, std::memory_order_acquire);
+    }
+    waiters.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  void wake(std::atomic<uint32> &epoch, std::atomic<int> &waiters)
+  {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiters.load(std::memory_order_relaxed) > 0) {
+      epoch.fetch_add(1, std::memory_order_release);
+      epoch.notify_all();
+    }
+  }
+
+private:
+  size_t                  capacity_ = 0;
+  size_t                  mask_     = 0;
+  std::unique_ptr<Cell[]> cells_;
+
+  alignas(64) std::atomic<size_t> enqueue_pos_{0};
+  alignas(64) std::atomic<size_t> dequeue_pos_{0};
+
+  alignas(64) std::atomic<uint32> not_empty_epoch_{0};  // 有新数据时递增，消费者在上面休眠
+  std::atomic<int>                empty_waiters_{0};
+  alignas(64) std::atomic<uint32> not_full_epoch_{0};   // 有空位时递增，生产者在上面休眠
+  std::atomic<int>                full_waiters_{0};
 };
@@ -12,8 +12,10 @@
 #include <memory>
 #include <map>
 #include <chrono>
+#include <condition_variable>
 #include <thread>
 
+#include "executor.h"
 #include "queue.h"
 #include "type_def.h"
 
@@ -29,14 +31,17 @@ namespace common {
  * 线程分为两类，一类是核心线程，一类是普通线程。核心线程不会退出，普通线程会在空闲一段时间后退出。
  * 线程池有一个任务队列，收到的任务会放到任务队列中。当任务队列中任务的个数比当前线程个数多时，就会
  * 创建新的线程。
+ * 队列为空时线程在条件变量上休眠，直到有新任务、线程池关闭或非核心线程空闲超时。
+ * 另外可以用 set_active_limit() 限制同时执行任务的线程个数，超出的线程即使有任务也休眠，
+ * 配合 ConcurrencyController 按吞吐调整并发度。
  *
- * TODO 任务execute接口，增加一个future返回值，可以获取任务的执行结果
+ * 需要任务结果时用 submit() 拿 future；需要等一批任务而不关闭线程池时用 TaskGroup。
  */
-class ThreadPoolExecutor
+class ThreadPoolExecutor : public Executor
 {
 public:
   ThreadPoolExecutor() = default;
-  virtual ~ThreadPoolExecutor();
+  ~ThreadPoolExecutor() override;
 
   /**
    * @brief 初始化线程池
@@ -66,24 +71,18 @@ public:
    * @param task 任务
    * @return int 成功放入队列返回0
    */
-  int execute(std::unique_ptr<Runnable> &&task);
-
-  /**
-   * @brief 提交一个任务，不一定可以立即执行
-   *
-   * @param callable 任务
-   * @return int 成功放入队列返回0
-   */
-  int execute(const std::function<void()> &callable);
+  int execute(std::unique_ptr<Runnable> &&task) override;
+  using Executor::execute;
 
   /**
    * @brief 关闭线程池
    */
-  int shutdown();
+  int shutdown() override;
   /**
    * @brief 等待线程池处理完所有任务并退出
+   * @details 最后一个退出的线程负责唤醒，不轮询
    */
-  int await_termination();
+  int await_termination() override;
 
 public:
   /**
@@ -97,7 +96,7 @@ public:
   /**
    * @brief 线程池中线程个数
    */
-  int pool_size() const { return static_cast<int>(threads_.size()); }
+  int pool_size() const override { return static_cast<int>(threads_.size()); }
   /**
    * @brief 曾经达到过的最大线程个数
    */
@@ -105,13 +104,25 @@ public:
   /**
    * @brief 处理过的任务个数
    */
-  int64 task_count() const { return task_count_.load(); }
+  int64 task_count() const override { return task_count_.load(); }
 
   /**
    * @brief 任务队列中的任务个数
    */
   int64 queue_size() const { return static_cast<int64>(work_queue_->size()); }
 
+  /**
+   * @brief 限制同时执行任务的线程个数
+   * @details 取值限制在 [1, max_pool_size] 之间。调小时正在执行的任务不受影响，执行完后多出的线程休眠，
+   * 非核心线程随后空闲超时退出；调大时唤醒休眠的线程，必要时创建新线程
+   */
+  void set_active_limit(int limit);
+
+  /**
+   * @brief 同时执行任务的线程个数上限，默认等于 max_pool_size
+   */
+  int active_limit() const { return active_limit_.load(); }
+
 private:
   /**
    * @brief 创建一个线程
@@ -130,6 +141,16 @@ private:
    */
   int extend_thread();
 
+  /**
+   * @brief 占一个活跃名额，活跃线程数已经达到 active_limit_ 时返回 false
+   */
+  bool acquire_active();
+
+  /**
+   * @brief 归还活跃名额，队列里还有任务时唤醒一个因为名额休眠的线程
+   */
+  void release_active();
+
 private:
   /**
    * @brief 线程函数。从队列中拉任务并执行
@@ -167,10 +188,15 @@ private:
 
   mutable std::mutex                    lock_;     /// 保护线程池内部数据的锁
   std::map<std::thread::id, ThreadData> threads_;  /// 线程列表
+  std::condition_variable               terminated_cv_;  /// 和 lock_ 配合，threads_ 变空时通知 await_termination
+
+  std::mutex              idle_mutex_;  /// 和 idle_cv_ 配合，保护 “队列为空” 到 “开始休眠” 之间不丢唤醒
+  std::condition_variable idle_cv_;     /// 空闲线程在这里等待新任务
 
   int                largest_pool_size_ = 0;  /// 历史上达到的最大的线程个数
   std::atomic<int64> task_count_        = 0;  /// 处理过的任务个数
   std::atomic<int>   active_count_      = 0;  /// 活跃线程个数
+  std::atomic<int>   active_limit_      = 0;  /// 活跃线程个数上限
   std::string        pool_name_;              /// 线程池名称
 };
 
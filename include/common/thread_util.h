@@ -7,6 +7,11 @@
  */
 #pragma once
 
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <vector>
+
 namespace common {
 
 /**
@@ -18,4 +23,75 @@ namespace common {
  */
 int thread_set_name(const char *name);
 
+/**
+ * @brief 解析 CPU 列表，格式和 /sys/devices/system/node/node0/cpulist 相同，比如 "0-3,8,10-11"
+ * @return int 成功返回0，空串得到空列表；格式错误、范围颠倒或编号不小于 CPU_SETSIZE 时返回-1，cpus 被清空
+ */
+int parse_cpu_list(const std::string &list, std::vector<int> &cpus);
+
+/**
+ * @brief 把当前线程绑定到一组 CPU 上
+ * @details 这组 CPU 都在同一个 NUMA 节点上时，顺便把当前线程的内存分配策略设为优先这个节点，
+ * 线程之后首次访问的页（malloc 的 arena、vector 的扩容等）都落在本地节点上
+ * @return int 成功返回0；cpus 为空时什么都不做
+ */
+int thread_bind_cpus(const std::vector<int> &cpus);
+
+/**
+ * @brief 当前线程的内存分配优先使用 node 节点，内存不够时再用其他节点
+ * @return int 成功返回0；内核不支持 NUMA 时返回-1
+ */
+int thread_prefer_numa_node(int node);
+
+/**
+ * @brief 把 [addr, addr + len) 完整覆盖的页迁移到 node 节点，之后也优先在这个节点上分配
+ * @details 用于已经被别的线程初始化过的共享缓冲区，比如生产者和收集线程之间的 ring buffer
+ */
+int memory_bind_numa_node(void *addr, size_t len, int node);
+
+/**
+ * @brief CPU 所在的 NUMA 节点，不知道时返回-1
+ */
+int numa_node_of_cpu(int cpu);
+
+/**
+ * @brief NUMA 节点上的 CPU 列表
+ */
+int numa_node_cpus(int node, std::vector<int> &cpus);
+
+/**
+ * @brief 文件或目录所在块设备挂在哪个 NUMA 节点上
+ * @details 从 /sys/dev/block/<major>:<minor> 往上找第一个 numa_node 属性，NVMe 分区会找到它所在的 PCIe 设备。
+ * tmpfs、overlay 之类没有块设备，或者单节点机器上返回-1
+ */
+int numa_node_of_path(const char *path);
+
+/**
+ * @brief 按 NUMA 节点分组的一组 CPU，线程池的线程启动时依次领取一组
+ * @details 一个列表跨多个节点时，每个线程只绑定到其中一个节点的 CPU，并优先在这个节点上分配内存，
+ * 线程自己的 arena 和它转换出来的 buffer 都是本地的；线程之间按节点轮流分配。
+ * assign 要在线程启动前调用，place_current_thread 可以在多个线程里调用
+ */
+class CpuPlacement
+{
+public:
+  CpuPlacement() = default;
+
+  CpuPlacement(const CpuPlacement &)            = delete;
+  CpuPlacement &operator=(const CpuPlacement &) = delete;
+
+  void assign(const std::vector<int> &cpus);
+
+  bool empty() const { return groups_.empty(); }
+
+  /**
+   * @brief 把当前线程绑定到下一组 CPU 上，没有配置时什么都不做
+   */
+  int place_current_thread();
+
+private:
+  std::vector<std::vector<int>> groups_;  // 每个 NUMA 节点上的 CPU
+  std::atomic<size_t>           next_{0};
+};
+
 }  // namespace common
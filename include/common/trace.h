@@ -0,0 +1,143 @@
+//
+// Created by Coonger on 2024/12/18.
+//
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "rc.h"
+#include "type_def.h"
+
+namespace common {
+
+/**
+ * @brief 流水线活动的追踪，输出 Chrome trace event JSON，可以直接用 chrome://tracing 或 ui.perfetto.dev 打开
+ * @details 默认关闭，关闭时每个埋点只有一次 relaxed load。打开后每个线程第一次记录时领一个缓冲区，
+ * 记录一个 span 只写本线程的缓冲区，不加锁；缓冲区满了之后的 span 直接丢弃并计数，追踪的开销和内存都有上界。
+ * 缓冲区归 Tracer 所有，线程退出时归还，新线程优先领归还的缓冲区，接着已有的 span 往后写，
+ * 所以线程池反复创建线程时缓冲区个数不超过同时记录的线程数，退出线程的 span 也会保留到下次 start()。
+ * start() 要在被追踪的线程开始记录之前调用；write_chrome_json() 可以在运行中调用，只输出已经写完的 span
+ */
+class Tracer
+{
+public:
+  static Tracer &instance();
+
+  /**
+   * @brief 清空已有的 span 并开始记录
+   * @param events_per_thread 每个线程最多记录的 span 数
+   */
+  void start(size_t events_per_thread);
+  void stop() { enabled_.store(false, std::memory_order_relaxed); }
+
+  bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+  static uint64 now_ns() { return ns_of(std::chrono::steady_clock::now()); }
+
+  /// 已经取过的 steady_clock 时间点换算成 record 用的时间戳，省一次取时钟
+  static uint64 ns_of(std::chrono::steady_clock::time_point t)
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+  }
+
+  /**
+   * @brief 记录一个已经结束的 span，name 和 category 必须是字符串常量
+   * @param arg 大于等于 0 时作为 args.id 输出，比如 batch 的序号
+   */
+  void record(const char *name, const char *category, uint64 start_ns, uint64 end_ns, int64 arg = -1);
+
+  RC write_chrome_json(const std::string &path) const;
+
+  /// 缓冲区满了被丢掉的 span 数
+  uint64 dropped() const;
+
+  /// 已经分配的缓冲区数，包括空闲的
+  size_t buffer_count() const;
+
+private:
+  struct Event
+  {
+    const char *name;
+    const char *category;
+    uint64      start_ns;
+    uint64      dur_ns;
+    int64       arg;
+  };
+
+  /// 用过某个缓冲区的线程，events 里 [begin, 下一个线程的 begin) 是它记录的
+  struct Holder
+  {
+    int         tid;
+    std::string thread_name;
+    size_t      begin;
+  };
+
+  struct ThreadBuffer
+  {
+    std::vector<Holder>      holders;  // mutex_ 保护，最后一个是当前持有者
+    bool                     in_use = false;
+    std::unique_ptr<Event[]> events;
+    size_t                   capacity = 0;
+    std::atomic<size_t>      size{0};  // 写线程 release 发布，导出时 acquire 读取
+    std::atomic<uint64>      dropped{0};
+    uint64                   generation = 0;
+  };
+
+  /// 线程退出时把缓冲区还给 Tracer
+  struct LocalBuffer
+  {
+    ThreadBuffer *buffer = nullptr;
+    ~LocalBuffer();
+  };
+
+  Tracer() = default;
+
+  ThreadBuffer *local_buffer();
+  void          release(ThreadBuffer *buffer);
+
+private:
+  std::atomic<bool>   enabled_{false};
+  std::atomic<uint64> generation_{0};  // 每次 start() 加一，线程发现不一致时清空自己的缓冲区
+  std::atomic<uint64> epoch_ns_{0};    // 输出的 ts 从 start() 开始算
+
+  mutable std::mutex                         mutex_;
+  std::vector<std::unique_ptr<ThreadBuffer>> buffers_;
+  std::vector<ThreadBuffer *>                free_;  // 持有线程已经退出的缓冲区
+  size_t                                     capacity_ = 0;
+};
+
+/**
+ * @brief 作用域内的 span，追踪关闭时什么都不做
+ * @details 不能跨 co_await 使用：协程恢复后可能在另一个线程上，这时用 Tracer::record 分段记录
+ */
+class TraceSpan
+{
+public:
+  TraceSpan(const char *name, const char *category, int64 arg = -1)
+      : name_(name), category_(category), arg_(arg), start_ns_(Tracer::instance().enabled() ? Tracer::now_ns() : 0)
+  {}
+
+  ~TraceSpan()
+  {
+    if (start_ns_ != 0) {
+      Tracer::instance().record(name_, category_, start_ns_, Tracer::now_ns(), arg_);
+    }
+  }
+
+  TraceSpan(const TraceSpan &)            = delete;
+  TraceSpan &operator=(const TraceSpan &) = delete;
+
+private:
+  const char *name_;
+  const char *category_;
+  int64       arg_;
+  uint64      start_ns_;
+};
+
+}  // namespace common
@@ -0,0 +1,140 @@
+//
+// Created by Coonger on 2024/12/8.
+//
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "type_def.h"
+
+namespace common {
+
+/**
+ * @brief Chase-Lev 无锁工作窃取双端队列
+ * @details 参考 "Correct and Efficient Work-Stealing for Weak Memory Models"（Lê et al., PPoPP'13）。
+ * 只有 owner 线程可以 push / pop（操作 bottom 端，后进先出，缓存友好），
+ * 其他线程通过 steal 从 top 端取走最早放入的元素。
+ * 扩容只由 owner 完成，旧数组可能还被窃取者读着，所以保留到队列析构时再释放。
+ * @tparam T 元素类型，必须是可以放进 std::atomic 的平凡类型（通常是指针）
+ */
+template <typename T>
+class WorkStealingDeque
+{
+public:
+  explicit WorkStealingDeque(int64 capacity = 1024)
+  {
+    arrays_.emplace_back(std::make_unique<Array>(capacity));
+    array_.store(arrays_.back().get(), std::memory_order_relaxed);
+  }
+
+  WorkStealingDeque(const WorkStealingDeque &)            = delete;
+  WorkStealingDeque &operator=(const WorkStealingDeque &) = delete;
+
+  /**
+   * @brief owner 在 bottom 端放入一个元素，满了就扩容
+   */
+  void push(T item)
+  {
+    int64  b     = bottom_.load(std::memory_order_relaxed);
+    int64  t     = top_.load(std::memory_order_acquire);
+    Array *array = array_.load(std::memory_order_relaxed);
+    if (b - t > array->capacity - 1) {
+      array = grow(array, t, b);
+    }
+    array->put(b, item);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(b + 1, std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief owner 从 bottom 端取出一个元素
+   * @return 队列为空或最后一个元素被窃取者抢走时返回 false
+   */
+  bool pop(T &item)
+  {
+    int64  b     = bottom_.load(std::memory_order_relaxed) - 1;
+    Array *array = array_.load(std::memory_order_relaxed);
+    bottom_.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64 t = top_.load(std::memory_order_relaxed);
+
+    if (t > b) {
+      // 空队列
+      bottom_.store(b + 1, std::memory_order_relaxed);
+      return false;
+    }
+
+    item = array->get(b);
+    if (t == b) {
+      // 只剩最后一个元素，和窃取者竞争 top
+      bool won = top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+      bottom_.store(b + 1, std::memory_order_relaxed);
+      return won;
+    }
+    return true;
+  }
+
+  /**
+   * @brief 其他线程从 top 端窃取一个元素
+   * @return 队列为空或和别的线程竞争失败时返回 false
+   */
+  bool steal(T &item)
+  {
+    int64 t = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64 b = bottom_.load(std::memory_order_acquire);
+    if (t >= b) {
+      return false;
+    }
+
+    Array *array = array_.load(std::memory_order_acquire);
+    item         = array->get(t);
+    return top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief 队列里元素个数的近似值
+   */
+  int64 size() const
+  {
+    int64 b = bottom_.load(std::memory_order_relaxed);
+    int64 t = top_.load(std::memory_order_relaxed);
+    return b > t ? b - t : 0;
+  }
+
+private:
+  struct Array
+  {
+    explicit Array(int64 cap) : capacity(cap), mask(cap - 1), slots(new std::atomic<T>[cap]) {}
+
+    T    get(int64 i) const { return slots[i & mask].load(std::memory_order_relaxed); }
+    void put(int64 i, T item) { slots[i & mask].store(item, std::memory_order_relaxed); }
+
+    const int64                       capacity;  // 必须是 2 的幂
+    const int64                       mask;
+    std::unique_ptr<std::atomic<T>[]> slots;
+  };
+
+  Array *grow(Array *old, int64 t, int64 b)
+  {
+    arrays_.emplace_back(std::make_unique<Array>(old->capacity * 2));
+    Array *array = arrays_.back().get();
+    for (int64 i = t; i < b; ++i) {
+      array->put(i, old->get(i));
+    }
+    array_.store(array, std::memory_order_release);
+    return array;
+  }
+
+private:
+  alignas(64) std::atomic<int64> top_{0};
+  alignas(64) std::atomic<int64> bottom_{0};
+  alignas(64) std::atomic<Array *> array_{nullptr};
+
+  std::vector<std::unique_ptr<Array>> arrays_;  // 当前数组和扩容前的旧数组，只有 owner 修改
+};
+
+}  // namespace common
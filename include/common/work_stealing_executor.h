@@ -0,0 +1,112 @@
+//
+// Created by Coonger on 2024/12/8.
+//
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "executor.h"
+#include "work_stealing_deque.h"
+
+namespace common {
+
+/**
+ * @brief 工作窃取线程池
+ * @ingroup ThreadPool
+ * @details 固定个数的 worker，每个 worker 有一个 Chase-Lev 双端队列：
+ *   1. worker 线程里提交的任务放进自己的队列（无锁），外部线程提交的任务放进全局注入队列
+ *   2. worker 依次从 自己的队列 -> 注入队列 -> 随机选一个其他 worker 窃取 取任务
+ *   3. 都取不到时在条件变量上休眠，不占 CPU；提交任务时只有存在休眠的 worker 才加锁唤醒
+ * 休眠与唤醒用 queued_ 和 sleepers_ 两个计数配合：worker 先登记 sleepers_ 再检查 queued_，
+ * 提交方先增加 queued_ 再检查 sleepers_，两边都是 seq_cst，至少有一方能看到对方，不会丢失唤醒。
+ */
+class WorkStealingExecutor : public Executor
+{
+public:
+  WorkStealingExecutor() = default;
+  ~WorkStealingExecutor() override;
+
+  /**
+   * @brief 初始化线程池并启动 worker
+   *
+   * @param name 线程池名称
+   * @param worker_count worker 个数，<= 0 时取 CPU 核数
+   */
+  int init(const char *name, int worker_count);
+
+  using Executor::execute;
+  int execute(std::unique_ptr<Runnable> &&task) override;
+
+  int shutdown() override;
+  int await_termination() override;
+
+  int   pool_size() const override { return static_cast<int>(workers_.size()); }
+  int64 task_count() const override { return task_count_.load(); }
+
+  /**
+   * @brief 当前活跃线程的个数，就是正在处理任务的线程个数
+   */
+  int active_count() const { return active_count_.load(); }
+  /**
+   * @brief 通过窃取拿到的任务个数
+   */
+  int64 steal_count() const { return steal_count_.load(); }
+  /**
+   * @brief 排队中还没开始执行的任务个数
+   */
+  int64 queue_size() const { return queued_.load(); }
+
+private:
+  struct Worker
+  {
+    WorkStealingDeque<Runnable *> deque;
+    std::thread                   thread;
+  };
+
+  void thread_func(int index);
+
+  /// 按 自己的队列 -> 注入队列 -> 窃取 的顺序取一个任务
+  Runnable *find_task(int index, uint32 &seed);
+  Runnable *pop_injected();
+  Runnable *steal(int thief, uint32 &seed);
+
+  /// 没有任务时休眠，返回 false 表示线程池已关闭且任务已执行完
+  bool park();
+  void notify_one();
+
+private:
+  enum class State
+  {
+    NEW,
+    RUNNING,
+    TERMINATING,
+    TERMINATED
+  };
+
+  std::atomic<State> state_{State::NEW};
+  std::string        pool_name_;
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+
+  std::mutex            inject_mutex_;
+  std::deque<Runnable *> inject_queue_;  /// 外部线程提交的任务
+
+  std::mutex              park_mutex_;
+  std::condition_variable park_cv_;
+  std::atomic<int>        sleepers_{0};  /// 正在休眠（或准备休眠）的 worker 个数
+  std::atomic<int64>      queued_{0};    /// 已提交还没被取走的任务个数
+
+  std::atomic<int64> task_count_{0};
+  std::atomic<int64> steal_count_{0};
+  std::atomic<int>   active_count_{0};
+};
+
+}  // namespace common
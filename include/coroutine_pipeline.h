@@ -0,0 +1,96 @@
+//
+// Created by Coonger on 2024/12/13.
+//
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include "common/channel.h"
+#include "common/coroutine.h"
+#include "log_file.h"
+
+namespace loft {
+
+/**
+ * @brief 协程版的转换流水线（PipelineMode::COROUTINE）
+ * @details THREADED 模式下，收集线程、线程池、写线程之间靠条件变量加 100ms 超时交接。
+ * 这里把各阶段写成跑在 LogFileManager 线程池上的协程，阶段之间用有界 Channel 连接：
+ * @code
+ *   collect ──batches_──▶ transform × N ──results_──▶ write
+ * @endcode
+ *   - collect：从 ring_buffer_ 一次取一个 batch 并编号；没有任务时挂起在 ingest_ 上，生产者入队后唤醒它
+ *   - transform：解析 flatbuffer、转换成 event 并序列化，N 个协程并发处理不同的 batch
+ *   - write：按编号重新排序后串行写文件（或交给 sequencer_ 定序）
+ * 交接只是一次协程恢复，通道满时上游挂起，背压不占用线程。
+ * 增加校验、压缩之类的阶段只需要再写一个协程、插入一个 Channel，不需要新线程。
+ */
+class CoroutinePipeline
+{
+public:
+  /**
+   * @param executor          运行各阶段的执行器，生命周期要覆盖 pipeline，期间不能被替换
+   * @param transform_stages  并发的 transform 协程个数
+   */
+  CoroutinePipeline(LogFileManager *manager, Executor *executor, uint32 transform_stages);
+  ~CoroutinePipeline();
+
+  DISALLOW_COPY_AND_MOVE(CoroutinePipeline);
+
+  /**
+   * @brief 启动各阶段的协程
+   */
+  void start();
+
+  /**
+   * @brief 生产者入队后调用，唤醒挂起的 collect 阶段
+   */
+  void wake() { ingest_.set(); }
+
+  /**
+   * @brief 等待已经被 collect 取走的 batch 全部写完
+   */
+  void drain();
+
+  /**
+   * @brief 处理完已入队的任务后让所有阶段退出，返回时不再有协程访问 manager
+   */
+  void stop();
+
+private:
+  struct Batch
+  {
+    size_t            sequence = 0;
+    std::vector<Task> tasks;
+  };
+
+  Fiber collect();
+  Fiber transform();
+  Fiber write();
+
+  /// 一个阶段的协程退出
+  void exit_stage();
+
+private:
+  LogFileManager *manager_;
+  Executor       *executor_;
+  uint32          transform_stages_;
+
+  AsyncEvent                                         ingest_;
+  Channel<Batch>                                     batches_;
+  Channel<std::unique_ptr<LogFileManager::BatchResult>> results_;
+
+  std::atomic<bool>   stopping_{false};
+  std::atomic<uint32> transforms_running_{0};
+
+  std::mutex              mutex_;
+  std::condition_variable cv_;
+  size_t                  collected_batches_ = 0;  // collect 取走的 batch 数
+  size_t                  written_batches_   = 0;  // write 写完的 batch 数
+  int                     live_stages_       = 0;  // 还没退出的协程个数
+};
+
+}  // namespace loft
@@ -95,12 +95,12 @@ public:
     } else {
       char *dst = (char *)malloc(base64_needed_decoded_length(strlen(str)));
       int64_t dst_len = base64_decode(str, strlen(str), (void *)dst, nullptr, 0);
-      row->writeData(reinterpret_cast<uchar *>(dst), field->type(), field->pack_length(), dst_len);
+      // 时间类型按列的小数位数打包，DATETIME(6) 的微秒不能按精度 0 写
+      int precision = is_temporal_type(field->type()) ? static_cast<int>(field->decimals()) : 0;
+      row->writeData(reinterpret_cast<uchar *>(dst), field->type(), field->pack_length(), dst_len, precision);
       // 释放内存
       free(dst);
     }
-    // TODO 时间类型 datatime timestamp
-
   }
 };
 
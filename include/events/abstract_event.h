@@ -10,6 +10,7 @@
 #include "common/mysql_constant_def.h"
 
 #include "basic_ostream.h"
+#include "events/event_iovec.h"
 
 enum Log_event_type
 {
@@ -241,6 +242,15 @@ public:
     return pos;
   }
 
+  /**
+   * @brief scatter-gather 序列化：小块写进 iov 的 scratch 区，大块直接引用 event 持有的内存
+   * @details 默认实现把整个 event 序列化进 scratch，只适合 Gtid、Xid 这类定长的小 event；
+   * Rows_event、Query_event、Table_map_event 会重写，引用 row buffer、query 文本等。
+   * 引用形态下 iov 依赖 event 本身，event 必须比 iov 活得久
+   * @return false 表示 scratch 放不下，调用方应退回 write_to_buffer()
+   */
+  virtual bool write_to_iovec(EventIovec &iov);
+
 protected:
   static const uint32_t POSITION_PLACEHOLDER = 0;
   virtual size_t        write_common_header_to_buffer(uchar *buffer);
@@ -0,0 +1,129 @@
+//
+// Created by Coonger on 2024/12/6.
+//
+#pragma once
+
+#include <cassert>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include <sys/uio.h>  // struct iovec
+
+#include "common/type_def.h"
+
+/**
+ * @brief 一个 event 序列化后的 scatter-gather 表示
+ * @details 两种形态：
+ *   1. 引用形态：common-header、post-header、长度编码这类小块写进内联的 scratch_ 区，
+ *      row buffer、query 文本这类大块直接引用 event（或 task 输入）自己持有的内存，不做拷贝
+ *   2. 连续形态：持有一块完整的 buffer，等价于 write_to_buffer() 的结果
+ * 引用形态下被引用的内存必须比 EventIovec 活得久，由 BatchResult 负责保活。
+ * scratch_ 在第一次 reserve() 时才分配，连续形态的 EventIovec 只比 vector<uchar> 多几个字段。
+ * scratch 段记录的是偏移而不是指针，所以 EventIovec 可以放在 vector 里随意移动。
+ * common-header 总是第一段，并且在 scratch_ 或 buffer 里连续存放，写线程通过 header() 回填 log_pos
+ */
+class EventIovec
+{
+public:
+  static constexpr size_t SCRATCH_SIZE = 256;
+
+  EventIovec() = default;
+  explicit EventIovec(std::vector<uchar> &&buffer) : buffer_(std::move(buffer)), total_(buffer_.size()) {}
+
+  EventIovec(EventIovec &&)            = default;
+  EventIovec &operator=(EventIovec &&) = default;
+
+  /**
+   * @brief 在 scratch 区里分配 len 字节，紧跟在上一段 scratch 之后时合并成一段
+   * @return scratch 不够时返回 nullptr，调用方应退回连续形态
+   */
+  uchar *reserve(size_t len)
+  {
+    assert(buffer_.empty());
+    if (scratch_used_ + len > SCRATCH_SIZE) {
+      return nullptr;
+    }
+    if (scratch_ == nullptr) {
+      scratch_ = std::make_unique_for_overwrite<uchar[]>(SCRATCH_SIZE);
+    }
+    uchar *ptr = scratch_.get() + scratch_used_;
+    if (!segments_.empty() && segments_.back().data == nullptr &&
+        segments_.back().offset + segments_.back().len == scratch_used_) {
+      segments_.back().len += len;
+    } else {
+      segments_.push_back({nullptr, scratch_used_, len});
+    }
+    scratch_used_ += len;
+    total_ += len;
+    return ptr;
+  }
+
+  /**
+   * @brief 引用一段外部内存
+   */
+  void append(const void *data, size_t len)
+  {
+    assert(buffer_.empty());
+    if (len == 0) {
+      return;
+    }
+    segments_.push_back({static_cast<const uchar *>(data), 0, len});
+    total_ += len;
+  }
+
+  /// event 的总长度，等于 common-header 里的 event_len
+  size_t size() const { return total_; }
+
+  /// common-header 的起始地址
+  uchar *header() { return buffer_.empty() ? scratch_.get() : buffer_.data(); }
+
+  /// 用于内存预算：event 的字节数（引用形态下包括被引用、由 BatchResult 保活的内存）加上自身的额外开销
+  size_t memory_usage() const
+  {
+    return sizeof(EventIovec) + total_ + (scratch_ != nullptr ? SCRATCH_SIZE : 0) +
+           segments_.capacity() * sizeof(Segment);
+  }
+
+  /// 追加到 iov 里，用于 writev / pwritev / io_uring
+  void append_to(std::vector<struct iovec> &iov) const
+  {
+    if (!buffer_.empty()) {
+      iov.push_back({const_cast<uchar *>(buffer_.data()), buffer_.size()});
+      return;
+    }
+    for (const auto &seg : segments_) {
+      const uchar *ptr = seg.data != nullptr ? seg.data : scratch_.get() + seg.offset;
+      iov.push_back({const_cast<uchar *>(ptr), seg.len});
+    }
+  }
+
+  /// 拼成一块连续内存
+  std::vector<uchar> to_vector() const
+  {
+    if (!buffer_.empty()) {
+      return buffer_;
+    }
+    std::vector<uchar> out;
+    out.reserve(total_);
+    for (const auto &seg : segments_) {
+      const uchar *ptr = seg.data != nullptr ? seg.data : scratch_.get() + seg.offset;
+      out.insert(out.end(), ptr, ptr + seg.len);
+    }
+    return out;
+  }
+
+private:
+  struct Segment
+  {
+    const uchar *data;    // nullptr 表示在 scratch_ 里
+    size_t       offset;  // scratch_ 里的偏移
+    size_t       len;
+  };
+
+  std::unique_ptr<uchar[]> scratch_;  // 固定 SCRATCH_SIZE 字节，分配后不会再移动，reserve() 返回的指针一直有效
+  size_t                   scratch_used_ = 0;
+  std::vector<Segment>     segments_;
+  std::vector<uchar>       buffer_;  // 连续形态
+  size_t                   total_ = 0;
+};
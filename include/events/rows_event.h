@@ -29,6 +29,9 @@ public:
   size_t write_data_header_to_buffer(uchar *buffer) override;
   size_t write_data_body_to_buffer(uchar *buffer) override;
 
+  /// 库名、表名、列类型、字段元数据、空值位图直接引用，长度编码写进 scratch
+  bool write_to_iovec(EventIovec &iov) override;
+
   int save_field_metadata();
 
   /** Constants representing offsets */
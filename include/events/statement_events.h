@@ -27,8 +27,13 @@ public:
   size_t write_data_header_to_buffer(uchar *buffer) override;
   size_t write_data_body_to_buffer(uchar *buffer) override;
 
+  /// 状态变量写进 scratch，库名和 query 文本直接引用
+  bool write_to_iovec(EventIovec &iov) override;
+
 private:
   void calculate_status_vars_len();
+  /// 写入状态变量，返回写入的字节数
+  size_t write_status_vars_to_buffer(uchar *buffer);
 
 public:
   /** query event post-header */
@@ -120,7 +125,7 @@ public:
   bool sql_mode_inited;
   bool charset_inited = true;  // 三个编码集有关
 
-  uint32_t flags2;
+  uint32_t flags2 = 0;
   /* In connections sql_mode is 32 bits now but will be 64 bits soon */
   uint64_t sql_mode;
   uint16_t auto_increment_increment, auto_increment_offset;
@@ -237,9 +237,24 @@ public:
   size_t write_data_header_to_buffer(uchar *buffer) override;
   size_t write_data_body_to_buffer(uchar *buffer) override;
 
+  /// columns image、null bitmap 和 row 数据都直接引用 event 内部的 buffer
+  bool write_to_iovec(EventIovec &iov) override;
+
 private:
   size_t calculate_event_size();
 
+  /**
+   * @brief 计算 columns image 和 null bitmap，只执行一次：里面有 std::reverse，重复执行会把位图翻回去
+   */
+  void build_row_images();
+
+  /**
+   * @brief body 里 width 之后的各段内存，按写入顺序排列
+   * @return 段数，最多 ROWS_BODY_MAX_PARTS
+   */
+  static constexpr size_t ROWS_BODY_MAX_PARTS = 6;
+  size_t body_parts(const uchar *parts[ROWS_BODY_MAX_PARTS], size_t lens[ROWS_BODY_MAX_PARTS]);
+
   /**
    * @brief 处理固定长度类型
    */
@@ -300,6 +315,8 @@ private:
     // 2. 将字符串转换为时间对象
     MYSQL_TIME ltime;
     parse_func(static_cast<const char *>(data), str_length, &ltime);
+    // 3. 超出列精度的微秒截断掉
+    my_time_trunc(&ltime, precision);
     // 4. 将时间对象转换为二进制表示
     convert_func(&ltime, buf.get() + data_size, precision);
     data_size += time_size;
@@ -329,4 +346,5 @@ private:
   std::vector<uint8> null_before;
 
   bool m_is_before;
+  bool m_row_images_built = false;
 };
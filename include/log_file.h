@@ -11,19 +11,121 @@
 #include <map>           // std::map
 #include <future>
 #include <queue>
+#include <shared_mutex>
+#include <span>
+#include <string_view>
+#include <unordered_map>
 
 #include "transform_manager.h"
 #include "binlog.h"
+#include "replication_lag.h"
 #include "events/abstract_event.h"
 #include "common/init_setting.h"
+#include "common/memory_budget.h"
+#include "common/adaptive_batcher.h"
+#include "common/alloc_accounting.h"
+#include "common/concurrency_controller.h"
+#include "common/metrics.h"
+#include "common/trace.h"
 #include "common/rc.h"
 #include "common/task_queue.h"
 
 #include "common/thread_pool_executor.h"
+#include "common/work_stealing_executor.h"
+#include "common/task_group.h"
 using namespace common;
 
 namespace loft {
 
+class BinlogSequencer;
+class PartitionedBatchProcessor;
+class WritesetTracker;
+class CoroutinePipeline;
+
+/**
+ * @brief binlog 的写入模式
+ */
+enum class BinlogWriteMode
+{
+  SERIAL,    /// 单写线程：逐条检查剩余空间、填充 log_pos、写文件流
+  PARALLEL,  /// 写线程只做定序（前缀和分配 file + offset），worker 自己填充 log_pos 并 pwrite
+};
+
+/**
+ * @brief 执行 BatchProcessor 和并发写任务的线程池实现
+ */
+enum class ExecutorType
+{
+  THREAD_POOL,    /// ThreadPoolExecutor：单个共享队列，线程数在 min_workers ~ max_workers（默认 CPU 核数）之间按吞吐爬山伸缩
+  WORK_STEALING,  /// WorkStealingExecutor：每个 worker 一个 Chase-Lev 队列，空闲时互相窃取
+};
+
+/**
+ * @brief 收集线程取出一个 batch 后如何转换
+ */
+enum class SchedulerType
+{
+  FIFO,         /// 一个 BatchProcessor 按到达顺序转换整个 batch
+  PARTITIONED,  /// PartitionedBatchProcessor：按表分区并发转换，DDL 作为屏障，最后按 scn 归并
+};
+
+/**
+ * @brief 收集、转换、写入各阶段之间如何交接
+ */
+enum class PipelineMode
+{
+  THREADED,   /// 收集线程 + 线程池 + 写线程，用条件变量交接
+  COROUTINE,  /// CoroutinePipeline：各阶段是线程池上的协程，用有界 Channel 交接
+};
+
+/**
+ * @brief GTID event 里 last_committed / sequence_number 的来源
+ */
+enum class DependencyTracking
+{
+  COMMIT_ORDER,  /// 沿用源端记录里的 last_commit / tx_seq
+  WRITESET,      /// WritesetTracker 按写过的行重新计算，从库可以并行回放不冲突的事务
+};
+
+/**
+ * @brief LogFileManager 的启动参数，在构造时确定，运行中不可修改
+ */
+struct LogFileOptions
+{
+  /**
+   * zero-copy 序列化：event 用 write_to_iovec() 描述成 scatter-gather 形式，row buffer、query 文本不再拷贝，
+   * 代价是 event 和 task 的输入要保留到写完为止
+   */
+  bool zero_copy = false;
+  BinlogWriteMode write_mode = BinlogWriteMode::SERIAL;
+  BinlogBackend    backend    = BinlogBackend::FSTREAM;  /// binlog 文件输出流的实现，并发写模式只区分 MMAP 和 pwrite
+  BinlogDurability durability = BinlogDurability::NONE;  /// 每个 batch 写完后的落盘策略
+  size_t memory_budget        = DEFAULT_MEMORY_BUDGET;         /// 流水线共享的内存预算（字节），0 表示不限制
+  uint32 admission_timeout_ms = DEFAULT_ADMISSION_TIMEOUT_MS;  /// transformAsync 等待预算的最长时间
+  ExecutorType executor       = ExecutorType::THREAD_POOL;
+  int          worker_threads = 0;  /// WORK_STEALING 的 worker 个数，0 表示取 CPU 核数
+  SchedulerType scheduler     = SchedulerType::FIFO;
+  uint32        partitions    = 0;  /// PARTITIONED 的分区个数，0 表示取 CPU 核数
+  DependencyTracking dependency_tracking   = DependencyTracking::COMMIT_ORDER;
+  size_t             writeset_history_size = DEFAULT_WRITESET_HISTORY_SIZE;
+  PipelineMode pipeline         = PipelineMode::THREADED;
+  size_t batch_min_size       = DEFAULT_BATCH_MIN_SIZE;        /// 收集线程 batch 大小的下限和上限，见 AdaptiveBatcher
+  size_t batch_max_size       = DEFAULT_BATCH_MAX_SIZE;
+  uint32 batch_max_latency_us = DEFAULT_BATCH_MAX_LATENCY_US;  /// 记录被收集线程看到后，最多等这么久就投递
+  uint32       transform_stages = 0;  /// COROUTINE 模式下并发的 transform 协程个数，0 表示取 CPU 核数
+  int    min_workers           = 1;  /// THREAD_POOL 转换线程个数的下限和上限，max_workers 为 0 表示取 CPU 核数
+  int    max_workers           = 0;
+  uint32 autoscale_interval_ms = DEFAULT_AUTOSCALE_INTERVAL_MS;  /// 并发度的采样区间，见 ConcurrencyController；0 表示固定用 max_workers 个线程
+  std::string collector_cpus;  /// 收集线程绑定的 CPU，格式同 cpulist，如 "0-3,8"；空表示不绑定。ring buffer 迁到这些 CPU 所在的节点
+  std::string worker_cpus;     /// 转换线程绑定的 CPU，跨 NUMA 节点时按节点轮流分给各线程
+  std::string writer_cpus;     /// 写线程绑定的 CPU
+  bool        writer_near_output = false;  /// writer_cpus 为空时，把写线程和它分配的输出缓冲区放到 binlog 目录所在设备的 NUMA 节点上
+  std::string metrics_textfile;  /// 非空时按 metrics_interval_ms 把 get_metrics() 写成这个 Prometheus textfile（*.prom）
+  uint32      metrics_interval_ms = DEFAULT_METRICS_INTERVAL_MS;
+  std::string trace_file;  /// 非空时记录流水线各阶段的 span，shutdown 时写成 Chrome trace JSON（chrome://tracing、Perfetto 可以打开）
+  uint32      trace_events_per_thread = DEFAULT_TRACE_EVENTS_PER_THREAD;  /// 每个线程最多记录的 span 数，超出的丢弃
+};
+
 /**
  * @brief 负责处理一个日志文件，包括读取和写入
  */
@@ -50,7 +152,10 @@ private:
 class BinLogFileWriter
 {
 public:
-  BinLogFileWriter()  = default;
+  explicit BinLogFileWriter(
+      BinlogBackend backend = BinlogBackend::FSTREAM, BinlogDurability durability = BinlogDurability::NONE)
+      : backend_(backend), durability_(durability)
+  {}
   ~BinLogFileWriter() {
     close();
   }
@@ -79,8 +184,9 @@ public:
   auto get_binlog() -> MYSQL_BIN_LOG * { return bin_log_.get(); }
 
 private:
-  std::string filename_;  /// 日志文件名
-                          //    int fd_ = -1;      /// 日志文件描述符
+  std::string   filename_;  /// 日志文件名
+  BinlogBackend    backend_;     /// 文件输出流的实现方式
+  BinlogDurability durability_;  /// 落盘策略
 
   std::unique_ptr<MYSQL_BIN_LOG> bin_log_;  /// 封装的 MYSQL_BIN_LOG 类
 };
@@ -92,8 +198,12 @@ private:
  */
 class LogFileManager
 {
+  friend class BinlogSequencer;
+  friend class PartitionedBatchProcessor;
+  friend class CoroutinePipeline;
+
 public:
-  LogFileManager();
+  explicit LogFileManager(const LogFileOptions &options = LogFileOptions());
   ~LogFileManager();
 
   // TODO 此处 实现 3 个 必要接口
@@ -117,8 +227,33 @@ public:
    * @return
    */
   RC transform(std::vector<unsigned char> &&buf, bool is_ddl);
+  /**
+   * @brief 异步转换：为 buf 申请内存预算后放入任务队列
+   * @details 预算不足时阻塞等待，最多 admission_timeout_ms；仍然不足则返回 RC::SPEED_LIMIT，
+   * 此时 buf 没有被移走，调用方可以稍后用同一个 buf 重试
+   */
   std::future<RC> transformAsync(std::vector<unsigned char> &&buf, bool is_ddl);
 
+  /**
+   * @brief 批量提交：整批记录共用一个完成句柄，不再为每条记录分配 promise / future
+   * @details records 里的 Task 会被移走。句柄在整批记录都写入 binlog 并 fdatasync 之后完成
+   * （FSTREAM 后端只能保证交给了内核）。内存预算按整批一次申请，申请不到时句柄立即以 RC::SPEED_LIMIT 完成，
+   * records 保持不变，调用方可以原样重试
+   * @return 完成句柄
+   */
+  BatchHandle transformBatch(std::span<Task> records);
+
+  /**
+   * @brief 回调形式的批量提交，callback 在整批完成时于写线程上调用一次
+   * @return 提交本身的结果：RC::SPEED_LIMIT 时 callback 也会以 SPEED_LIMIT 被调用
+   */
+  RC transformBatch(std::span<Task> records, BatchCompletion::Callback callback);
+
+  /**
+   * @brief 立即投递已入队的记录，不再等攒够一个 batch 或者等到 deadline
+   */
+  void flush();
+
       /// 接口三：
   /**
    * @brief 从文件名称的后缀中获取这是第几个 binlog 文件，文件索引信息保存在log_files_里
@@ -149,6 +284,16 @@ public:
    */
   RC next_file(BinLogFileWriter &file_writer);
 
+  /**
+   * @brief 计算下一个日志文件的编号和文件名，但还不登记
+   */
+  RC next_file_name(uint32 &fileno, std::string &filename, std::filesystem::path &file_path);
+
+  /**
+   * @brief 登记一个新的日志文件：加入 log_files_，写索引文件，更新 last_file_no_
+   */
+  RC register_file(uint32 fileno, const std::string &filename, const std::filesystem::path &file_path);
+
   /**
    * @brief 写binlog索引文件
    * @param filename
@@ -170,6 +315,10 @@ public:
   auto get_file_writer() -> BinLogFileWriter * { return file_writer_.get(); }
   auto get_transform_manager() -> LogFormatTransformManager * { return transform_manager_.get(); }
   auto get_last_file_no() -> uint32 { return last_file_no_.load(); }
+  auto get_memory_budget() -> MemoryBudget & { return memory_budget_; }
+  auto get_metrics() -> MetricsRegistry & { return metrics_; }
+
+  struct BatchResult;
 
   class BatchProcessor : public Runnable {
   public:
@@ -177,48 +326,177 @@ public:
         : manager_(manager), tasks_(std::move(tasks)), batch_sequence_(sequence) {}
 
     void run() override {
-      auto result = std::make_unique<BatchResult>(batch_sequence_);
+      // 将结果加入写入队列
+      manager_->result_queue_.add_result(process(manager_, std::move(tasks_), batch_sequence_));
+    }
+
+    /**
+     * @brief 按到达顺序转换一个 batch，记好账后返回结果，由调用者交给写入阶段
+     */
+    static std::unique_ptr<BatchResult> process(LogFileManager *manager, std::vector<Task> &&tasks, size_t sequence) {
+      TraceSpan span("transform", "transform", static_cast<int64>(sequence));
+      AllocStageScope alloc_stage(AllocStage::RESULT);
+      auto start_time = std::chrono::steady_clock::now();
+      auto result = std::make_unique<BatchResult>(sequence);
+
+      size_t input_bytes = 0;
+      for (const auto& task : tasks) {
+        input_bytes += task_bytes(task);
+        result->add_completion(task.completion_);
+        // 转换但不直接写入文件
+        transform(manager, task, *result);
+      }
+      // ckp 先保存到 result 里，直到 切换文件时，才知道写到哪条 event，再写入对应的 ckp
 
+      auto elapsed = std::chrono::steady_clock::now() - start_time;
+      manager->batcher_.record_batch(tasks.size(), elapsed);
+      manager->transform_busy_ns_ += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+      manager->metric_batch_time_->record_duration(elapsed);
+      manager->count_table_rows(tasks);
+      account(manager, *result, std::move(tasks), input_bytes);
+      return result;
+    }
+
+    /**
+     * @brief 转换一条记录，event 和对应的 ckp 追加到 result 末尾
+     */
+    static void transform(LogFileManager *manager, const Task &task, BatchResult &result) {
+      LogicalClock clock;
       std::string checkpoint;
-      for (const auto& task : tasks_) {
-        if (task.is_ddl_) {
-          const DDL* ddl = GetDDL(task.data_.data());
-          checkpoint = ddl->check_point()->c_str();
-
-          // 转换但不直接写入文件
-          auto events = manager_->get_transform_manager()->transformDDL(ddl);
-          for (auto &event : events) {
-            result->transformed_data.push_back(transform_to_buffer(event.get()));
-          }
-          for (int i = 0; i < 3; i++) {
-            result->ckps.push_back(checkpoint);
-          }
+      if (task.is_ddl_) {
+        const DDL* ddl = GetDDL(task.data_.data());
+        checkpoint = ddl->check_point()->c_str();
 
-        } else {
-          const DML* dml = GetDML(task.data_.data());
-          checkpoint = dml->check_point()->c_str();
+        result.source.add(commit_time_us(ddl->tx_time()), ddl->scn());
 
-          // 转换但不直接写入文件
-          auto events = manager_->get_transform_manager()->transformDML(dml);
-          for (auto &event : events) {
-            result->transformed_data.push_back(transform_to_buffer(event.get()));
-          }
-          for (int i = 0; i < 5; i++) {
-            result->ckps.push_back(checkpoint);
-          }
+        std::vector<std::unique_ptr<AbstractEvent>> events;
+        {
+          AllocStageScope alloc_stage(AllocStage::SCHEMA);
+          events = manager->get_transform_manager()->transformDDL(ddl, clock_of(task, clock));
+        }
+        for (auto &event : events) {
+          serialize(manager, result, std::move(event));
+        }
+        for (int i = 0; i < 3; i++) {
+          result.ckps.push_back(checkpoint);
+        }
+
+      } else {
+        const DML* dml = GetDML(task.data_.data());
+        checkpoint = dml->check_point()->c_str();
+
+        result.source.add(commit_time_us(dml->tx_time()), dml->scn());
+
+        std::vector<std::unique_ptr<AbstractEvent>> events;
+        {
+          AllocStageScope alloc_stage(AllocStage::EVENT);
+          events = manager->get_transform_manager()->transformDML(dml, clock_of(task, clock));
+        }
+        for (auto &event : events) {
+          serialize(manager, result, std::move(event));
+        }
+        for (int i = 0; i < 5; i++) {
+          result.ckps.push_back(checkpoint);
         }
       }
-      // ckp 先保存到 result 里，直到 切换文件时，才知道写到哪条 event，再写入对应的 ckp
+    }
 
-      // 将结果加入写入队列
-      manager_->result_queue_.add_result(std::move(result));
+    /**
+     * @brief 一个 batch 转换完：为输出记账、处理输入的生命周期
+     */
+    static void account(LogFileManager *manager, BatchResult &result, std::vector<Task> &&tasks, size_t input_bytes) {
+      size_t task_count = tasks.size();
+      // 转换线程不能等预算：写线程可能正等着这个 batch 的序号，等下去会和生产者互相卡住
+      size_t output_bytes = result_bytes(result);
+      manager->memory_budget_.force_acquire(output_bytes);
+      if (manager->options_.zero_copy) {
+        // query 文本、库名引用的是 task 里的 flatbuffer 数据，要跟着 result 一起保留到写完
+        result.inputs = std::move(tasks);
+        result.budget_bytes = input_bytes + output_bytes;
+      } else {
+        // 输入在 processor 析构时释放，credit 现在就可以还给生产者
+        manager->memory_budget_.release(input_bytes);
+        result.budget_bytes = output_bytes;
+      }
 
-      manager_->processed_tasks_ += tasks_.size();
+      manager->processed_tasks_ += task_count;
+      manager->transformed_batches_++;
+    }
+
+    /**
+     * @brief account 之后交给写线程
+     */
+    static void commit(LogFileManager *manager, std::unique_ptr<BatchResult> result, std::vector<Task> &&tasks,
+        size_t input_bytes) {
+      account(manager, *result, std::move(tasks), input_bytes);
+      // 将结果加入写入队列
+      manager->result_queue_.add_result(std::move(result));
     }
 
   private:
+    /// task 上有 WritesetTracker 算好的逻辑时钟时返回它，否则返回 nullptr
+    static const LogicalClock *clock_of(const Task &task, LogicalClock &clock) {
+      if (task.sequence_number_ == 0) {
+        return nullptr;
+      }
+      clock.last_committed  = task.last_committed_;
+      clock.sequence_number = task.sequence_number_;
+      return &clock;
+    }
+
+    /**
+     * @brief 源端提交时间（epoch 微秒），复制延迟从这里算起
+     * @details 用 tx_time：它是源端事务的提交时间，转换后写成 Gtid 的 original_commit_timestamp；
+     * msg_time 是写成 immediate_commit_timestamp 的消息时间，不是 SLA 关心的起点。
+     * 没有或者不是 "YYYY-MM-DD HH:MM:SS[.ffffff]" 格式时返回 0，不参与统计；
+     * 先在这里校验，stringToTimestamp 遇到格式不对会抛异常，转换线程和协程里都没有人接
+     */
+    static uint64 commit_time_us(const flatbuffers::String *tx_time) {
+      if (tx_time == nullptr || !is_commit_time(tx_time->c_str(), tx_time->size())) {
+        return 0;
+      }
+      return LogFormatTransformManager::stringToTimestamp(tx_time->str());
+    }
+
+    static bool is_commit_time(const char *text, size_t size) {
+      static constexpr char PATTERN[] = "dddd-dd-dd dd:dd:dd";
+      if (size < sizeof(PATTERN) - 1) {
+        return false;
+      }
+      for (size_t i = 0; i < sizeof(PATTERN) - 1; i++) {
+        bool digit = text[i] >= '0' && text[i] <= '9';
+        if (PATTERN[i] == 'd' ? !digit : text[i] != PATTERN[i]) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    static void serialize(LogFileManager *manager, BatchResult &result, std::unique_ptr<AbstractEvent> event) {
+      if (manager->options_.zero_copy) {
+        EventIovec iov;
+        if (event->write_to_iovec(iov)) {
+          result.transformed_data.push_back(std::move(iov));
+          result.events.push_back(std::move(event));
+          return;
+        }
+      }
+      result.transformed_data.emplace_back(transform_to_buffer(event.get()));
+    }
+
+    static size_t result_bytes(const BatchResult &result) {
+      size_t bytes = 0;
+      for (const auto &data : result.transformed_data) {
+        bytes += data.memory_usage();
+      }
+      for (const auto &ckp : result.ckps) {
+        bytes += sizeof(std::string) + ckp.capacity();
+      }
+      return bytes;
+    }
+
     // 将转换后的数据存入内存
-    std::vector<uchar> transform_to_buffer(AbstractEvent* event) {
+    static std::vector<uchar> transform_to_buffer(AbstractEvent* event) {
       std::vector<uchar> buffer(LOG_EVENT_HEADER_LEN + event->get_data_size(), 0);
       // 将event写入buffer
       event->write_to_buffer(buffer.data());
@@ -234,9 +512,38 @@ public:
   // 用于存储转换后的数据
   struct BatchResult {
     size_t sequence;
-    std::vector<std::vector<uchar>> transformed_data;  // 每个event转换后的数据
+    std::vector<EventIovec> transformed_data;  // 每个event转换后的数据
     std::vector<std::string> ckps;  // 每个event对应的ckp;
+    std::vector<std::unique_ptr<AbstractEvent>> events;  // zero-copy 模式下被 transformed_data 引用的 event
+    std::vector<Task> inputs;                            // zero-copy 模式下被 query event 引用的输入
     size_t event_write_count_{0};
+    size_t budget_bytes{0};  // 这个 batch 在 memory_budget_ 上持有的 credit，写完后归还
+    SourceProgress source;   // 源端记录的提交时间和 scn 范围，写完后上报给 replication_lag_
+    std::vector<std::pair<BatchHandle, size_t>> completions;  // 落盘后要通知的批量提交句柄，以及各自的记录数
+
+    /**
+     * @brief 登记一条记录所属的批量提交句柄，同一批提交的记录在队列里通常是连续的，合并成一项
+     */
+    void add_completion(const BatchHandle &completion) {
+      if (completion == nullptr) {
+        return;
+      }
+      if (!completions.empty() && completions.back().first == completion) {
+        completions.back().second++;
+      } else {
+        completions.emplace_back(completion, 1);
+      }
+    }
+
+    /**
+     * @brief 通知批量提交的句柄：这个 batch 里属于它们的记录已经完成
+     */
+    void finish(RC rc) {
+      for (auto &[completion, count] : completions) {
+        completion->finish(count, rc);
+      }
+      completions.clear();
+    }
 
     BatchResult(size_t seq) : sequence(seq) {}
   };
@@ -251,7 +558,12 @@ public:
 
 
     void add_result(std::unique_ptr<BatchResult> result) {
-      std::lock_guard<std::mutex> lock(mutex_);
+      std::unique_lock<std::mutex> lock(mutex_, std::try_to_lock);
+      if (!lock.owns_lock()) {
+        // 只有被争用时才记录，worker 在这把锁上排队时 trace 里能看到
+        TraceSpan span("result_queue_lock", "queue", static_cast<int64>(result->sequence));
+        lock.lock();
+      }
       pending_results_[result->sequence] = std::move(result);
       // 只有当下一个期望序号的结果到达时才通知
       if (pending_results_.count(next_write_sequence_) > 0) {
@@ -261,10 +573,17 @@ public:
 
     // 专门的文件写入线程
     void process_writes(BinLogFileWriter* writer, LogFileManager* manager) {
+      AllocStageScope alloc_stage(AllocStage::WRITER);
       while (!(*stop_flag_)) {
+        manager->place_writer_thread();
         std::unique_ptr<BatchResult> result;
         {
           std::unique_lock<std::mutex> lock(mutex_);
+          // 已经有转换好的 batch，但下一个序号还没到：写线程在等一个慢的 batch，流水线出现气泡
+          uint64 reorder_start = !pending_results_.empty() && pending_results_.count(next_write_sequence_) == 0 &&
+                                         Tracer::instance().enabled()
+                                     ? Tracer::now_ns()
+                                     : 0;
           if (cv_.wait_for(lock,
                   std::chrono::milliseconds(100),
                   [this] {
@@ -275,6 +594,10 @@ public:
               break;
             }
             if (pending_results_.count(next_write_sequence_) > 0) {
+              if (reorder_start != 0) {
+                Tracer::instance().record("reorder_wait", "writer", reorder_start, Tracer::now_ns(),
+                    static_cast<int64>(next_write_sequence_));
+              }
               result = std::move(pending_results_[next_write_sequence_]);
               pending_results_.erase(next_write_sequence_);
               next_write_sequence_++;
@@ -282,29 +605,73 @@ public:
           }
         }
 
-        if (result) { // 检查是否要切换文件
-          manager->written_tasks_ += result->transformed_data.size();
-
-          // 按顺序写入文件
-          std::lock_guard<std::mutex> write_lock(manager->writer_mutex_);
-          for (auto& data : result->transformed_data) {
-            // 切换文件
-            const uint32* event_len_ptr = reinterpret_cast<const uint32_t*>(data.data() + EVENT_LEN_OFFSET);
-            if (!writer->get_binlog()->remain_bytes_safe(*event_len_ptr)) {
-              manager->update_checkpoint(manager->get_last_file_no(), result->ckps[result->event_write_count_]);
-              manager->next_file(*writer);
-            }
+        if (result) {
+          auto start_time = std::chrono::steady_clock::now();
+          write(writer, manager, std::move(result));
+          manager->writer_busy_ns_ += std::chrono::duration_cast<std::chrono::nanoseconds>(
+              std::chrono::steady_clock::now() - start_time).count();
+        }
+      }
+    }
 
-            // 写入实际数据, 填充 common_header 中的 log_pos 字段
-            uint64 current_pos = writer->get_binlog()->get_bytes_written();
-            uint64 next_pos = current_pos + data.size();
-            int4store(data.data() + LOG_POS_OFFSET, next_pos);
+    /**
+     * @brief 把一个按序到达的 batch 写出去，调用者保证 batch 按序号串行调用
+     */
+    static void write(BinLogFileWriter* writer, LogFileManager* manager, std::unique_ptr<BatchResult> result) {
+      TraceSpan span("write", "writer", static_cast<int64>(result->sequence));
+      AllocStageScope alloc_stage(AllocStage::WRITER);
+      manager->count_written_bytes(*result);
+      manager->replication_lag_->begin(result->sequence, result->source);
+      if (manager->sequencer_ != nullptr) {
+        // 并发写模式：这里只定序，拷贝和写文件交给 worker
+        manager->dispatch_parallel_write(std::move(result));
+        manager->written_batches_++;
+        return;
+      }
 
-            writer->get_binlog()->write(data.data(), data.size());
-            result->event_write_count_++;
-          }
+      // 检查是否要切换文件
+      manager->written_tasks_ += result->transformed_data.size();
+
+      // 按顺序写入文件：一个文件内的 event 攒成 iovec，一次 writev 写出
+      std::lock_guard<std::mutex> write_lock(manager->writer_mutex_);
+      std::vector<struct iovec> iov;
+      uint64 pending_bytes = 0;
+      bool written = true;
+      for (auto& data : result->transformed_data) {
+        // 切换文件，先把攒下的写到旧文件
+        uint32 event_len = static_cast<uint32>(data.size());
+        if (!writer->get_binlog()->remain_bytes_safe(pending_bytes + event_len)) {
+          written &= writer->get_binlog()->writev(iov.data(), static_cast<int>(iov.size()));
+          iov.clear();
+          pending_bytes = 0;
+          manager->update_checkpoint(manager->get_last_file_no(), result->ckps[result->event_write_count_]);
+          manager->next_file(*writer);
         }
+
+        // 填充 common_header 中的 log_pos 字段
+        uint64 current_pos = writer->get_binlog()->get_bytes_written() + pending_bytes;
+        uint64 next_pos = current_pos + event_len;
+        int4store(data.header() + LOG_POS_OFFSET, next_pos);
+
+        data.append_to(iov);
+        pending_bytes += event_len;
+        result->event_write_count_++;
       }
+      written &= writer->get_binlog()->writev(iov.data(), static_cast<int>(iov.size()));
+      // 一个 batch 写完就交给内核：io_uring 后端在这里提交缓冲区，序列化下一个 batch 时 I/O 在后台进行。
+      // 有批量提交在等这个 batch 时，不论落盘策略都要等到落盘再通知
+      auto sync_start = std::chrono::steady_clock::now();
+      RC rc = result->completions.empty() ? writer->get_binlog()->flush() : writer->get_binlog()->sync();
+      auto sync_end = std::chrono::steady_clock::now();
+      manager->metric_sync_time_->record_duration(sync_end - sync_start);
+      Tracer::instance().record("sync", "writer", Tracer::ns_of(sync_start), Tracer::ns_of(sync_end),
+          static_cast<int64>(result->sequence));
+      bool durable = !result->completions.empty() || manager->options_.durability == BinlogDurability::SYNC;
+      rc = !written ? RC::IOERR_WRITE : rc;
+      manager->replication_lag_->complete(result->sequence, rc, durable);
+      result->finish(rc);
+      manager->memory_budget_.release(result->budget_bytes);
+      manager->written_batches_++;
     }
   };
 
@@ -327,17 +694,45 @@ public:
    * @brief 追踪处理进度
    */
   void log_progress() {
-    LOG_DEBUG("Pending tasks: %zu, Processed SQL num: %zu, Written Events num: %zu",
+    LOG_DEBUG("Pending tasks: %zu, Processed SQL num: %zu, Written Events num: %zu, "
+              "Memory used: %zu, peak: %zu, budget: %zu, stalls: %lu",
                  pending_tasks_.load(),
                  processed_tasks_.load(),
-                 written_tasks_.load());
+                 written_tasks_.load(),
+                 memory_budget_.used(),
+                 memory_budget_.peak(),
+                 memory_budget_.capacity(),
+                 memory_budget_.stalls());
   }
 
   size_t get_processed_sql_num() const {
     return processed_tasks_.load(std::memory_order_relaxed);
   }
 
-  void preload_tasks(const std::vector<Task>& tasks); // 预加载任务
+  /**
+   * @brief 各阶段累计的忙碌时间，压测工具用它和墙钟时间算利用率
+   * @details 收集阶段是从取 batch 到投递完，不含等待记录到达的时间；转换阶段是所有转换线程的时间之和；
+   * 写入阶段是写线程（或写协程）处理 batch 的时间，PARALLEL 写模式下只包含定序，不包含 worker 的 pwrite
+   */
+  struct StageStats {
+    uint64 collector_busy_ns = 0;
+    uint64 transform_busy_ns = 0;
+    uint64 writer_busy_ns    = 0;
+    size_t processed_records = 0;
+    size_t written_events    = 0;
+  };
+
+  StageStats stage_stats() const {
+    StageStats stats;
+    stats.collector_busy_ns = collector_busy_ns_.load(std::memory_order_relaxed);
+    stats.transform_busy_ns = transform_busy_ns_.load(std::memory_order_relaxed);
+    stats.writer_busy_ns    = writer_busy_ns_.load(std::memory_order_relaxed);
+    stats.processed_records = processed_tasks_.load(std::memory_order_relaxed);
+    stats.written_events    = written_tasks_.load(std::memory_order_relaxed);
+    return stats;
+  }
+
+  void preload_tasks(const std::vector<Task>& tasks); // 预加载任务，会重建线程池，COROUTINE 流水线下不支持
 
 private:
   /**
@@ -345,6 +740,72 @@ private:
    */
   void process_tasks();
 
+  /**
+   * @brief 生产者入队 added 条后通知收集方
+   * @details THREADED 模式只在 队列从空变为非空（开始计 deadline）、攒够目标大小、或 urgent（DDL）时唤醒收集线程，
+   * COROUTINE 模式每次都唤醒 collect 阶段
+   */
+  void notify_collector(size_t current_pending, size_t added, bool urgent);
+
+  /**
+   * @brief 按 options_.scheduler 把收集到的一个 batch 交给 BatchProcessor 或 PartitionedBatchProcessor
+   */
+  void dispatch_batch(std::vector<Task> &&batch_tasks);
+
+  /**
+   * @brief PARALLEL 写模式下，写线程把按序到达的 batch 交给 sequencer_ 定序
+   */
+  void dispatch_parallel_write(std::unique_ptr<BatchResult> result);
+
+  /**
+   * @brief 一个 task 在内存预算上记的字节数
+   */
+  static size_t task_bytes(const Task &task) { return sizeof(Task) + task.data_.capacity(); }
+
+  /**
+   * @brief transformBatch 的公共部分：申请预算、给每条记录挂上句柄、一次 push_bulk 入队
+   */
+  RC submit_batch(std::span<Task> records, const BatchHandle &completion);
+
+  /**
+   * @brief 按 options_.executor 创建并启动线程池，以及挂在它上面的 batch_group_
+   */
+  void create_executor();
+
+  /**
+   * @brief 收集线程每轮调用一次，满一个采样区间时由 concurrency_ 调整线程池的活跃线程数
+   */
+  void tune_workers();
+
+  /**
+   * @brief 解析 options_ 里某个阶段的 CPU 列表，格式错误时打日志并返回空列表
+   */
+  static std::vector<int> stage_cpus(const std::string &cpu_list, const char *stage);
+
+  /**
+   * @brief 写线程每轮调用：init() 找到输出设备所在的 NUMA 节点后，把写线程迁过去
+   */
+  void place_writer_thread();
+
+  /**
+   * @brief 注册各阶段的指标，options_.metrics_textfile 非空时启动导出线程
+   */
+  void register_metrics();
+
+  /**
+   * @brief 一个 batch 转换完后按 db.table 累加行数，连续的同表记录先在本地合并
+   */
+  void count_table_rows(const std::vector<Task> &tasks);
+
+  /**
+   * @brief 取 db.table 的行数 counter，命中缓存时只拿读锁、不分配内存；
+   * 第一次见到的表才去注册表里创建，超过 MAX_TABLE_ROW_SERIES 张表后都记到 table="_other" 上
+   */
+  Counter *table_rows_counter(std::string_view db, std::string_view table);
+
+  /// 交给写入阶段的字节数
+  void count_written_bytes(const BatchResult &result);
+
 private:
   const char *file_prefix_ = DEFAULT_BINLOG_FILE_NAME_PREFIX;
   const char *file_dot_    = ".";
@@ -376,19 +837,60 @@ private:
 
   // 2. 消费者——转换计算
   std::unique_ptr<LogFormatTransformManager> transform_manager_;
-  std::unique_ptr<ThreadPoolExecutor> thread_pool_;
+  std::unique_ptr<Executor> thread_pool_;
+  std::unique_ptr<TaskGroup> batch_group_;  // 已投递的 BatchProcessor，wait_for_completion 等它们全部转换完
+  std::unique_ptr<ConcurrencyController> concurrency_;  // 仅 THREAD_POOL + THREADED 且开启自动调整时存在，只在收集线程里使用
+  std::unique_ptr<CoroutinePipeline> pipeline_;  // 仅 COROUTINE 模式下存在，代替收集线程和写线程
 
   std::atomic<size_t> batch_sequence_{0}; // 顺序收集 tasks 的批次序号
+  std::unique_ptr<WritesetTracker> writeset_tracker_;  // 仅 WRITESET 依赖追踪时存在，只在收集线程里使用
 
   // 3. 共享的文件写入器
+  LogFileOptions                    options_;
+  MemoryBudget                      memory_budget_;  // ingest、transform、reorder 共享的内存预算
+  AdaptiveBatcher                   batcher_;        // 收集线程的 batch 大小
+  std::atomic<bool>                 flush_requested_{false};  // DDL 或 flush() 要求立即投递
+  std::atomic<int64>                first_pending_ns_{0};     // 队列从空变为非空的时刻（steady_clock），deadline 从这里算
+  uint64                            collected_total_ = 0;     // 收集线程取走的记录总数，用来观测到达速率
   std::unique_ptr<BinLogFileWriter> file_writer_;
+  std::unique_ptr<BinlogSequencer>  sequencer_;  // 仅 PARALLEL 写模式下存在
   std::mutex writer_mutex_;  // 保护文件写入
   ResultQueue result_queue_;
   std::thread writer_thread_;  // 专门的写入线程
+  std::atomic<int> writer_node_{-1};          // writer_near_output 时输出设备所在的 NUMA 节点，init() 里确定
+  int              placed_writer_node_ = -1;  // 写线程已经迁到的节点，只在写线程里访问
 
   // 追踪进度
   std::atomic<size_t> processed_tasks_{0};
   std::atomic<size_t> written_tasks_{0};
+  std::atomic<size_t> transformed_batches_{0};  // 转换完的 batch 数，和 written_batches_ 的差是写线程的积压
+  std::atomic<size_t> written_batches_{0};
+  std::atomic<uint64> collector_busy_ns_{0};  // 见 StageStats
+  std::atomic<uint64> transform_busy_ns_{0};
+  std::atomic<uint64> writer_busy_ns_{0};
+
+  // 指标：注册表先于导出线程构造，导出线程先停止、先析构
+  MetricsRegistry                        metrics_;
+  std::unique_ptr<ReplicationLagTracker> replication_lag_;
+  std::unique_ptr<MetricsExporter>       metrics_exporter_;
+  Histogram                       *metric_batch_time_  = nullptr;  // 一个 batch（或一个分区单元）的转换耗时
+  Histogram                       *metric_rotate_time_ = nullptr;  // 切换 binlog 文件的耗时
+  Histogram                       *metric_sync_time_   = nullptr;  // 每个 batch 写完后 flush / sync 的耗时
+  Counter                         *metric_bytes_written_ = nullptr;
+
+  /// 字符串作 key 的 map 支持直接用 string_view 查找
+  struct StringHash
+  {
+    using is_transparent = void;
+    size_t operator()(std::string_view value) const { return std::hash<std::string_view>()(value); }
+  };
+  using TableCounters = std::unordered_map<std::string, Counter *, StringHash, std::equal_to<>>;
+  using DbCounters    = std::unordered_map<std::string, TableCounters, StringHash, std::equal_to<>>;
+
+  static constexpr size_t MAX_TABLE_ROW_SERIES = 1024;  // loft_table_rows_total 最多的标签个数
+  std::shared_mutex table_rows_mutex_;
+  DbCounters        table_rows_;  // db -> table -> counter，超出上限的表也缓存，指向 "_other"
+  size_t            table_rows_series_ = 0;
 
   // 预加载 version
   std::vector<Task> preloaded_tasks_;   // 预加载的 SQL 任务队列
@@ -0,0 +1,100 @@
+//
+// Created by Coonger on 2024/12/11.
+//
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "log_file.h"
+
+namespace loft {
+
+/**
+ * @brief 按表分区并发转换一个 batch 的调度器（SchedulerType::PARTITIONED）
+ * @details FIFO 调度下一个 batch 由一个 BatchProcessor 从头转到尾。这里把收集线程取出的一个 batch
+ * 按 db.table 哈希到若干分区，每个分区内的记录保持到达顺序，组成一个转换单元，不同分区的单元并发执行：
+ *   - DDL 是屏障：它依赖受影响分区（没有表名的 DDL 影响所有分区）上一个单元，之后这些分区上的单元又依赖它
+ *   - 就绪的单元按优先级投递到线程池：DDL > INSERT > UPDATE = DELETE
+ *   - 所有单元转换完后，按 (scn, 到达顺序) 归并每条记录的 event 和 ckp，组成一个 BatchResult，
+ *     沿用这个 batch 的序号交给写线程。batch 内 scn 单调时 binlog 里记录的顺序与 FIFO 调度一致，
+ *     不单调时按 scn 重排（DDL 也参与排序），重排只发生在一个 batch 之内
+ * 转换本身是无状态的，分区只决定并发度，不影响输出内容
+ */
+class PartitionedBatchProcessor : public std::enable_shared_from_this<PartitionedBatchProcessor>
+{
+public:
+  PartitionedBatchProcessor(
+      LogFileManager *manager, std::vector<Task> &&tasks, size_t sequence, uint32 partitions);
+
+  DISALLOW_COPY_AND_MOVE(PartitionedBatchProcessor);
+
+  /**
+   * @brief 建立分区和依赖关系，投递没有前驱的单元。最后一个单元执行完时提交整个 batch
+   */
+  void start();
+
+private:
+  /// 单元的优先级，数值越小越先投递
+  enum Priority
+  {
+    PRIORITY_DDL    = 0,
+    PRIORITY_INSERT = 1,
+    PRIORITY_OTHER  = 2,  // UPDATE、DELETE
+  };
+
+  /**
+   * @brief 一个转换单元：同一分区里连续的 DML，或者一条 DDL
+   */
+  struct Unit
+  {
+    std::vector<size_t>              records;     // 在 tasks_ 里的下标，按到达顺序
+    std::vector<Unit *>              successors;  // 依赖这个单元的单元
+    std::atomic<size_t>              dependencies{0};
+    int                              priority = PRIORITY_OTHER;
+    LogFileManager::BatchResult      output{0};   // 只用 transformed_data、events、ckps
+  };
+
+  /**
+   * @brief 一条记录的转换结果在所属单元 output 里的位置
+   */
+  struct Slot
+  {
+    Unit  *unit        = nullptr;
+    size_t data_begin  = 0;
+    size_t data_end    = 0;
+    size_t ckp_begin   = 0;
+    size_t ckp_end     = 0;
+    int64  scn         = 0;
+  };
+
+  /// 按 db.table 计算分区，返回 false 表示记录影响所有分区（没有表名的 DDL）
+  bool route(const Task &task, uint32 &partition, int64 &scn, int &priority) const;
+
+  void add_edge(Unit *from, Unit *to);
+
+  /// 按优先级投递一组就绪的单元，执行器拒绝时在当前线程执行
+  void schedule(std::vector<Unit *> &ready);
+
+  void run_unit(Unit *unit);
+
+  /// 全部单元执行完：按 (scn, 到达顺序) 归并，提交给写线程
+  void finish();
+
+private:
+  LogFileManager   *manager_;
+  std::vector<Task> tasks_;
+  size_t            batch_sequence_;
+  uint32            partitions_;
+
+  std::vector<std::unique_ptr<Unit>> units_;
+  std::vector<Slot>                  slots_;  // 与 tasks_ 一一对应
+  std::atomic<size_t>                remaining_units_{0};
+  std::chrono::steady_clock::time_point start_time_;  // 上报给 AdaptiveBatcher 的转换耗时从 start() 开始算
+};
+
+}  // namespace loft
@@ -0,0 +1,101 @@
+//
+// Created by Coonger on 2024/12/16.
+//
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "format/ddl_generated.h"
+#include "format/dml_generated.h"
+#include "common/type_def.h"
+
+namespace loft {
+
+/**
+ * @brief 用生成的 DMLBuilder / DDLBuilder 拼 Cantian redo 记录，基准和数据生成器用它构造输入
+ * @details 字段的编码和 Cantian 导出的格式一致，转换时由 DataHandlerFactory 里的 handler 还原：
+ *   - 整数、YEAR 是 LongVal；FLOAT、DOUBLE 是 DoubleVal
+ *   - DECIMAL 是十进制文本的 StringVal
+ *   - 其他字符、二进制、JSON、时间类型都是 base64 之后的 StringVal，用 encode_string() 编码
+ * 构造出来的 buffer 可以直接 GetDML / GetDDL，写进 redo 文件时前面再加 4 字节的长度
+ */
+class RedoRecordBuilder
+{
+public:
+  /// 一列的定义，对应 FieldMeta
+  struct Column
+  {
+    std::string name;
+    std::string type;  // type_map 里的类型名，比如 "INT"、"VARCHAR"、"DATETIME"
+    int         length      = 0;
+    int         precision   = 0;
+    bool        is_unsigned = false;
+    bool        nullable    = false;
+  };
+
+  /// 一个字段值，kind 为 DataMeta_NONE 表示 NULL
+  struct Value
+  {
+    DataMeta    kind         = DataMeta_NONE;
+    int64       long_value   = 0;
+    double      double_value = 0;
+    std::string string_value;  // 已经按上面的规则编码
+
+    static Value of_long(int64 value);
+    static Value of_double(double value);
+    static Value of_string(std::string value);
+  };
+
+  /// 一行里出现的字段：(列下标, 值)，列下标对应 Column 的顺序
+  using Row = std::vector<std::pair<size_t, Value>>;
+
+  /// 每条记录都有的事务信息
+  struct Header
+  {
+    int64       scn         = 0;
+    int64       seq         = 0;
+    int64       lsn         = 0;
+    int64       last_commit = 0;
+    int64       tx_seq      = 0;
+    std::string msg_time;  // "YYYY-MM-DD HH:MM:SS.ffffff"
+    std::string tx_time;
+    std::string check_point;
+  };
+
+  RedoRecordBuilder() = default;
+
+  /**
+   * @brief 构造一条 DML
+   * @param op_type "I"、"U" 或 "D"
+   * @param keys    UPDATE / DELETE 定位用的字段，INSERT 传空
+   * @param data    INSERT / UPDATE 的新值，DELETE 传空
+   */
+  std::vector<uint8> dml(const Header &header, const std::string &db, const std::string &table, const char *op_type,
+      const std::vector<Column> &columns, const Row &keys, const Row &data);
+
+  /**
+   * @brief 构造一条 DDL
+   * @param ddl_type 比如 "CREATE TABLE"、"DROP TABLE"
+   */
+  std::vector<uint8> ddl(const Header &header, const std::string &db, const std::string &table, const std::string &sql,
+      const char *ddl_type);
+
+  /// 字符、二进制、JSON、时间类型的值在 redo 里是 base64 编码的
+  static std::string encode_string(std::string_view raw);
+
+  /// 把时间格式化成 msg_time / tx_time 的格式，micros 是 UTC 微秒
+  static std::string format_time(int64 micros);
+
+private:
+  flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<kvPair>>> build_row(
+      const std::vector<Column> &columns, const Row &row);
+
+private:
+  flatbuffers::FlatBufferBuilder fbb_;  // 每条记录复用，避免反复扩容
+};
+
+}  // namespace loft
@@ -0,0 +1,150 @@
+//
+// Created by Coonger on 2024/12/17.
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "common/rc.h"
+#include "common/type_def.h"
+#include "redo_builder.h"
+
+namespace loft {
+
+/**
+ * @brief RedoGenerator 的参数
+ * @details 列类型和操作的比例写成 "名字:权重" 的列表，比如 "int:4,varchar:2,datetime:1"、"I:80,U:15,D:5"。
+ * 列类型可选 int、smallint、bigint、double、decimal、varchar、text、datetime、timestamp、year、json
+ */
+struct RedoGeneratorOptions
+{
+  uint64      seed           = 1;
+  int         tables         = 4;
+  int         min_columns    = 8;  // 不含主键列 id
+  int         max_columns    = 16;
+  std::string column_mix     = "int:4,bigint:2,varchar:2,decimal:1,datetime:1";
+  int         string_length  = 32;   // varchar / text 值的平均字节数，实际长度在 [1/2, 3/2] 之间均匀分布
+  int         json_length    = 256;  // json 值的大约字节数
+  std::string op_mix         = "I:80,U:15,D:5";
+  int         min_tx_records = 1;  // 每个事务的 DML 条数
+  int         max_tx_records = 8;
+  double      skew           = 0;  // [0, 1)，0 为均匀；越大越集中在少数表和少数行上
+  uint64      output_bytes   = 0;  // 输出达到这个大小（含长度前缀）后在事务边界停止，0 表示不限制
+  uint64      records        = 0;  // DML 达到这个条数后在事务边界停止，0 表示不限制；两个都为 0 时 next() 永不结束
+};
+
+/**
+ * @brief 生成可复现的 Cantian redo 记录流，用于压测和扩展性测试
+ * @details 先输出建库和每张表的建表 DDL，再按事务输出 DML：
+ *   - 每个事务从 [min_tx_records, max_tx_records] 里取条数，事务内 seq 从 1 递增，scn、tx_seq 按事务递增
+ *   - 表和 UPDATE / DELETE 的行按 skew 倾斜选取，只会选到还没被删除的行；INSERT 的主键在每张表内递增
+ *   - DATETIME / TIMESTAMP 列的精度是 6，值带微秒，是虚拟时钟之前一天内的随机时刻
+ *   - msg_time / tx_time 是从 2024-08-01 开始、每个事务前进几百微秒的虚拟时钟
+ * 随机数只依赖 seed，不使用 <random> 里各标准库实现不同的分布，同一个 seed 总是生成相同的字节流。
+ * 写到文件时每条记录前面加 4 字节的长度，和 BufferReader 的读取方式一致；DDL 都在文件开头，条数见 ddl_count()
+ */
+class RedoGenerator
+{
+public:
+  explicit RedoGenerator(const RedoGeneratorOptions &options);
+
+  /**
+   * @brief 解析列类型和操作比例，生成表结构
+   * @return 参数不合法时返回 RC::INVALID_ARGUMENT
+   */
+  RC init();
+
+  /**
+   * @brief 生成下一条记录
+   * @param[out] record 一条 DDL 或 DML 的 FlatBuffer，不带长度前缀
+   * @param[out] is_ddl 是否是 DDL
+   * @return 达到 output_bytes / records 的限制后返回 false
+   */
+  bool next(std::vector<uint8> &record, bool &is_ddl);
+
+  /**
+   * @brief 把整个流写到文件，每条记录前加 4 字节长度
+   * @return output_bytes 和 records 都为 0（流不会结束）时返回 RC::INVALID_ARGUMENT
+   */
+  RC write(const std::string &path);
+
+  uint64 ddl_count() const { return ddl_count_; }
+  uint64 dml_count() const { return dml_count_; }
+  uint64 transaction_count() const { return tx_count_; }
+  uint64 output_bytes() const { return output_bytes_; }  // 含长度前缀
+
+private:
+  /// 一种列类型的定义
+  struct ColumnType
+  {
+    const char *name;      // column_mix 里的名字
+    const char *meta;      // FieldMeta::data_type
+    const char *sql;       // 建表语句里的类型
+    int         length;    // 0 表示由 string_length 决定（varchar）
+    int         precision;
+  };
+
+  struct Table
+  {
+    std::string                            name;
+    std::vector<RedoRecordBuilder::Column> columns;  // 第 0 列是主键 id
+    std::vector<const ColumnType *>        types;    // 与 columns 一一对应
+    int64                                  next_id = 1;
+    std::vector<int64>                     live_ids;  // 还没被删除的行，大致按插入顺序，删除时用末尾的行补位
+  };
+
+  struct Weighted
+  {
+    int    index;   // ColumnType 下标或操作
+    uint32 weight;
+  };
+
+  static const ColumnType COLUMN_TYPES[];
+  static const char      *OPS[];  // 与 op_mix 里的名字对应，也是 DML 的 op_type
+
+  static RC parse_mix(const std::string &mix, const std::vector<std::string> &names, std::vector<Weighted> &result);
+
+  uint64 next_random();
+  uint64 uniform(uint64 n);  // [0, n)
+  double unit();             // [0, 1)
+  uint64 skewed(uint64 n);   // [0, n)，按 skew 偏向 0
+  int    pick(const std::vector<Weighted> &mix, uint32 total);
+
+  RedoRecordBuilder::Header next_header();
+  RedoRecordBuilder::Value  make_value(const ColumnType &type);
+  RedoRecordBuilder::Row    make_row(const Table &table, int64 id);
+  std::string               random_text(size_t length);
+  std::string               create_table_sql(const Table &table) const;
+
+  void begin_transaction();
+  void emit_dml(std::vector<uint8> &record);
+
+private:
+  RedoGeneratorOptions options_;
+  RedoRecordBuilder    builder_;
+
+  uint64 random_state_;
+
+  std::vector<Table>    tables_;
+  std::vector<Weighted> column_mix_;
+  uint32                column_total_ = 0;
+  std::vector<Weighted> op_mix_;
+  uint32                op_total_ = 0;
+
+  size_t next_ddl_     = 0;  // 0 是建库，1..tables 是建表
+  int    tx_remaining_ = 0;  // 当前事务还要生成的 DML 条数
+  int64  scn_          = 0;
+  int64  seq_          = 0;
+  int64  lsn_          = 0;
+  int64  tx_seq_       = 0;
+  int64  clock_micros_ = 0;  // 虚拟时钟，UTC 微秒
+
+  uint64 ddl_count_    = 0;
+  uint64 dml_count_    = 0;
+  uint64 tx_count_     = 0;
+  uint64 output_bytes_ = 0;
+};
+
+}  // namespace loft
@@ -0,0 +1,86 @@
+//
+// Created by Coonger on 2024/12/18.
+//
+
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+
+#include "common/metrics.h"
+#include "common/rc.h"
+#include "common/type_def.h"
+
+namespace loft {
+
+/**
+ * @brief 一个 batch 里源端记录的提交时间和 scn 范围
+ */
+struct SourceProgress
+{
+  uint64 oldest_commit_us = 0;  // 源端提交时间（epoch 微秒），0 表示这个 batch 没有可用的时间
+  uint64 newest_commit_us = 0;
+  int64  max_scn          = 0;
+
+  void add(uint64 commit_us, int64 scn);
+  void merge(const SourceProgress &other);
+};
+
+/**
+ * @brief 源端提交到 binlog 写出之间的复制延迟
+ * @details 写线程按 batch 顺序调用 begin()，写完（或落盘）后由写线程或并发写的 worker 调用 complete()，
+ * 完成的顺序可以和 begin 不同。
+ *   - loft_replication_lag_seconds：每个 batch 写完时，batch 里最早提交的记录已经落后了多久
+ *   - loft_replication_lag_current_seconds：已写出的最新记录落后了多久；还有 batch 在途时，
+ *     取它和最早在途记录的延迟中较大的一个，写线程卡住时这个值会持续增长
+ *   - loft_binlog_written_scn / loft_binlog_durable_scn：按 begin 顺序连续完成的前缀里最大的 scn，
+ *     后者只在前缀末尾的 batch 落盘（fdatasync / msync MS_SYNC）时推进
+ * 有 batch 写失败时 binlog 里有了空洞，两个水位都不再推进
+ */
+class ReplicationLagTracker
+{
+public:
+  explicit ReplicationLagTracker(common::MetricsRegistry &registry);
+
+  /**
+   * @brief 一个 batch 开始写入，调用者保证按 batch 顺序串行调用
+   */
+  void begin(size_t sequence, const SourceProgress &progress);
+
+  /**
+   * @brief 一个 batch 写完
+   * @param durable 写完后是否已经等到落盘
+   */
+  void complete(size_t sequence, RC rc, bool durable);
+
+  int64  written_scn() const { return written_scn_.load(std::memory_order_relaxed); }
+  int64  durable_scn() const { return durable_scn_.load(std::memory_order_relaxed); }
+  uint64 current_lag_us() const;
+
+  /// 当前的 epoch 微秒，和 LogFormatTransformManager::stringToTimestamp 的结果可以直接相减
+  static uint64 now_us();
+
+private:
+  struct Entry
+  {
+    size_t         sequence;
+    SourceProgress progress;
+    bool           done    = false;
+    bool           failed  = false;
+    bool           durable = false;
+  };
+
+private:
+  common::Histogram *lag_ = nullptr;
+
+  mutable std::mutex  mutex_;
+  std::deque<Entry>   inflight_;  // 按 begin 顺序排列
+  bool                stalled_ = false;
+
+  std::atomic<int64>  written_scn_{0};
+  std::atomic<int64>  durable_scn_{0};
+  std::atomic<uint64> last_lag_us_{0};
+};
+
+}  // namespace loft
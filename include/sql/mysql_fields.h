@@ -329,11 +329,11 @@ protected:
 
   /**
   Adjust number of decimal digits from DECIMAL_NOT_SPECIFIED to
-  DATETIME_MAX_DECIMALS
+  DATETIME_MAX_DECIMALS. 源端的时间精度可能超过 6 位（比如 TIMESTAMP(9)），同样按 6 位处理
 */
   static uint8_t normalize_dec(uint8_t dec_arg)
   {
-    return dec_arg == DECIMAL_NOT_SPECIFIED ? DATETIME_MAX_DECIMALS : dec_arg;
+    return dec_arg == DECIMAL_NOT_SPECIFIED || dec_arg > DATETIME_MAX_DECIMALS ? DATETIME_MAX_DECIMALS : dec_arg;
   }
 
 public:
@@ -345,6 +345,8 @@ public:
     set_flag(BINARY_FLAG);
     dec = normalize_dec(dec_arg);
   }
+
+  uint32_t decimals() const final { return dec; }
 };
 
 class Field_temporal_with_date : public Field_temporal
@@ -356,16 +358,16 @@ public:
   {}
 };
 
+/**
+ * @brief rows event 里按 DATETIME2 / TIMESTAMP2 的格式打包，table map 的元数据是 1 个字节的小数位数
+ */
 class Field_temporal_with_date_and_time : public Field_temporal_with_date
 {
 private:
   int do_save_field_metadata(unsigned char *metadata_ptr) const override
   {
-    if (decimals()) {
-      *metadata_ptr = decimals();
-      return 1;
-    }
-    return 0;
+    *metadata_ptr = decimals();
+    return 1;
   }
 
 public:
@@ -380,9 +382,11 @@ class Field_timestamp : public Field_temporal_with_date_and_time
 public:
   static const int PACK_LENGTH = 4;
 
-  Field_timestamp(uint32_t len_arg, bool is_nullable_arg, unsigned char null_bit_arg, const char *field_name_arg);
+  Field_timestamp(uint32_t len_arg, bool is_nullable_arg, unsigned char null_bit_arg, const char *field_name_arg,
+      uint8_t dec_arg = 0);
 
   enum_field_types type() const final { return MYSQL_TYPE_TIMESTAMP; }
+  enum_field_types binlog_type() const final { return MYSQL_TYPE_TIMESTAMP2; }
 
   uint32_t pack_length() const final { return PACK_LENGTH; }
 };
@@ -402,19 +406,30 @@ class Field_datetime : public Field_temporal_with_date_and_time
 public:
   static const int PACK_LENGTH = 8;
 
-  Field_datetime(bool is_nullable_arg, unsigned char null_bit_arg, const char *field_name_arg)
-      : Field_temporal_with_date_and_time(is_nullable_arg, null_bit_arg, field_name_arg, 0)
+  Field_datetime(bool is_nullable_arg, unsigned char null_bit_arg, const char *field_name_arg, uint8_t dec_arg = 0)
+      : Field_temporal_with_date_and_time(is_nullable_arg, null_bit_arg, field_name_arg, dec_arg)
   {}
 
   Field_datetime(const char *field_name_arg) : Field_temporal_with_date_and_time(false, 0, field_name_arg, 0) {}
 
   enum_field_types type() const final { return MYSQL_TYPE_DATETIME; }
+  enum_field_types binlog_type() const final { return MYSQL_TYPE_DATETIME2; }
 
   uint32_t pack_length() const final { return PACK_LENGTH; }
 };
 
+/**
+ * @brief rows event 里按 TIME2 的格式打包，table map 的元数据是 1 个字节的小数位数
+ */
 class Field_time_common : public Field_temporal
 {
+private:
+  int do_save_field_metadata(unsigned char *metadata_ptr) const override
+  {
+    *metadata_ptr = decimals();
+    return 1;
+  }
+
 public:
   Field_time_common(bool is_nullable_arg, unsigned char null_bit_arg, const char *field_name_arg, uint8_t dec_arg)
       : Field_temporal(is_nullable_arg, null_bit_arg, field_name_arg, MAX_TIME_WIDTH, dec_arg)
@@ -424,11 +439,12 @@ public:
 class Field_time final : public Field_time_common
 {
 public:
-  Field_time(bool is_nullable_arg, unsigned char null_bit_arg, const char *field_name_arg)
-      : Field_time_common(is_nullable_arg, null_bit_arg, field_name_arg, 0)
+  Field_time(bool is_nullable_arg, unsigned char null_bit_arg, const char *field_name_arg, uint8_t dec_arg = 0)
+      : Field_time_common(is_nullable_arg, null_bit_arg, field_name_arg, dec_arg)
   {}
 
   enum_field_types type() const final { return MYSQL_TYPE_TIME; }
+  enum_field_types binlog_type() const final { return MYSQL_TYPE_TIME2; }
 
   uint32_t pack_length() const final { return 3; }
 };
@@ -14,6 +14,15 @@
 
 using namespace loft;
 
+/**
+ * @brief GTID event 里的逻辑时钟，从库按 LOGICAL_CLOCK 并行回放时，last_committed 相同的事务可以并发执行
+ */
+struct LogicalClock
+{
+  int64 last_committed  = 0;
+  int64 sequence_number = 0;
+};
+
 class LogFormatTransformManager
 {
 public:
@@ -26,11 +35,14 @@ public:
   // 组装 5 个 event
   void transformDML(const DML *dml, MYSQL_BIN_LOG *binLog);
 
-  std::vector<std::unique_ptr<AbstractEvent>> transformDDL(const DDL *ddl);
-  std::vector<std::unique_ptr<AbstractEvent>> transformDML(const DML *dml);
+  /// clock 不为空时用它代替源端记录里的 last_commit / tx_seq，见 WritesetTracker
+  std::vector<std::unique_ptr<AbstractEvent>> transformDDL(const DDL *ddl, const LogicalClock *clock = nullptr);
+  std::vector<std::unique_ptr<AbstractEvent>> transformDML(const DML *dml, const LogicalClock *clock = nullptr);
+
+  /// 解析 msg_time / tx_time（东八区 "YYYY-MM-DD HH:MM:SS.ffffff"），返回 UTC 微秒
+  static uint64_t stringToTimestamp(const std::string& timeString);
 
 private:
-  inline uint64_t stringToTimestamp(const std::string& timeString);
   inline enum_field_types ConvertStringType(std::string_view type_str);
   void processRowData(const ::flatbuffers::Vector<::flatbuffers::Offset<loft::kvPair>> &fields, Rows_event *row,
       const std::unordered_map<std::string, int> &field_map, const std::vector<mysql::FieldRef> &field_vec,
@@ -0,0 +1,133 @@
+//
+// Created by Coonger on 2024/12/4.
+//
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <linux/io_uring.h>
+
+#include "basic_ostream.h"
+#include "common/macros.h"
+
+/**
+   Binlog_uring_ofile 通过 io_uring 追加写 binlog，写线程不会阻塞在 write(2) / fsync(2) 上：
+   1. open 时注册 buffer_count 块固定缓冲区（IORING_REGISTER_BUFFERS），write() 只是把数据拷贝进当前缓冲区
+   2. 缓冲区写满或 flush() 时提交一个 IORING_OP_WRITE_FIXED，然后换下一块空闲缓冲区继续攒数据，
+      这样序列化 batch N+1 和 batch N 的 I/O 是重叠的；只有所有缓冲区都在途时 write() 才会等待
+   3. sync() 把最后一块缓冲区的写和一个 IORING_OP_FSYNC(DATASYNC) 用 IOSQE_IO_LINK 串起来提交，
+      链头带 IOSQE_IO_DRAIN，保证 fsync 之前提交的所有写都已完成
+   4. 独立的 reaper 线程阻塞在 io_uring_enter 上收割 completion，归还缓冲区，记录错误
+
+   内核不支持 io_uring（或被 seccomp 禁用）时构造失败，返回 RC::IOERR_OPEN，由调用方回退到其他后端
+*/
+class Binlog_uring_ofile : public Binlog_file_ostream
+{
+public:
+  static constexpr size_t DEFAULT_BUFFER_SIZE  = 1 << 20;  // 1MB
+  static constexpr uint32 DEFAULT_BUFFER_COUNT = 8;
+
+  Binlog_uring_ofile(const char *binlog_name, RC &rc, uint32 buffer_count = DEFAULT_BUFFER_COUNT,
+      size_t buffer_size = DEFAULT_BUFFER_SIZE);
+
+  ~Binlog_uring_ofile() override;
+
+  DISALLOW_COPY_AND_MOVE(Binlog_uring_ofile);
+
+  bool     write(const uchar *buffer, my_off_t length) override;
+  RC       seek(my_off_t position) override;
+  /// 提交 fdatasync 并等待它完成
+  RC       sync() override;
+  /// 把当前缓冲区里攒的数据提交给内核，不等待完成
+  RC       flush() override;
+  my_off_t get_position() override { return m_position_; }
+
+  bool is_empty() const override { return m_position_ == 0; }
+  /// 等待所有在途的写完成后关闭文件和 ring
+  void close() override;
+
+  /**
+   * @brief 当前内核是否可以使用 io_uring
+   */
+  static bool is_supported();
+
+private:
+  /// user_data 的高 8 位区分 completion 的类型，低位是缓冲区下标
+  enum class Op : uint64
+  {
+    WRITE = 1,
+    FSYNC = 2,
+    STOP  = 3,
+  };
+
+  struct Buffer
+  {
+    uchar   *data   = nullptr;
+    size_t   used   = 0;
+    bool     busy   = false;  // 已提交、completion 还没收割
+    my_off_t offset = 0;      // 这块缓冲区在文件里的起始位置
+  };
+
+  RC   setup_ring(uint32 entries);
+  void teardown_ring();
+
+  /// 取一个空闲的 sqe；sq 满时先提交已填好的 sqe 腾出位置，提交失败返回 nullptr
+  struct io_uring_sqe *get_sqe();
+  /// 发布 get_sqe() 填好的 sqe，直到内核全部取走；失败时置 failed_
+  bool                 submit();
+
+  /// 为 current_ 指向的缓冲区准备一个 WRITE_FIXED sqe，返回是否准备了（空缓冲区不需要写，取不到 sqe 时置 failed_）
+  bool prepare_current(uint8_t flags);
+  /// 切换到下一块缓冲区，它还在途时等待 reaper 归还
+  bool acquire_buffer();
+
+  void reap_loop();
+  /// 等待所有已提交的 sqe 都被收割
+  void wait_idle();
+
+private:
+  int         m_fd_       = -1;
+  my_off_t    m_position_ = 0;
+  std::string m_file_name_;
+
+  // ---- io_uring 的 mmap 区域 ----
+  int                  ring_fd_ = -1;
+  void                *sq_ptr_  = nullptr;
+  size_t               sq_size_ = 0;
+  void                *cq_ptr_  = nullptr;
+  size_t               cq_size_ = 0;
+  struct io_uring_sqe *sqes_    = nullptr;
+  size_t               sqes_size_ = 0;
+
+  uint32 *sq_head_  = nullptr;
+  uint32 *sq_tail_  = nullptr;
+  uint32 *sq_mask_  = nullptr;
+  uint32 *sq_array_ = nullptr;
+  uint32  sq_entries_ = 0;
+  uint32  sq_local_tail_ = 0;  // 已填好但还没发布给内核的 sqe 的 tail
+
+  uint32              *cq_head_ = nullptr;
+  uint32              *cq_tail_ = nullptr;
+  uint32              *cq_mask_ = nullptr;
+  struct io_uring_cqe *cqes_    = nullptr;
+
+  // ---- 注册的固定缓冲区 ----
+  size_t              buffer_size_ = 0;
+  std::vector<Buffer> buffers_;
+  uint32              current_ = 0;
+
+  // ---- reaper 线程与写线程之间的同步 ----
+  std::thread             reaper_;
+  std::mutex              mutex_;
+  std::condition_variable cv_;
+  int64                   inflight_        = 0;  // 已交给内核、还没收割的 sqe 数；reaper 可能先于 submit() 计数，短暂为负
+  std::atomic<bool>       reaper_exited_{false};  // reaper 出错退出后不会再有人收割 completion
+  uint64                  sync_submitted_  = 0;
+  uint64                  sync_completed_  = 0;
+  std::atomic<bool>       failed_{false};        // 任一 completion 出错后，后续 write 都返回 false
+};
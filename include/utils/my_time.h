@@ -79,4 +79,9 @@ void str_to_datetime(const char *const str_arg, std::size_t length, MYSQL_TIME *
 
 void datetime_to_timeval(const MYSQL_TIME *ltime, my_timeval *tm);
 
+/**
+ * @brief 把微秒部分截断到 dec 位小数，按列精度打包之前调用，否则精度以外的位会触发打包函数里的断言
+ */
+void my_time_trunc(MYSQL_TIME *ltime, uint dec);
+
 longlong TIME_to_longlong_packed(const MYSQL_TIME &my_time);
@@ -0,0 +1,75 @@
+//
+// Created by Coonger on 2024/12/12.
+//
+
+#pragma once
+
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "transform_manager.h"
+#include "common/task_queue.h"
+
+namespace loft {
+
+/**
+ * @brief 基于 WRITESET 的事务依赖追踪，等价于 MySQL 的 binlog_transaction_dependency_tracking=WRITESET
+ * @details 源端记录里的 last_commit / tx_seq 是 Cantian 自己的编号，从库按 LOGICAL_CLOCK 并行回放时几乎没有并行度。
+ * 这里按提交顺序给每个事务（一条记录）重新分配 sequence_number，并用它写过的行计算 last_committed：
+ *   - writeset 是 (db, table, 键列名, 键值) 的 64 位哈希，UPDATE 同时包含前后镜像的键
+ *   - history_ 记录每个哈希最后一次被哪个事务写过，last_committed 取 writeset 在 history_ 里命中的最大值，
+ *     下限是 history_start_
+ *   - DDL、没有表名、键里有 NULL、键列和之前不一致的记录不能用 writeset，last_committed = sequence_number - 1，
+ *     并清空 history_，之后的事务都排在它后面
+ *   - history_ 放不下时同样清空，上限是 history_size
+ * 键列名从 UPDATE / DELETE 的 keys 里学习；还不知道键列时，INSERT 没有 writeset，
+ * 但会记在表上，之后这张表的 UPDATE / DELETE 至少依赖到它
+ * 只能在一个线程里按 binlog 的输出顺序调用，不是线程安全的
+ */
+class WritesetTracker
+{
+public:
+  explicit WritesetTracker(size_t history_size);
+
+  /**
+   * @brief 按顺序为一个 batch 的记录计算逻辑时钟，写回 task 的 last_committed_ / sequence_number_
+   * @param scn_order 为 true 时按 (scn, 到达顺序) 处理，和 PARTITIONED 调度的输出顺序一致
+   */
+  void track(std::span<Task> tasks, bool scn_order);
+
+  /**
+   * @brief 为下一个事务分配 sequence_number 并计算 last_committed
+   * @param writeset    这个事务写过的行的哈希
+   * @param can_use     false 表示这个事务不能用 writeset 并行，只能排在前一个事务后面
+   * @param min_parent  last_committed 的额外下限
+   */
+  LogicalClock next(const std::vector<uint64> &writeset, bool can_use, int64 min_parent = 0);
+
+  size_t history_size() const { return history_.size(); }
+
+private:
+  /**
+   * @brief 一张表学到的键列，以及还不知道键列时最后一个 INSERT 的 sequence_number
+   */
+  struct TableState
+  {
+    std::vector<std::string> key_columns;  // 按名字排序
+    int64                    keyless_insert = 0;
+  };
+
+  LogicalClock track_ddl();
+  LogicalClock track_dml(const DML *dml);
+
+private:
+  size_t max_history_;
+  int64  sequence_number_ = 0;
+  int64  history_start_   = 0;  // 最近一次清空 history_ 的事务，之后的事务都不能早于它
+
+  std::unordered_map<uint64, int64>       history_;  // 行哈希 -> 最后写它的 sequence_number
+  std::unordered_map<std::string, TableState> tables_;   // db.table -> 键列
+  std::vector<uint64>                     writeset_;  // 复用的缓冲区
+};
+
+}  // namespace loft
@@ -3,6 +3,53 @@
 //
 #include "basic_ostream.h"
 
+#include <fcntl.h>     // ::open, posix_fallocate
+#include <sys/mman.h>  // mmap, msync
+#include <sys/stat.h>  // fstat
+#include <unistd.h>    // ::pwrite, ::fdatasync
+#include <algorithm>   // std::min
+#include <climits>     // IOV_MAX
+#include <cerrno>
+#include <cstring>
+
+#include "common/init_setting.h"
+#include "common/logging.h"
+
+namespace {
+
+const my_off_t PAGE_SIZE_MASK = ~static_cast<my_off_t>(sysconf(_SC_PAGESIZE) - 1);
+
+/**
+ * @brief 保证文件至少有 length 字节（优先 fallocate，不支持时 ftruncate），然后把 [0, length) 映射为可写
+ * @details 映射区超出文件大小的部分访问会 SIGBUS，所以 fallocate 失败时必须用 ftruncate 兜底
+ */
+uchar *map_file(int fd, my_off_t length, const char *filename)
+{
+  int ret = posix_fallocate(fd, 0, static_cast<off_t>(length));
+  if (ret != 0 && ::ftruncate(fd, static_cast<off_t>(length)) != 0) {
+    LOG_ERROR("extend binlog file for mmap failed. filename=%s, error=%s", filename, strerror(errno));
+    return nullptr;
+  }
+  void *addr = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (addr == MAP_FAILED) {
+    LOG_ERROR("mmap binlog file failed. filename=%s, error=%s", filename, strerror(errno));
+    return nullptr;
+  }
+  return static_cast<uchar *>(addr);
+}
+
+/// 对 [begin, end) 做 msync，msync 要求起点按页对齐
+int msync_range(uchar *map, my_off_t begin, my_off_t end, int flags)
+{
+  my_off_t aligned = begin & PAGE_SIZE_MASK;
+  if (end <= aligned) {
+    return 0;
+  }
+  return ::msync(map + aligned, end - aligned, flags);
+}
+
+}  // namespace
+
 bool Binlog_ofile::write(const uchar *buffer,my_off_t length) {
     assert(m_pipeline_head_ != nullptr);
 
@@ -49,3 +96,394 @@ Binlog_ofile::Binlog_ofile(const char *binlog_name, RC &rc) {
         rc = RC::IOERR_OPEN;
     }
 }
+
+/******************************************************************************
+                     Binlog_fd_ofile
+******************************************************************************/
+Binlog_fd_ofile::Binlog_fd_ofile(const char *binlog_name, RC &rc) : m_file_name_(binlog_name)
+{
+  m_fd_ = ::open(binlog_name, O_WRONLY | O_CREAT | O_APPEND, 0644);
+  if (m_fd_ < 0) {
+    LOG_ERROR("open binlog file failed. filename=%s, error=%s", binlog_name, strerror(errno));
+    rc = RC::IOERR_OPEN;
+    return;
+  }
+  // 和 Binlog_ofile 一样，可能是继续写最后一个文件，position 从文件末尾开始
+  off_t end = ::lseek(m_fd_, 0, SEEK_END);
+  m_position_  = end < 0 ? 0 : static_cast<my_off_t>(end);
+  m_writeback_ = m_position_;
+  rc = RC::FILE_OPEN;
+}
+
+bool Binlog_fd_ofile::write(const uchar *buffer, my_off_t length)
+{
+  assert(m_fd_ >= 0);
+  while (length > 0) {
+    ssize_t n = ::write(m_fd_, buffer, length);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      LOG_ERROR("write binlog file failed. filename=%s, error=%s", m_file_name_.c_str(), strerror(errno));
+      return false;
+    }
+    buffer += n;
+    length -= n;
+    m_position_ += n;
+  }
+  return true;
+}
+
+bool Binlog_fd_ofile::writev(const struct iovec *iov, int iovcnt)
+{
+  assert(m_fd_ >= 0);
+  // 一次 writev 最多 IOV_MAX 段，且可能只写了一部分
+  std::vector<struct iovec> pending(iov, iov + iovcnt);
+  size_t                    first = 0;
+  while (first < pending.size()) {
+    int     cnt = static_cast<int>(std::min<size_t>(pending.size() - first, IOV_MAX));
+    ssize_t n   = ::writev(m_fd_, pending.data() + first, cnt);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      LOG_ERROR("writev binlog file failed. filename=%s, error=%s", m_file_name_.c_str(), strerror(errno));
+      return false;
+    }
+    m_position_ += n;
+    size_t written = static_cast<size_t>(n);
+    while (first < pending.size() && written >= pending[first].iov_len) {
+      written -= pending[first].iov_len;
+      first++;
+    }
+    if (written > 0) {
+      pending[first].iov_base = static_cast<char *>(pending[first].iov_base) + written;
+      pending[first].iov_len -= written;
+    }
+  }
+  return true;
+}
+
+RC Binlog_fd_ofile::seek(my_off_t position)
+{
+  assert(m_fd_ >= 0);
+  // O_APPEND 模式下 seek 只影响读，binlog 只会追加写，所以只允许 seek 到当前位置
+  return position == m_position_ ? RC::SUCCESS : RC::IOERR_SEEK;
+}
+
+RC Binlog_fd_ofile::sync()
+{
+  assert(m_fd_ >= 0);
+  if (::fdatasync(m_fd_) != 0) {
+    return RC::IOERR_SYNC;
+  }
+  m_writeback_ = m_position_;
+  return RC::SUCCESS;
+}
+
+RC Binlog_fd_ofile::start_writeback()
+{
+  assert(m_fd_ >= 0);
+  if (m_position_ == m_writeback_) {
+    return RC::SUCCESS;
+  }
+  off_t length = static_cast<off_t>(m_position_ - m_writeback_);
+  if (::sync_file_range(m_fd_, static_cast<off_t>(m_writeback_), length, SYNC_FILE_RANGE_WRITE) != 0) {
+    LOG_ERROR("sync_file_range binlog file failed. filename=%s, error=%s", m_file_name_.c_str(), strerror(errno));
+    return RC::IOERR_SYNC;
+  }
+  m_writeback_ = m_position_;
+  return RC::SUCCESS;
+}
+
+void Binlog_fd_ofile::close()
+{
+  if (m_fd_ >= 0) {
+    ::close(m_fd_);
+    m_fd_        = -1;
+    m_position_  = 0;
+    m_writeback_ = 0;
+  }
+}
+
+/******************************************************************************
+                     Binlog_mmap_ofile
+******************************************************************************/
+Binlog_mmap_ofile::Binlog_mmap_ofile(const char *binlog_name, my_off_t max_size, BinlogDurability durability, RC &rc)
+    : m_durability_(durability), m_file_name_(binlog_name)
+{
+  m_fd_ = ::open(binlog_name, O_RDWR | O_CREAT, 0644);
+  if (m_fd_ < 0) {
+    LOG_ERROR("open binlog file failed. filename=%s, error=%s", binlog_name, strerror(errno));
+    rc = RC::IOERR_OPEN;
+    return;
+  }
+
+  struct stat st;
+  if (fstat(m_fd_, &st) != 0) {
+    LOG_ERROR("stat binlog file failed. filename=%s, error=%s", binlog_name, strerror(errno));
+    rc = RC::IOERR_ACCESS;
+    close();
+    return;
+  }
+  // 可能是继续写最后一个文件，position 从已有内容的末尾开始，并且至少预留 WRITE_THRESHOLD 给 Rotate event
+  m_position_ = static_cast<my_off_t>(st.st_size);
+  m_synced_   = m_position_;
+  m_map_len_  = std::max<my_off_t>(max_size, m_position_ + WRITE_THRESHOLD);
+
+  m_map_ = map_file(m_fd_, m_map_len_, binlog_name);
+  if (m_map_ == nullptr) {
+    rc = RC::IOERR_OPEN;
+    ::ftruncate(m_fd_, static_cast<off_t>(m_position_));
+    close();
+    return;
+  }
+  rc = RC::FILE_OPEN;
+}
+
+bool Binlog_mmap_ofile::write(const uchar *buffer, my_off_t length)
+{
+  assert(m_map_ != nullptr);
+  if (m_position_ + length > m_map_len_) {
+    LOG_ERROR("binlog mmap region overflow. filename=%s, position=%llu, length=%llu, map_len=%llu",
+        m_file_name_.c_str(), m_position_, length, m_map_len_);
+    return false;
+  }
+  std::memcpy(m_map_ + m_position_, buffer, length);
+  m_position_ += length;
+  return true;
+}
+
+RC Binlog_mmap_ofile::seek(my_off_t position)
+{
+  if (position > m_map_len_) {
+    return RC::IOERR_SEEK;
+  }
+  m_position_ = position;
+  m_synced_   = std::min(m_synced_, position);
+  return RC::SUCCESS;
+}
+
+RC Binlog_mmap_ofile::msync_dirty(int flags)
+{
+  assert(m_map_ != nullptr);
+  if (msync_range(m_map_, m_synced_, m_position_, flags) != 0) {
+    LOG_ERROR("msync binlog file failed. filename=%s, error=%s", m_file_name_.c_str(), strerror(errno));
+    return RC::IOERR_SYNC;
+  }
+  // MS_ASYNC 只是启动回写，下次 sync 仍要覆盖这段区间
+  if (flags & MS_SYNC) {
+    m_synced_ = m_position_;
+  }
+  return RC::SUCCESS;
+}
+
+RC Binlog_mmap_ofile::sync() { return msync_dirty(MS_SYNC); }
+
+RC Binlog_mmap_ofile::flush()
+{
+  switch (m_durability_) {
+    case BinlogDurability::FLUSH: return msync_dirty(MS_ASYNC);
+    case BinlogDurability::SYNC: return msync_dirty(MS_SYNC);
+    default: return RC::SUCCESS;
+  }
+}
+
+void Binlog_mmap_ofile::close()
+{
+  if (m_map_ != nullptr) {
+    ::munmap(m_map_, m_map_len_);
+    m_map_ = nullptr;
+    // 去掉 fallocate 出来、没有写过的尾部
+    if (::ftruncate(m_fd_, static_cast<off_t>(m_position_)) != 0) {
+      LOG_ERROR("truncate binlog file failed. filename=%s, error=%s", m_file_name_.c_str(), strerror(errno));
+    }
+    if (m_durability_ != BinlogDurability::NONE) {
+      ::fdatasync(m_fd_);
+    }
+  }
+  if (m_fd_ >= 0) {
+    ::close(m_fd_);
+    m_fd_       = -1;
+    m_position_ = 0;
+    m_synced_   = 0;
+  }
+}
+
+/******************************************************************************
+                     Binlog_pfile
+******************************************************************************/
+Binlog_pfile::Binlog_pfile(const char *binlog_name, my_off_t prealloc_size, RC &rc, bool use_mmap)
+    : m_file_name_(binlog_name)
+{
+  m_fd_ = ::open(binlog_name, O_RDWR | O_CREAT, 0644);
+  if (m_fd_ < 0) {
+    LOG_ERROR("open binlog file failed. filename=%s, error=%s", binlog_name, strerror(errno));
+    rc = RC::IOERR_OPEN;
+    return;
+  }
+
+  struct stat st;
+  if (fstat(m_fd_, &st) != 0) {
+    LOG_ERROR("stat binlog file failed. filename=%s, error=%s", binlog_name, strerror(errno));
+    rc = RC::IOERR_ACCESS;
+    return;
+  }
+  m_initial_size_ = static_cast<my_off_t>(st.st_size);
+
+  if (use_mmap) {
+    m_map_len_ = std::max<my_off_t>(prealloc_size, m_initial_size_ + WRITE_THRESHOLD);
+    m_map_     = map_file(m_fd_, m_map_len_, binlog_name);
+    if (m_map_ == nullptr) {
+      rc = RC::IOERR_OPEN;
+      return;
+    }
+    rc = RC::SUCCESS;
+    return;
+  }
+
+  // 预分配失败（如 tmpfs 不支持）不影响正确性，只是退化为普通的稀疏写
+  if (prealloc_size > m_initial_size_) {
+    int ret = posix_fallocate(m_fd_, 0, static_cast<off_t>(prealloc_size));
+    if (ret != 0) {
+      LOG_DEBUG("fallocate binlog file failed, fallback to sparse write. filename=%s, error=%s",
+          binlog_name, strerror(ret));
+    }
+  }
+  rc = RC::SUCCESS;
+}
+
+Binlog_pfile::~Binlog_pfile()
+{
+  if (m_map_ != nullptr) {
+    ::munmap(m_map_, m_map_len_);
+    m_map_ = nullptr;
+  }
+  if (m_fd_ >= 0) {
+    ::close(m_fd_);
+    m_fd_ = -1;
+  }
+}
+
+bool Binlog_pfile::pwrite(const uchar *buffer, my_off_t length, my_off_t offset)
+{
+  assert(m_fd_ >= 0);
+  if (m_map_ != nullptr) {
+    if (offset + length > m_map_len_) {
+      LOG_ERROR("binlog mmap region overflow. filename=%s, offset=%llu, length=%llu", m_file_name_.c_str(), offset, length);
+      return false;
+    }
+    std::memcpy(m_map_ + offset, buffer, length);
+    return true;
+  }
+  while (length > 0) {
+    ssize_t n = ::pwrite(m_fd_, buffer, length, static_cast<off_t>(offset));
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      LOG_ERROR("pwrite binlog file failed. filename=%s, error=%s", m_file_name_.c_str(), strerror(errno));
+      return false;
+    }
+    buffer += n;
+    length -= n;
+    offset += n;
+  }
+  return true;
+}
+
+bool Binlog_pfile::pwritev(const struct iovec *iov, int iovcnt, my_off_t offset)
+{
+  assert(m_fd_ >= 0);
+  if (m_map_ != nullptr) {
+    for (int i = 0; i < iovcnt; ++i) {
+      if (!pwrite(static_cast<const uchar *>(iov[i].iov_base), iov[i].iov_len, offset)) {
+        return false;
+      }
+      offset += iov[i].iov_len;
+    }
+    return true;
+  }
+  // 一次 pwritev 最多 IOV_MAX 段，且可能只写了一部分，这里拷贝一份 iovec 方便推进
+  std::vector<struct iovec> pending(iov, iov + iovcnt);
+  size_t                    first = 0;
+  while (first < pending.size()) {
+    int     cnt = static_cast<int>(std::min<size_t>(pending.size() - first, IOV_MAX));
+    ssize_t n   = ::pwritev(m_fd_, pending.data() + first, cnt, static_cast<off_t>(offset));
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      LOG_ERROR("pwritev binlog file failed. filename=%s, error=%s", m_file_name_.c_str(), strerror(errno));
+      return false;
+    }
+    offset += n;
+    size_t written = static_cast<size_t>(n);
+    while (first < pending.size() && written >= pending[first].iov_len) {
+      written -= pending[first].iov_len;
+      first++;
+    }
+    if (written > 0) {
+      pending[first].iov_base = static_cast<char *>(pending[first].iov_base) + written;
+      pending[first].iov_len -= written;
+    }
+  }
+  return true;
+}
+
+RC Binlog_pfile::sync()
+{
+  assert(m_fd_ >= 0);
+  if (m_map_ != nullptr && ::msync(m_map_, m_map_len_, MS_SYNC) != 0) {
+    return RC::IOERR_SYNC;
+  }
+  return ::fdatasync(m_fd_) == 0 ? RC::SUCCESS : RC::IOERR_SYNC;
+}
+
+RC Binlog_pfile::sync_range(my_off_t offset, my_off_t length, BinlogDurability durability)
+{
+  assert(m_fd_ >= 0);
+  if (durability == BinlogDurability::NONE || length == 0) {
+    return RC::SUCCESS;
+  }
+
+  int ret;
+  if (m_map_ != nullptr) {
+    ret = msync_range(m_map_, offset, offset + length, durability == BinlogDurability::SYNC ? MS_SYNC : MS_ASYNC);
+  } else if (durability == BinlogDurability::SYNC) {
+    ret = ::fdatasync(m_fd_);
+  } else {
+    ret = ::sync_file_range(m_fd_, static_cast<off_t>(offset), static_cast<off_t>(length), SYNC_FILE_RANGE_WRITE);
+  }
+  if (ret != 0) {
+    LOG_ERROR("sync binlog range failed. filename=%s, offset=%llu, error=%s", m_file_name_.c_str(), offset, strerror(errno));
+    return RC::IOERR_SYNC;
+  }
+  return RC::SUCCESS;
+}
+
+RC Binlog_pfile::close(my_off_t final_size)
+{
+  if (m_fd_ < 0) {
+    return RC::FILE_NOT_OPENED;
+  }
+
+  // 解除映射后脏页仍在 page cache 里，下面的 fdatasync 会把它们刷下去
+  if (m_map_ != nullptr) {
+    ::munmap(m_map_, m_map_len_);
+    m_map_ = nullptr;
+  }
+
+  RC rc = RC::SUCCESS;
+  if (::ftruncate(m_fd_, static_cast<off_t>(final_size)) != 0) {
+    LOG_ERROR("truncate binlog file failed. filename=%s, error=%s", m_file_name_.c_str(), strerror(errno));
+    rc = RC::IOERR_WRITE;
+  }
+  if (::fdatasync(m_fd_) != 0) {
+    LOG_ERROR("sync binlog file failed. filename=%s, error=%s", m_file_name_.c_str(), strerror(errno));
+    rc = RC::IOERR_SYNC;
+  }
+  ::close(m_fd_);
+  m_fd_ = -1;
+  return rc;
+}
@@ -2,11 +2,15 @@
 // Created by Coonger on 2024/10/17.
 //
 #include "binlog.h"
+#include "uring_ostream.h"
 
-MYSQL_BIN_LOG::MYSQL_BIN_LOG(const char *file_name, uint64_t file_size, RC &rc)
+MYSQL_BIN_LOG::MYSQL_BIN_LOG(const char *file_name, uint64_t file_size, RC &rc, BinlogBackend backend,
+    BinlogDurability durability)
     : max_size_(file_size)
     , atomic_log_state_(LOG_CLOSED)
-    , bytes_written_(0) {
+    , bytes_written_(0)
+    , backend_(backend)
+    , durability_(durability) {
     LOFT_ASSERT(file_name, "file_name is null");
 
     std::strncpy(file_name_, file_name, FN_REFLEN - 1);
@@ -19,7 +23,32 @@ RC MYSQL_BIN_LOG::open() {
     // Step 1: 打开文件流
 
     RC ret;
-    m_binlog_file_ = std::make_unique<Binlog_ofile>(file_name_, ret);
+    switch (backend_) {
+        case BinlogBackend::MMAP:
+            m_binlog_file_ = std::make_unique<Binlog_mmap_ofile>(file_name_, max_size_, durability_, ret);
+            if (ret != RC::IOERR_OPEN) {
+                break;
+            }
+            LOG_INFO("mmap backend unavailable, fallback to fd backend. filename=%s", file_name_);
+            backend_ = BinlogBackend::FD;
+            m_binlog_file_ = std::make_unique<Binlog_fd_ofile>(file_name_, ret);
+            break;
+        case BinlogBackend::IO_URING:
+            m_binlog_file_ = std::make_unique<Binlog_uring_ofile>(file_name_, ret);
+            if (ret != RC::IOERR_OPEN) {
+                break;
+            }
+            // 内核不支持 io_uring 或注册缓冲区失败，回退到 fd 后端
+            LOG_INFO("io_uring backend unavailable, fallback to fd backend. filename=%s", file_name_);
+            backend_ = BinlogBackend::FD;
+            [[fallthrough]];
+        case BinlogBackend::FD:
+            m_binlog_file_ = std::make_unique<Binlog_fd_ofile>(file_name_, ret);
+            break;
+        default:
+            m_binlog_file_ = std::make_unique<Binlog_ofile>(file_name_, ret);
+            break;
+    }
 
     if (ret == RC::IOERR_OPEN) {
         atomic_log_state_ = LOG_CLOSED;
@@ -60,6 +89,25 @@ RC MYSQL_BIN_LOG::close() {
     return RC::SUCCESS;
 }
 
+RC MYSQL_BIN_LOG::flush() {
+    RC rc = m_binlog_file_->flush();
+    // mmap 后端在 flush() 里自己按策略 msync；其他后端 SYNC 等待落盘，FLUSH 只启动回写
+    if (LOFT_FAIL(rc) || backend_ == BinlogBackend::MMAP) {
+        return rc;
+    }
+    if (durability_ == BinlogDurability::SYNC) {
+        rc = m_binlog_file_->sync();
+    } else if (durability_ == BinlogDurability::FLUSH) {
+        rc = m_binlog_file_->start_writeback();
+    }
+    return rc;
+}
+
+RC MYSQL_BIN_LOG::sync() {
+    RC rc = m_binlog_file_->flush();
+    return LOFT_SUCC(rc) ? m_binlog_file_->sync() : rc;
+}
+
 bool MYSQL_BIN_LOG::write_event_to_binlog(AbstractEvent *ev) {
     return ev->write(this->m_binlog_file_.get());
 }
@@ -0,0 +1,73 @@
+//
+// Created by Coonger on 2024/12/18.
+//
+
+#include "binlog_inspect.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include "common/init_setting.h"
+#include "common/mysql_constant_def.h"
+#include "common/type_def.h"
+#include "events/abstract_event.h"
+
+namespace loft {
+
+std::filesystem::path make_temp_dir(const char *prefix)
+{
+  std::string tmpl = std::string("/tmp/") + prefix + "-XXXXXX";
+  if (mkdtemp(tmpl.data()) == nullptr) {
+    return {};
+  }
+  return tmpl;
+}
+
+std::vector<std::filesystem::path> binlog_files(const std::filesystem::path &dir)
+{
+  std::vector<std::filesystem::path> files;
+  for (const auto &entry : std::filesystem::directory_iterator(dir)) {
+    std::string name = entry.path().filename().string();
+    if (entry.is_regular_file() && name.rfind(DEFAULT_BINLOG_FILE_NAME_PREFIX, 0) == 0 &&
+        entry.path().extension() != ".index") {
+      files.push_back(entry.path());
+    }
+  }
+  std::sort(files.begin(), files.end());
+  return files;
+}
+
+std::vector<char> read_file(const std::filesystem::path &path)
+{
+  std::ifstream in(path, std::ios::binary);
+  return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+void normalize_binlog(std::vector<char> &data)
+{
+  size_t offset = BINLOG_MAGIC_SIZE;
+  while (offset + LOG_EVENT_HEADER_LEN <= data.size()) {
+    uint32 len = 0;
+    memcpy(&len, data.data() + offset + EVENT_LEN_OFFSET, sizeof(len));
+    if (len < LOG_EVENT_HEADER_LEN || offset + len > data.size()) {
+      return;
+    }
+    auto type = static_cast<uint8>(data[offset + EVENT_TYPE_OFFSET]);
+    if (type == FORMAT_DESCRIPTION_EVENT || type == ROTATE_EVENT) {
+      memset(data.data() + offset, 0, 4);
+    }
+    if (type == FORMAT_DESCRIPTION_EVENT) {
+      size_t created = offset + LOG_EVENT_HEADER_LEN + ST_CREATED_OFFSET;
+      if (created + 4 <= offset + len) {
+        memset(data.data() + created, 0, 4);
+      }
+    }
+    offset += len;
+  }
+}
+
+}  // namespace loft
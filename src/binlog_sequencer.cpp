@@ -0,0 +1,266 @@
+//
+// Created by Coonger on 2024/12/2.
+//
+
+#include "binlog_sequencer.h"
+
+#include "events/control_events.h"
+
+BinlogSequencer::BinlogSequencer(LogFileManager *manager) : manager_(manager) {}
+
+BinlogSequencer::~BinlogSequencer()
+{
+  drain();
+  close();
+}
+
+RC BinlogSequencer::attach()
+{
+  BinLogFileWriter *writer = manager_->get_file_writer();
+  if (writer->get_binlog() != nullptr) {
+    // 外部已经通过 last_file()/next_file() 打开了文件：关闭文件流，从它当前的位置继续写
+    std::string file_path = writer->filename();
+    writer->close();
+    return open_file(manager_->get_last_file_no(), file_path.c_str(), false);
+  }
+
+  auto &log_files = manager_->get_log_files();
+  if (!log_files.empty()) {
+    auto last = log_files.rbegin();
+    return open_file(last->first, last->second.c_str(), false);
+  }
+
+  uint32                fileno = 0;
+  std::string           filename;
+  std::filesystem::path file_path;
+  manager_->next_file_name(fileno, filename, file_path);
+  manager_->register_file(fileno, filename, file_path);
+  return open_file(fileno, file_path.c_str(), true);
+}
+
+RC BinlogSequencer::open_file(uint32 file_no, const char *file_path, bool write_header)
+{
+  RC   rc;
+  bool use_mmap = manager_->options_.backend == BinlogBackend::MMAP;
+  auto file     = std::make_unique<Binlog_pfile>(file_path, manager_->get_file_max_size(), rc, use_mmap);
+  if (LOFT_FAIL(rc)) {
+    LOG_ERROR("open binlog file for parallel write failed. filename=%s", file_path);
+    return rc;
+  }
+
+  my_off_t position = file->initial_size();
+  if (write_header || position == 0) {
+    // 新文件：先写 magic number 和 fde，和 MYSQL_BIN_LOG::open() 写出的内容一致
+    Memory_ostream header;
+    header.write(reinterpret_cast<const uchar *>(BINLOG_MAGIC), BIN_LOG_HEADER_SIZE);
+    auto fde = std::make_unique<Format_description_event>(BINLOG_VERSION, SERVER_VERSION_STR);
+    fde->write(&header);
+    if (!file->pwrite(header.buffer().data(), header.buffer().size(), 0)) {
+      return RC::IOERR_WRITE;
+    }
+    position = header.buffer().size();
+  }
+
+  current_          = std::make_shared<OutputFile>();
+  current_->file_no = file_no;
+  current_->file    = std::move(file);
+  position_         = position;
+  return RC::SUCCESS;
+}
+
+RC BinlogSequencer::rotate(const std::string &checkpoint)
+{
+  TraceSpan span("rotate", "writer");
+
+  // 和 ResultQueue::process_writes 一致：放不下的这条 event 的 ckp 记到旧文件上
+  manager_->update_checkpoint(current_->file_no, checkpoint);
+
+  uint32                fileno = 0;
+  std::string           filename;
+  std::filesystem::path file_path;
+  manager_->next_file_name(fileno, filename, file_path);
+
+  // 在旧文件的末尾写 rotate event，它一定落在预留的 WRITE_THRESHOLD 里
+  Memory_ostream rotate_buf(position_);
+  auto rotate_event = std::make_unique<Rotate_event>(filename, filename.length(), Rotate_event::DUP_NAME, 4);
+  rotate_event->write(&rotate_buf);
+  if (!current_->file->pwrite(rotate_buf.buffer().data(), rotate_buf.buffer().size(), position_)) {
+    return RC::IOERR_WRITE;
+  }
+
+  // 释放定序器对旧文件的引用，在途写任务都完成后由最后一个 worker 封存
+  current_->end_pos = position_ + rotate_buf.buffer().size();
+  auto old_file     = std::move(current_);
+  release(old_file);
+
+  manager_->register_file(fileno, filename, file_path);
+  return open_file(fileno, file_path.c_str(), true);
+}
+
+void BinlogSequencer::finish_unwritten(LogFileManager::BatchResult &result, RC rc)
+{
+  manager_->replication_lag_->complete(result.sequence, rc, false);
+  result.finish(rc);
+  manager_->memory_budget_.release(result.budget_bytes);
+}
+
+RC BinlogSequencer::dispatch(std::unique_ptr<LogFileManager::BatchResult> result)
+{
+  RC failure = status();
+  if (LOFT_FAIL(failure)) {
+    finish_unwritten(*result, failure);
+    return failure;
+  }
+
+  if (!attached_) {
+    RC rc = attach();
+    if (LOFT_FAIL(rc)) {
+      finish_unwritten(*result, rc);
+      return rc;
+    }
+    attached_ = true;
+  }
+
+  // 1. 前缀和：只读每条 event 的长度，确定它落在哪个文件的哪个 offset
+  const size_t         max_size = manager_->get_file_max_size();
+  std::vector<Segment> segments;
+  Segment              segment{current_, position_, 0, 0};
+
+  // 每个涉及到的文件都要被这个写任务引用，保证封存发生在写完之后。
+  // 引用必须在 rotate() 释放定序器自己的引用之前加上，否则没有在途写任务时旧文件会被立刻封存
+  auto add_segment = [&segments](const Segment &seg) {
+    if (seg.end > seg.begin) {
+      seg.file->refs.fetch_add(1, std::memory_order_relaxed);
+      segments.push_back(seg);
+    }
+  };
+
+  auto &events = result->transformed_data;
+  for (size_t i = 0; i < events.size(); ++i) {
+    uint32 event_len = static_cast<uint32>(events[i].size());
+    // 等价于 MYSQL_BIN_LOG::remain_bytes_safe()
+    if (!(position_ + event_len + WRITE_THRESHOLD < max_size)) {
+      segment.end = i;
+      add_segment(segment);
+      auto rotate_start = std::chrono::steady_clock::now();
+      RC   rc           = rotate(result->ckps[i]);
+      manager_->metric_rotate_time_->record_duration(std::chrono::steady_clock::now() - rotate_start);
+      if (LOFT_FAIL(rc)) {
+        LOG_ERROR("rotate binlog file failed. rc=%s", strrc(rc));
+        for (auto &seg : segments) {
+          release(seg.file);
+        }
+        RC expected = RC::SUCCESS;
+        failure_.compare_exchange_strong(expected, rc, std::memory_order_acq_rel);
+        finish_unwritten(*result, rc);
+        return rc;
+      }
+      segment = Segment{current_, position_, i, i};
+    }
+    position_ += event_len;
+  }
+  segment.end = events.size();
+  add_segment(segment);
+
+  if (segments.empty()) {
+    finish_unwritten(*result, RC::SUCCESS);
+    return RC::SUCCESS;
+  }
+
+  // 2. 投递给 worker：填充 log_pos + pwritev
+  {
+    std::lock_guard<std::mutex> lock(inflight_mutex_);
+    inflight_jobs_++;
+  }
+
+  auto batch = std::shared_ptr<LogFileManager::BatchResult>(std::move(result));
+  auto job   = [this, batch, segments = std::move(segments)] { write_segments(batch.get(), segments); };
+  if (manager_->thread_pool_->execute(job) != 0) {
+    // 线程池已经关闭，就地执行，保证不丢数据
+    job();
+  }
+  return RC::SUCCESS;
+}
+
+void BinlogSequencer::write_segments(LogFileManager::BatchResult *result, const std::vector<Segment> &segments)
+{
+  TraceSpan       span("write_segments", "writer", static_cast<int64>(result->sequence));
+  AllocStageScope alloc_stage(AllocStage::WRITER);
+
+  // 有批量提交在等这个 batch 时，不论落盘策略都要等到落盘再通知
+  const BinlogDurability durability =
+      result->completions.empty() ? manager_->options_.durability : BinlogDurability::SYNC;
+  RC write_rc = RC::SUCCESS;
+
+  auto &events = result->transformed_data;
+  for (const auto &seg : segments) {
+    std::vector<struct iovec> iov;
+    iov.reserve(seg.end - seg.begin);
+
+    my_off_t pos = seg.offset;
+    for (size_t i = seg.begin; i < seg.end; ++i) {
+      auto &data = events[i];
+      pos += data.size();
+      int4store(data.header() + LOG_POS_OFFSET, static_cast<uint32>(pos));
+      data.append_to(iov);
+    }
+
+    if (!seg.file->file->pwritev(iov.data(), static_cast<int>(iov.size()), seg.offset)) {
+      LOG_ERROR("parallel binlog write failed. file_no=%u, offset=%llu", seg.file->file_no, seg.offset);
+      write_rc = RC::IOERR_WRITE;
+    }
+    auto sync_start = std::chrono::steady_clock::now();
+    RC   sync_rc    = seg.file->file->sync_range(seg.offset, pos - seg.offset, durability);
+    auto sync_end   = std::chrono::steady_clock::now();
+    manager_->metric_sync_time_->record_duration(sync_end - sync_start);
+    Tracer::instance().record("sync", "writer", Tracer::ns_of(sync_start), Tracer::ns_of(sync_end),
+        static_cast<int64>(result->sequence));
+    if (LOFT_SUCC(write_rc) && LOFT_FAIL(sync_rc)) {
+      write_rc = sync_rc;
+    }
+    release(seg.file);
+  }
+
+  if (LOFT_FAIL(write_rc)) {
+    // 只记第一次失败，之后的 batch 在 dispatch 里直接失败
+    RC expected = RC::SUCCESS;
+    failure_.compare_exchange_strong(expected, write_rc, std::memory_order_acq_rel);
+  } else {
+    manager_->written_tasks_ += events.size();
+  }
+  manager_->replication_lag_->complete(result->sequence, write_rc, durability == BinlogDurability::SYNC);
+  result->finish(write_rc);
+  manager_->memory_budget_.release(result->budget_bytes);
+
+  std::lock_guard<std::mutex> lock(inflight_mutex_);
+  if (--inflight_jobs_ == 0) {
+    inflight_cv_.notify_all();
+  }
+}
+
+void BinlogSequencer::release(const std::shared_ptr<OutputFile> &file)
+{
+  if (file->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    RC rc = file->file->close(file->end_pos);
+    if (LOFT_FAIL(rc)) {
+      LOG_ERROR("seal binlog file failed. file_no=%u, rc=%s", file->file_no, strrc(rc));
+    }
+  }
+}
+
+void BinlogSequencer::drain()
+{
+  std::unique_lock<std::mutex> lock(inflight_mutex_);
+  inflight_cv_.wait(lock, [this] { return inflight_jobs_ == 0; });
+}
+
+RC BinlogSequencer::close()
+{
+  if (current_ == nullptr) {
+    return RC::FILE_NOT_OPENED;
+  }
+  current_->end_pos = position_;
+  auto file         = std::move(current_);
+  release(file);
+  return RC::SUCCESS;
+}
@@ -0,0 +1,84 @@
+//
+// Created by Coonger on 2024/12/14.
+//
+
+#include "common/adaptive_batcher.h"
+
+#include <algorithm>
+
+namespace common {
+
+namespace {
+// 滑动平均里新样本的权重
+constexpr double EWMA_ALPHA = 0.2;
+// 速率的观测窗口太短时误差很大，攒够这么久再算一次
+constexpr auto MIN_OBSERVE_INTERVAL = std::chrono::microseconds(200);
+}  // namespace
+
+AdaptiveBatcher::AdaptiveBatcher(size_t min_batch, size_t max_batch, std::chrono::microseconds max_latency)
+    : min_batch_(std::max<size_t>(min_batch, 1)),
+      max_batch_(std::max(max_batch, std::max<size_t>(min_batch, 1))),
+      max_latency_(max_latency),
+      target_(max_batch_)
+{}
+
+void AdaptiveBatcher::observe_arrivals(uint64 total_arrivals, Clock::time_point now)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!observed_) {
+    observed_      = true;
+    last_arrivals_ = total_arrivals;
+    last_observe_  = now;
+    return;
+  }
+
+  auto interval = now - last_observe_;
+  if (interval < MIN_OBSERVE_INTERVAL) {
+    return;
+  }
+  double seconds = std::chrono::duration<double>(interval).count();
+  double sample  = static_cast<double>(total_arrivals - last_arrivals_) / seconds;
+  rate_          = rate_ == 0 ? sample : rate_ + EWMA_ALPHA * (sample - rate_);
+
+  last_arrivals_ = total_arrivals;
+  last_observe_  = now;
+  update_target();
+}
+
+void AdaptiveBatcher::record_batch(size_t records, std::chrono::nanoseconds elapsed)
+{
+  if (records == 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  double sample  = std::chrono::duration<double, std::micro>(elapsed).count();
+  batch_time_us_ = batch_time_us_ == 0 ? sample : batch_time_us_ + EWMA_ALPHA * (sample - batch_time_us_);
+  update_target();
+}
+
+void AdaptiveBatcher::update_target()
+{
+  if (rate_ == 0) {
+    return;
+  }
+  double window_us = static_cast<double>(max_latency_.count());
+  if (batch_time_us_ > 0) {
+    window_us = std::min(window_us, batch_time_us_);
+  }
+  double target = rate_ * window_us / 1e6;
+  target_.store(std::clamp(static_cast<size_t>(target), min_batch_, max_batch_), std::memory_order_relaxed);
+}
+
+double AdaptiveBatcher::arrival_rate() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return rate_;
+}
+
+double AdaptiveBatcher::batch_time_us() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return batch_time_us_;
+}
+
+}  // namespace common
@@ -0,0 +1,126 @@
+//
+// Created by Coonger on 2024/12/18.
+//
+
+#include "common/alloc_accounting.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace common {
+
+namespace {
+
+struct alignas(64) StageCounters
+{
+  std::atomic<uint64> allocated_bytes{0};
+  std::atomic<uint64> allocations{0};
+  std::atomic<int64>  live_bytes{0};
+  std::atomic<int64>  peak_bytes{0};
+};
+
+// 常量初始化，比任何静态对象的构造都早，静态初始化阶段的分配也能记上
+StageCounters g_stages[static_cast<size_t>(AllocStage::COUNT)];
+
+const char *const STAGE_NAMES[] = {"other", "ingest", "schema", "event", "result", "writer"};
+static_assert(sizeof(STAGE_NAMES) / sizeof(STAGE_NAMES[0]) == static_cast<size_t>(AllocStage::COUNT));
+
+}  // namespace
+
+const char *alloc_stage_name(AllocStage stage)
+{
+  return stage < AllocStage::COUNT ? STAGE_NAMES[static_cast<size_t>(stage)] : "unknown";
+}
+
+AllocStats alloc_stats(AllocStage stage)
+{
+  AllocStats stats;
+  if (stage >= AllocStage::COUNT) {
+    return stats;
+  }
+  const StageCounters &c = g_stages[static_cast<size_t>(stage)];
+  stats.allocated_bytes  = c.allocated_bytes.load(std::memory_order_relaxed);
+  stats.allocations      = c.allocations.load(std::memory_order_relaxed);
+  stats.live_bytes       = c.live_bytes.load(std::memory_order_relaxed);
+  stats.peak_bytes       = c.peak_bytes.load(std::memory_order_relaxed);
+  return stats;
+}
+
+}  // namespace common
+
+#ifdef LOFT_ALLOC_ACCOUNTING
+
+namespace {
+
+using common::AllocStage;
+
+/// 放在每块内存前面，16 字节保证返回的地址仍然满足 __STDCPP_DEFAULT_NEW_ALIGNMENT__
+struct alignas(16) AllocHeader
+{
+  uint64     size;
+  AllocStage stage;
+};
+static_assert(sizeof(AllocHeader) == 16);
+
+void *accounted_alloc(size_t size)
+{
+  auto *header = static_cast<AllocHeader *>(std::malloc(sizeof(AllocHeader) + size));
+  if (header == nullptr) {
+    return nullptr;
+  }
+  AllocStage stage = common::detail::current_alloc_stage();
+  header->size     = size;
+  header->stage    = stage;
+
+  auto &c = common::g_stages[static_cast<size_t>(stage)];
+  c.allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+  c.allocations.fetch_add(1, std::memory_order_relaxed);
+  int64 live = c.live_bytes.fetch_add(static_cast<int64>(size), std::memory_order_relaxed) + static_cast<int64>(size);
+  int64 peak = c.peak_bytes.load(std::memory_order_relaxed);
+  while (live > peak && !c.peak_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+  }
+  return header + 1;
+}
+
+void accounted_free(void *ptr)
+{
+  if (ptr == nullptr) {
+    return;
+  }
+  auto *header = static_cast<AllocHeader *>(ptr) - 1;
+  common::g_stages[static_cast<size_t>(header->stage)].live_bytes.fetch_sub(
+      static_cast<int64>(header->size), std::memory_order_relaxed);
+  std::free(header);
+}
+
+void *throwing_alloc(size_t size)
+{
+  while (true) {
+    void *ptr = accounted_alloc(size);
+    if (ptr != nullptr) {
+      return ptr;
+    }
+    std::new_handler handler = std::get_new_handler();
+    if (handler == nullptr) {
+      throw std::bad_alloc();
+    }
+    handler();
+  }
+}
+
+}  // namespace
+
+void *operator new(size_t size) { return throwing_alloc(size); }
+void *operator new[](size_t size) { return throwing_alloc(size); }
+void *operator new(size_t size, const std::nothrow_t &) noexcept { return accounted_alloc(size); }
+void *operator new[](size_t size, const std::nothrow_t &) noexcept { return accounted_alloc(size); }
+
+void operator delete(void *ptr) noexcept { accounted_free(ptr); }
+void operator delete[](void *ptr) noexcept { accounted_free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { accounted_free(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { accounted_free(ptr); }
+void operator delete(void *ptr, const std::nothrow_t &) noexcept { accounted_free(ptr); }
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept { accounted_free(ptr); }
+
+#endif  // LOFT_ALLOC_ACCOUNTING
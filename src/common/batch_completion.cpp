@@ -0,0 +1,67 @@
+//
+// Created by Coonger on 2024/12/10.
+//
+
+#include "common/batch_completion.h"
+
+namespace common {
+
+BatchCompletion::BatchCompletion(size_t records, Callback callback)
+    : remaining_(records), callback_(std::move(callback))
+{}
+
+RC BatchCompletion::wait()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  cv_.wait(lock, [this] { return remaining_ == 0; });
+  return rc_;
+}
+
+bool BatchCompletion::wait_for(std::chrono::milliseconds timeout)
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  return cv_.wait_for(lock, timeout, [this] { return remaining_ == 0; });
+}
+
+bool BatchCompletion::done() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return remaining_ == 0;
+}
+
+RC BatchCompletion::status() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return rc_;
+}
+
+size_t BatchCompletion::remaining() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return remaining_;
+}
+
+void BatchCompletion::finish(size_t count, RC rc)
+{
+  Callback callback;
+  RC       result;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (rc != RC::SUCCESS && rc_ == RC::SUCCESS) {
+      rc_ = rc;
+    }
+    remaining_ = count >= remaining_ ? 0 : remaining_ - count;
+    if (remaining_ != 0) {
+      return;
+    }
+    callback = std::move(callback_);
+    result   = rc_;
+  }
+  cv_.notify_all();
+  // 在锁外回调，回调里可以再查询这个句柄
+  if (callback) {
+    callback(result);
+  }
+}
+
+}  // namespace common
@@ -0,0 +1,97 @@
+//
+// Created by Coonger on 2024/12/15.
+//
+
+#include "common/concurrency_controller.h"
+
+#include <algorithm>
+
+namespace common {
+
+namespace {
+// 吞吐变化在这个比例以内视为持平，避免被抖动带着来回走
+constexpr double TOLERANCE = 0.05;
+}  // namespace
+
+ConcurrencyController::ConcurrencyController(int min_workers, int max_workers, std::chrono::milliseconds interval)
+    : min_workers_(std::max(min_workers, 1)),
+      max_workers_(std::max(max_workers, std::max(min_workers, 1))),
+      interval_(interval),
+      limit_(min_workers_)
+{}
+
+bool ConcurrencyController::update(uint64 completed, uint64 unwritten, Clock::time_point now)
+{
+  if (!started_) {
+    started_        = true;
+    last_sample_    = now;
+    last_completed_ = completed;
+    last_unwritten_ = unwritten;
+    return false;
+  }
+  if (now - last_sample_ < interval_) {
+    return false;
+  }
+
+  double seconds      = std::chrono::duration<double>(now - last_sample_).count();
+  uint64 processed    = completed - last_completed_;
+  double throughput   = static_cast<double>(processed) / seconds;
+  int    limit        = limit_.load(std::memory_order_relaxed);
+  bool   writer_bound = unwritten > last_unwritten_ && unwritten > static_cast<uint64>(limit);
+  bool   backlog      = backlog_;
+
+  throughput_.store(throughput, std::memory_order_relaxed);
+  worker_throughput_.store(throughput / limit, std::memory_order_relaxed);
+  last_sample_    = now;
+  last_completed_ = completed;
+  last_unwritten_ = unwritten;
+  backlog_        = false;
+
+  int direction = 0;
+  int next      = 0;
+  if (writer_bound) {
+    direction = -1;
+    baseline_ = 0;
+  } else if (!backlog) {
+    baseline_ = 0;
+    return false;
+  } else if (baseline_ == 0) {
+    // 没有基线：刚启动、或者刚从空闲 / 写瓶颈恢复，往上试探一步，不沿用空闲前翻倍的步长
+    direction = 1;
+    step_     = 1;
+    baseline_ = throughput;
+  } else {
+    double gain = (throughput - baseline_) / baseline_;
+    if (gain > TOLERANCE) {
+      direction = direction_;
+      step_ *= 2;
+    } else if (gain < -TOLERANCE) {
+      direction = -direction_;
+    } else if (direction_ > 0 && previous_limit_ < limit) {
+      // 上一步加的线程没有带来吞吐，直接退回加之前的并发度，步长翻倍时不用一个一个往回减
+      direction = -1;
+      next      = previous_limit_;
+    } else {
+      direction = limit == min_workers_ ? 1 : -1;
+    }
+    baseline_ = throughput;
+  }
+
+  if (direction != direction_ || writer_bound) {
+    step_ = 1;
+  }
+  step_      = std::min(step_, std::max((max_workers_ - min_workers_) / 4, 1));
+  direction_ = direction;
+
+  if (next == 0) {
+    next = std::clamp(limit + direction * step_, min_workers_, max_workers_);
+  }
+  previous_limit_ = limit;
+  if (next == limit) {
+    return false;
+  }
+  limit_.store(next, std::memory_order_relaxed);
+  return true;
+}
+
+}  // namespace common
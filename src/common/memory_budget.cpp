@@ -0,0 +1,73 @@
+//
+// Created by Coonger on 2024/12/7.
+//
+
+#include "common/memory_budget.h"
+
+namespace common {
+
+bool MemoryBudget::admissible(size_t bytes) const
+{
+  size_t used = used_.load(std::memory_order_relaxed);
+  return capacity_ == 0 || used + bytes <= capacity_ || used == 0;
+}
+
+void MemoryBudget::add_locked(size_t bytes)
+{
+  size_t used = used_.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+  size_t peak = peak_.load(std::memory_order_relaxed);
+  while (used > peak && !peak_.compare_exchange_weak(peak, used, std::memory_order_relaxed)) {}
+}
+
+bool MemoryBudget::acquire(size_t bytes, std::chrono::milliseconds timeout)
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (!closed_ && !admissible(bytes)) {
+    stalls_.fetch_add(1, std::memory_order_relaxed);
+    cv_.wait_for(lock, timeout, [this, bytes] { return closed_ || admissible(bytes); });
+  }
+  if (closed_ || !admissible(bytes)) {
+    return false;
+  }
+  add_locked(bytes);
+  return true;
+}
+
+bool MemoryBudget::try_acquire(size_t bytes)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (closed_ || !admissible(bytes)) {
+    return false;
+  }
+  add_locked(bytes);
+  return true;
+}
+
+void MemoryBudget::force_acquire(size_t bytes)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  add_locked(bytes);
+}
+
+void MemoryBudget::release(size_t bytes)
+{
+  if (bytes == 0) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    used_.fetch_sub(bytes, std::memory_order_relaxed);
+  }
+  cv_.notify_all();
+}
+
+void MemoryBudget::close()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closed_ = true;
+  }
+  cv_.notify_all();
+}
+
+}  // namespace common
@@ -0,0 +1,334 @@
+//
+// Created by Coonger on 2024/12/17.
+//
+
+#include "common/metrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+
+#include "common/logging.h"
+
+namespace common {
+
+namespace {
+
+std::string escape(const std::string &text, bool quote)
+{
+  std::string escaped;
+  escaped.reserve(text.size());
+  for (char c : text) {
+    if (c == '\\') {
+      escaped += "\\\\";
+    } else if (c == '\n') {
+      escaped += "\\n";
+    } else if (c == '"' && quote) {
+      escaped += "\\\"";
+    } else {
+      escaped += c;
+    }
+  }
+  return escaped;
+}
+
+std::string format_labels(const MetricLabels &labels)
+{
+  std::string body;
+  for (const auto &[key, value] : labels) {
+    if (!body.empty()) {
+      body += ',';
+    }
+    body += key + "=\"" + escape(value, true) + "\"";
+  }
+  return body;
+}
+
+std::string format_number(double value)
+{
+  if (std::isinf(value)) {
+    return value > 0 ? "+Inf" : "-Inf";
+  }
+  if (std::isnan(value)) {
+    return "NaN";
+  }
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%.10g", value);
+  return buf;
+}
+
+/// name{body} 或 name{body,extra}，两者都为空时不输出括号
+std::string series(const std::string &name, const std::string &body, const std::string &extra = "")
+{
+  if (body.empty() && extra.empty()) {
+    return name;
+  }
+  if (body.empty() || extra.empty()) {
+    return name + "{" + body + extra + "}";
+  }
+  return name + "{" + body + "," + extra + "}";
+}
+
+const char *type_name(MetricType type)
+{
+  switch (type) {
+    case MetricType::COUNTER: return "counter";
+    case MetricType::GAUGE: return "gauge";
+    case MetricType::HISTOGRAM: return "histogram";
+  }
+  return "untyped";
+}
+
+}  // namespace
+
+/******************************************************************************
+                     Histogram
+******************************************************************************/
+
+size_t Histogram::bucket_of(uint64 value)
+{
+  if (value < SUB_BUCKETS) {
+    return static_cast<size_t>(value);
+  }
+  int    exponent = 63 - __builtin_clzll(value);  // >= SUB_BUCKET_BITS
+  int    shift    = exponent - SUB_BUCKET_BITS;
+  uint64 sub      = (value >> shift) - SUB_BUCKETS;  // [0, SUB_BUCKETS)
+  return static_cast<size_t>(SUB_BUCKETS + shift * SUB_BUCKETS + sub);
+}
+
+uint64 Histogram::bucket_upper(size_t bucket)
+{
+  if (bucket < SUB_BUCKETS) {
+    return bucket + 1;
+  }
+  size_t shift = (bucket - SUB_BUCKETS) / SUB_BUCKETS;
+  uint64 sub   = (bucket - SUB_BUCKETS) % SUB_BUCKETS;
+  if (shift + SUB_BUCKET_BITS + 1 >= 64 && sub == SUB_BUCKETS - 1) {
+    return std::numeric_limits<uint64>::max();  // 最后一个桶的上界是 2^64
+  }
+  return (SUB_BUCKETS + sub + 1) << shift;
+}
+
+uint64 Histogram::percentile(double q) const
+{
+  uint64 total = count();
+  if (total == 0) {
+    return 0;
+  }
+  auto   rank       = static_cast<uint64>(std::ceil(q * static_cast<double>(total)));
+  uint64 cumulative = 0;
+  for (size_t i = 0; i < BUCKETS; i++) {
+    cumulative += buckets_[i].load(std::memory_order_relaxed);
+    if (cumulative >= std::max<uint64>(rank, 1)) {
+      return bucket_upper(i) - 1;
+    }
+  }
+  // 并发 record 时 count_ 可能比各桶之和先增加
+  return bucket_upper(BUCKETS - 1) - 1;
+}
+
+uint64 Histogram::count_below_power(int exponent) const
+{
+  // 2^exponent 正好是某个桶的上界
+  size_t last = exponent <= SUB_BUCKET_BITS ? (size_t{1} << exponent) - 1
+                                            : (exponent - SUB_BUCKET_BITS) * SUB_BUCKETS + SUB_BUCKETS - 1;
+  uint64 sum  = 0;
+  for (size_t i = 0; i <= last && i < BUCKETS; i++) {
+    sum += buckets_[i].load(std::memory_order_relaxed);
+  }
+  return sum;
+}
+
+/******************************************************************************
+                     MetricsRegistry
+******************************************************************************/
+
+MetricsRegistry::Metric *MetricsRegistry::find_or_create(const std::string &name, const std::string &help,
+    MetricType type, const MetricLabels &labels, bool &created)
+{
+  created = false;
+
+  auto [it, inserted] = families_.try_emplace(name);
+  Family &family      = it->second;
+  if (inserted) {
+    family.help = help;
+    family.type = type;
+  } else if (family.type != type) {
+    LOG_ERROR("metric registered with a different type. name=%s", name.c_str());
+    return nullptr;
+  }
+
+  std::string body = format_labels(labels);
+  for (Metric &metric : family.metrics) {
+    if (metric.label_body == body) {
+      return &metric;
+    }
+  }
+  Metric &metric    = family.metrics.emplace_back();
+  metric.label_body = std::move(body);
+  created           = true;
+  return &metric;
+}
+
+Counter *MetricsRegistry::counter(const std::string &name, const std::string &help, const MetricLabels &labels)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  bool                        created = false;
+  Metric                     *metric  = find_or_create(name, help, MetricType::COUNTER, labels, created);
+  if (metric == nullptr) {
+    return nullptr;
+  }
+  if (created) {
+    metric->counter = std::make_unique<Counter>();
+  }
+  return metric->counter.get();
+}
+
+Gauge *MetricsRegistry::gauge(const std::string &name, const std::string &help, const MetricLabels &labels)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  bool                        created = false;
+  Metric                     *metric  = find_or_create(name, help, MetricType::GAUGE, labels, created);
+  if (metric == nullptr) {
+    return nullptr;
+  }
+  if (created) {
+    metric->gauge = std::make_unique<Gauge>();
+  }
+  return metric->gauge.get();
+}
+
+Histogram *MetricsRegistry::histogram(
+    const std::string &name, const std::string &help, double scale, const MetricLabels &labels)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  bool                        created = false;
+  Metric                     *metric  = find_or_create(name, help, MetricType::HISTOGRAM, labels, created);
+  if (metric == nullptr) {
+    return nullptr;
+  }
+  if (created) {
+    metric->histogram = std::make_unique<Histogram>(scale);
+  }
+  return metric->histogram.get();
+}
+
+bool MetricsRegistry::callback(const std::string &name, const std::string &help, MetricType type,
+    std::function<double()> fn, const MetricLabels &labels)
+{
+  if (type == MetricType::HISTOGRAM) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  bool                        created = false;
+  Metric                     *metric  = find_or_create(name, help, type, labels, created);
+  if (metric == nullptr || !created) {
+    return false;
+  }
+  metric->fn = std::move(fn);
+  return true;
+}
+
+std::string MetricsRegistry::to_prometheus() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::string                 text;
+  for (const auto &[name, family] : families_) {
+    text += "# HELP " + name + " " + escape(family.help, false) + "\n";
+    text += "# TYPE " + name + " " + type_name(family.type) + "\n";
+
+    for (const Metric &metric : family.metrics) {
+      if (metric.fn) {
+        text += series(name, metric.label_body) + " " + format_number(metric.fn()) + "\n";
+      } else if (metric.counter != nullptr) {
+        text += series(name, metric.label_body) + " " + std::to_string(metric.counter->value()) + "\n";
+      } else if (metric.gauge != nullptr) {
+        text += series(name, metric.label_body) + " " + std::to_string(metric.gauge->value()) + "\n";
+      } else if (metric.histogram != nullptr) {
+        const Histogram &h = *metric.histogram;
+        // 先读 count，各桶的累计值不会超过它
+        uint64 count = h.count();
+        for (int e = 0; e <= h.max_exponent(); e++) {
+          std::string le = "le=\"" + format_number(std::ldexp(1.0, e) * h.scale()) + "\"";
+          uint64      n  = std::min(h.count_below_power(e), count);
+          text += series(name + "_bucket", metric.label_body, le) + " " + std::to_string(n) + "\n";
+        }
+        text += series(name + "_bucket", metric.label_body, "le=\"+Inf\"") + " " + std::to_string(count) + "\n";
+        text += series(name + "_sum", metric.label_body) + " " + format_number(h.sum() * h.scale()) + "\n";
+        text += series(name + "_count", metric.label_body) + " " + std::to_string(count) + "\n";
+      }
+    }
+  }
+  return text;
+}
+
+RC MetricsRegistry::write_textfile(const std::string &path) const
+{
+  std::string text = to_prometheus();
+  std::string tmp  = path + ".tmp";
+
+  FILE *file = fopen(tmp.c_str(), "w");
+  if (file == nullptr) {
+    LOG_ERROR("failed to open metrics textfile. path=%s", tmp.c_str());
+    return RC::FILE_OPEN;
+  }
+  bool written = fwrite(text.data(), 1, text.size(), file) == text.size();
+  if (fclose(file) != 0 || !written) {
+    LOG_ERROR("failed to write metrics textfile. path=%s", tmp.c_str());
+    remove(tmp.c_str());
+    return RC::IOERR_WRITE;
+  }
+  if (rename(tmp.c_str(), path.c_str()) != 0) {
+    LOG_ERROR("failed to rename metrics textfile. path=%s", path.c_str());
+    remove(tmp.c_str());
+    return RC::IOERR_WRITE;
+  }
+  return RC::SUCCESS;
+}
+
+/******************************************************************************
+                     MetricsExporter
+******************************************************************************/
+
+MetricsExporter::MetricsExporter(const MetricsRegistry &registry, std::string path, std::chrono::milliseconds interval)
+    : registry_(registry), path_(std::move(path)), interval_(interval)
+{}
+
+MetricsExporter::~MetricsExporter() { stop(); }
+
+void MetricsExporter::start()
+{
+  if (thread_.joinable()) {
+    return;
+  }
+  thread_ = std::thread(&MetricsExporter::run, this);
+}
+
+void MetricsExporter::stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_) {
+      return;
+    }
+    stopping_ = true;
+  }
+  cv_.notify_all();
+  if (thread_.joinable()) {
+    thread_.join();
+    registry_.write_textfile(path_);
+  }
+}
+
+void MetricsExporter::run()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!cv_.wait_for(lock, interval_, [this] { return stopping_; })) {
+    lock.unlock();
+    registry_.write_textfile(path_);
+    lock.lock();
+  }
+}
+
+}  // namespace common
@@ -0,0 +1,73 @@
+//
+// Created by Coonger on 2024/12/9.
+//
+
+#include "common/task_group.h"
+
+namespace common {
+
+/**
+ * @brief 包一层组内计数：执行器执行完任务后销毁它，销毁时通知所属的 TaskGroup。
+ * 执行器拒绝提交时同样会销毁它，计数也就自动回退了
+ */
+class TaskGroup::GroupRunnable : public Runnable
+{
+public:
+  GroupRunnable(TaskGroup *group, std::unique_ptr<Runnable> &&task) : group_(group), task_(std::move(task)) {}
+  ~GroupRunnable() override
+  {
+    task_.reset();  // 先释放任务捕获的资源，再让等待者继续
+    group_->done();
+  }
+
+  void run() override { task_->run(); }
+
+private:
+  TaskGroup                *group_;
+  std::unique_ptr<Runnable> task_;
+};
+
+TaskGroup::~TaskGroup() { wait(); }
+
+int TaskGroup::run(std::unique_ptr<Runnable> &&task)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++pending_;
+  }
+
+  return executor_->execute(std::make_unique<GroupRunnable>(this, std::move(task)));
+}
+
+int TaskGroup::run(const std::function<void()> &callable)
+{
+  return run(std::unique_ptr<Runnable>(new RunnableAdaptor(callable)));
+}
+
+void TaskGroup::done()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (--pending_ == 0) {
+    cv_.notify_all();
+  }
+}
+
+void TaskGroup::wait()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  cv_.wait(lock, [this] { return pending_ == 0; });
+}
+
+bool TaskGroup::wait_for(std::chrono::milliseconds timeout)
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  return cv_.wait_for(lock, timeout, [this] { return pending_ == 0; });
+}
+
+int64 TaskGroup::pending() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return pending_;
+}
+
+}  // namespace common
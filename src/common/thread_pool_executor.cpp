@@ -1,6 +1,7 @@
 //
 // Created by Coonger on 2024/11/21.
 //
+#include <algorithm>
 #include <thread>
 
 #include "common/thread_pool_executor.h"
@@ -39,6 +40,7 @@ int ThreadPoolExecutor::init(const char *name, int core_pool_size, int max_pool_
   max_pool_size_      = max_pool_size;
   keep_alive_time_ms_ = chrono::milliseconds(keep_alive_time_ms);
   work_queue_         = std::move(work_queue);
+  active_limit_       = max_pool_size;
 
   while (static_cast<int>(threads_.size()) < core_pool_size_) {
     if (create_thread(true /*core_thread*/) != 0) {
@@ -65,16 +67,14 @@ int ThreadPoolExecutor::shutdown()
     return 0;
   }
 
-  state_ = State::TERMINATING;
+  {
+    lock_guard<mutex> guard(idle_mutex_);
+    state_ = State::TERMINATING;
+  }
+  idle_cv_.notify_all();
   return 0;
 }
 
-int ThreadPoolExecutor::execute(const function<void()> &callable)
-{
-  unique_ptr<Runnable> task_ptr(new RunnableAdaptor(callable));
-  return this->execute(std::move(task_ptr));
-}
-
 int ThreadPoolExecutor::execute(unique_ptr<Runnable> &&task)
 {
   if (state_ != State::RUNNING) {
@@ -82,7 +82,12 @@ int ThreadPoolExecutor::execute(unique_ptr<Runnable> &&task)
     return -1;
   }
 
-  int ret       = work_queue_->push(std::move(task));
+  int ret = work_queue_->push(std::move(task));
+  {
+    lock_guard<mutex> guard(idle_mutex_);
+  }
+  idle_cv_.notify_one();
+
   int task_size = work_queue_->size();
   if (task_size > pool_size() - active_count()) {
     extend_thread();
@@ -96,9 +101,9 @@ int ThreadPoolExecutor::await_termination()
     return -1;
   }
 
-  while (threads_.size() > 0) {
-    this_thread::sleep_for(200ms);
-  }
+  unique_lock<mutex> guard(lock_);
+  terminated_cv_.wait(guard, [this] { return threads_.empty(); });
+  state_ = State::TERMINATED;
   return 0;
 }
 
@@ -110,6 +115,9 @@ void ThreadPoolExecutor::thread_func()
   if (ret != 0) {
     LOG_ERROR("[%s] set thread name failed", pool_name_.c_str());
   }
+  if (placement_.place_current_thread() != 0) {
+    LOG_ERROR("[%s] bind thread to cpus failed", pool_name_.c_str());
+  }
 
   lock_.lock();
   auto iter = threads_.find(this_thread::get_id());
@@ -134,18 +142,38 @@ void ThreadPoolExecutor::thread_func()
   /// 并不需要保留这么多线程
   while (thread_data.core_thread || Clock::now() < idle_deadline) {
     unique_ptr<Runnable> task;
+    bool                 executed = false;
+
+    // 先占活跃名额再取任务，同时执行任务的线程不会超过 active_limit_
+    if (acquire_active()) {
+      ret = work_queue_->pop(task);
+      if (0 == ret && task) {
+        thread_data.idle = false;
+        task->run();
+        thread_data.idle = true;
+        ++task_count_;
+        executed = true;
+
+        if (keep_alive_time_ms_.count() > 0) {
+          idle_deadline = Clock::now() + keep_alive_time_ms_;
+        }
+      }
+      release_active();
+    }
 
-    ret = work_queue_->pop(task);
-    if (0 == ret && task) {
-      thread_data.idle = false;
-      ++active_count_;
-      task->run();
-      --active_count_;
-      thread_data.idle = true;
-      ++task_count_;
-
-      if (keep_alive_time_ms_.count() > 0) {
-        idle_deadline = Clock::now() + keep_alive_time_ms_;
+    if (!executed) {
+      // 队列为空或者名额已满：休眠到有可执行的任务、线程池关闭或者空闲超时，不再空转
+      unique_lock<mutex> idle_lock(idle_mutex_);
+      auto               wakeup = [this] {
+        if (work_queue_->size() > 0) {
+          return active_count_.load() < active_limit_.load();
+        }
+        return state_ != State::RUNNING;
+      };
+      if (thread_data.core_thread) {
+        idle_cv_.wait(idle_lock, wakeup);
+      } else {
+        idle_cv_.wait_until(idle_lock, idle_deadline, wakeup);
       }
     }
     if (state_ != State::RUNNING && work_queue_->size() == 0) {
@@ -158,11 +186,15 @@ void ThreadPoolExecutor::thread_func()
   delete thread_data.thread_ptr;
   thread_data.thread_ptr = nullptr;
 
+  // 先打日志再从 threads_ 里摘掉自己：最后一个线程摘掉后 await_termination 就可能返回，线程池随之析构
+  LOG_INFO("[%s] thread exit", pool_name_.c_str());
+
   lock_.lock();
   threads_.erase(this_thread::get_id());
+  if (threads_.empty()) {
+    terminated_cv_.notify_all();
+  }
   lock_.unlock();
-
-  LOG_INFO("[%s] thread exit", pool_name_.c_str());
 }
 
 int ThreadPoolExecutor::create_thread(bool core_thread)
@@ -196,8 +228,8 @@ int ThreadPoolExecutor::extend_thread()
 {
   lock_guard guard(lock_);
 
-  // 超过最大线程数，不再创建
-  if (pool_size() >= max_pool_size_) {
+  // 超过最大线程数或者活跃名额，不再创建
+  if (pool_size() >= std::min(max_pool_size_, active_limit_.load())) {
     return 0;
   }
   // 任务数比空闲线程数少，不创建新线程
@@ -208,4 +240,44 @@ int ThreadPoolExecutor::extend_thread()
   return create_thread_locked(false /*core_thread*/);
 }
 
+void ThreadPoolExecutor::set_active_limit(int limit)
+{
+  limit   = std::clamp(limit, 1, std::max(max_pool_size_, 1));
+  int old = active_limit_.exchange(limit);
+  if (limit <= old || state_ != State::RUNNING) {
+    return;
+  }
+
+  {
+    lock_guard<mutex> guard(idle_mutex_);
+  }
+  idle_cv_.notify_all();
+  // 休眠的线程不够用时补上，extend_thread 自己判断是否还需要
+  for (int i = old; i < limit; i++) {
+    extend_thread();
+  }
+}
+
+bool ThreadPoolExecutor::acquire_active()
+{
+  int active = active_count_.load();
+  while (active < active_limit_.load()) {
+    if (active_count_.compare_exchange_weak(active, active + 1)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPoolExecutor::release_active()
+{
+  --active_count_;
+  if (work_queue_->size() > 0) {
+    {
+      lock_guard<mutex> guard(idle_mutex_);
+    }
+    idle_cv_.notify_one();
+  }
+}
+
 }  // end namespace common
\ No newline at end of file
@@ -3,10 +3,39 @@
 //
 
 #include <pthread.h>
+#include <sched.h>
 #include <stdio.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/mempolicy.h>
+
+#include <climits>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <map>
+
+#include "common/thread_util.h"
 
 namespace common {
 
+namespace {
+// 内核的 nodemask 参数，1024 个节点足够了
+constexpr int NODE_MASK_WORDS = 16;
+constexpr int NODE_MASK_BITS  = NODE_MASK_WORDS * sizeof(unsigned long) * CHAR_BIT;
+
+int read_int(const std::filesystem::path &path, int &value)
+{
+  std::ifstream in(path);
+  if (!(in >> value)) {
+    return -1;
+  }
+  return 0;
+}
+}  // namespace
+
 int thread_set_name(const char *name)
 {
   const int namelen = 16;
@@ -20,4 +49,178 @@ int thread_set_name(const char *name)
 #endif
 }
 
-}  // namespace common
\ No newline at end of file
+int parse_cpu_list(const std::string &list, std::vector<int> &cpus)
+{
+  cpus.clear();
+  size_t pos = 0;
+  while (pos < list.size()) {
+    size_t end = list.find(',', pos);
+    if (end == std::string::npos) {
+      end = list.size();
+    }
+    std::string item = list.substr(pos, end - pos);
+    pos              = end + 1;
+    if (item.empty()) {
+      continue;
+    }
+
+    // 每一项是 "N" 或者 "N-M"，%n 检查整项都被解析了
+    int  first = 0;
+    int  last  = 0;
+    int  read  = 0;
+    int  size  = static_cast<int>(item.size());
+    bool range = sscanf(item.c_str(), "%d-%d%n", &first, &last, &read) == 2 && read == size;
+    if (!range) {
+      read = 0;
+      if (sscanf(item.c_str(), "%d%n", &first, &read) != 1 || read != size) {
+        cpus.clear();
+        return -1;
+      }
+      last = first;
+    }
+    // 超出 CPU_SETSIZE 的编号绑不上，"0-100000000" 这样的输入也不能展开成上亿个元素
+    if (first < 0 || last < first || last >= CPU_SETSIZE) {
+      cpus.clear();
+      return -1;
+    }
+    for (int cpu = first; cpu <= last; cpu++) {
+      cpus.push_back(cpu);
+    }
+  }
+  return 0;
+}
+
+int thread_bind_cpus(const std::vector<int> &cpus)
+{
+  if (cpus.empty()) {
+    return 0;
+  }
+
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int cpu : cpus) {
+    if (cpu < CPU_SETSIZE) {
+      CPU_SET(cpu, &set);
+    }
+  }
+  int ret = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  if (ret != 0) {
+    return ret;
+  }
+
+  int node = numa_node_of_cpu(cpus.front());
+  for (int cpu : cpus) {
+    if (numa_node_of_cpu(cpu) != node) {
+      return 0;
+    }
+  }
+  if (node >= 0) {
+    thread_prefer_numa_node(node);
+  }
+  return 0;
+}
+
+int thread_prefer_numa_node(int node)
+{
+  if (node < 0 || node >= NODE_MASK_BITS) {
+    return -1;
+  }
+  unsigned long mask[NODE_MASK_WORDS] = {0};
+  mask[node / (sizeof(unsigned long) * CHAR_BIT)] |= 1UL << (node % (sizeof(unsigned long) * CHAR_BIT));
+  // 内核会把 maxnode 减一，和 libnuma 一样多传一位
+  return static_cast<int>(::syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask, NODE_MASK_BITS + 1));
+}
+
+int memory_bind_numa_node(void *addr, size_t len, int node)
+{
+  if (node < 0 || node >= NODE_MASK_BITS) {
+    return -1;
+  }
+  // mbind 要求起始地址按页对齐，只处理区间完整覆盖的页
+  uintptr_t page  = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+  uintptr_t begin = (reinterpret_cast<uintptr_t>(addr) + page - 1) & ~(page - 1);
+  uintptr_t end   = (reinterpret_cast<uintptr_t>(addr) + len) & ~(page - 1);
+  if (end <= begin) {
+    return 0;
+  }
+
+  unsigned long mask[NODE_MASK_WORDS] = {0};
+  mask[node / (sizeof(unsigned long) * CHAR_BIT)] |= 1UL << (node % (sizeof(unsigned long) * CHAR_BIT));
+  return static_cast<int>(::syscall(SYS_mbind,
+      reinterpret_cast<void *>(begin),
+      end - begin,
+      MPOL_PREFERRED,
+      mask,
+      NODE_MASK_BITS + 1,
+      MPOL_MF_MOVE));
+}
+
+int numa_node_of_cpu(int cpu)
+{
+  std::error_code ec;
+  std::filesystem::path dir = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+  for (const auto &entry : std::filesystem::directory_iterator(dir, ec)) {
+    std::string name = entry.path().filename().string();
+    if (name.size() > 4 && name.compare(0, 4, "node") == 0) {
+      return atoi(name.c_str() + 4);
+    }
+  }
+  return -1;
+}
+
+int numa_node_cpus(int node, std::vector<int> &cpus)
+{
+  std::ifstream in("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+  std::string   list;
+  if (!std::getline(in, list)) {
+    cpus.clear();
+    return -1;
+  }
+  return parse_cpu_list(list, cpus);
+}
+
+int numa_node_of_path(const char *path)
+{
+  struct stat st;
+  if (::stat(path, &st) != 0) {
+    return -1;
+  }
+
+  std::error_code       ec;
+  std::filesystem::path dev = "/sys/dev/block/" + std::to_string(major(st.st_dev)) + ":" +
+                              std::to_string(minor(st.st_dev));
+  dev = std::filesystem::canonical(dev, ec);
+  if (ec) {
+    return -1;
+  }
+  for (; dev.has_relative_path(); dev = dev.parent_path()) {
+    int node = -1;
+    if (read_int(dev / "device" / "numa_node", node) == 0 || read_int(dev / "numa_node", node) == 0) {
+      return node;
+    }
+  }
+  return -1;
+}
+
+void CpuPlacement::assign(const std::vector<int> &cpus)
+{
+  std::map<int, std::vector<int>> nodes;
+  for (int cpu : cpus) {
+    nodes[numa_node_of_cpu(cpu)].push_back(cpu);
+  }
+  groups_.clear();
+  for (auto &[node, group] : nodes) {
+    groups_.push_back(std::move(group));
+  }
+}
+
+int CpuPlacement::place_current_thread()
+{
+  if (groups_.empty()) {
+    return 0;
+  }
+  size_t index = next_.fetch_add(1, std::memory_order_relaxed) % groups_.size();
+  return thread_bind_cpus(groups_[index]);
+}
+
+}  // namespace common
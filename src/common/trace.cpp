@@ -0,0 +1,231 @@
+//
+// Created by Coonger on 2024/12/18.
+//
+
+#include "common/trace.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "common/logging.h"
+
+namespace common {
+
+namespace {
+
+void append_escaped(std::string &out, const std::string &text)
+{
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    } else if (static_cast<unsigned char>(c) >= 0x20) {
+      out += c;
+    }
+  }
+}
+
+}  // namespace
+
+Tracer &Tracer::instance()
+{
+  static Tracer tracer;
+  return tracer;
+}
+
+void Tracer::start(size_t events_per_thread)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  capacity_ = std::max<size_t>(events_per_thread, 1);
+  for (auto &buffer : buffers_) {
+    buffer->size.store(0, std::memory_order_relaxed);
+    buffer->dropped.store(0, std::memory_order_relaxed);
+    // 只留下当前持有者，从头开始记
+    if (buffer->in_use) {
+      buffer->holders.erase(buffer->holders.begin(), buffer->holders.end() - 1);
+      buffer->holders.back().begin = 0;
+    } else {
+      buffer->holders.clear();
+    }
+  }
+  generation_.fetch_add(1, std::memory_order_relaxed);
+  epoch_ns_.store(now_ns(), std::memory_order_relaxed);
+  enabled_.store(true, std::memory_order_release);
+}
+
+Tracer::LocalBuffer::~LocalBuffer()
+{
+  if (buffer != nullptr) {
+    Tracer::instance().release(buffer);
+  }
+}
+
+Tracer::ThreadBuffer *Tracer::local_buffer()
+{
+  thread_local LocalBuffer local;
+  ThreadBuffer           *&buffer = local.buffer;
+
+  uint64 generation = generation_.load(std::memory_order_relaxed);
+  if (buffer != nullptr && buffer->generation == generation) {
+    return buffer;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (buffer == nullptr) {
+    if (free_.empty()) {
+      buffers_.push_back(std::make_unique<ThreadBuffer>());
+      buffer = buffers_.back().get();
+    } else {
+      buffer = free_.back();
+      free_.pop_back();
+    }
+    buffer->in_use = true;
+
+    Holder holder{static_cast<int>(syscall(SYS_gettid)), "", buffer->size.load(std::memory_order_relaxed)};
+    char   name[16] = {0};
+    if (pthread_getname_np(pthread_self(), name, sizeof(name)) == 0) {
+      holder.thread_name = name;
+    }
+    // 上一个持有者什么都没记下来，不用留着
+    if (!buffer->holders.empty() && buffer->holders.back().begin == holder.begin) {
+      buffer->holders.pop_back();
+    }
+    buffer->holders.push_back(std::move(holder));
+  }
+  // 新分配的缓冲区，或者 start() 修改了容量
+  if (buffer->capacity != capacity_) {
+    buffer->events   = std::make_unique<Event[]>(capacity_);
+    buffer->capacity = capacity_;
+    buffer->size.store(0, std::memory_order_release);
+    buffer->holders.erase(buffer->holders.begin(), buffer->holders.end() - 1);
+    buffer->holders.back().begin = 0;
+  }
+  buffer->generation = generation;
+  return buffer;
+}
+
+void Tracer::record(const char *name, const char *category, uint64 start_ns, uint64 end_ns, int64 arg)
+{
+  if (!enabled()) {
+    return;
+  }
+  ThreadBuffer *buffer = local_buffer();
+  size_t        size   = buffer->size.load(std::memory_order_relaxed);
+  if (size >= buffer->capacity) {
+    buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  buffer->events[size] = Event{name, category, start_ns, end_ns > start_ns ? end_ns - start_ns : 0, arg};
+  buffer->size.store(size + 1, std::memory_order_release);
+}
+
+void Tracer::release(ThreadBuffer *buffer)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  buffer->in_use = false;
+  free_.push_back(buffer);
+}
+
+uint64 Tracer::dropped() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  uint64                      total = 0;
+  for (const auto &buffer : buffers_) {
+    total += buffer->dropped.load(std::memory_order_relaxed);
+  }
+  return total;
+}
+
+size_t Tracer::buffer_count() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return buffers_.size();
+}
+
+RC Tracer::write_chrome_json(const std::string &path) const
+{
+  FILE *file = fopen(path.c_str(), "w");
+  if (file == nullptr) {
+    LOG_ERROR("failed to open trace file. path=%s", path.c_str());
+    return RC::FILE_OPEN;
+  }
+
+  const int    pid   = static_cast<int>(getpid());
+  const uint64 epoch = epoch_ns_.load(std::memory_order_relaxed);
+  uint64       total = 0;
+  uint64       lost  = 0;
+  bool         first   = true;
+  bool         written = true;
+  std::string  out   = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+  char         line[256];
+
+  auto emit = [&](const std::string &text) {
+    if (!first) {
+      out += ",\n";
+    }
+    first = false;
+    out += text;
+    if (out.size() >= (1 << 20)) {
+      written &= fwrite(out.data(), 1, out.size(), file) == out.size();
+      out.clear();
+    }
+  };
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto &buffer : buffers_) {
+      size_t size = buffer->size.load(std::memory_order_acquire);
+      lost += buffer->dropped.load(std::memory_order_relaxed);
+      if (size == 0) {
+        continue;
+      }
+
+      for (size_t h = 0; h < buffer->holders.size(); h++) {
+        const Holder &holder = buffer->holders[h];
+        size_t        end    = h + 1 < buffer->holders.size() ? buffer->holders[h + 1].begin : size;
+        end                  = std::min(end, size);
+        if (holder.begin >= end) {
+          continue;
+        }
+
+        // 查看器按 thread_name 元数据给每一行命名
+        std::string meta = "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" + std::to_string(pid) +
+                           ",\"tid\":" + std::to_string(holder.tid) + ",\"args\":{\"name\":\"";
+        append_escaped(meta, holder.thread_name.empty() ? std::to_string(holder.tid) : holder.thread_name);
+        meta += "\"}}";
+        emit(meta);
+
+        for (size_t i = holder.begin; i < end; i++) {
+          const Event &e = buffer->events[i];
+          // ts / dur 的单位是微秒，保留到纳秒
+          int n = snprintf(line, sizeof(line),
+              "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+              e.name, e.category, pid, holder.tid,
+              e.start_ns >= epoch ? (e.start_ns - epoch) / 1000.0 : 0.0, e.dur_ns / 1000.0);
+          std::string event(line, std::min<size_t>(n, sizeof(line) - 1));
+          if (e.arg >= 0) {
+            event += ",\"args\":{\"id\":" + std::to_string(e.arg) + "}";
+          }
+          event += "}";
+          emit(event);
+        }
+      }
+      total += size;
+    }
+  }
+
+  out += "\n],\"otherData\":{\"dropped_events\":" + std::to_string(lost) + "}}\n";
+  written &= fwrite(out.data(), 1, out.size(), file) == out.size();
+  if (fclose(file) != 0 || !written) {
+    LOG_ERROR("failed to write trace file. path=%s", path.c_str());
+    return RC::IOERR_WRITE;
+  }
+  LOG_INFO("trace written. path=%s, events=%llu, dropped=%llu",
+      path.c_str(), (unsigned long long)total, (unsigned long long)lost);
+  return RC::SUCCESS;
+}
+
+}  // namespace common
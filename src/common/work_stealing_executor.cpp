@@ -0,0 +1,215 @@
+//
+// Created by Coonger on 2024/12/8.
+//
+
+#include "common/work_stealing_executor.h"
+#include "common/logging.h"
+#include "common/thread_util.h"
+
+namespace common {
+
+namespace {
+
+/// 当前线程所属的线程池和 worker 下标，用于判断 execute 是否来自 worker 自己
+thread_local WorkStealingExecutor *tls_executor     = nullptr;
+thread_local int                   tls_worker_index = -1;
+
+uint32 next_random(uint32 &seed)
+{
+  // xorshift32
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return seed;
+}
+
+}  // namespace
+
+WorkStealingExecutor::~WorkStealingExecutor()
+{
+  if (state_ != State::TERMINATED && state_ != State::NEW) {
+    shutdown();
+    await_termination();
+  }
+}
+
+int WorkStealingExecutor::init(const char *name, int worker_count)
+{
+  if (state_ != State::NEW) {
+    LOG_ERROR("invalid state. state=%d", static_cast<int>(state_.load()));
+    return -1;
+  }
+
+  if (worker_count <= 0) {
+    worker_count = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+  }
+  if (name != nullptr) {
+    pool_name_ = name;
+  }
+
+  // 先把所有 worker 的队列建好再启动线程，窃取时可以无锁地遍历 workers_
+  for (int i = 0; i < worker_count; ++i) {
+    workers_.emplace_back(std::make_unique<Worker>());
+  }
+  state_ = State::RUNNING;
+  for (int i = 0; i < worker_count; ++i) {
+    workers_[i]->thread = std::thread(&WorkStealingExecutor::thread_func, this, i);
+  }
+  return 0;
+}
+
+int WorkStealingExecutor::execute(std::unique_ptr<Runnable> &&task)
+{
+  if (tls_executor == this) {
+    // worker 自己提交：它退出前一定会取完自己队列里的任务，不会遗留
+    if (state_ != State::RUNNING) {
+      LOG_ERROR("[%s] cannot submit task. state=%d", pool_name_.c_str(), static_cast<int>(state_.load()));
+      return -1;
+    }
+    workers_[tls_worker_index]->deque.push(task.release());
+    queued_.fetch_add(1, std::memory_order_seq_cst);
+  } else {
+    // 外部提交：检查状态和入队都在 inject_mutex_ 下，shutdown() 也持有这把锁切换状态，
+    // worker 看到 TERMINATING 时一定也能看到这里增加的 queued_，不会在任务入队之前退出
+    std::lock_guard<std::mutex> lock(inject_mutex_);
+    if (state_ != State::RUNNING) {
+      LOG_ERROR("[%s] cannot submit task. state=%d", pool_name_.c_str(), static_cast<int>(state_.load()));
+      return -1;
+    }
+    inject_queue_.push_back(task.release());
+    queued_.fetch_add(1, std::memory_order_seq_cst);
+  }
+  notify_one();
+  return 0;
+}
+
+void WorkStealingExecutor::notify_one()
+{
+  if (sleepers_.load(std::memory_order_seq_cst) > 0) {
+    std::lock_guard<std::mutex> lock(park_mutex_);
+    park_cv_.notify_one();
+  }
+}
+
+int WorkStealingExecutor::shutdown()
+{
+  {
+    // 和外部线程的 execute 互斥，见 execute
+    std::lock_guard<std::mutex> lock(inject_mutex_);
+    State expected = State::RUNNING;
+    if (!state_.compare_exchange_strong(expected, State::TERMINATING)) {
+      return 0;
+    }
+  }
+  std::lock_guard<std::mutex> lock(park_mutex_);
+  park_cv_.notify_all();
+  return 0;
+}
+
+int WorkStealingExecutor::await_termination()
+{
+  if (state_ != State::TERMINATING) {
+    return -1;
+  }
+  for (auto &worker : workers_) {
+    if (worker->thread.joinable()) {
+      worker->thread.join();
+    }
+  }
+  state_ = State::TERMINATED;
+  return 0;
+}
+
+Runnable *WorkStealingExecutor::pop_injected()
+{
+  std::lock_guard<std::mutex> lock(inject_mutex_);
+  if (inject_queue_.empty()) {
+    return nullptr;
+  }
+  Runnable *task = inject_queue_.front();
+  inject_queue_.pop_front();
+  return task;
+}
+
+Runnable *WorkStealingExecutor::steal(int thief, uint32 &seed)
+{
+  const int count = static_cast<int>(workers_.size());
+  if (count <= 1) {
+    return nullptr;
+  }
+  int start = static_cast<int>(next_random(seed) % count);
+  for (int i = 0; i < count; ++i) {
+    int victim = (start + i) % count;
+    if (victim == thief) {
+      continue;
+    }
+    Runnable *task = nullptr;
+    if (workers_[victim]->deque.steal(task)) {
+      steal_count_.fetch_add(1, std::memory_order_relaxed);
+      return task;
+    }
+  }
+  return nullptr;
+}
+
+Runnable *WorkStealingExecutor::find_task(int index, uint32 &seed)
+{
+  Runnable *task = nullptr;
+  if (workers_[index]->deque.pop(task)) {
+    return task;
+  }
+  if ((task = pop_injected()) != nullptr) {
+    return task;
+  }
+  return steal(index, seed);
+}
+
+bool WorkStealingExecutor::park()
+{
+  std::unique_lock<std::mutex> lock(park_mutex_);
+  sleepers_.fetch_add(1, std::memory_order_seq_cst);
+  park_cv_.wait(lock, [this] {
+    return queued_.load(std::memory_order_seq_cst) > 0 || state_.load() != State::RUNNING;
+  });
+  sleepers_.fetch_sub(1, std::memory_order_seq_cst);
+  return queued_.load(std::memory_order_seq_cst) > 0 || state_.load() == State::RUNNING;
+}
+
+void WorkStealingExecutor::thread_func(int index)
+{
+  LOG_INFO("[%s] worker %d started", pool_name_.c_str(), index);
+  if (thread_set_name(pool_name_.c_str()) != 0) {
+    LOG_ERROR("[%s] set thread name failed", pool_name_.c_str());
+  }
+  if (placement_.place_current_thread() != 0) {
+    LOG_ERROR("[%s] bind thread to cpus failed", pool_name_.c_str());
+  }
+
+  tls_executor     = this;
+  tls_worker_index = index;
+  uint32 seed      = static_cast<uint32>(index) * 2654435761U + 1;
+
+  while (true) {
+    Runnable *task = find_task(index, seed);
+    if (task == nullptr) {
+      // 任务可能在别的 worker 的队列里被抢来抢去，queued_ 仍大于 0 时 park 会立即返回再试一轮
+      if (!park()) {
+        break;
+      }
+      continue;
+    }
+
+    queued_.fetch_sub(1, std::memory_order_seq_cst);
+    ++active_count_;
+    std::unique_ptr<Runnable> owned(task);
+    owned->run();
+    --active_count_;
+    ++task_count_;
+  }
+
+  tls_executor     = nullptr;
+  tls_worker_index = -1;
+  LOG_INFO("[%s] worker %d exit", pool_name_.c_str(), index);
+}
+
+}  // namespace common
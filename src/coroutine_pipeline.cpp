@@ -0,0 +1,154 @@
+//
+// Created by Coonger on 2024/12/13.
+//
+
+#include "coroutine_pipeline.h"
+
+#include <map>
+
+#include "writeset_tracker.h"
+
+CoroutinePipeline::CoroutinePipeline(LogFileManager *manager, Executor *executor, uint32 transform_stages)
+    : manager_(manager),
+      executor_(executor),
+      transform_stages_(std::max(transform_stages, 1U)),
+      ingest_(executor),
+      batches_(executor, transform_stages_),
+      results_(executor, transform_stages_)
+{}
+
+CoroutinePipeline::~CoroutinePipeline() { stop(); }
+
+void CoroutinePipeline::start()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    live_stages_ = static_cast<int>(transform_stages_) + 2;
+  }
+  transforms_running_ = transform_stages_;
+
+  write();
+  for (uint32 i = 0; i < transform_stages_; i++) {
+    transform();
+  }
+  collect();
+}
+
+void CoroutinePipeline::drain()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  cv_.wait(lock, [this] { return written_batches_ == collected_batches_ || live_stages_ == 0; });
+}
+
+void CoroutinePipeline::stop()
+{
+  stopping_ = true;
+  wake();
+  std::unique_lock<std::mutex> lock(mutex_);
+  cv_.wait(lock, [this] { return live_stages_ == 0; });
+}
+
+void CoroutinePipeline::exit_stage()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (--live_stages_ == 0) {
+    cv_.notify_all();
+  }
+}
+
+Fiber CoroutinePipeline::collect()
+{
+  co_await schedule_on(executor_);
+
+  size_t sequence = 0;
+  while (true) {
+    size_t pending = manager_->pending_tasks_.load();
+    if (pending == 0) {
+      if (stopping_) {
+        break;
+      }
+      co_await ingest_.wait();
+      continue;
+    }
+
+    auto              busy_start = std::chrono::steady_clock::now();
+    std::vector<Task> tasks;
+    tasks.reserve(std::min(pending, LogFileManager::BATCH_SIZE));
+    size_t read = manager_->ring_buffer_->pop_bulk(tasks, std::min(pending, LogFileManager::BATCH_SIZE));
+    if (read == 0) {
+      co_await schedule_on(executor_);
+      continue;
+    }
+    {
+      // 先计入 collected_batches_ 再减 pending_tasks_，drain 看到 pending_tasks_ 为 0 时这个 batch 一定已经计数
+      std::lock_guard<std::mutex> lock(mutex_);
+      collected_batches_++;
+    }
+    manager_->pending_tasks_ -= read;
+
+    if (manager_->writeset_tracker_ != nullptr) {
+      manager_->writeset_tracker_->track(tasks, false);
+    }
+    // 不含等下游 channel 腾位置的时间；span 不能跨 co_await，在这里分段记录
+    auto busy_end = std::chrono::steady_clock::now();
+    manager_->collector_busy_ns_ +=
+        std::chrono::duration_cast<std::chrono::nanoseconds>(busy_end - busy_start).count();
+    Tracer::instance().record("collect", "collector", Tracer::ns_of(busy_start), Tracer::ns_of(busy_end),
+        static_cast<int64>(read));
+    // 先构造具名的 Batch 再 co_await：GCC 12 下把聚合临时量直接写在 co_await 的操作数里，tasks 的缓冲区
+    // 没有真正移交，collect 这边析构 tasks 后 transform 读到的是已释放的内存
+    Batch batch{sequence++, std::move(tasks)};
+    if (!co_await batches_.send(std::move(batch))) {
+      break;
+    }
+  }
+
+  batches_.close();
+  exit_stage();
+}
+
+Fiber CoroutinePipeline::transform()
+{
+  co_await schedule_on(executor_);
+
+  while (auto batch = co_await batches_.recv()) {
+    auto result = LogFileManager::BatchProcessor::process(manager_, std::move(batch->tasks), batch->sequence);
+    if (!co_await results_.send(std::move(result))) {
+      break;
+    }
+  }
+
+  // 最后一个退出的 transform 关闭下游
+  if (--transforms_running_ == 0) {
+    results_.close();
+  }
+  exit_stage();
+}
+
+Fiber CoroutinePipeline::write()
+{
+  co_await schedule_on(executor_);
+
+  // transform 并发完成，先到的 batch 在这里等前面的编号
+  std::map<size_t, std::unique_ptr<LogFileManager::BatchResult>> reorder;
+  size_t                                                         next_sequence = 0;
+  while (auto result = co_await results_.recv()) {
+    size_t sequence = (*result)->sequence;
+    reorder.emplace(sequence, std::move(*result));
+
+    while (!reorder.empty() && reorder.begin()->first == next_sequence) {
+      auto start_time = std::chrono::steady_clock::now();
+      LogFileManager::ResultQueue::write(manager_->get_file_writer(), manager_, std::move(reorder.begin()->second));
+      manager_->writer_busy_ns_ +=
+          std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_time).count();
+      reorder.erase(reorder.begin());
+      next_sequence++;
+
+      std::lock_guard<std::mutex> lock(mutex_);
+      written_batches_++;
+      cv_.notify_all();
+    }
+  }
+
+  exit_stage();
+}
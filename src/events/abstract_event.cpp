@@ -64,6 +64,16 @@ size_t AbstractEvent::write_common_header_to_buffer(uchar *buffer)
   return LOG_EVENT_HEADER_LEN;
 }
 
+bool AbstractEvent::write_to_iovec(EventIovec &iov)
+{
+  size_t len = LOG_EVENT_HEADER_LEN + get_data_size();
+  uchar *buf = iov.reserve(len);
+  if (buf == nullptr) {
+    return false;
+  }
+  return write_to_buffer(buf) == len;
+}
+
 bool AbstractEvent::write_common_footer(Basic_ostream *ostream)
 {
   LOG_INFO("current event checksum write pos: %llu", ostream->get_position());
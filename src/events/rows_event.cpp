@@ -264,3 +264,46 @@ size_t Table_map_event::write_data_body_to_buffer(uchar *buffer)
   // 返回写入的总字节数
   return current_pos - buffer;
 }
+
+bool Table_map_event::write_to_iovec(EventIovec &iov)
+{
+  assert(!m_dbnam_.empty());
+  assert(!m_tblnam_.empty());
+
+  // 长度编码最多 9 字节
+  auto store_length = [&iov](uint64 length) {
+    uchar buf[9];
+    uchar *end = net_store_length(buf, length);
+    uchar *dst = iov.reserve(end - buf);
+    if (dst != nullptr) {
+      memcpy(dst, buf, end - buf);
+    }
+    return dst != nullptr;
+  };
+
+  uchar *header = iov.reserve(LOG_EVENT_HEADER_LEN + TABLE_MAP_HEADER_LEN);
+  if (header == nullptr) {
+    return false;
+  }
+  size_t pos = write_common_header_to_buffer(header);
+  write_data_header_to_buffer(header + pos);
+
+  if (!store_length(m_dblen_)) {
+    return false;
+  }
+  iov.append(m_dbnam_.c_str(), m_dblen_ + 1);
+  if (!store_length(m_tbllen_)) {
+    return false;
+  }
+  iov.append(m_tblnam_.c_str(), m_tbllen_ + 1);
+  if (!store_length(m_colcnt_)) {
+    return false;
+  }
+  iov.append(m_coltype_.get(), m_colcnt_);
+  if (!store_length(m_field_metadata_size_)) {
+    return false;
+  }
+  iov.append(m_field_metadata_.get(), m_field_metadata_size_);
+  iov.append(m_null_bits_.get(), (m_colcnt_ + 7) / 8);
+  return iov.size() == LOG_EVENT_HEADER_LEN + m_data_size_;
+}
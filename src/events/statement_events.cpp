@@ -243,6 +243,58 @@ size_t Query_event::write_data_header_to_buffer(uchar *buffer)
 }
 
 size_t Query_event::write_data_body_to_buffer(uchar *buffer)
+{
+  uchar *current_pos = buffer;
+
+  // 更新状态变量长度
+  status_vars_len_ = write_status_vars_to_buffer(current_pos);
+  current_pos += status_vars_len_;
+  int2store(buffer - AbstractEvent::QUERY_HEADER_LEN + Q_STATUS_VARS_LEN_OFFSET, status_vars_len_);
+
+  // 写入数据库名
+  if (db_) {
+    memcpy(current_pos, db_, db_len_);
+  }
+  current_pos += db_len_;
+  *current_pos++ = 0;  // 数据库名结束符
+
+  // 写入查询语句
+  memcpy(current_pos, query_, q_len_);
+  current_pos += q_len_;
+
+  return current_pos - buffer;
+}
+
+bool Query_event::write_to_iovec(EventIovec &iov)
+{
+  // common-header + post-header + 状态变量，状态变量的长度在构造时已经算好
+  size_t header_len = LOG_EVENT_HEADER_LEN + AbstractEvent::QUERY_HEADER_LEN;
+  uchar *header     = iov.reserve(header_len + status_vars_len_);
+  if (header == nullptr) {
+    return false;
+  }
+  size_t pos = write_common_header_to_buffer(header);
+  pos += write_data_header_to_buffer(header + pos);
+  size_t status_len = write_status_vars_to_buffer(header + pos);
+  if (status_len != status_vars_len_) {
+    return false;
+  }
+  int2store(header + LOG_EVENT_HEADER_LEN + Q_STATUS_VARS_LEN_OFFSET, status_vars_len_);
+
+  // 库名和 query 文本引用 task 里的 flatbuffer 数据
+  if (db_) {
+    iov.append(db_, db_len_);
+  }
+  uchar *terminator = iov.reserve(1);
+  if (terminator == nullptr) {
+    return false;
+  }
+  *terminator = 0;
+  iov.append(query_, q_len_);
+  return true;
+}
+
+size_t Query_event::write_status_vars_to_buffer(uchar *buffer)
 {
   uchar *current_pos     = buffer;
   uchar *start_of_status = current_pos;
@@ -324,22 +376,7 @@ size_t Query_event::write_data_body_to_buffer(uchar *buffer)
     }
   }
 
-  // 更新状态变量长度
-  status_vars_len_ = current_pos - start_of_status;
-  int2store(buffer - AbstractEvent::QUERY_HEADER_LEN + Q_STATUS_VARS_LEN_OFFSET, status_vars_len_);
-
-  // 写入数据库名
-  if (db_) {
-    memcpy(current_pos, db_, db_len_);
-  }
-  current_pos += db_len_;
-  *current_pos++ = 0;  // 数据库名结束符
-
-  // 写入查询语句
-  memcpy(current_pos, query_, q_len_);
-  current_pos += q_len_;
-
-  return current_pos - buffer;
+  return current_pos - start_of_status;
 }
 
 void Query_event::calculate_status_vars_len()
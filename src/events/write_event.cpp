@@ -48,12 +48,12 @@ bool Rows_event::write_data_header(Basic_ostream *ostream)
   return ostream->write(buf, ROWS_HEADER_LEN_V2);
 }
 
-bool Rows_event::write_data_body(Basic_ostream *ostream)
+void Rows_event::build_row_images()
 {
-  bool         res = true;
-  uchar        sbuf[sizeof(m_width) + 1];
-  uchar *const sbuf_end = net_store_length(sbuf, (size_t)m_width);
-  res &= ostream->write(sbuf, sbuf_end - sbuf);
+  if (m_row_images_built) {
+    return;
+  }
+  m_row_images_built = true;
 
   if (m_type == Log_event_type::UPDATE_ROWS_EVENT || m_type == Log_event_type::DELETE_ROWS_EVENT) {
     int N = Get_N();
@@ -74,7 +74,6 @@ bool Rows_event::write_data_body(Basic_ostream *ostream)
     }
 
     std::reverse(columns_before_image.get(), columns_before_image.get() + N);  // 使用 get()
-    res &= ostream->write(columns_before_image.get(), N);                      // 使用 get()
   }
 
   if (m_type == Log_event_type::UPDATE_ROWS_EVENT || m_type == Log_event_type::WRITE_ROWS_EVENT) {
@@ -96,7 +95,6 @@ bool Rows_event::write_data_body(Basic_ostream *ostream)
     }
 
     std::reverse(columns_after_image.get(), columns_after_image.get() + N);  // 使用 get()
-    res &= ostream->write(columns_after_image.get(), N);                     // 使用 get()
   }
 
   if (m_type == Log_event_type::UPDATE_ROWS_EVENT || m_type == Log_event_type::DELETE_ROWS_EVENT) {
@@ -108,8 +106,6 @@ bool Rows_event::write_data_body(Basic_ostream *ostream)
       }
     }
     std::reverse(row_bitmap_before.get(), row_bitmap_before.get() + N);
-    res &= ostream->write(row_bitmap_before.get(), N);
-    res &= ostream->write(m_rows_before_buf.get(), before_data_size_used);
   }
 
   if (m_type == Log_event_type::UPDATE_ROWS_EVENT || m_type == Log_event_type::WRITE_ROWS_EVENT) {
@@ -121,8 +117,52 @@ bool Rows_event::write_data_body(Basic_ostream *ostream)
       }
     }
     std::reverse(row_bitmap_after.get(), row_bitmap_after.get() + N);
-    res &= ostream->write(row_bitmap_after.get(), N);
-    res &= ostream->write(m_rows_after_buf.get(), after_data_size_used);
+  }
+}
+
+size_t Rows_event::body_parts(const uchar *parts[ROWS_BODY_MAX_PARTS], size_t lens[ROWS_BODY_MAX_PARTS])
+{
+  build_row_images();
+
+  bool   has_before = m_type == Log_event_type::UPDATE_ROWS_EVENT || m_type == Log_event_type::DELETE_ROWS_EVENT;
+  bool   has_after  = m_type == Log_event_type::UPDATE_ROWS_EVENT || m_type == Log_event_type::WRITE_ROWS_EVENT;
+  size_t cnt        = 0;
+  auto   add        = [&](const uchar *data, size_t len) {
+    parts[cnt]  = data;
+    lens[cnt++] = len;
+  };
+
+  // columns image：before 在前，after 在后
+  if (has_before) {
+    add(columns_before_image.get(), Get_N());
+  }
+  if (has_after) {
+    add(columns_after_image.get(), Get_N());
+  }
+  // 每个 image 的 null bitmap 后面紧跟着 row 数据
+  if (has_before) {
+    add(row_bitmap_before.get(), (rows_before.size() + 7) / 8);
+    add(m_rows_before_buf.get(), before_data_size_used);
+  }
+  if (has_after) {
+    add(row_bitmap_after.get(), (rows_after.size() + 7) / 8);
+    add(m_rows_after_buf.get(), after_data_size_used);
+  }
+  return cnt;
+}
+
+bool Rows_event::write_data_body(Basic_ostream *ostream)
+{
+  bool         res = true;
+  uchar        sbuf[sizeof(m_width) + 1];
+  uchar *const sbuf_end = net_store_length(sbuf, (size_t)m_width);
+  res &= ostream->write(sbuf, sbuf_end - sbuf);
+
+  const uchar *parts[ROWS_BODY_MAX_PARTS];
+  size_t       lens[ROWS_BODY_MAX_PARTS];
+  size_t       cnt = body_parts(parts, lens);
+  for (size_t i = 0; i < cnt; i++) {
+    res &= ostream->write(parts[i], lens[i]);
   }
   return res;
 }
@@ -230,87 +270,40 @@ size_t Rows_event::write_data_body_to_buffer(uchar *buffer)
   memcpy(current_pos, sbuf, sbuf_end - sbuf);
   current_pos += (sbuf_end - sbuf);
 
-  // 处理DELETE和UPDATE事件的before image
-  if (m_type == Log_event_type::UPDATE_ROWS_EVENT || m_type == Log_event_type::DELETE_ROWS_EVENT) {
-    int N = Get_N();
-    if (rows_before.size() != 0) {
-      memset(columns_before_image.get(), 0, N * sizeof(uchar));
-    }
-
-    for (int i = 0; i < rows_before.size(); i++) {
-      assert(rows_before[i] <= m_width);
-      int n = N - ((rows_before[i] - 1) / 8 + 1);
-      set_N_bit(*(columns_before_image.get() + n), (rows_before[i] - 1) % 8 + 1);
-    }
-
-    if (rows_before.size() != 0) {
-      size_t row_bitmap_size = (rows_before.size() + 7) / 8;
-      row_bitmap_before      = std::make_unique<uchar[]>(row_bitmap_size);
-      memset(row_bitmap_before.get(), 0x00, row_bitmap_size * sizeof(uchar));
+  // 写入 columns image、null bitmap 和 row 数据
+  const uchar *parts[ROWS_BODY_MAX_PARTS];
+  size_t       lens[ROWS_BODY_MAX_PARTS];
+  size_t       cnt = body_parts(parts, lens);
+  for (size_t i = 0; i < cnt; i++) {
+    if (lens[i] > 0) {
+      memcpy(current_pos, parts[i], lens[i]);
+      current_pos += lens[i];
     }
-
-    std::reverse(columns_before_image.get(), columns_before_image.get() + N);
-    memcpy(current_pos, columns_before_image.get(), N);
-    current_pos += N;
   }
 
-  // 处理WRITE和UPDATE事件的after image
-  if (m_type == Log_event_type::UPDATE_ROWS_EVENT || m_type == Log_event_type::WRITE_ROWS_EVENT) {
-    int N = Get_N();
-    if (rows_after.size() != 0) {
-      memset(columns_after_image.get(), 0, N * sizeof(uchar));
-    }
-
-    for (int i = 0; i < rows_after.size(); i++) {
-      assert(rows_after[i] <= m_width);
-      int n = N - ((rows_after[i] - 1) / 8 + 1);
-      set_N_bit(*(columns_after_image.get() + n), (rows_after[i] - 1) % 8 + 1);
-    }
-
-    if (rows_after.size() != 0) {
-      size_t row_bitmap_size = (rows_after.size() + 7) / 8;
-      row_bitmap_after       = std::make_unique<uchar[]>(row_bitmap_size);
-      memset(row_bitmap_after.get(), 0x00, row_bitmap_size * sizeof(uchar));
-    }
-
-    std::reverse(columns_after_image.get(), columns_after_image.get() + N);
-    memcpy(current_pos, columns_after_image.get(), N);
-    current_pos += N;
-  }
+  return current_pos - buffer;
+}
 
-  // 写入before数据
-  if (m_type == Log_event_type::UPDATE_ROWS_EVENT || m_type == Log_event_type::DELETE_ROWS_EVENT) {
-    int N = (rows_before.size() + 7) / 8;
-    for (int i = 0; i < null_before.size(); i++) {
-      if (null_before[i]) {
-        int n = N - (i / 8 + 1);
-        set_N_bit(*(row_bitmap_before.get() + n), i % 8 + 1);
-      }
-    }
-    std::reverse(row_bitmap_before.get(), row_bitmap_before.get() + N);
-    memcpy(current_pos, row_bitmap_before.get(), N);
-    current_pos += N;
+bool Rows_event::write_to_iovec(EventIovec &iov)
+{
+  uchar        sbuf[sizeof(m_width) + 1];
+  uchar *const sbuf_end  = net_store_length(sbuf, (size_t)m_width);
+  size_t       width_len = sbuf_end - sbuf;
 
-    memcpy(current_pos, m_rows_before_buf.get(), before_data_size_used);
-    current_pos += before_data_size_used;
+  // common-header + post-header + width 写进 scratch
+  uchar *header = iov.reserve(LOG_EVENT_HEADER_LEN + ROWS_HEADER_LEN_V2 + width_len);
+  if (header == nullptr) {
+    return false;
   }
-
-  // 写入after数据
-  if (m_type == Log_event_type::UPDATE_ROWS_EVENT || m_type == Log_event_type::WRITE_ROWS_EVENT) {
-    int N = (rows_after.size() + 7) / 8;
-    for (int i = 0; i < null_after.size(); i++) {
-      if (null_after[i]) {
-        int n = N - (i / 8 + 1);
-        set_N_bit(*(row_bitmap_after.get() + n), i % 8 + 1);
-      }
-    }
-    std::reverse(row_bitmap_after.get(), row_bitmap_after.get() + N);
-    memcpy(current_pos, row_bitmap_after.get(), N);
-    current_pos += N;
-
-    memcpy(current_pos, m_rows_after_buf.get(), after_data_size_used);
-    current_pos += after_data_size_used;
+  size_t pos = write_common_header_to_buffer(header);
+  pos += write_data_header_to_buffer(header + pos);
+  memcpy(header + pos, sbuf, width_len);
+
+  const uchar *parts[ROWS_BODY_MAX_PARTS];
+  size_t       lens[ROWS_BODY_MAX_PARTS];
+  size_t       cnt = body_parts(parts, lens);
+  for (size_t i = 0; i < cnt; i++) {
+    iov.append(parts[i], lens[i]);
   }
-
-  return current_pos - buffer;
+  return true;
 }
@@ -8,6 +8,10 @@
 #include <cstring> // std::strcmp
 
 #include "log_file.h"
+#include "binlog_sequencer.h"
+#include "partition_scheduler.h"
+#include "writeset_tracker.h"
+#include "coroutine_pipeline.h"
 #include "buffer_reader.h"
 
 /******************************************************************************
@@ -97,7 +101,7 @@ RC BinLogFileWriter::open(const char *filename, size_t max_file_size)
     filename_ = filename;
     // 这里仅是 初始化了文件信息，还没有 open 文件流
     RC ret;
-    bin_log_ = std::make_unique<MYSQL_BIN_LOG>(filename, max_file_size, ret);
+    bin_log_ = std::make_unique<MYSQL_BIN_LOG>(filename, max_file_size, ret, backend_, durability_);
     // 确保 open 失败时返回错误，而不是继续运行
     if (ret != RC::SUCCESS || bin_log_ == nullptr) {
       LOG_ERROR("Failed to create binlog file: %s", filename);
@@ -117,7 +121,9 @@ RC BinLogFileWriter::close()
         return RC::FILE_NOT_OPENED;
     }
 
-    return bin_log_->close(); // 正确返回  RC::SUCCESS;
+    RC rc = bin_log_->close(); // 正确返回  RC::SUCCESS;
+    bin_log_.reset();          // 重复 close 时直接返回 FILE_NOT_OPENED，而不是对已关闭的文件流 sync
+    return rc;
 }
 
 RC BinLogFileWriter::write(AbstractEvent &event) { return bin_log_->write_event_to_binlog(&event) ? RC::SUCCESS : RC::IOERR_EVENT_WRITE; }
@@ -126,25 +132,56 @@ RC BinLogFileWriter::write(AbstractEvent &event) { return bin_log_->write_event_
                      LogFileManager
 ******************************************************************************/
 
-LogFileManager::LogFileManager()
+LogFileManager::LogFileManager(const LogFileOptions &options)
     : file_reader_(std::make_unique<RedoLogFileReader>()),
-      file_writer_(std::make_unique<BinLogFileWriter>()),
+      options_(options),
+      memory_budget_(options.memory_budget),
+      batcher_(options.batch_min_size, options.batch_max_size, std::chrono::microseconds(options.batch_max_latency_us)),
+      file_writer_(std::make_unique<BinLogFileWriter>(options.backend, options.durability)),
       transform_manager_(std::make_unique<LogFormatTransformManager>()),
       ring_buffer_(std::make_shared<TaskQueue<Task>>(10000)) {
 
-  // 启动一个任务收集线程
-  task_collector_thread_ = std::thread(&LogFileManager::process_tasks, this);
+  if (options_.dependency_tracking == DependencyTracking::WRITESET) {
+    writeset_tracker_ = std::make_unique<WritesetTracker>(options_.writeset_history_size);
+  }
+
+  // 线程池的线程第一次记录 span 时才分配缓冲区，这里先打开
+  if (!options_.trace_file.empty()) {
+    Tracer::instance().start(options_.trace_events_per_thread);
+  }
 
   // 初始化线程池, 在 task_collector_thread_ 准备好一个 batch 任务之后，投入线程池中执行
-  thread_pool_ = std::make_unique<ThreadPoolExecutor>();
-  thread_pool_->init("LogProcessor", 1, 4, 1000);
+  create_executor();
+
+  // 收集线程、写线程启动前注册好，热路径上的指标指针不为空
+  register_metrics();
+
+  if (options_.write_mode == BinlogWriteMode::PARALLEL) {
+    sequencer_ = std::make_unique<BinlogSequencer>(this);
+  }
 
-  // 启动专门的写入线程
   result_queue_.stop_flag_ = &stop_flag_;  // 设置ResultQueue的stop_flag_指针
 
-  writer_thread_ = std::thread([this] {
-    result_queue_.process_writes(file_writer_.get(), this);
-  });
+  if (options_.pipeline == PipelineMode::COROUTINE) {
+    // 收集、转换、写入都是线程池上的协程，不再需要专门的线程
+    uint32 stages = options_.transform_stages;
+    if (stages == 0) {
+      stages = std::max(std::thread::hardware_concurrency(), 1U);
+    }
+    pipeline_ = std::make_unique<CoroutinePipeline>(this, thread_pool_.get(), stages);
+    pipeline_->start();
+  } else {
+    // 启动一个任务收集线程
+    task_collector_thread_ = std::thread(&LogFileManager::process_tasks, this);
+
+    // 启动专门的写入线程
+    writer_thread_ = std::thread([this] {
+      if (thread_bind_cpus(stage_cpus(options_.writer_cpus, "writer")) != 0) {
+        LOG_ERROR("bind writer thread to cpus failed. cpus=%s", options_.writer_cpus.c_str());
+      }
+      result_queue_.process_writes(file_writer_.get(), this);
+    });
+  }
   // 其他初始化操作可以放在这里，比如加载已有日志文件的索引，设置初始状态等
 
   start_time_ = std::chrono::high_resolution_clock::now();
@@ -225,6 +262,17 @@ RC LogFileManager::init(const char *directory, const char *file_name_prefix, uin
              directory_.c_str(), static_cast<int>(log_files_.size()));
 
 
+    // 写线程放到离输出设备最近的节点上，写线程在下一轮循环里迁过去
+    if (options_.writer_near_output && options_.writer_cpus.empty() && writer_thread_.joinable()) {
+      int node = numa_node_of_path(directory_.c_str());
+      if (node >= 0) {
+        writer_node_.store(node, std::memory_order_release);
+      } else {
+        LOG_INFO("cannot find numa node of binlog directory, writer thread is not placed. directory=%s",
+                 directory_.c_str());
+      }
+    }
+
     // 获得索引文件 句柄
     std::filesystem::path index_path = directory_ / (file_prefix_ + index_suffix_);
     index_fd_ = ::open(index_path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
@@ -257,23 +305,25 @@ RC LogFileManager::transform(std::vector<unsigned char> &&buf, bool is_ddl) {
  * @return
  */
 std::future<RC> LogFileManager::transformAsync(std::vector<unsigned char>&& buf, bool is_ddl) {
+  AllocStageScope alloc_stage(AllocStage::INGEST);
   auto promise = std::make_shared<std::promise<RC>>();
   auto future = promise->get_future();
 
   try {
-
-    Task task(std::move(buf), is_ddl);
-
-    if (!ring_buffer_->write(std::move(task))) {
+    // 先申请预算再移走 buf：写线程跟不上时在这里把生产者拖慢，超时就让调用方稍后重试
+    size_t bytes = sizeof(Task) + buf.capacity();
+    if (!memory_budget_.acquire(bytes, std::chrono::milliseconds(options_.admission_timeout_ms))) {
       promise->set_value(RC::SPEED_LIMIT);
       return future;
     }
 
+    // 预算已经限住了在途的数据量，队列满时 write 只会短暂阻塞，不会失败
+    Task task(std::move(buf), is_ddl);
+    ring_buffer_->write(std::move(task));
+
     size_t current_pending = ++pending_tasks_;
-    // 只有当积累了足够的任务或者是DDL任务时才通知消费者
-    if (current_pending >= BATCH_SIZE) {
-      task_cond_.notify_one();
-    }
+    // DDL 之后的记录要等它的 binlog 写完才有意义，不再攒 batch
+    notify_collector(current_pending, 1, is_ddl);
 
     promise->set_value(RC::SUCCESS);
   } catch (const std::exception& e) {
@@ -283,6 +333,53 @@ std::future<RC> LogFileManager::transformAsync(std::vector<unsigned char>&& buf,
   return future;
 }
 
+BatchHandle LogFileManager::transformBatch(std::span<Task> records) {
+  AllocStageScope alloc_stage(AllocStage::INGEST);
+  auto completion = std::make_shared<BatchCompletion>(records.size());
+  RC rc = submit_batch(records, completion);
+  if (LOFT_FAIL(rc)) {
+    completion->finish(records.size(), rc);
+  }
+  return completion;
+}
+
+RC LogFileManager::transformBatch(std::span<Task> records, BatchCompletion::Callback callback) {
+  AllocStageScope alloc_stage(AllocStage::INGEST);
+  auto completion = std::make_shared<BatchCompletion>(records.size(), std::move(callback));
+  RC rc = submit_batch(records, completion);
+  if (LOFT_FAIL(rc)) {
+    completion->finish(records.size(), rc);
+  }
+  return rc;
+}
+
+RC LogFileManager::submit_batch(std::span<Task> records, const BatchHandle &completion) {
+  // 整批一次申请预算，申请不到就一条都不放，records 保持原样
+  size_t bytes = 0;
+  for (const auto &record : records) {
+    bytes += task_bytes(record);
+  }
+  if (!memory_budget_.acquire(bytes, std::chrono::milliseconds(options_.admission_timeout_ms))) {
+    return RC::SPEED_LIMIT;
+  }
+
+  if (records.empty()) {
+    completion->finish(0, RC::SUCCESS);
+    return RC::SUCCESS;
+  }
+
+  bool has_ddl = false;
+  for (auto &record : records) {
+    record.completion_ = completion;
+    has_ddl |= record.is_ddl_;
+  }
+  // 收集线程只取计入 pending_tasks_ 的任务，所以每写入一段就要计数，不能等整批写完
+  ring_buffer_->push_bulk(records.data(), records.size(), [this, has_ddl](size_t pushed) {
+    notify_collector(pending_tasks_ += pushed, pushed, has_ddl);
+  });
+  return RC::SUCCESS;
+}
+
 RC LogFileManager::get_fileno_from_filename(
     const std::string &filename, uint32_t &fileno
 ) {
@@ -316,16 +413,13 @@ RC LogFileManager::last_file(BinLogFileWriter &file_writer) {
 }
 
 RC LogFileManager::next_file(BinLogFileWriter &file_writer) {
+    TraceSpan span("rotate", "writer");
+    auto rotate_start = std::chrono::steady_clock::now();
 
-    // 最小从 1 开始
-    uint32_t fileno = log_files_.empty() ? 1 : log_files_.rbegin()->first + 1;
-
-    std::ostringstream oss;
-    oss << std::setw(6) << std::setfill('0') << fileno;
-    file_suffix_ = oss.str();
-
-    std::string nextFilename = file_prefix_ + std::string(file_dot_) + file_suffix_;
-    std::filesystem::path next_file_path = directory_ / nextFilename;
+    uint32_t fileno = 0;
+    std::string nextFilename;
+    std::filesystem::path next_file_path;
+    next_file_name(fileno, nextFilename, next_file_path);
 
     if (!log_files_.empty()) {
         // 在上一个文件中，写入一个 rotate event 再关闭
@@ -337,15 +431,38 @@ RC LogFileManager::next_file(BinLogFileWriter &file_writer) {
         file_writer.close();
     }
 
+    register_file(fileno, nextFilename, next_file_path);
+
+    RC rc = file_writer.open(next_file_path.c_str(), max_file_size_per_file_);
+    metric_rotate_time_->record_duration(std::chrono::steady_clock::now() - rotate_start);
+    return rc;
+}
+
+RC LogFileManager::next_file_name(uint32 &fileno, std::string &filename, std::filesystem::path &file_path) {
+
+    // 最小从 1 开始
+    fileno = log_files_.empty() ? 1 : log_files_.rbegin()->first + 1;
+
+    std::ostringstream oss;
+    oss << std::setw(6) << std::setfill('0') << fileno;
+    file_suffix_ = oss.str();
+
+    filename = file_prefix_ + std::string(file_dot_) + file_suffix_;
+    file_path = directory_ / filename;
+    return RC::SUCCESS;
+}
 
-    log_files_.emplace(fileno, next_file_path);
+RC LogFileManager::register_file(uint32 fileno, const std::string &filename, const std::filesystem::path &file_path) {
+
+    log_files_.emplace(fileno, file_path);
     // 写入索引文件
-    write_filename2index(nextFilename);
+    std::string index_line = filename;
+    RC rc = write_filename2index(index_line);
 
-    LOG_DEBUG("[==rotate file==]next file name = %s", next_file_path.c_str());
+    LOG_DEBUG("[==rotate file==]next file name = %s", file_path.c_str());
 
     last_file_no_.store(fileno, std::memory_order_release);  // 更新当前文件号
-    return file_writer.open(next_file_path.c_str(), max_file_size_per_file_);
+    return rc;
 }
 
 RC LogFileManager::write_filename2index(std::string &filename) {
@@ -421,40 +538,336 @@ RC LogFileManager::get_last_status_from_filename(
 }
 
 void LogFileManager::process_tasks() {
+  // 收集线程攒 batch、创建 processor 的分配都算在 ingest 上
+  AllocStageScope alloc_stage(AllocStage::INGEST);
+  // 收集线程是 ring buffer 唯一的消费者，槽位放在它所在的节点上
+  std::vector<int> cpus = stage_cpus(options_.collector_cpus, "collector");
+  if (thread_bind_cpus(cpus) != 0) {
+    LOG_ERROR("bind collector thread to cpus failed. cpus=%s", options_.collector_cpus.c_str());
+  } else if (!cpus.empty()) {
+    int node = numa_node_of_cpu(cpus.front());
+    if (node >= 0 && ring_buffer_->bind_memory_node(node) != 0) {
+      LOG_INFO("move ring buffer to numa node failed. node=%d", node);
+    }
+  }
+
+  auto ready = [this] {
+    return stop_flag_ || flush_requested_ || pending_tasks_ >= batcher_.target();
+  };
 
   while (!stop_flag_) {
     std::vector<Task> batch_tasks;
-    batch_tasks.reserve(BATCH_SIZE);
+    std::chrono::steady_clock::time_point busy_start;
 
     {
       std::unique_lock<std::mutex> lock(task_mutex_);
+      // 空闲时等第一条记录到达，生产者在队列从空变为非空时会通知
       task_cond_.wait_for(lock,
           std::chrono::milliseconds(100),
           [this] {
-            return stop_flag_ || pending_tasks_ > 0;  // 只要有任务就处理
+            return stop_flag_ || pending_tasks_ > 0;
           });
 
-      if (stop_flag_ && pending_tasks_ == 0) break;
+      // 再等到攒够目标大小，或者最早的记录到了 deadline
+      if (pending_tasks_ > 0 && !ready()) {
+        auto deadline = std::chrono::steady_clock::time_point(
+            std::chrono::nanoseconds(first_pending_ns_.load(std::memory_order_relaxed))) + batcher_.max_latency();
+        task_cond_.wait_until(lock, deadline, ready);
+      }
 
-      size_t tasks_to_read = std::min(pending_tasks_.load(), BATCH_SIZE);
-      for (size_t i = 0; i < tasks_to_read; ++i) {
-        Task task;
-        if (ring_buffer_->read(task)) {
-          batch_tasks.push_back(std::move(task));
-          --pending_tasks_;
-        }
+      if (stop_flag_ && pending_tasks_ == 0) break;
+      flush_requested_ = false;
+
+      auto now = std::chrono::steady_clock::now();
+      busy_start = now;
+      batcher_.observe_arrivals(collected_total_ + pending_tasks_.load(), now);
+
+      // 只取已经计入 pending_tasks_ 的任务，一次 pop_bulk 取走整个 batch
+      size_t tasks_to_read = std::min(pending_tasks_.load(), batcher_.max_batch());
+      batch_tasks.reserve(tasks_to_read);
+      size_t read = ring_buffer_->pop_bulk(batch_tasks, tasks_to_read);
+      collected_total_ += read;
+      // 剩下的记录从现在开始计 deadline
+      if ((pending_tasks_ -= read) > 0) {
+        first_pending_ns_.store(now.time_since_epoch().count(), std::memory_order_relaxed);
       }
     } // 释放锁
 
     if (!batch_tasks.empty()) {
-      auto processor = std::make_shared<BatchProcessor>(
-          this, std::move(batch_tasks), batch_sequence_++);
+      if (concurrency_ != nullptr) {
+        // 上一个 batch 还没被 worker 取走，说明 worker 不够用
+        concurrency_->observe_backlog(static_cast<ThreadPoolExecutor *>(thread_pool_.get())->queue_size() > 0);
+      }
+      int64 collected = static_cast<int64>(batch_tasks.size());
+      dispatch_batch(std::move(batch_tasks));
+      auto busy_end = std::chrono::steady_clock::now();
+      collector_busy_ns_ += std::chrono::duration_cast<std::chrono::nanoseconds>(busy_end - busy_start).count();
+      Tracer::instance().record("collect", "collector", Tracer::ns_of(busy_start), Tracer::ns_of(busy_end), collected);
+    }
+    tune_workers();
+  }
+}
+
+std::vector<int> LogFileManager::stage_cpus(const std::string &cpu_list, const char *stage) {
+  std::vector<int> cpus;
+  if (parse_cpu_list(cpu_list, cpus) != 0) {
+    LOG_ERROR("invalid cpu list, %s thread is not bound. cpus=%s", stage, cpu_list.c_str());
+  }
+  return cpus;
+}
 
-      thread_pool_->execute([processor] {
-        processor->run();
+void LogFileManager::place_writer_thread() {
+  int node = writer_node_.load(std::memory_order_acquire);
+  if (node < 0 || node == placed_writer_node_) {
+    return;
+  }
+  placed_writer_node_ = node;
+
+  // 绑到整个节点的 CPU 上，thread_bind_cpus 同时把内存分配偏好设为这个节点，之后写线程打开的文件、
+  // mmap 的页、拼 iovec 的 buffer 都在这个节点上
+  std::vector<int> cpus;
+  if (numa_node_cpus(node, cpus) != 0 || thread_bind_cpus(cpus) != 0) {
+    LOG_ERROR("bind writer thread to numa node failed. node=%d", node);
+    return;
+  }
+  LOG_INFO("writer thread placed on numa node %d, near binlog directory %s", node, directory_.c_str());
+}
+
+void LogFileManager::tune_workers() {
+  if (concurrency_ == nullptr) {
+    return;
+  }
+  size_t transformed = transformed_batches_.load();
+  size_t written     = written_batches_.load();
+  size_t unwritten   = transformed > written ? transformed - written : 0;
+  if (!concurrency_->update(processed_tasks_.load(), unwritten, std::chrono::steady_clock::now())) {
+    return;
+  }
+  static_cast<ThreadPoolExecutor *>(thread_pool_.get())->set_active_limit(concurrency_->limit());
+  LOG_DEBUG("transform workers: %d, throughput: %.0f records/s, per worker: %.0f records/s, unwritten batches: %zu",
+      concurrency_->limit(),
+      concurrency_->throughput(),
+      concurrency_->worker_throughput(),
+      unwritten);
+}
+
+void LogFileManager::notify_collector(size_t current_pending, size_t added, bool urgent) {
+  bool first = current_pending == added;
+  if (first) {
+    first_pending_ns_.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+  }
+  if (urgent) {
+    flush_requested_ = true;
+  }
+  if (pipeline_ != nullptr) {
+    pipeline_->wake();
+    return;
+  }
+
+  // 只在状态变化时通知：开始计 deadline、刚好攒够目标大小、要求立即投递
+  size_t target = batcher_.target();
+  if (first || urgent || (current_pending >= target && current_pending - added < target)) {
+    // 在锁内通知，收集线程检查条件和进入等待之间不会漏掉
+    std::lock_guard<std::mutex> lock(task_mutex_);
+    task_cond_.notify_one();
+  }
+}
+
+void LogFileManager::flush() {
+  flush_requested_ = true;
+  if (pipeline_ != nullptr) {
+    pipeline_->wake();
+    return;
+  }
+  std::lock_guard<std::mutex> lock(task_mutex_);
+  task_cond_.notify_one();
+}
+
+void LogFileManager::dispatch_batch(std::vector<Task> &&batch_tasks) {
+  // 逻辑时钟要按 binlog 的输出顺序分配，转换是并发的，所以在收集线程里先算好
+  if (writeset_tracker_ != nullptr) {
+    writeset_tracker_->track(batch_tasks, options_.scheduler == SchedulerType::PARTITIONED);
+  }
+
+  if (options_.scheduler == SchedulerType::PARTITIONED) {
+    uint32 partitions = options_.partitions;
+    if (partitions == 0) {
+      partitions = std::max(std::thread::hardware_concurrency(), 1U);
+    }
+    // 最后一个单元执行完时提交整个 batch，processor 的生命周期由投递出去的单元共同持有
+    auto processor = std::make_shared<PartitionedBatchProcessor>(
+        this, std::move(batch_tasks), batch_sequence_++, partitions);
+    processor->start();
+    return;
+  }
+
+  auto processor = std::make_shared<BatchProcessor>(
+      this, std::move(batch_tasks), batch_sequence_++);
+
+  // 使用值捕获来确保processor的生命周期
+  batch_group_->run([processor] {
+    processor->run();
+  });
+}
+
+void LogFileManager::create_executor() {
+  // 旧的 group 引用着旧的线程池，要先于线程池销毁
+  batch_group_.reset();
+  concurrency_.reset();
+  if (options_.executor == ExecutorType::WORK_STEALING) {
+    auto executor = std::make_unique<WorkStealingExecutor>();
+    executor->set_thread_cpus(stage_cpus(options_.worker_cpus, "worker"));
+    executor->init("LogProcessor", options_.worker_threads);
+    thread_pool_ = std::move(executor);
+  } else {
+    int max_workers = options_.max_workers;
+    if (max_workers <= 0) {
+      max_workers = static_cast<int>(std::max(std::thread::hardware_concurrency(), 1U));
+    }
+    int min_workers = std::clamp(options_.min_workers, 1, max_workers);
+
+    auto executor = std::make_unique<ThreadPoolExecutor>();
+    executor->set_thread_cpus(stage_cpus(options_.worker_cpus, "worker"));
+    executor->init("LogProcessor", min_workers, max_workers, 1000);
+    // COROUTINE 模式没有收集线程来驱动采样，固定用 max_workers 个线程
+    if (options_.autoscale_interval_ms > 0 && options_.pipeline == PipelineMode::THREADED) {
+      concurrency_ = std::make_unique<ConcurrencyController>(
+          min_workers, max_workers, std::chrono::milliseconds(options_.autoscale_interval_ms));
+      executor->set_active_limit(concurrency_->limit());
+    }
+    thread_pool_ = std::move(executor);
+  }
+  batch_group_ = std::make_unique<TaskGroup>(thread_pool_.get());
+}
+
+void LogFileManager::register_metrics() {
+  metric_batch_time_ = metrics_.histogram("loft_batch_transform_seconds", "Time to transform one batch of redo records.", 1e-9);
+  metric_rotate_time_ = metrics_.histogram("loft_binlog_rotate_seconds", "Time to rotate to a new binlog file.", 1e-9);
+  metric_sync_time_ = metrics_.histogram("loft_binlog_sync_seconds", "Time to flush or fsync a written batch.", 1e-9);
+  metric_bytes_written_ = metrics_.counter("loft_binlog_written_bytes_total", "Bytes of binlog events handed to the writer.");
+  replication_lag_ = std::make_unique<ReplicationLagTracker>(metrics_);
+
+  // 队列深度和进度计数在导出时读取
+  metrics_.callback("loft_task_queue_depth", "Records submitted but not yet collected into a batch.", MetricType::GAUGE,
+      [this] { return static_cast<double>(pending_tasks_.load()); });
+  metrics_.callback("loft_thread_pool_queue_depth", "Batches waiting for a transform worker.", MetricType::GAUGE,
+      [this] {
+        auto *executor = dynamic_cast<ThreadPoolExecutor *>(thread_pool_.get());
+        return executor != nullptr ? static_cast<double>(executor->queue_size()) : 0.0;
       });
+  metrics_.callback("loft_result_queue_depth", "Transformed batches waiting for the writer.", MetricType::GAUGE,
+      [this] {
+        std::lock_guard<std::mutex> lock(result_queue_.mutex_);
+        return static_cast<double>(result_queue_.pending_results_.size());
+      });
+  metrics_.callback("loft_processed_records_total", "Redo records transformed.", MetricType::COUNTER,
+      [this] { return static_cast<double>(processed_tasks_.load()); });
+  metrics_.callback("loft_written_events_total", "Binlog events written.", MetricType::COUNTER,
+      [this] { return static_cast<double>(written_tasks_.load()); });
+  metrics_.callback("loft_memory_budget_used_bytes", "Bytes held against the pipeline memory budget.",
+      MetricType::GAUGE, [this] { return static_cast<double>(memory_budget_.used()); });
+
+  if (alloc_accounting_enabled()) {
+    for (size_t i = 0; i < static_cast<size_t>(AllocStage::COUNT); i++) {
+      auto         stage  = static_cast<AllocStage>(i);
+      MetricLabels labels = {{"stage", alloc_stage_name(stage)}};
+      metrics_.callback("loft_alloc_bytes_total", "Bytes allocated with operator new, by pipeline stage.",
+          MetricType::COUNTER, [stage] { return static_cast<double>(alloc_stats(stage).allocated_bytes); }, labels);
+      metrics_.callback("loft_alloc_total", "operator new calls, by pipeline stage.",
+          MetricType::COUNTER, [stage] { return static_cast<double>(alloc_stats(stage).allocations); }, labels);
+      metrics_.callback("loft_alloc_live_bytes", "Bytes allocated by a stage and not yet freed.",
+          MetricType::GAUGE, [stage] { return static_cast<double>(alloc_stats(stage).live_bytes); }, labels);
+      metrics_.callback("loft_alloc_peak_bytes", "Highest live bytes seen for a stage.",
+          MetricType::GAUGE, [stage] { return static_cast<double>(alloc_stats(stage).peak_bytes); }, labels);
     }
   }
+
+  if (!options_.metrics_textfile.empty()) {
+    metrics_exporter_ = std::make_unique<MetricsExporter>(
+        metrics_, options_.metrics_textfile, std::chrono::milliseconds(options_.metrics_interval_ms));
+    metrics_exporter_->start();
+    LOG_INFO("metrics textfile exporter started. path=%s, interval=%ums",
+        options_.metrics_textfile.c_str(), options_.metrics_interval_ms);
+  }
+}
+
+void LogFileManager::count_table_rows(const std::vector<Task> &tasks) {
+  auto view = [](const flatbuffers::String *str) {
+    return str == nullptr ? std::string_view() : std::string_view(str->c_str(), str->size());
+  };
+
+  Counter *current = nullptr;
+  uint64   rows    = 0;
+  for (const auto &task : tasks) {
+    if (task.is_ddl_) {
+      continue;
+    }
+    const DML *dml     = GetDML(task.data_.data());
+    Counter   *counter = table_rows_counter(view(dml->db_name()), view(dml->table_()));
+    if (counter != current) {
+      if (current != nullptr) {
+        current->add(rows);
+      }
+      current = counter;
+      rows    = 0;
+    }
+    rows++;
+  }
+  if (current != nullptr) {
+    current->add(rows);
+  }
+}
+
+Counter *LogFileManager::table_rows_counter(std::string_view db, std::string_view table) {
+  {
+    std::shared_lock<std::shared_mutex> lock(table_rows_mutex_);
+    auto db_it = table_rows_.find(db);
+    if (db_it != table_rows_.end()) {
+      auto it = db_it->second.find(table);
+      if (it != db_it->second.end()) {
+        return it->second;
+      }
+    }
+  }
+
+  std::unique_lock<std::shared_mutex> lock(table_rows_mutex_);
+  auto db_it = table_rows_.find(db);
+  if (db_it == table_rows_.end()) {
+    db_it = table_rows_.emplace(std::string(db), TableCounters()).first;
+  }
+  auto it = db_it->second.find(table);
+  if (it != db_it->second.end()) {
+    return it->second;
+  }
+
+  // 表很多时每张表一个时间序列会撑爆监控系统，超出上限的表合并成一个
+  std::string label = "_other";
+  if (table_rows_series_ < MAX_TABLE_ROW_SERIES) {
+    label.clear();
+    if (!db.empty()) {
+      label.append(db).push_back('.');
+    }
+    label.append(table);
+    table_rows_series_++;
+  }
+  Counter *counter = metrics_.counter("loft_table_rows_total", "Row changes transformed per table.", {{"table", label}});
+  db_it->second.emplace(std::string(table), counter);
+  return counter;
+}
+
+void LogFileManager::count_written_bytes(const BatchResult &result) {
+  uint64 bytes = 0;
+  for (const auto &data : result.transformed_data) {
+    bytes += data.size();
+  }
+  metric_bytes_written_->add(bytes);
+}
+
+void LogFileManager::dispatch_parallel_write(std::unique_ptr<BatchResult> result) {
+  RC rc = sequencer_->dispatch(std::move(result));
+  if (LOFT_FAIL(rc)) {
+    LOG_ERROR("dispatch parallel binlog write failed. rc=%s", strrc(rc));
+  }
 }
 
 void LogFileManager::shutdown() {
@@ -466,8 +879,18 @@ void LogFileManager::shutdown() {
 
     // 2. 设置停止标志，阻止新任务提交
     stop_flag_ = true;
+    {
+      std::lock_guard<std::mutex> lock(task_mutex_);
+      task_cond_.notify_all();
+    }
+    memory_budget_.close();  // 还在等预算的生产者立即返回 SPEED_LIMIT
     LOG_DEBUG("Stop flag set, no new tasks will be accepted");
 
+    // 3.0 COROUTINE 模式下没有收集线程和写线程，等各阶段协程退出
+    if (pipeline_ != nullptr) {
+      LOG_DEBUG("Waiting for coroutine pipeline stages to exit");
+      pipeline_->stop();
+    }
 
     // 3. 等待收集线程结束
     if (task_collector_thread_.joinable()) {
@@ -481,11 +904,27 @@ void LogFileManager::shutdown() {
       writer_thread_.join();
     }
 
+    // 4.1 并发写模式下，写线程只负责定序，还要等 worker 把已分配好的区间写完，再封存当前文件
+    if (sequencer_ != nullptr) {
+      LOG_DEBUG("Waiting for parallel binlog writes to drain");
+      sequencer_->drain();
+      sequencer_->close();
+    }
+
     // 5. 关闭线程池
     LOG_DEBUG("Shutting down thread pool");
     thread_pool_->shutdown();
-    LOG_DEBUG("Thread pool max size was: %d", thread_pool_->largest_pool_size());
+    thread_pool_->await_termination();
+    LOG_DEBUG("Thread pool size: %d, executed tasks: %ld", thread_pool_->pool_size(), thread_pool_->task_count());
 
+    // 6. 所有阶段都已退出，停止导出线程并写最后一次
+    if (metrics_exporter_ != nullptr) {
+      metrics_exporter_->stop();
+    }
+    if (!options_.trace_file.empty()) {
+      Tracer::instance().stop();
+      Tracer::instance().write_chrome_json(options_.trace_file);
+    }
 
     // 7. 记录总执行时间
     auto endTime = std::chrono::high_resolution_clock::now();
@@ -503,15 +942,17 @@ void LogFileManager::wait_for_completion() {
 
   // 1. 等待任务入队完成
   while (pending_tasks_ > 0) {
-    {
-      std::unique_lock<std::mutex> lock(task_mutex_);
-      task_cond_.notify_one();  // 通知处理线程处理剩余任务
-    }
+    flush();  // 通知处理线程立即处理剩余任务
     std::this_thread::sleep_for(std::chrono::milliseconds(50));
   }
 
-  // 2. 等待线程池中的任务执行完成
-  thread_pool_->await_termination();
+  // COROUTINE 模式：等待 collect 已取走的 batch 全部写完
+  if (pipeline_ != nullptr) {
+    pipeline_->drain();
+  }
+
+  // 2. 等待已投递的 batch 全部转换完成，线程池保持运行
+  batch_group_->wait();
 
   // 3. 等待写入队列完成
   {
@@ -529,13 +970,17 @@ void LogFileManager::wait_for_completion() {
  * @brief [only] 内部测试
  */
 void LogFileManager::preload_tasks(const std::vector<Task> &tasks) {
+  if (pipeline_ != nullptr) {
+    // 协程流水线的各阶段挂在 thread_pool_ 上，下面重建执行器会让它们引用已经销毁的线程池
+    LOG_ERROR("preload_tasks is not supported in coroutine pipeline mode, use transformBatch instead");
+    return;
+  }
 
   preloaded_tasks_ = tasks;  // 复制所有任务
 
   // 1. 开始计时点移到这里
   start_time_ = std::chrono::high_resolution_clock::now();
-  thread_pool_ = std::make_unique<ThreadPoolExecutor>();
-  thread_pool_->init("LogProcessor", 1, 4, 1000);
+  create_executor();
 //  batch_queue_.stop_flag_ = &stop_flag_;  // 设置BatchQueue的stop_flag_指针
   result_queue_.stop_flag_ = &stop_flag_;  // 设置ResultQueue的stop_flag_指针
 
@@ -556,13 +1001,14 @@ void LogFileManager::preload_tasks(const std::vector<Task> &tasks) {
     }
     // 准备好 preloaded_tasks_ 后马上就可以初始化 batch_queue_，从这里开始计时
     if (!batch_tasks.empty()) {
-      auto processor = std::make_shared<BatchProcessor>(
-          this, std::move(batch_tasks), batch_sequence_++);
+      // 预加载的任务没有经过 transformAsync，在这里补记账，BatchProcessor 会按同样的规则归还
+      size_t batch_bytes = 0;
+      for (const auto &task : batch_tasks) {
+        batch_bytes += task_bytes(task);
+      }
+      memory_budget_.force_acquire(batch_bytes);
 
-      // 使用值捕获来确保processor的生命周期
-      thread_pool_->execute([processor] {
-        processor->run();
-      });
+      dispatch_batch(std::move(batch_tasks));
 
     }
 
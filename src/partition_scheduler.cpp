@@ -0,0 +1,204 @@
+//
+// Created by Coonger on 2024/12/11.
+//
+
+#include "partition_scheduler.h"
+
+#include <algorithm>
+#include <numeric>
+#include <string_view>
+
+PartitionedBatchProcessor::PartitionedBatchProcessor(
+    LogFileManager *manager, std::vector<Task> &&tasks, size_t sequence, uint32 partitions)
+    : manager_(manager), tasks_(std::move(tasks)), batch_sequence_(sequence), partitions_(std::max(partitions, 1U))
+{}
+
+bool PartitionedBatchProcessor::route(const Task &task, uint32 &partition, int64 &scn, int &priority) const
+{
+  const flatbuffers::String *db_name;
+  const flatbuffers::String *table;
+  if (task.is_ddl_) {
+    const DDL *ddl = GetDDL(task.data_.data());
+    db_name  = ddl->db_name();
+    table    = ddl->table_();
+    scn      = ddl->scn();
+    priority = PRIORITY_DDL;
+  } else {
+    const DML *dml = GetDML(task.data_.data());
+    db_name  = dml->db_name();
+    table    = dml->table_();
+    scn      = dml->scn();
+    bool insert = dml->op_type() != nullptr && std::string_view(dml->op_type()->c_str()) == "I";
+    priority    = insert ? PRIORITY_INSERT : PRIORITY_OTHER;
+  }
+
+  if (table == nullptr || table->size() == 0) {
+    // CREATE DATABASE 之类没有表名的 DDL 不知道会影响哪些表，按全局屏障处理
+    partition = 0;
+    return !task.is_ddl_;
+  }
+
+  size_t hash = std::hash<std::string_view>()(std::string_view(table->c_str(), table->size()));
+  if (db_name != nullptr) {
+    hash = hash * 31 + std::hash<std::string_view>()(std::string_view(db_name->c_str(), db_name->size()));
+  }
+  partition = static_cast<uint32>(hash % partitions_);
+  return true;
+}
+
+void PartitionedBatchProcessor::add_edge(Unit *from, Unit *to)
+{
+  // 连续的 DDL 之间，前一个会是多个分区的最后一个单元，只记一条边
+  if (!from->successors.empty() && from->successors.back() == to) {
+    return;
+  }
+  from->successors.push_back(to);
+  to->dependencies.fetch_add(1, std::memory_order_relaxed);
+}
+
+void PartitionedBatchProcessor::start()
+{
+  start_time_ = std::chrono::steady_clock::now();
+  slots_.resize(tasks_.size());
+
+  std::vector<Unit *> last(partitions_, nullptr);  // 每个分区上最后一个单元
+  std::vector<Unit *> open(partitions_, nullptr);  // 每个分区上还能继续追加 DML 的单元
+
+  for (size_t i = 0; i < tasks_.size(); i++) {
+    uint32 partition = 0;
+    int    priority  = PRIORITY_OTHER;
+    bool   local     = route(tasks_[i], partition, slots_[i].scn, priority);
+
+    if (tasks_[i].is_ddl_) {
+      units_.emplace_back(std::make_unique<Unit>());
+      Unit *barrier     = units_.back().get();
+      barrier->priority = priority;
+      barrier->records.push_back(i);
+
+      uint32 begin = local ? partition : 0;
+      uint32 end   = local ? partition + 1 : partitions_;
+      for (uint32 p = begin; p < end; p++) {
+        if (last[p] != nullptr) {
+          add_edge(last[p], barrier);
+        }
+        last[p] = barrier;
+        open[p] = nullptr;
+      }
+      continue;
+    }
+
+    Unit *unit = open[partition];
+    if (unit == nullptr) {
+      units_.emplace_back(std::make_unique<Unit>());
+      unit = units_.back().get();
+      unit->priority = priority;
+      if (last[partition] != nullptr) {
+        add_edge(last[partition], unit);
+      }
+      last[partition] = unit;
+      open[partition] = unit;
+    }
+    unit->records.push_back(i);
+    unit->priority = std::min(unit->priority, priority);
+  }
+
+  if (units_.empty()) {
+    finish();
+    return;
+  }
+
+  remaining_units_.store(units_.size());
+  std::vector<Unit *> ready;
+  for (auto &unit : units_) {
+    if (unit->dependencies.load(std::memory_order_relaxed) == 0) {
+      ready.push_back(unit.get());
+    }
+  }
+  schedule(ready);
+}
+
+void PartitionedBatchProcessor::schedule(std::vector<Unit *> &ready)
+{
+  std::stable_sort(ready.begin(), ready.end(), [](const Unit *a, const Unit *b) { return a->priority < b->priority; });
+
+  auto self = shared_from_this();
+  for (Unit *unit : ready) {
+    int ret = manager_->batch_group_->run([self, unit] { self->run_unit(unit); });
+    if (ret != 0) {
+      // 线程池已经关闭，就地转换，保证 batch 仍然能提交
+      run_unit(unit);
+    }
+  }
+}
+
+void PartitionedBatchProcessor::run_unit(Unit *unit)
+{
+  TraceSpan       span("transform_unit", "transform", static_cast<int64>(batch_sequence_));
+  AllocStageScope alloc_stage(AllocStage::RESULT);
+  auto unit_start = std::chrono::steady_clock::now();
+  for (size_t index : unit->records) {
+    Slot &slot      = slots_[index];
+    slot.unit       = unit;
+    slot.data_begin = unit->output.transformed_data.size();
+    slot.ckp_begin  = unit->output.ckps.size();
+    LogFileManager::BatchProcessor::transform(manager_, tasks_[index], unit->output);
+    slot.data_end = unit->output.transformed_data.size();
+    slot.ckp_end  = unit->output.ckps.size();
+  }
+  manager_->transform_busy_ns_ +=
+      std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - unit_start).count();
+
+  std::vector<Unit *> ready;
+  for (Unit *successor : unit->successors) {
+    if (successor->dependencies.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      ready.push_back(successor);
+    }
+  }
+  if (!ready.empty()) {
+    schedule(ready);
+  }
+
+  if (remaining_units_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    finish();
+  }
+}
+
+void PartitionedBatchProcessor::finish()
+{
+  AllocStageScope alloc_stage(AllocStage::RESULT);
+
+  // 分区内已经是到达顺序，这里只需要按 scn 稳定排序，scn 相同的保持到达顺序
+  std::vector<size_t> order(tasks_.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(
+      order.begin(), order.end(), [this](size_t a, size_t b) { return slots_[a].scn < slots_[b].scn; });
+
+  auto result = std::make_unique<LogFileManager::BatchResult>(batch_sequence_);
+  result->transformed_data.reserve(tasks_.size() * 5);
+  result->ckps.reserve(tasks_.size() * 5);
+
+  size_t input_bytes = 0;
+  for (size_t index : order) {
+    const Slot &slot = slots_[index];
+    auto       &out  = slot.unit->output;
+    std::move(out.transformed_data.begin() + slot.data_begin,
+        out.transformed_data.begin() + slot.data_end,
+        std::back_inserter(result->transformed_data));
+    std::move(out.ckps.begin() + slot.ckp_begin, out.ckps.begin() + slot.ckp_end, std::back_inserter(result->ckps));
+
+    input_bytes += LogFileManager::task_bytes(tasks_[index]);
+    result->add_completion(tasks_[index].completion_);
+  }
+  // zero-copy 的 event 只需要和 result 同生命周期，顺序无关
+  for (auto &unit : units_) {
+    std::move(unit->output.events.begin(), unit->output.events.end(), std::back_inserter(result->events));
+    result->source.merge(unit->output.source);
+  }
+  units_.clear();
+
+  auto elapsed = std::chrono::steady_clock::now() - start_time_;
+  manager_->batcher_.record_batch(tasks_.size(), elapsed);
+  manager_->metric_batch_time_->record_duration(elapsed);
+  manager_->count_table_rows(tasks_);
+  LogFileManager::BatchProcessor::commit(manager_, std::move(result), std::move(tasks_), input_bytes);
+}
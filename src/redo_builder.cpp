@@ -0,0 +1,154 @@
+//
+// Created by Coonger on 2024/12/16.
+//
+
+#include "redo_builder.h"
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+#include "utils/base64.h"
+
+namespace loft {
+
+RedoRecordBuilder::Value RedoRecordBuilder::Value::of_long(int64 value)
+{
+  Value v;
+  v.kind       = DataMeta_LongVal;
+  v.long_value = value;
+  return v;
+}
+
+RedoRecordBuilder::Value RedoRecordBuilder::Value::of_double(double value)
+{
+  Value v;
+  v.kind         = DataMeta_DoubleVal;
+  v.double_value = value;
+  return v;
+}
+
+RedoRecordBuilder::Value RedoRecordBuilder::Value::of_string(std::string value)
+{
+  Value v;
+  v.kind         = DataMeta_StringVal;
+  v.string_value = std::move(value);
+  return v;
+}
+
+std::vector<uint8> RedoRecordBuilder::dml(const Header &header, const std::string &db, const std::string &table,
+    const char *op_type, const std::vector<Column> &columns, const Row &keys, const Row &data)
+{
+  fbb_.Clear();
+
+  std::vector<flatbuffers::Offset<Field>> fields;
+  fields.reserve(columns.size());
+  for (const Column &column : columns) {
+    auto meta = CreateFieldMetaDirect(fbb_,
+        column.type.c_str(),
+        column.length,
+        column.precision,
+        column.is_unsigned,
+        column.nullable);
+    fields.push_back(CreateField(fbb_, fbb_.CreateString(column.name), meta));
+  }
+  auto fields_offset = fbb_.CreateVector(fields);
+  auto keys_offset   = keys.empty() ? 0 : build_row(columns, keys);
+  auto data_offset   = data.empty() ? 0 : build_row(columns, data);
+
+  auto root = CreateDML(fbb_,
+      fbb_.CreateString(header.check_point),
+      fbb_.CreateString(db),
+      0,
+      fields_offset,
+      keys_offset,
+      header.last_commit,
+      header.lsn,
+      fbb_.CreateString(header.msg_time),
+      data_offset,
+      0,
+      fbb_.CreateString(op_type),
+      header.scn,
+      header.seq,
+      fbb_.CreateString(table),
+      header.tx_seq,
+      fbb_.CreateString(header.tx_time));
+  fbb_.Finish(root);
+  return std::vector<uint8>(fbb_.GetBufferPointer(), fbb_.GetBufferPointer() + fbb_.GetSize());
+}
+
+std::vector<uint8> RedoRecordBuilder::ddl(const Header &header, const std::string &db, const std::string &table,
+    const std::string &sql, const char *ddl_type)
+{
+  fbb_.Clear();
+
+  // 建库、删库的 DDL 没有库名和表名
+  auto root = CreateDDL(fbb_,
+      fbb_.CreateString(header.check_point),
+      db.empty() ? 0 : fbb_.CreateString(db),
+      fbb_.CreateString(sql),
+      fbb_.CreateString(ddl_type),
+      header.last_commit,
+      header.lsn,
+      fbb_.CreateString(header.msg_time),
+      fbb_.CreateString("DDL"),
+      header.scn,
+      header.seq,
+      table.empty() ? 0 : fbb_.CreateString(table),
+      header.tx_seq,
+      fbb_.CreateString(header.tx_time));
+  fbb_.Finish(root);
+  return std::vector<uint8>(fbb_.GetBufferPointer(), fbb_.GetBufferPointer() + fbb_.GetSize());
+}
+
+flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<kvPair>>> RedoRecordBuilder::build_row(
+    const std::vector<Column> &columns, const Row &row)
+{
+  std::vector<flatbuffers::Offset<kvPair>> pairs;
+  pairs.reserve(row.size());
+  for (const auto &[index, value] : row) {
+    flatbuffers::Offset<void> offset;
+    switch (value.kind) {
+      case DataMeta_LongVal: offset = CreateLongVal(fbb_, value.long_value).Union(); break;
+      case DataMeta_DoubleVal: offset = CreateDoubleVal(fbb_, value.double_value).Union(); break;
+      case DataMeta_StringVal:
+        offset = CreateStringVal(fbb_, fbb_.CreateString(value.string_value)).Union();
+        break;
+      default: break;
+    }
+    pairs.push_back(CreatekvPair(fbb_, fbb_.CreateString(columns[index].name), value.kind, offset));
+  }
+  return fbb_.CreateVector(pairs);
+}
+
+std::string RedoRecordBuilder::encode_string(std::string_view raw)
+{
+  std::string encoded(base64_needed_encoded_length(raw.size()), '\0');
+  base64_encode(raw.data(), raw.size(), encoded.data());
+  encoded.resize(strlen(encoded.c_str()));
+  return encoded;
+}
+
+std::string RedoRecordBuilder::format_time(int64 micros)
+{
+  // Cantian 导出的是东八区时间，stringToTimestamp 解析时会减掉 8 小时
+  time_t    seconds = static_cast<time_t>(micros / 1000000) + 8 * 3600;
+  struct tm tm_value;
+  gmtime_r(&seconds, &tm_value);
+
+  char buf[32];
+  snprintf(buf,
+      sizeof(buf),
+      "%04d-%02d-%02d %02d:%02d:%02d.%06ld",
+      tm_value.tm_year + 1900,
+      tm_value.tm_mon + 1,
+      tm_value.tm_mday,
+      tm_value.tm_hour,
+      tm_value.tm_min,
+      tm_value.tm_sec,
+      static_cast<long>(micros % 1000000));
+  return buf;
+}
+
+}  // namespace loft
@@ -0,0 +1,374 @@
+//
+// Created by Coonger on 2024/12/17.
+//
+
+#include "redo_generator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string_view>
+
+#include "common/logging.h"
+
+namespace loft {
+
+namespace {
+
+constexpr const char *DB_NAME = "loft_gen";
+
+constexpr int64 START_SCN          = 54348795023361;
+constexpr int64 START_CLOCK_MICROS = 1722493959LL * 1000000;  // 2024-08-01 14:32:39 +08:00
+constexpr int64 COMMIT_DELAY       = 2000000;                 // msg_time 比 tx_time 晚 2 秒
+
+constexpr size_t WRITE_BUFFER_SIZE = 1 << 20;
+
+constexpr char ALNUM[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+
+}  // namespace
+
+// length 为 0 的 varchar 按 string_length 定长度
+const RedoGenerator::ColumnType RedoGenerator::COLUMN_TYPES[] = {
+    {"int", "INT", "int", 11, 0},
+    {"smallint", "SMALLINT", "smallint", 6, 0},
+    {"bigint", "BIGINT", "bigint", 20, 0},
+    {"double", "DOUBLE", "double(20,6)", 20, 6},
+    {"decimal", "DECIMAL", "decimal(10,5)", 10, 5},
+    {"varchar", "VARCHAR", "varchar", 0, 0},
+    {"text", "TEXT", "text", 65535, 0},
+    {"datetime", "DATETIME", "datetime(6)", 26, 6},
+    {"timestamp", "TIMESTAMP", "timestamp(6)", 26, 6},
+    {"year", "YEAR", "year(4)", 4, 0},
+    {"json", "JSON", "json", 0, 0},
+};
+
+const char *RedoGenerator::OPS[] = {"I", "U", "D"};
+
+RedoGenerator::RedoGenerator(const RedoGeneratorOptions &options)
+    : options_(options), random_state_(options.seed), scn_(START_SCN), clock_micros_(START_CLOCK_MICROS)
+{}
+
+RC RedoGenerator::init()
+{
+  if (options_.tables <= 0 || options_.min_columns < 0 || options_.max_columns < options_.min_columns ||
+      options_.min_tx_records <= 0 || options_.max_tx_records < options_.min_tx_records ||
+      options_.string_length <= 0 || options_.json_length <= 0 || options_.skew < 0 || options_.skew >= 1) {
+    LOG_ERROR("invalid generator options");
+    return RC::INVALID_ARGUMENT;
+  }
+  std::vector<std::string> type_names;
+  for (const ColumnType &type : COLUMN_TYPES) {
+    type_names.emplace_back(type.name);
+  }
+  RC rc = parse_mix(options_.column_mix, type_names, column_mix_);
+  if (rc != RC::SUCCESS) {
+    return rc;
+  }
+  rc = parse_mix(options_.op_mix, std::vector<std::string>(std::begin(OPS), std::end(OPS)), op_mix_);
+  if (rc != RC::SUCCESS) {
+    return rc;
+  }
+  for (const Weighted &w : column_mix_) {
+    column_total_ += w.weight;
+  }
+  for (const Weighted &w : op_mix_) {
+    op_total_ += w.weight;
+  }
+
+  int varchar_length = std::min(std::max(options_.string_length * 2, 16), 16383);
+
+  tables_.resize(options_.tables);
+  for (int t = 0; t < options_.tables; t++) {
+    Table &table = tables_[t];
+    table.name   = "t" + std::to_string(t);
+    table.columns.push_back(RedoRecordBuilder::Column{"id", "BIGINT", 20, 0});
+    table.types.push_back(&COLUMN_TYPES[2]);
+
+    int columns = options_.min_columns + static_cast<int>(uniform(options_.max_columns - options_.min_columns + 1));
+    for (int c = 1; c <= columns; c++) {
+      const ColumnType &type   = COLUMN_TYPES[pick(column_mix_, column_total_)];
+      int               length = type.length;
+      if (length == 0 && std::string_view(type.name) == "varchar") {
+        length = varchar_length;
+      }
+      table.columns.push_back(RedoRecordBuilder::Column{"c" + std::to_string(c), type.meta, length, type.precision});
+      table.types.push_back(&type);
+    }
+  }
+  return RC::SUCCESS;
+}
+
+RC RedoGenerator::parse_mix(
+    const std::string &mix, const std::vector<std::string> &names, std::vector<Weighted> &result)
+{
+  size_t begin = 0;
+  while (begin < mix.size()) {
+    size_t end = mix.find(',', begin);
+    if (end == std::string::npos) {
+      end = mix.size();
+    }
+    std::string item  = mix.substr(begin, end - begin);
+    size_t      colon = item.find(':');
+    std::string name  = item.substr(0, colon);
+    auto        it    = std::find(names.begin(), names.end(), name);
+    if (it == names.end()) {
+      LOG_ERROR("unknown name in mix. mix=%s, name=%s", mix.c_str(), name.c_str());
+      return RC::INVALID_ARGUMENT;
+    }
+    uint32 weight = colon == std::string::npos ? 1 : std::strtoul(item.c_str() + colon + 1, nullptr, 10);
+    if (weight > 0) {
+      result.push_back(Weighted{static_cast<int>(it - names.begin()), weight});
+    }
+    begin = end + 1;
+  }
+  if (result.empty()) {
+    LOG_ERROR("mix has no positive weight. mix=%s", mix.c_str());
+    return RC::INVALID_ARGUMENT;
+  }
+  return RC::SUCCESS;
+}
+
+uint64 RedoGenerator::next_random()
+{
+  // splitmix64
+  uint64 z = (random_state_ += 0x9E3779B97F4A7C15ULL);
+  z        = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z        = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+uint64 RedoGenerator::uniform(uint64 n)
+{
+  // 乘法取高位把 64 位随机数映射到 [0, n)，比取模快
+  return static_cast<uint64>((static_cast<__uint128_t>(next_random()) * n) >> 64);
+}
+
+double RedoGenerator::unit() { return static_cast<double>(next_random() >> 11) * 0x1.0p-53; }
+
+uint64 RedoGenerator::skewed(uint64 n)
+{
+  if (options_.skew == 0) {
+    return uniform(n);
+  }
+  // u^(1/(1-skew)) 随 skew 增大向 0 聚集，skew = 0.9 时约一半的访问落在前 0.1% 上
+  auto rank = static_cast<uint64>(n * std::pow(unit(), 1.0 / (1.0 - options_.skew)));
+  return std::min(rank, n - 1);
+}
+
+int RedoGenerator::pick(const std::vector<Weighted> &mix, uint32 total)
+{
+  uint64 r = uniform(total);
+  for (const Weighted &w : mix) {
+    if (r < w.weight) {
+      return w.index;
+    }
+    r -= w.weight;
+  }
+  return mix.back().index;
+}
+
+RedoRecordBuilder::Header RedoGenerator::next_header()
+{
+  RedoRecordBuilder::Header header;
+  header.scn         = scn_;
+  header.seq         = ++seq_;
+  header.lsn         = ++lsn_;
+  header.last_commit = tx_seq_ - 1;
+  header.tx_seq      = tx_seq_;
+  header.tx_time     = RedoRecordBuilder::format_time(clock_micros_);
+  header.msg_time    = RedoRecordBuilder::format_time(clock_micros_ + COMMIT_DELAY);
+  header.check_point = std::to_string(tx_seq_) + "-" + std::to_string(seq_) + "-" + std::to_string(scn_);
+  return header;
+}
+
+std::string RedoGenerator::random_text(size_t length)
+{
+  std::string text(length, '\0');
+  uint64      bits = 0;
+  for (size_t i = 0; i < length; i++) {
+    if (i % 8 == 0) {
+      bits = next_random();
+    }
+    text[i] = ALNUM[(bits & 0xFF) % (sizeof(ALNUM) - 1)];
+    bits >>= 8;
+  }
+  return text;
+}
+
+RedoRecordBuilder::Value RedoGenerator::make_value(const ColumnType &type)
+{
+  using Value = RedoRecordBuilder::Value;
+
+  std::string_view name = type.name;
+  if (name == "int") {
+    return Value::of_long(static_cast<int32>(next_random()));
+  }
+  if (name == "smallint") {
+    return Value::of_long(static_cast<int16>(next_random()));
+  }
+  if (name == "bigint") {
+    return Value::of_long(static_cast<int64>(next_random() >> 1));
+  }
+  if (name == "double") {
+    return Value::of_double(static_cast<double>(uniform(100000000000ULL)) / 1000000);
+  }
+  if (name == "decimal") {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%llu.%05llu", (unsigned long long)uniform(100000), (unsigned long long)uniform(100000));
+    return Value::of_string(buf);
+  }
+  if (name == "varchar" || name == "text") {
+    size_t half = options_.string_length / 2;
+    return Value::of_string(RedoRecordBuilder::encode_string(random_text(half + uniform(options_.string_length + 1))));
+  }
+  if (name == "datetime" || name == "timestamp") {
+    int64 micros = clock_micros_ - static_cast<int64>(uniform(86400ULL * 1000000));
+    return Value::of_string(RedoRecordBuilder::encode_string(RedoRecordBuilder::format_time(micros)));
+  }
+  if (name == "year") {
+    return Value::of_long(2000 + static_cast<int64>(uniform(100)));
+  }
+  // json
+  std::string doc = "{\"seq\": " + std::to_string(lsn_) + ", \"payload\": \"";
+  doc += random_text(options_.json_length > 32 ? options_.json_length - 32 : 1);
+  doc += "\"}";
+  return Value::of_string(RedoRecordBuilder::encode_string(doc));
+}
+
+RedoRecordBuilder::Row RedoGenerator::make_row(const Table &table, int64 id)
+{
+  RedoRecordBuilder::Row row;
+  row.reserve(table.columns.size());
+  row.emplace_back(0, RedoRecordBuilder::Value::of_long(id));
+  for (size_t i = 1; i < table.columns.size(); i++) {
+    row.emplace_back(i, make_value(*table.types[i]));
+  }
+  return row;
+}
+
+std::string RedoGenerator::create_table_sql(const Table &table) const
+{
+  std::string sql = "create table " + table.name + "(id bigint primary key";
+  for (size_t i = 1; i < table.columns.size(); i++) {
+    const RedoRecordBuilder::Column &column = table.columns[i];
+    sql += ", " + column.name + " " + table.types[i]->sql;
+    if (std::string_view(table.types[i]->name) == "varchar") {
+      sql += "(" + std::to_string(column.length) + ")";
+    }
+  }
+  sql += ")";
+  return sql;
+}
+
+void RedoGenerator::begin_transaction()
+{
+  tx_seq_++;
+  tx_count_++;
+  scn_ += 1 + uniform(64);
+  seq_ = 0;
+  clock_micros_ += 100 + uniform(400);
+}
+
+bool RedoGenerator::next(std::vector<uint8> &record, bool &is_ddl)
+{
+  // DDL 各自是一个事务
+  if (next_ddl_ <= tables_.size()) {
+    begin_transaction();
+
+    auto header = next_header();
+    if (next_ddl_ == 0) {
+      record = builder_.ddl(header, "", "", std::string("create database ") + DB_NAME, "CREATE DATABASE");
+    } else {
+      const Table &table = tables_[next_ddl_ - 1];
+      record             = builder_.ddl(header, DB_NAME, table.name, create_table_sql(table), "CREATE TABLE");
+    }
+    next_ddl_++;
+    is_ddl = true;
+    ddl_count_++;
+    output_bytes_ += sizeof(uint32) + record.size();
+    return true;
+  }
+
+  if (tx_remaining_ == 0) {
+    // 只在事务边界检查限制，生成的流里不会有半个事务
+    if ((options_.records > 0 && dml_count_ >= options_.records) ||
+        (options_.output_bytes > 0 && output_bytes_ >= options_.output_bytes)) {
+      return false;
+    }
+    begin_transaction();
+    tx_remaining_ =
+        options_.min_tx_records + static_cast<int>(uniform(options_.max_tx_records - options_.min_tx_records + 1));
+  }
+
+  emit_dml(record);
+  tx_remaining_--;
+  is_ddl = false;
+  dml_count_++;
+  output_bytes_ += sizeof(uint32) + record.size();
+  return true;
+}
+
+void RedoGenerator::emit_dml(std::vector<uint8> &record)
+{
+  Table &table = tables_[skewed(tables_.size())];
+  int    op    = pick(op_mix_, op_total_);
+  if (table.live_ids.empty()) {
+    op = 0;  // 空表只能 INSERT
+  }
+
+  auto                   header = next_header();
+  RedoRecordBuilder::Row keys;
+  RedoRecordBuilder::Row data;
+  if (op == 0) {
+    table.live_ids.push_back(table.next_id);
+    data = make_row(table, table.next_id++);
+  } else {
+    // 最近插入的行最热
+    size_t index = table.live_ids.size() - 1 - skewed(table.live_ids.size());
+    int64  id    = table.live_ids[index];
+    keys.emplace_back(0, RedoRecordBuilder::Value::of_long(id));
+    if (op == 1) {
+      data = make_row(table, id);
+    } else {
+      table.live_ids[index] = table.live_ids.back();
+      table.live_ids.pop_back();
+    }
+  }
+  record = builder_.dml(header, DB_NAME, table.name, OPS[op], table.columns, keys, data);
+}
+
+RC RedoGenerator::write(const std::string &path)
+{
+  if (options_.output_bytes == 0 && options_.records == 0) {
+    LOG_ERROR("either output_bytes or records must be set to write a file");
+    return RC::INVALID_ARGUMENT;
+  }
+
+  FILE *file = fopen(path.c_str(), "wb");
+  if (file == nullptr) {
+    LOG_ERROR("failed to open output file. path=%s", path.c_str());
+    return RC::FILE_OPEN;
+  }
+  std::unique_ptr<char[]> buffer(new char[WRITE_BUFFER_SIZE]);
+  setvbuf(file, buffer.get(), _IOFBF, WRITE_BUFFER_SIZE);
+
+  RC                 rc = RC::SUCCESS;
+  std::vector<uint8> record;
+  bool               is_ddl = false;
+  while (next(record, is_ddl)) {
+    auto len = static_cast<uint32>(record.size());
+    if (fwrite(&len, sizeof(len), 1, file) != 1 || fwrite(record.data(), 1, record.size(), file) != record.size()) {
+      LOG_ERROR("failed to write output file. path=%s", path.c_str());
+      rc = RC::IOERR_WRITE;
+      break;
+    }
+  }
+  if (fclose(file) != 0 && rc == RC::SUCCESS) {
+    rc = RC::FILE_CLOSE;
+  }
+  return rc;
+}
+
+}  // namespace loft
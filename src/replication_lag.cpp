@@ -0,0 +1,117 @@
+//
+// Created by Coonger on 2024/12/18.
+//
+
+#include "replication_lag.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "common/logging.h"
+
+using namespace common;
+using namespace loft;
+
+void SourceProgress::add(uint64 commit_us, int64 scn)
+{
+  if (commit_us != 0) {
+    oldest_commit_us = oldest_commit_us == 0 ? commit_us : std::min(oldest_commit_us, commit_us);
+    newest_commit_us = std::max(newest_commit_us, commit_us);
+  }
+  max_scn = std::max(max_scn, scn);
+}
+
+void SourceProgress::merge(const SourceProgress &other)
+{
+  if (other.oldest_commit_us != 0) {
+    add(other.oldest_commit_us, other.max_scn);
+    add(other.newest_commit_us, other.max_scn);
+  } else {
+    max_scn = std::max(max_scn, other.max_scn);
+  }
+}
+
+ReplicationLagTracker::ReplicationLagTracker(MetricsRegistry &registry)
+{
+  lag_ = registry.histogram(
+      "loft_replication_lag_seconds", "Source commit to binlog write delay of the oldest record in each batch.", 1e-6);
+  registry.callback("loft_replication_lag_current_seconds",
+      "Source commit to binlog write delay of the newest written record.",
+      MetricType::GAUGE,
+      [this] { return static_cast<double>(current_lag_us()) * 1e-6; });
+  registry.callback("loft_binlog_written_scn",
+      "Highest source SCN below which every record has been written to the binlog.",
+      MetricType::GAUGE,
+      [this] { return static_cast<double>(written_scn()); });
+  registry.callback("loft_binlog_durable_scn",
+      "Highest source SCN below which every record has been written and synced to disk.",
+      MetricType::GAUGE,
+      [this] { return static_cast<double>(durable_scn()); });
+}
+
+uint64 ReplicationLagTracker::now_us()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+void ReplicationLagTracker::begin(size_t sequence, const SourceProgress &progress)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  inflight_.push_back(Entry{sequence, progress});
+}
+
+void ReplicationLagTracker::complete(size_t sequence, RC rc, bool durable)
+{
+  uint64 now = now_us();
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = std::find_if(inflight_.begin(), inflight_.end(), [sequence](const Entry &e) { return e.sequence == sequence; });
+  if (it == inflight_.end()) {
+    return;
+  }
+  it->done    = true;
+  it->failed  = LOFT_FAIL(rc);
+  it->durable = durable;
+  if (!it->failed && it->progress.oldest_commit_us != 0) {
+    // 源端和本机的时钟有偏差时可能是负数，按 0 记
+    lag_->record(now > it->progress.oldest_commit_us ? now - it->progress.oldest_commit_us : 0);
+  }
+
+  // 推进连续完成的前缀
+  while (!inflight_.empty() && inflight_.front().done) {
+    const Entry &front = inflight_.front();
+    if (front.failed && !stalled_) {
+      stalled_ = true;
+      LOG_ERROR("binlog write failed, written/durable scn stop advancing. sequence=%zu, scn=%lld",
+          front.sequence, (long long)front.progress.max_scn);
+    }
+    if (!stalled_) {
+      int64 scn = std::max(written_scn_.load(std::memory_order_relaxed), front.progress.max_scn);
+      written_scn_.store(scn, std::memory_order_relaxed);
+      if (front.durable) {
+        durable_scn_.store(scn, std::memory_order_relaxed);
+      }
+      if (front.progress.newest_commit_us != 0) {
+        uint64 newest = front.progress.newest_commit_us;
+        last_lag_us_.store(now > newest ? now - newest : 0, std::memory_order_relaxed);
+      }
+    }
+    inflight_.pop_front();
+  }
+}
+
+uint64 ReplicationLagTracker::current_lag_us() const
+{
+  uint64 lag = last_lag_us_.load(std::memory_order_relaxed);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const Entry &entry : inflight_) {
+    if (!entry.done && entry.progress.oldest_commit_us != 0) {
+      uint64 now = now_us();
+      lag        = std::max(lag, now > entry.progress.oldest_commit_us ? now - entry.progress.oldest_commit_us : 0);
+      break;
+    }
+  }
+  return lag;
+}
@@ -192,9 +192,9 @@ int Field_bit::do_save_field_metadata(unsigned char *metadata_ptr) const
                      Field_temporal
 ******************************************************************************/
 
-Field_timestamp::Field_timestamp(
-    uint32_t len_arg, bool is_nullable_arg, unsigned char null_bit_arg, const char *field_name_arg)
-    : Field_temporal_with_date_and_time(is_nullable_arg, null_bit_arg, field_name_arg, 0)
+Field_timestamp::Field_timestamp(uint32_t len_arg, bool is_nullable_arg, unsigned char null_bit_arg,
+    const char *field_name_arg, uint8_t dec_arg)
+    : Field_temporal_with_date_and_time(is_nullable_arg, null_bit_arg, field_name_arg, dec_arg)
 {
   set_flag(TIMESTAMP_FLAG);
   set_flag(UNSIGNED_FLAG);
@@ -301,9 +301,9 @@ auto make_field(const char *field_name, size_t field_length, bool is_unsigned, b
       return std::make_shared<Field_longlong>(field_length, is_nullable, null_bit, field_name, is_unsigned);
     case MYSQL_TYPE_YEAR: return std::make_shared<Field_year>(is_nullable, null_bit, field_name);
     case MYSQL_TYPE_TIMESTAMP:
-      return std::make_shared<Field_timestamp>(field_length, is_nullable, null_bit, field_name);
-    case MYSQL_TYPE_TIME: return std::make_shared<Field_time>(is_nullable, null_bit, field_name);
-    case MYSQL_TYPE_DATETIME: return std::make_shared<Field_datetime>(is_nullable, null_bit, field_name);
+      return std::make_shared<Field_timestamp>(field_length, is_nullable, null_bit, field_name, decimals);
+    case MYSQL_TYPE_TIME: return std::make_shared<Field_time>(is_nullable, null_bit, field_name, decimals);
+    case MYSQL_TYPE_DATETIME: return std::make_shared<Field_datetime>(is_nullable, null_bit, field_name, decimals);
     case MYSQL_TYPE_NULL: return std::make_shared<Field_null>(field_length, field_name);
     case MYSQL_TYPE_BIT:
       return std::make_shared<Field_bit>(field_length, is_nullable, null_bit, bit_offset, field_name);
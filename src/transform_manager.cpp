@@ -25,7 +25,7 @@
 #include <iostream>
 #include <map>
 
-inline uint64_t LogFormatTransformManager::stringToTimestamp(const std::string& timeString) {
+uint64_t LogFormatTransformManager::stringToTimestamp(const std::string& timeString) {
   std::tm timeStruct = {};
 
   // 直接使用指针操作，避免字符串拷贝
@@ -353,7 +353,8 @@ void LogFormatTransformManager::transformDML(const DML *dml, MYSQL_BIN_LOG *binL
   binLog->write_event_to_binlog(xe.get());
 }
 
-std::vector<std::unique_ptr<AbstractEvent>> LogFormatTransformManager::transformDDL(const DDL *ddl)
+std::vector<std::unique_ptr<AbstractEvent>> LogFormatTransformManager::transformDDL(
+    const DDL *ddl, const LogicalClock *clock)
 {
   auto ddlType = ddl->ddl_type();
 
@@ -371,7 +372,9 @@ std::vector<std::unique_ptr<AbstractEvent>> LogFormatTransformManager::transform
   auto o_ts = stringToTimestamp(originalCommitTs->c_str());
 
   std::unique_ptr<AbstractEvent> gtidEvent = std::make_unique<Gtid_event>(
-      lastCommit, txSeq, true, o_ts, i_ts, ORIGINAL_SERVER_VERSION, IMMEDIATE_SERVER_VERSION);
+      clock != nullptr ? clock->last_committed : lastCommit,
+      clock != nullptr ? clock->sequence_number : txSeq,
+      true, o_ts, i_ts, ORIGINAL_SERVER_VERSION, IMMEDIATE_SERVER_VERSION);
 
   // 2. 构造 Query event
   const char *query_arg   = ddlSql->data();
@@ -428,7 +431,8 @@ std::vector<std::unique_ptr<AbstractEvent>> LogFormatTransformManager::transform
   events.push_back(std::move(queryEvent));
   return events;
 }
-std::vector<std::unique_ptr<AbstractEvent>> LogFormatTransformManager::transformDML(const DML *dml)
+std::vector<std::unique_ptr<AbstractEvent>> LogFormatTransformManager::transformDML(
+    const DML *dml, const LogicalClock *clock)
 {
   auto lastCommit        = dml->last_commit();
   auto txSeq             = dml->tx_seq();
@@ -438,7 +442,9 @@ std::vector<std::unique_ptr<AbstractEvent>> LogFormatTransformManager::transform
   auto o_ts              = stringToTimestamp(originalCommitTs->c_str());
 
   auto ge = std::make_unique<Gtid_event>(
-      lastCommit, txSeq, true, o_ts, i_ts, ORIGINAL_SERVER_VERSION, IMMEDIATE_SERVER_VERSION);
+      clock != nullptr ? clock->last_committed : lastCommit,
+      clock != nullptr ? clock->sequence_number : txSeq,
+      true, o_ts, i_ts, ORIGINAL_SERVER_VERSION, IMMEDIATE_SERVER_VERSION);
 
   //////////****************** gtid event end *******************************
 
@@ -0,0 +1,437 @@
+//
+// Created by Coonger on 2024/12/4.
+//
+#include "uring_ostream.h"
+
+#include <fcntl.h>         // ::open
+#include <sys/mman.h>      // mmap
+#include <sys/syscall.h>   // __NR_io_uring_*
+#include <unistd.h>
+#include <algorithm>       // std::min
+#include <cerrno>
+#include <cstdlib>         // aligned_alloc
+#include <cstring>
+
+#include "common/logging.h"
+
+namespace {
+
+constexpr int    USER_DATA_OP_SHIFT = 56;
+constexpr uint64 USER_DATA_IDX_MASK = (1ULL << USER_DATA_OP_SHIFT) - 1;
+
+int io_uring_setup(uint32 entries, struct io_uring_params *params)
+{
+  return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+int io_uring_enter(int ring_fd, uint32 to_submit, uint32 min_complete, uint32 flags)
+{
+  return static_cast<int>(::syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+int io_uring_register(int ring_fd, uint32 opcode, const void *arg, uint32 nr_args)
+{
+  return static_cast<int>(::syscall(__NR_io_uring_register, ring_fd, opcode, arg, nr_args));
+}
+
+}  // namespace
+
+bool Binlog_uring_ofile::is_supported()
+{
+  static const bool supported = [] {
+    struct io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    int fd = io_uring_setup(2, &params);
+    if (fd < 0) {
+      return false;
+    }
+    ::close(fd);
+    return true;
+  }();
+  return supported;
+}
+
+Binlog_uring_ofile::Binlog_uring_ofile(const char *binlog_name, RC &rc, uint32 buffer_count, size_t buffer_size)
+    : m_file_name_(binlog_name), buffer_size_(buffer_size)
+{
+  // 写的都是显式 offset，不能用 O_APPEND，否则内核会忽略 sqe 里的 off
+  m_fd_ = ::open(binlog_name, O_WRONLY | O_CREAT, 0644);
+  if (m_fd_ < 0) {
+    LOG_ERROR("open binlog file failed. filename=%s, error=%s", binlog_name, strerror(errno));
+    rc = RC::IOERR_OPEN;
+    return;
+  }
+  off_t end   = ::lseek(m_fd_, 0, SEEK_END);
+  m_position_ = end < 0 ? 0 : static_cast<my_off_t>(end);
+
+  // 每块缓冲区最多一个在途的写，再加上 sync 的 fsync 和 close 的 STOP
+  rc = setup_ring(buffer_count * 2 + 2);
+  if (LOFT_FAIL(rc)) {
+    close();
+    return;
+  }
+
+  buffers_.resize(buffer_count);
+  std::vector<struct iovec> iovs(buffer_count);
+  for (uint32 i = 0; i < buffer_count; ++i) {
+    buffers_[i].data = static_cast<uchar *>(std::aligned_alloc(4096, buffer_size_));
+    if (buffers_[i].data == nullptr) {
+      LOG_ERROR("alloc io_uring buffer failed. size=%zu", buffer_size_);
+      rc = RC::NOMEM;
+      close();
+      return;
+    }
+    iovs[i] = {buffers_[i].data, buffer_size_};
+  }
+  if (io_uring_register(ring_fd_, IORING_REGISTER_BUFFERS, iovs.data(), buffer_count) < 0) {
+    // 一般是 RLIMIT_MEMLOCK 不够
+    LOG_INFO("register io_uring buffers failed. error=%s", strerror(errno));
+    rc = RC::IOERR_OPEN;
+    close();
+    return;
+  }
+  buffers_[current_].offset = m_position_;
+
+  reaper_ = std::thread(&Binlog_uring_ofile::reap_loop, this);
+  rc      = RC::FILE_OPEN;
+}
+
+Binlog_uring_ofile::~Binlog_uring_ofile() { close(); }
+
+RC Binlog_uring_ofile::setup_ring(uint32 entries)
+{
+  struct io_uring_params params;
+  std::memset(&params, 0, sizeof(params));
+  ring_fd_ = io_uring_setup(entries, &params);
+  if (ring_fd_ < 0) {
+    LOG_INFO("io_uring_setup failed. error=%s", strerror(errno));
+    return RC::IOERR_OPEN;
+  }
+
+  sq_size_ = params.sq_off.array + params.sq_entries * sizeof(uint32);
+  cq_size_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+  if (single_mmap) {
+    sq_size_ = cq_size_ = std::max(sq_size_, cq_size_);
+  }
+
+  sq_ptr_ = ::mmap(nullptr, sq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+  if (sq_ptr_ == MAP_FAILED) {
+    sq_ptr_ = nullptr;
+    return RC::IOERR_OPEN;
+  }
+  if (single_mmap) {
+    cq_ptr_ = sq_ptr_;
+  } else {
+    cq_ptr_ =
+        ::mmap(nullptr, cq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+    if (cq_ptr_ == MAP_FAILED) {
+      cq_ptr_ = nullptr;
+      return RC::IOERR_OPEN;
+    }
+  }
+
+  sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+  void *sqes = ::mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) {
+    return RC::IOERR_OPEN;
+  }
+  sqes_ = static_cast<struct io_uring_sqe *>(sqes);
+
+  auto *sq       = static_cast<char *>(sq_ptr_);
+  sq_head_       = reinterpret_cast<uint32 *>(sq + params.sq_off.head);
+  sq_tail_       = reinterpret_cast<uint32 *>(sq + params.sq_off.tail);
+  sq_mask_       = reinterpret_cast<uint32 *>(sq + params.sq_off.ring_mask);
+  sq_array_      = reinterpret_cast<uint32 *>(sq + params.sq_off.array);
+  sq_entries_    = params.sq_entries;
+  sq_local_tail_ = *sq_tail_;
+
+  auto *cq = static_cast<char *>(cq_ptr_);
+  cq_head_ = reinterpret_cast<uint32 *>(cq + params.cq_off.head);
+  cq_tail_ = reinterpret_cast<uint32 *>(cq + params.cq_off.tail);
+  cq_mask_ = reinterpret_cast<uint32 *>(cq + params.cq_off.ring_mask);
+  cqes_    = reinterpret_cast<struct io_uring_cqe *>(cq + params.cq_off.cqes);
+  return RC::SUCCESS;
+}
+
+void Binlog_uring_ofile::teardown_ring()
+{
+  if (sqes_ != nullptr) {
+    ::munmap(sqes_, sqes_size_);
+    sqes_ = nullptr;
+  }
+  if (cq_ptr_ != nullptr && cq_ptr_ != sq_ptr_) {
+    ::munmap(cq_ptr_, cq_size_);
+  }
+  cq_ptr_ = nullptr;
+  if (sq_ptr_ != nullptr) {
+    ::munmap(sq_ptr_, sq_size_);
+    sq_ptr_ = nullptr;
+  }
+  if (ring_fd_ >= 0) {
+    ::close(ring_fd_);  // 同时注销了注册的缓冲区
+    ring_fd_ = -1;
+  }
+}
+
+struct io_uring_sqe *Binlog_uring_ofile::get_sqe()
+{
+  // 只有写线程提交 sqe，sq_local_tail_ 不需要同步；head 由内核推进
+  uint32 head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+  if (sq_local_tail_ - head >= sq_entries_) {
+    // sq 满了：把已填好的 sqe 都交给内核，内核消费后 head 前进，sq 重新空出来
+    if (!submit()) {
+      return nullptr;
+    }
+  }
+  uint32 index     = sq_local_tail_ & *sq_mask_;
+  auto  *sqe       = &sqes_[index];
+  sq_array_[index] = index;
+  sq_local_tail_++;
+  std::memset(sqe, 0, sizeof(*sqe));
+  return sqe;
+}
+
+bool Binlog_uring_ofile::submit()
+{
+  __atomic_store_n(sq_tail_, sq_local_tail_, __ATOMIC_RELEASE);
+  uint32 pending;
+  while ((pending = sq_local_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE)) > 0) {
+    int ret = io_uring_enter(ring_fd_, pending, 0, 0);
+    if (ret < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if ((errno == EAGAIN || errno == EBUSY) && !failed_) {
+        // 内核资源不足或 cq 溢出：等 reaper 收割一些 completion 再重试
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait_for(lock, std::chrono::milliseconds(1));
+        continue;
+      }
+      LOG_ERROR("io_uring_enter submit failed. filename=%s, error=%s", m_file_name_.c_str(), strerror(errno));
+      failed_ = true;
+      cv_.notify_all();
+      return false;
+    }
+    // 只有真正交给内核的 sqe 才会有 completion，close() 据此等待
+    std::lock_guard<std::mutex> lock(mutex_);
+    inflight_ += ret;
+  }
+  return true;
+}
+
+bool Binlog_uring_ofile::prepare_current(uint8_t flags)
+{
+  Buffer &buffer = buffers_[current_];
+  if (buffer.used == 0) {
+    return false;
+  }
+
+  auto *sqe = get_sqe();
+  if (sqe == nullptr) {
+    return false;
+  }
+  sqe->opcode    = IORING_OP_WRITE_FIXED;
+  sqe->flags     = flags;
+  sqe->fd        = m_fd_;
+  sqe->addr      = reinterpret_cast<uint64>(buffer.data);
+  sqe->len       = static_cast<uint32>(buffer.used);
+  sqe->off       = buffer.offset;
+  sqe->buf_index = static_cast<uint16_t>(current_);
+  sqe->user_data = (static_cast<uint64>(Op::WRITE) << USER_DATA_OP_SHIFT) | current_;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  buffer.busy = true;
+  return true;
+}
+
+bool Binlog_uring_ofile::acquire_buffer()
+{
+  current_ = (current_ + 1) % buffers_.size();
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  cv_.wait(lock, [this] { return !buffers_[current_].busy || failed_; });
+  buffers_[current_].used   = 0;
+  buffers_[current_].offset = m_position_;
+  return !failed_;
+}
+
+bool Binlog_uring_ofile::write(const uchar *buffer, my_off_t length)
+{
+  assert(ring_fd_ >= 0);
+  if (failed_) {
+    return false;
+  }
+
+  while (length > 0) {
+    Buffer &current = buffers_[current_];
+    size_t  n       = std::min<size_t>(length, buffer_size_ - current.used);
+    std::memcpy(current.data + current.used, buffer, n);
+    current.used += n;
+    m_position_ += n;
+    buffer += n;
+    length -= n;
+
+    if (current.used == buffer_size_) {
+      if (!prepare_current(0) || !submit() || !acquire_buffer()) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+RC Binlog_uring_ofile::seek(my_off_t position)
+{
+  // binlog 只会追加写，和 Binlog_fd_ofile 一样只允许 seek 到当前位置
+  return position == m_position_ ? RC::SUCCESS : RC::IOERR_SEEK;
+}
+
+RC Binlog_uring_ofile::flush()
+{
+  assert(ring_fd_ >= 0);
+  if (prepare_current(0)) {
+    if (!submit() || !acquire_buffer()) {
+      return RC::IOERR_WRITE;
+    }
+  }
+  return failed_ ? RC::IOERR_WRITE : RC::SUCCESS;
+}
+
+RC Binlog_uring_ofile::sync()
+{
+  assert(ring_fd_ >= 0);
+  if (failed_) {
+    return RC::IOERR_SYNC;
+  }
+
+  // 链头带 IOSQE_IO_DRAIN：之前提交的写全部完成后才开始，链上的 fsync 紧跟在最后一块缓冲区的写之后
+  bool has_write = prepare_current(IOSQE_IO_DRAIN | IOSQE_IO_LINK);
+  if (failed_) {
+    return RC::IOERR_SYNC;
+  }
+
+  auto *sqe = get_sqe();
+  if (sqe == nullptr) {
+    return RC::IOERR_SYNC;
+  }
+  sqe->opcode      = IORING_OP_FSYNC;
+  sqe->flags       = has_write ? 0 : IOSQE_IO_DRAIN;
+  sqe->fd          = m_fd_;
+  sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+  sqe->user_data   = static_cast<uint64>(Op::FSYNC) << USER_DATA_OP_SHIFT;
+
+  uint64 ticket;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ticket = ++sync_submitted_;
+  }
+  if (!submit()) {
+    return RC::IOERR_SYNC;
+  }
+  if (has_write && !acquire_buffer()) {
+    return RC::IOERR_SYNC;
+  }
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  cv_.wait(lock, [this, ticket] { return sync_completed_ >= ticket || failed_; });
+  return failed_ ? RC::IOERR_SYNC : RC::SUCCESS;
+}
+
+void Binlog_uring_ofile::reap_loop()
+{
+  bool stop = false;
+  while (!stop) {
+    int ret = io_uring_enter(ring_fd_, 0, 1, IORING_ENTER_GETEVENTS);
+    if (ret < 0 && errno != EINTR) {
+      LOG_ERROR("io_uring_enter wait failed. filename=%s, error=%s", m_file_name_.c_str(), strerror(errno));
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        failed_        = true;
+        reaper_exited_ = true;
+      }
+      cv_.notify_all();
+      return;
+    }
+
+    uint32 head = *cq_head_;  // 只有 reaper 消费 cqe
+    uint32 tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    if (head == tail) {
+      continue;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (; head != tail; ++head) {
+        const struct io_uring_cqe *cqe = &cqes_[head & *cq_mask_];
+        auto                       op  = static_cast<Op>(cqe->user_data >> USER_DATA_OP_SHIFT);
+        uint32                     idx = static_cast<uint32>(cqe->user_data & USER_DATA_IDX_MASK);
+        switch (op) {
+          case Op::WRITE: {
+            Buffer &buffer = buffers_[idx];
+            if (cqe->res < 0 || static_cast<size_t>(cqe->res) != buffer.used) {
+              LOG_ERROR("io_uring write failed. filename=%s, offset=%llu, expect=%zu, res=%d",
+                  m_file_name_.c_str(), buffer.offset, buffer.used, cqe->res);
+              failed_ = true;
+            }
+            buffer.busy = false;
+          } break;
+          case Op::FSYNC: {
+            if (cqe->res < 0) {
+              LOG_ERROR("io_uring fsync failed. filename=%s, error=%s", m_file_name_.c_str(), strerror(-cqe->res));
+              failed_ = true;
+            }
+            sync_completed_++;
+          } break;
+          case Op::STOP: {
+            stop = true;
+          } break;
+        }
+        inflight_--;
+      }
+      __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+    }
+    cv_.notify_all();
+  }
+}
+
+void Binlog_uring_ofile::wait_idle()
+{
+  // 出错之后也要等在途的写都回来：内核还在读这些缓冲区，不能提前释放
+  // 只有 reaper 自己退出了，才没有人再收割 completion
+  std::unique_lock<std::mutex> lock(mutex_);
+  cv_.wait(lock, [this] { return inflight_ == 0 || reaper_exited_; });
+}
+
+void Binlog_uring_ofile::close()
+{
+  if (reaper_.joinable()) {
+    flush();
+    wait_idle();
+
+    // 用一个 NOP 唤醒阻塞在 io_uring_enter 上的 reaper
+    if (!reaper_exited_) {
+      auto *sqe = get_sqe();
+      if (sqe == nullptr) {
+        LOG_ERROR("failed to stop io_uring reaper. filename=%s", m_file_name_.c_str());
+      } else {
+        sqe->opcode    = IORING_OP_NOP;
+        sqe->user_data = static_cast<uint64>(Op::STOP) << USER_DATA_OP_SHIFT;
+        submit();
+      }
+    }
+    reaper_.join();
+  }
+
+  teardown_ring();
+  for (auto &buffer : buffers_) {
+    std::free(buffer.data);
+  }
+  buffers_.clear();
+
+  if (m_fd_ >= 0) {
+    ::close(m_fd_);
+    m_fd_       = -1;
+    m_position_ = 0;
+  }
+}
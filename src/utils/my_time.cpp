@@ -279,6 +279,12 @@ void my_datetime_packed_to_binary(longlong nr, uchar *ptr, uint dec)
   }
 }
 
+void my_time_trunc(MYSQL_TIME *ltime, uint dec)
+{
+  assert(dec <= DATETIME_MAX_DECIMALS);
+  ltime->second_part -= ltime->second_part % log_10_int[DATETIME_MAX_DECIMALS - dec];
+}
+
 void my_timestamp_to_binary(const my_timeval *tm, uchar *ptr, uint dec)
 {
   assert(dec <= DATETIME_MAX_DECIMALS);
@@ -394,8 +400,8 @@ fractional:
         value *= static_cast<long>(log_10_int[field_length]);
     } else {
       for (; str != end && isdigit_char(*str); str++) {}
-      date[4] = static_cast<ulong>(value);
     }
+    date[4] = static_cast<ulong>(value);
   } else if ((end - str) == 1 && *str == '.') {
     str++;
     date[4] = 0;
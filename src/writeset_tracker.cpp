@@ -0,0 +1,240 @@
+//
+// Created by Coonger on 2024/12/12.
+//
+
+#include "writeset_tracker.h"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <string_view>
+
+namespace {
+
+constexpr uint64 FNV_OFFSET = 14695981039346656037ULL;
+constexpr uint64 FNV_PRIME  = 1099511628211ULL;
+
+/// FNV-1a，每段后面再混入长度，避免 ("ab", "c") 和 ("a", "bc") 得到同一个哈希
+uint64 hash_append(uint64 hash, const void *data, size_t len)
+{
+  auto bytes = static_cast<const unsigned char *>(data);
+  for (size_t i = 0; i < len; i++) {
+    hash = (hash ^ bytes[i]) * FNV_PRIME;
+  }
+  for (size_t i = 0; i < sizeof(len); i++) {
+    hash = (hash ^ ((len >> (i * 8)) & 0xff)) * FNV_PRIME;
+  }
+  return hash;
+}
+
+uint64 hash_append(uint64 hash, const flatbuffers::String *str)
+{
+  return str == nullptr ? hash_append(hash, "", 0) : hash_append(hash, str->c_str(), str->size());
+}
+
+/**
+ * @brief 把一个键值混入哈希
+ * @return 值为 NULL 时返回 false
+ */
+bool hash_value(uint64 &hash, const kvPair *pair)
+{
+  uint8 type = pair->value_type();
+  hash       = hash_append(hash, &type, sizeof(type));
+  switch (pair->value_type()) {
+    case DataMeta_LongVal: {
+      int64 value = pair->value_as_LongVal()->value();
+      hash        = hash_append(hash, &value, sizeof(value));
+      return true;
+    }
+    case DataMeta_DoubleVal: {
+      double value = pair->value_as_DoubleVal()->value();
+      hash         = hash_append(hash, &value, sizeof(value));
+      return true;
+    }
+    case DataMeta_StringVal: {
+      hash = hash_append(hash, pair->value_as_StringVal()->value());
+      return true;
+    }
+    default: return false;
+  }
+}
+
+using KvPairs = ::flatbuffers::Vector<::flatbuffers::Offset<kvPair>>;
+
+/**
+ * @brief 按 key_columns 从一行里取出键值，算出这一行的哈希
+ * @return 行里缺少某个键列，或者键值为 NULL 时返回 false
+ */
+bool hash_row(uint64 table_hash, const std::vector<std::string> &key_columns, const KvPairs &row, uint64 &hash)
+{
+  hash = table_hash;
+  for (const auto &column : key_columns) {
+    const kvPair *found = nullptr;
+    for (auto pair : row) {
+      if (pair->key() != nullptr && column == pair->key()->c_str()) {
+        found = pair;
+        break;
+      }
+    }
+    if (found == nullptr) {
+      return false;
+    }
+    hash = hash_append(hash, column.data(), column.size());
+    if (!hash_value(hash, found)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief 一行里是否出现了任意一个键列
+ */
+bool contains_key(const std::vector<std::string> &key_columns, const KvPairs &row)
+{
+  for (auto pair : row) {
+    if (pair->key() != nullptr &&
+        std::binary_search(key_columns.begin(), key_columns.end(), std::string_view(pair->key()->c_str()))) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+WritesetTracker::WritesetTracker(size_t history_size) : max_history_(std::max<size_t>(history_size, 1))
+{
+  history_.reserve(max_history_);
+}
+
+void WritesetTracker::track(std::span<Task> tasks, bool scn_order)
+{
+  std::vector<size_t> order(tasks.size());
+  std::iota(order.begin(), order.end(), 0);
+  if (scn_order) {
+    std::vector<int64> scn(tasks.size());
+    for (size_t i = 0; i < tasks.size(); i++) {
+      scn[i] = tasks[i].is_ddl_ ? GetDDL(tasks[i].data_.data())->scn() : GetDML(tasks[i].data_.data())->scn();
+    }
+    std::stable_sort(order.begin(), order.end(), [&scn](size_t a, size_t b) { return scn[a] < scn[b]; });
+  }
+
+  for (size_t index : order) {
+    Task        &task  = tasks[index];
+    LogicalClock clock = task.is_ddl_ ? track_ddl() : track_dml(GetDML(task.data_.data()));
+    task.last_committed_  = clock.last_committed;
+    task.sequence_number_ = clock.sequence_number;
+  }
+}
+
+LogicalClock WritesetTracker::next(const std::vector<uint64> &writeset, bool can_use, int64 min_parent)
+{
+  LogicalClock clock;
+  clock.sequence_number = ++sequence_number_;
+
+  bool  exceeds_capacity = false;
+  int64 last_parent      = std::max(history_start_, min_parent);
+  if (can_use) {
+    exceeds_capacity = history_.size() + writeset.size() > max_history_;
+    for (uint64 hash : writeset) {
+      auto it = history_.find(hash);
+      if (it != history_.end()) {
+        if (it->second > last_parent && it->second < clock.sequence_number) {
+          last_parent = it->second;
+        }
+        it->second = clock.sequence_number;
+      } else if (!exceeds_capacity) {
+        history_.emplace(hash, clock.sequence_number);
+      }
+    }
+  }
+
+  if (!can_use || exceeds_capacity) {
+    history_start_ = clock.sequence_number;
+    history_.clear();
+  }
+
+  clock.last_committed = can_use ? std::min(last_parent, clock.sequence_number - 1) : clock.sequence_number - 1;
+  return clock;
+}
+
+LogicalClock WritesetTracker::track_ddl()
+{
+  // DDL 可能改变表结构或键，之前学到的键列都不再可信
+  tables_.clear();
+  writeset_.clear();
+  return next(writeset_, false);
+}
+
+LogicalClock WritesetTracker::track_dml(const DML *dml)
+{
+  writeset_.clear();
+  if (dml->table_() == nullptr || dml->op_type() == nullptr) {
+    return next(writeset_, false);
+  }
+
+  std::string table_name;
+  if (dml->db_name() != nullptr) {
+    table_name.append(dml->db_name()->c_str(), dml->db_name()->size());
+  }
+  table_name.push_back('\0');
+  table_name.append(dml->table_()->c_str(), dml->table_()->size());
+  TableState &table      = tables_[table_name];
+  uint64      table_hash = hash_append(FNV_OFFSET, table_name.data(), table_name.size());
+
+  bool insert = std::strcmp(dml->op_type()->c_str(), "I") == 0;
+  if (insert) {
+    if (table.key_columns.empty()) {
+      // 还不知道键列：INSERT 之间互不依赖（源端能提交说明键不冲突），之后的 UPDATE / DELETE 排在它后面
+      LogicalClock clock   = next(writeset_, true);
+      table.keyless_insert = clock.sequence_number;
+      return clock;
+    }
+    uint64 hash;
+    if (dml->new_data() == nullptr || !hash_row(table_hash, table.key_columns, *dml->new_data(), hash)) {
+      return next(writeset_, false);
+    }
+    writeset_.push_back(hash);
+    return next(writeset_, true);
+  }
+
+  // UPDATE / DELETE：keys 就是定位这一行用的键
+  auto keys = dml->keys();
+  if (keys == nullptr || keys->size() == 0) {
+    return next(writeset_, false);
+  }
+  std::vector<std::string> key_columns;
+  key_columns.reserve(keys->size());
+  for (auto pair : *keys) {
+    if (pair->key() == nullptr) {
+      return next(writeset_, false);
+    }
+    key_columns.emplace_back(pair->key()->c_str(), pair->key()->size());
+  }
+  std::sort(key_columns.begin(), key_columns.end());
+  if (table.key_columns != key_columns) {
+    // 第一次学到键列直接使用；换了一组键时，之前的哈希和新的不可比，这个事务按串行处理
+    bool first        = table.key_columns.empty();
+    table.key_columns = std::move(key_columns);
+    if (!first) {
+      return next(writeset_, false);
+    }
+  }
+
+  uint64 hash;
+  if (!hash_row(table_hash, table.key_columns, *keys, hash)) {
+    return next(writeset_, false);
+  }
+  writeset_.push_back(hash);
+  // UPDATE 可能改了键，后镜像的键同样算写过。后镜像只带了一部分键列时算不出新键，按串行处理
+  if (dml->new_data() != nullptr && contains_key(table.key_columns, *dml->new_data())) {
+    if (!hash_row(table_hash, table.key_columns, *dml->new_data(), hash)) {
+      return next(writeset_, false);
+    }
+    if (hash != writeset_.front()) {
+      writeset_.push_back(hash);
+    }
+  }
+  return next(writeset_, true, table.keyless_insert);
+}
@@ -0,0 +1,152 @@
+//
+// Created by Coonger on 2024/12/18.
+//
+#include <gtest/gtest.h>
+
+#include <chrono>
+
+#include "common/adaptive_batcher.h"
+
+using common::AdaptiveBatcher;
+using namespace std::chrono_literals;
+
+namespace {
+
+/**
+ * @brief 用虚拟时钟驱动 AdaptiveBatcher 的到达观测
+ */
+struct Driver
+{
+  AdaptiveBatcher                    batcher;
+  AdaptiveBatcher::Clock::time_point now{};
+  uint64                             arrivals = 0;
+
+  Driver(size_t min_batch, size_t max_batch, std::chrono::microseconds max_latency)
+      : batcher(min_batch, max_batch, max_latency)
+  {
+    batcher.observe_arrivals(arrivals, now);
+  }
+
+  /**
+   * @brief 以 rate 条/秒的速率到达 interval 这么久，然后观测一次
+   * @return 调整后的目标大小
+   */
+  size_t arrive(uint64 rate, std::chrono::microseconds interval = 1ms)
+  {
+    now += interval;
+    arrivals += rate * interval.count() / 1000000;
+    batcher.observe_arrivals(arrivals, now);
+    return batcher.target();
+  }
+};
+
+}  // namespace
+
+/**
+ * @brief target 限制在 [min_batch, max_batch]，min_batch 至少为 1，max_batch 不小于 min_batch
+ */
+TEST(ADAPTIVE_BATCHER_TEST, CLAMP)
+{
+  // 还没有速率样本时按 max_batch 收集
+  Driver fast(16, 4096, 10ms);
+  EXPECT_EQ(fast.batcher.target(), 4096u);
+  // 1e6 条/秒 × 10ms = 10000，超过上限
+  EXPECT_EQ(fast.arrive(1000000), 4096u);
+  EXPECT_DOUBLE_EQ(fast.batcher.arrival_rate(), 1e6);
+
+  // 1000 条/秒 × 10ms = 10，低于下限
+  Driver slow(16, 4096, 10ms);
+  EXPECT_EQ(slow.arrive(1000), 16u);
+
+  // 没有到达时不低于 1
+  Driver idle(0, 4096, 10ms);
+  idle.arrive(1000);
+  for (int i = 0; i < 100; i++) {
+    idle.arrive(0);
+  }
+  EXPECT_EQ(idle.batcher.target(), 1u);
+
+  AdaptiveBatcher inverted(64, 8, 10ms);
+  EXPECT_EQ(inverted.max_batch(), 64u);
+  EXPECT_EQ(inverted.target(), 64u);
+}
+
+/**
+ * @brief 速率降下来后 rate 的滑动平均逐步衰减，target 单调缩小，最终收敛到 rate × max_latency
+ */
+TEST(ADAPTIVE_BATCHER_TEST, SHRINK_AT_LOW_RATE)
+{
+  Driver driver(1, 65536, 10ms);
+  EXPECT_EQ(driver.arrive(1000000), 10000u);
+
+  size_t last = driver.batcher.target();
+  for (int i = 0; i < 100; i++) {
+    size_t target = driver.arrive(1000);
+    EXPECT_LE(target, last);
+    last = target;
+  }
+  EXPECT_NEAR(driver.batcher.arrival_rate(), 1000, 1);
+  EXPECT_EQ(last, 10u);
+
+  // 转换很快时窗口取 batch_time，batch 更小：1000 条/秒 × 3ms = 3
+  driver.batcher.record_batch(3, 3ms);
+  EXPECT_EQ(driver.batcher.target(), 3u);
+}
+
+/**
+ * @brief 速率不变、batch_time 变大时 target 跟着变大，窗口不超过 max_latency
+ */
+TEST(ADAPTIVE_BATCHER_TEST, GROW_WITH_BATCH_TIME)
+{
+  Driver driver(1, 1000000, 10ms);
+  EXPECT_EQ(driver.arrive(1000000), 10000u);
+
+  // 第一个样本直接作为平均值：1e6 条/秒 × 100us = 100
+  driver.batcher.record_batch(100, 100us);
+  EXPECT_DOUBLE_EQ(driver.batcher.batch_time_us(), 100);
+  EXPECT_EQ(driver.batcher.target(), 100u);
+
+  // 空 batch 不计入
+  driver.batcher.record_batch(0, 50ms);
+  EXPECT_DOUBLE_EQ(driver.batcher.batch_time_us(), 100);
+
+  size_t last = driver.batcher.target();
+  for (int i = 0; i < 10; i++) {
+    driver.batcher.record_batch(last, 2ms);
+    EXPECT_GT(driver.batcher.target(), last);
+    last = driver.batcher.target();
+  }
+  EXPECT_LT(last, 2000u);
+
+  // batch_time 超过 max_latency 后按 max_latency 算
+  for (int i = 0; i < 100; i++) {
+    driver.batcher.record_batch(last, 50ms);
+  }
+  EXPECT_GT(driver.batcher.batch_time_us(), 10000);
+  EXPECT_EQ(driver.batcher.target(), 10000u);
+}
+
+/**
+ * @brief 距离上次观测不到 MIN_OBSERVE_INTERVAL（200us）的观测被跳过，到达数留到下一次一起算
+ */
+TEST(ADAPTIVE_BATCHER_TEST, SKIP_SHORT_INTERVAL)
+{
+  Driver driver(1, 65536, 10ms);
+
+  EXPECT_EQ(driver.arrive(1000000, 100us), 65536u);
+  EXPECT_EQ(driver.batcher.arrival_rate(), 0);
+  EXPECT_EQ(driver.arrive(1000000, 50us), 65536u);
+  EXPECT_EQ(driver.batcher.arrival_rate(), 0);
+
+  // 这一次和基线相隔 200us，一共 100 + 50 + 150 = 300 条：1.5e6 条/秒
+  EXPECT_EQ(driver.arrive(3000000, 50us), 15000u);
+  EXPECT_DOUBLE_EQ(driver.batcher.arrival_rate(), 1.5e6);
+
+  // 跳过的观测不更新基线：100us + 400us 一共 600 条，样本是 1.2e6
+  driver.now += 100us;
+  driver.batcher.observe_arrivals(driver.arrivals + 600, driver.now);
+  EXPECT_DOUBLE_EQ(driver.batcher.arrival_rate(), 1.5e6);
+  driver.now += 400us;
+  driver.batcher.observe_arrivals(driver.arrivals + 600, driver.now);
+  EXPECT_NEAR(driver.batcher.arrival_rate(), 1.5e6 + 0.2 * (1.2e6 - 1.5e6), 1e-3);
+}
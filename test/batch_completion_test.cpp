@@ -0,0 +1,222 @@
+//
+// Created by Coonger on 2024/12/18.
+//
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "common/batch_completion.h"
+#include "common/init_setting.h"
+#include "binlog_inspect.h"
+#include "log_file.h"
+#include "redo_generator.h"
+
+using common::BatchCompletion;
+using namespace std::chrono_literals;
+
+namespace {
+
+std::vector<Task> generate_tasks(uint64 records)
+{
+  loft::RedoGeneratorOptions options;
+  options.seed    = 11;
+  options.tables  = 2;
+  options.records = records;
+
+  loft::RedoGenerator generator(options);
+  EXPECT_EQ(generator.init(), RC::SUCCESS);
+
+  std::vector<Task>  tasks;
+  std::vector<uint8> record;
+  bool               is_ddl = false;
+  while (generator.next(record, is_ddl)) {
+    tasks.emplace_back(std::vector<unsigned char>(record.begin(), record.end()), is_ddl);
+  }
+  return tasks;
+}
+
+std::unique_ptr<LogFileManager> open_manager(const std::filesystem::path &dir, const LogFileOptions &options)
+{
+  auto manager = std::make_unique<LogFileManager>(options);
+  EXPECT_EQ(manager->init(dir.c_str(), DEFAULT_BINLOG_FILE_NAME_PREFIX, 1 << 20), RC::SUCCESS);
+  manager->last_file(*manager->get_file_writer());
+  return manager;
+}
+
+}  // namespace
+
+/**
+ * @brief 分几次 finish，最后一次完成时 wait 返回、回调在这个线程上调用一次；结果是第一个错误
+ */
+TEST(BATCH_COMPLETION_TEST, FINISH_AND_FIRST_ERROR)
+{
+  std::atomic<int> calls{0};
+  RC               result = RC::SUCCESS;
+  BatchCompletion *self   = nullptr;
+  BatchCompletion  completion(5, [&](RC rc) {
+    calls++;
+    result = rc;
+    // 回调在锁外调用，可以查询句柄本身
+    EXPECT_TRUE(self->done());
+  });
+  self = &completion;
+
+  completion.finish(2, RC::SUCCESS);
+  EXPECT_FALSE(completion.done());
+  EXPECT_EQ(completion.remaining(), 3u);
+  EXPECT_EQ(completion.status(), RC::SUCCESS);
+  EXPECT_FALSE(completion.wait_for(10ms));
+
+  completion.finish(1, RC::IOERR_WRITE);
+  EXPECT_EQ(completion.status(), RC::IOERR_WRITE);
+  EXPECT_FALSE(completion.done());
+  completion.finish(1, RC::IOERR_SYNC);
+  EXPECT_EQ(calls.load(), 0);
+
+  // 多报的条数不会让 remaining 下溢，回调只调用一次
+  completion.finish(5, RC::SUCCESS);
+  EXPECT_TRUE(completion.done());
+  EXPECT_EQ(completion.remaining(), 0u);
+  EXPECT_EQ(completion.wait(), RC::IOERR_WRITE);
+  EXPECT_EQ(calls.load(), 1);
+  EXPECT_EQ(result, RC::IOERR_WRITE);
+  completion.finish(1, RC::SUCCESS);
+  EXPECT_EQ(calls.load(), 1);
+}
+
+/**
+ * @brief 多个线程各自 finish 一部分，等待者在最后一部分完成后才返回
+ */
+TEST(BATCH_COMPLETION_TEST, CONCURRENT_FINISH)
+{
+  constexpr int THREADS    = 4;
+  constexpr int PER_THREAD = 1000;
+
+  std::atomic<int> calls{0};
+  auto completion = std::make_shared<BatchCompletion>(THREADS * PER_THREAD, [&calls](RC) { calls++; });
+
+  std::thread waiter([completion] { EXPECT_EQ(completion->wait(), RC::SUCCESS); });
+  std::vector<std::thread> writers;
+  for (int t = 0; t < THREADS; t++) {
+    writers.emplace_back([completion] {
+      for (int i = 0; i < PER_THREAD; i++) {
+        completion->finish(1, RC::SUCCESS);
+      }
+    });
+  }
+  for (auto &writer : writers) {
+    writer.join();
+  }
+  waiter.join();
+  EXPECT_TRUE(completion->done());
+  EXPECT_EQ(calls.load(), 1);
+}
+
+/**
+ * @brief 按提交顺序完成：写线程按 batch 顺序写出，每个批量提交的回调都在它之前的提交完成之后调用
+ */
+TEST(TRANSFORM_BATCH_TEST, COMPLETION_ORDER)
+{
+  std::filesystem::path dir   = loft::make_temp_dir("loft-completion");
+  std::vector<Task>     tasks = generate_tasks(300);
+
+  auto manager = open_manager(dir, LogFileOptions());
+
+  constexpr size_t         SUBMIT_BATCH = 7;
+  std::mutex               mutex;
+  std::vector<size_t>      order;
+  size_t                   submitted = 0;
+  size_t                   tail      = tasks.size() - SUBMIT_BATCH;
+  for (size_t begin = 0; begin < tail; begin += SUBMIT_BATCH) {
+    std::span<Task> batch(tasks.data() + begin, std::min(SUBMIT_BATCH, tail - begin));
+    size_t          index = submitted++;
+    RC              rc    = manager->transformBatch(batch, [&mutex, &order, index](RC result) {
+      EXPECT_EQ(result, RC::SUCCESS);
+      std::lock_guard<std::mutex> lock(mutex);
+      order.push_back(index);
+    });
+    ASSERT_EQ(rc, RC::SUCCESS);
+  }
+
+  // 最后一批用句柄形式提交，它完成时前面的提交都已经完成
+  BatchHandle handle = manager->transformBatch(std::span<Task>(tasks.data() + tail, SUBMIT_BATCH));
+  EXPECT_EQ(handle->wait(), RC::SUCCESS);
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    ASSERT_EQ(order.size(), submitted);
+    for (size_t i = 0; i < order.size(); i++) {
+      EXPECT_EQ(order[i], i);
+    }
+  }
+
+  manager.reset();
+  std::filesystem::remove_all(dir);
+}
+
+/**
+ * @brief 预算申请不到时句柄立即以 SPEED_LIMIT 完成、记录原样保留；调用方原样重试同一批，预算腾出来后成功
+ */
+TEST(TRANSFORM_BATCH_TEST, SPEED_LIMIT_RETRY)
+{
+  std::filesystem::path dir   = loft::make_temp_dir("loft-completion");
+  std::vector<Task>     tasks = generate_tasks(20);
+
+  LogFileOptions options;
+  options.memory_budget        = 1 << 20;
+  options.admission_timeout_ms = 1;
+  auto manager                 = open_manager(dir, options);
+
+  // 占满预算，模拟写线程跟不上
+  common::MemoryBudget &budget = manager->get_memory_budget();
+  budget.force_acquire(budget.capacity());
+
+  std::vector<size_t> sizes;
+  for (const Task &task : tasks) {
+    sizes.push_back(task.data_.size());
+  }
+
+  BatchHandle handle = manager->transformBatch(tasks);
+  ASSERT_TRUE(handle->done());
+  EXPECT_EQ(handle->status(), RC::SPEED_LIMIT);
+  EXPECT_EQ(handle->wait(), RC::SPEED_LIMIT);
+  for (size_t i = 0; i < tasks.size(); i++) {
+    EXPECT_EQ(tasks[i].data_.size(), sizes[i]) << "task " << i;
+    EXPECT_EQ(tasks[i].completion_, nullptr) << "task " << i;
+  }
+
+  // 回调形式：返回值和回调都是 SPEED_LIMIT，回调在提交的线程上立即调用
+  RC              callback_rc = RC::SUCCESS;
+  std::thread::id callback_thread;
+  EXPECT_EQ(manager->transformBatch(tasks,
+                [&](RC rc) {
+                  callback_rc     = rc;
+                  callback_thread = std::this_thread::get_id();
+                }),
+      RC::SPEED_LIMIT);
+  EXPECT_EQ(callback_rc, RC::SPEED_LIMIT);
+  EXPECT_EQ(callback_thread, std::this_thread::get_id());
+
+  // 写线程消化之后预算归还，调用方按约定原样重试
+  budget.release(budget.capacity());
+  int retries = 0;
+  while (true) {
+    handle = manager->transformBatch(tasks);
+    if (!handle->done() || handle->status() != RC::SPEED_LIMIT) {
+      break;
+    }
+    retries++;
+    std::this_thread::sleep_for(1ms);
+  }
+  EXPECT_EQ(retries, 0);
+  EXPECT_EQ(handle->wait(), RC::SUCCESS);
+
+  manager.reset();
+  std::filesystem::remove_all(dir);
+}
@@ -0,0 +1,299 @@
+//
+// Created by Coonger on 2024/12/18.
+//
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <sys/uio.h>
+#include <thread>
+#include <vector>
+
+#include "common/init_setting.h"
+#include "common/mysql_constant_def.h"
+#include "basic_ostream.h"
+#include "binlog_inspect.h"
+#include "log_file.h"
+#include "redo_generator.h"
+
+using loft::binlog_files;
+using loft::make_temp_dir;
+using loft::read_file;
+
+namespace {
+
+constexpr const char *TEMP_PREFIX = "loft-sequencer";
+
+struct EventInfo
+{
+  size_t offset;
+  uint32 len;
+  uint32 log_pos;
+  uint8  type;
+};
+
+/// 按 event header 里的长度逐个解析，解析不下去时停止
+std::vector<EventInfo> parse_events(const std::vector<char> &data)
+{
+  std::vector<EventInfo> events;
+  size_t                 offset = BINLOG_MAGIC_SIZE;
+  while (offset + LOG_EVENT_HEADER_LEN <= data.size()) {
+    EventInfo info{offset, 0, 0, static_cast<uint8>(data[offset + EVENT_TYPE_OFFSET])};
+    memcpy(&info.len, data.data() + offset + EVENT_LEN_OFFSET, sizeof(info.len));
+    memcpy(&info.log_pos, data.data() + offset + LOG_POS_OFFSET, sizeof(info.log_pos));
+    if (info.len < LOG_EVENT_HEADER_LEN || offset + info.len > data.size()) {
+      break;
+    }
+    events.push_back(info);
+    offset += info.len;
+  }
+  return events;
+}
+
+/// 带微秒的 DATETIME(6) / TIMESTAMP(6) 也在里面
+std::vector<Task> generate_tasks(uint64 records, size_t &ddl_count)
+{
+  loft::RedoGeneratorOptions options;
+  options.seed       = 7;
+  options.tables     = 3;
+  options.records    = records;
+  options.column_mix = "int:4,bigint:2,varchar:2,decimal:1,datetime:1,timestamp:1";
+
+  loft::RedoGenerator generator(options);
+  EXPECT_EQ(generator.init(), RC::SUCCESS);
+
+  std::vector<Task>  tasks;
+  std::vector<uint8> record;
+  bool               is_ddl = false;
+  ddl_count               = 0;
+  while (generator.next(record, is_ddl)) {
+    ddl_count += is_ddl ? 1 : 0;
+    tasks.emplace_back(std::vector<unsigned char>(record.begin(), record.end()), is_ddl);
+  }
+  return tasks;
+}
+
+/**
+ * @brief 用 PARALLEL 写模式转换 tasks，DDL 单独成批，DML 按 submit_batch 条一批
+ */
+void run_parallel(const std::vector<Task> &tasks, const std::filesystem::path &dir, uint64 file_size,
+    BinlogBackend backend, size_t submit_batch)
+{
+  LogFileOptions options;
+  options.write_mode            = BinlogWriteMode::PARALLEL;
+  options.backend               = backend;
+  options.min_workers           = 4;
+  options.max_workers           = 4;
+  options.autoscale_interval_ms = 0;
+
+  auto manager = std::make_unique<LogFileManager>(options);
+  ASSERT_EQ(manager->init(dir.c_str(), DEFAULT_BINLOG_FILE_NAME_PREFIX, file_size), RC::SUCCESS);
+  manager->last_file(*manager->get_file_writer());
+
+  std::vector<BatchHandle> handles;
+  std::vector<Task>        batch;
+  auto                     submit = [&] {
+    if (batch.empty()) {
+      return;
+    }
+    BatchHandle handle;
+    while (true) {
+      handle = manager->transformBatch(batch);
+      if (!handle->done() || handle->status() != RC::SPEED_LIMIT) {
+        break;
+      }
+      std::this_thread::yield();
+    }
+    handles.push_back(std::move(handle));
+    batch.clear();
+  };
+  for (const Task &task : tasks) {
+    if (!batch.empty() && (batch.size() >= submit_batch || task.is_ddl_ != batch.back().is_ddl_)) {
+      submit();
+    }
+    batch.push_back(task);
+  }
+  submit();
+
+  for (auto &handle : handles) {
+    EXPECT_EQ(handle->wait(), RC::SUCCESS);
+  }
+  // 析构时 drain 并封存最后一个文件
+  manager.reset();
+}
+
+/**
+ * @brief 检查 PARALLEL 写出的一组文件：
+ *  1. 每个 event 的 log_pos 等于它在文件里的结束位置，即前面所有 event 长度的前缀和
+ *  2. 文件大小等于最后一个 event 的结束位置，没有残留预分配的尾部
+ *  3. 除最后一个文件外都以 Rotate event 结尾，且 Rotate event 里是下一个文件名
+ * @return 所有文件里 event 的总数
+ */
+size_t check_parallel_output(const std::filesystem::path &dir)
+{
+  std::vector<std::filesystem::path> files = binlog_files(dir);
+  EXPECT_FALSE(files.empty());
+
+  size_t total = 0;
+  for (size_t i = 0; i < files.size(); i++) {
+    std::vector<char> data = read_file(files[i]);
+    EXPECT_GE(data.size(), static_cast<size_t>(BINLOG_MAGIC_SIZE));
+    EXPECT_EQ(memcmp(data.data(), BINLOG_MAGIC, BINLOG_MAGIC_SIZE), 0) << files[i];
+
+    std::vector<EventInfo> events = parse_events(data);
+    EXPECT_FALSE(events.empty()) << files[i];
+    if (events.empty()) {
+      continue;
+    }
+    EXPECT_EQ(events.front().type, FORMAT_DESCRIPTION_EVENT) << files[i];
+
+    for (const EventInfo &event : events) {
+      EXPECT_EQ(event.log_pos, event.offset + event.len) << files[i] << " offset " << event.offset;
+    }
+    EXPECT_EQ(data.size(), events.back().offset + events.back().len) << files[i];
+
+    if (i + 1 < files.size()) {
+      const EventInfo &rotate = events.back();
+      EXPECT_EQ(rotate.type, ROTATE_EVENT) << files[i];
+      std::string body(data.data() + rotate.offset + LOG_EVENT_HEADER_LEN, rotate.len - LOG_EVENT_HEADER_LEN);
+      EXPECT_NE(body.find(files[i + 1].filename().string()), std::string::npos) << files[i];
+    } else {
+      EXPECT_NE(events.back().type, ROTATE_EVENT) << files[i];
+    }
+    total += events.size();
+  }
+  return total;
+}
+
+}  // namespace
+
+/**
+ * @brief 多个线程各自 pwritev 到不重叠的区间，close 时截断到实际大小，丢掉 fallocate 的尾部
+ */
+TEST(BINLOG_PFILE_TEST, CONCURRENT_PWRITEV_AND_TRUNCATE_ON_CLOSE)
+{
+  std::filesystem::path dir  = make_temp_dir(TEMP_PREFIX);
+  std::string           path = (dir / "ON.000001").string();
+
+  constexpr size_t kWriters = 4;
+  constexpr size_t kChunk   = 1000;
+
+  RC           rc = RC::SUCCESS;
+  Binlog_pfile file(path.c_str(), 1 << 20, rc);
+  ASSERT_EQ(rc, RC::SUCCESS);
+  EXPECT_EQ(file.initial_size(), 0);
+
+  std::vector<std::thread> writers;
+  for (size_t w = 0; w < kWriters; w++) {
+    writers.emplace_back([&file, w] {
+      // 每个区间拆成两段 iovec，覆盖多段推进的逻辑
+      std::vector<uchar> head(kChunk / 4, static_cast<uchar>('a' + w));
+      std::vector<uchar> tail(kChunk - head.size(), static_cast<uchar>('A' + w));
+      struct iovec       iov[2] = {{head.data(), head.size()}, {tail.data(), tail.size()}};
+      EXPECT_TRUE(file.pwritev(iov, 2, w * kChunk));
+    });
+  }
+  for (auto &writer : writers) {
+    writer.join();
+  }
+
+  EXPECT_EQ(file.close(kWriters * kChunk), RC::SUCCESS);
+
+  std::vector<char> data = read_file(path);
+  ASSERT_EQ(data.size(), kWriters * kChunk);
+  for (size_t w = 0; w < kWriters; w++) {
+    EXPECT_EQ(data[w * kChunk], static_cast<char>('a' + w));
+    EXPECT_EQ(data[w * kChunk + kChunk / 4 - 1], static_cast<char>('a' + w));
+    EXPECT_EQ(data[w * kChunk + kChunk / 4], static_cast<char>('A' + w));
+    EXPECT_EQ(data[(w + 1) * kChunk - 1], static_cast<char>('A' + w));
+  }
+
+  std::filesystem::remove_all(dir);
+}
+
+/**
+ * @brief 重新打开已有内容的文件时 initial_size 是原来的大小；mmap 模式同样在 close 时截断
+ */
+TEST(BINLOG_PFILE_TEST, REOPEN_AND_MMAP)
+{
+  std::filesystem::path dir  = make_temp_dir(TEMP_PREFIX);
+  std::string           path = (dir / "ON.000001").string();
+
+  {
+    RC           rc = RC::SUCCESS;
+    Binlog_pfile file(path.c_str(), 1 << 16, rc);
+    ASSERT_EQ(rc, RC::SUCCESS);
+    const uchar magic[] = {0xfe, 0x62, 0x69, 0x6e};
+    EXPECT_TRUE(file.pwrite(magic, sizeof(magic), 0));
+    EXPECT_EQ(file.close(sizeof(magic)), RC::SUCCESS);
+  }
+
+  {
+    RC           rc = RC::SUCCESS;
+    Binlog_pfile file(path.c_str(), 1 << 16, rc, true);
+    ASSERT_EQ(rc, RC::SUCCESS);
+    EXPECT_EQ(file.initial_size(), 4);
+
+    std::vector<uchar> body(100, 'x');
+    EXPECT_TRUE(file.pwrite(body.data(), body.size(), file.initial_size()));
+    EXPECT_EQ(file.sync_range(file.initial_size(), body.size(), BinlogDurability::FLUSH), RC::SUCCESS);
+    // 超出映射区间的写入失败，而不是越界
+    EXPECT_FALSE(file.pwrite(body.data(), body.size(), (1 << 16) - 10));
+    EXPECT_EQ(file.close(file.initial_size() + body.size()), RC::SUCCESS);
+  }
+
+  std::vector<char> data = read_file(path);
+  ASSERT_EQ(data.size(), 104u);
+  EXPECT_EQ(static_cast<uchar>(data[0]), 0xfe);
+  EXPECT_EQ(data[4], 'x');
+  EXPECT_EQ(data[103], 'x');
+
+  std::filesystem::remove_all(dir);
+}
+
+/**
+ * @brief 文件足够大时只有一个文件：log_pos 是前缀和，关闭后截断到最后一个 event 的结尾
+ */
+TEST(BINLOG_SEQUENCER_TEST, PREFIX_SUM_OFFSETS)
+{
+  size_t            ddl_count = 0;
+  std::vector<Task> tasks     = generate_tasks(2000, ddl_count);
+
+  std::filesystem::path dir = make_temp_dir(TEMP_PREFIX);
+  run_parallel(tasks, dir, DEFAULT_BINLOG_FILE_SIZE, BinlogBackend::FD, 64);
+
+  EXPECT_EQ(binlog_files(dir).size(), 1u);
+  EXPECT_GT(check_parallel_output(dir), tasks.size());
+
+  std::filesystem::remove_all(dir);
+}
+
+/**
+ * @brief 文件很小、一个 batch 跨越多个文件：每个文件以指向下一个文件的 Rotate event 结尾，
+ * 所有文件里的 event 数和文件足够大时一致（多出来的只有每个新文件的 FDE 和旧文件的 Rotate）
+ */
+TEST(BINLOG_SEQUENCER_TEST, ROTATION_INSIDE_BATCH)
+{
+  size_t            ddl_count = 0;
+  std::vector<Task> tasks     = generate_tasks(2000, ddl_count);
+
+  std::filesystem::path single_dir = make_temp_dir(TEMP_PREFIX);
+  run_parallel(tasks, single_dir, DEFAULT_BINLOG_FILE_SIZE, BinlogBackend::FD, 2000);
+  size_t single_events = check_parallel_output(single_dir);
+
+  for (BinlogBackend backend : {BinlogBackend::FD, BinlogBackend::MMAP}) {
+    std::filesystem::path dir = make_temp_dir(TEMP_PREFIX);
+    // 一个 batch 2000 条 DML，远大于 16KB，切换一定发生在 batch 中间
+    run_parallel(tasks, dir, 16 << 10, backend, 2000);
+
+    size_t files = binlog_files(dir).size();
+    EXPECT_GT(files, 2u);
+    // 每多一个文件多一个 Rotate 和一个 FDE
+    EXPECT_EQ(check_parallel_output(dir), single_events + (files - 1) * 2);
+
+    std::filesystem::remove_all(dir);
+  }
+
+  std::filesystem::remove_all(single_dir);
+}
@@ -0,0 +1,326 @@
+//
+// Created by Coonger on 2024/12/18.
+//
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <future>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "common/channel.h"
+#include "common/coroutine.h"
+#include "common/thread_pool_executor.h"
+
+using common::AsyncEvent;
+using common::Channel;
+using common::Fiber;
+using common::ThreadPoolExecutor;
+
+namespace {
+
+/*
+ * executor 传 nullptr 时 resume_on 就地恢复，协程在调用线程里一步步执行，单线程的用例据此检查每一步的状态。
+ * 协程参数都按值拷进协程帧，不用带捕获的 lambda 写协程，避免 lambda 对象先于协程销毁
+ */
+
+Fiber send_all(Channel<int> *channel, std::vector<int> values, std::vector<bool> *results)
+{
+  for (int value : values) {
+    results->push_back(co_await channel->send(value));
+  }
+}
+
+Fiber recv_n(Channel<int> *channel, int n, std::vector<std::optional<int>> *received)
+{
+  for (int i = 0; i < n; i++) {
+    received->push_back(co_await channel->recv());
+  }
+}
+
+Fiber wait_event(AsyncEvent *event, int *woken)
+{
+  co_await event->wait();
+  (*woken)++;
+}
+
+/// 每次被唤醒就推进 rounds，直到 total 轮
+Fiber wait_rounds(ThreadPoolExecutor *executor, AsyncEvent *event, std::atomic<int> *rounds, int total,
+                  std::promise<void> *done)
+{
+  co_await common::schedule_on(executor);
+  for (int i = 0; i < total; i++) {
+    co_await event->wait();
+    rounds->store(i + 1, std::memory_order_release);
+  }
+  done->set_value();
+}
+
+struct Stress
+{
+  ThreadPoolExecutor *executor;
+  Channel<int>       *channel;
+  std::atomic<int>    producers_left;
+  std::atomic<int>    consumers_left;
+  std::promise<void>  done;
+};
+
+Fiber produce(Stress *stress, int first, int count)
+{
+  co_await common::schedule_on(stress->executor);
+  for (int i = first; i < first + count; i++) {
+    EXPECT_TRUE(co_await stress->channel->send(i));
+  }
+  if (--stress->producers_left == 0) {
+    stress->channel->close();
+  }
+}
+
+Fiber consume(Stress *stress, std::vector<int> *received)
+{
+  co_await common::schedule_on(stress->executor);
+  while (true) {
+    std::optional<int> value = co_await stress->channel->recv();
+    if (!value) {
+      break;
+    }
+    received->push_back(*value);
+  }
+  if (--stress->consumers_left == 0) {
+    stress->done.set_value();
+  }
+}
+
+}  // namespace
+
+/**
+ * @brief 容量为 0：不经过缓冲区，先到的一方挂起，另一方到来时直接交接
+ */
+TEST(CHANNEL_TEST, CAPACITY_ZERO)
+{
+  Channel<int> channel(nullptr, 0);
+
+  // 接收方先到
+  std::vector<std::optional<int>> received;
+  recv_n(&channel, 1, &received);
+  EXPECT_TRUE(received.empty());
+  std::vector<bool> sent;
+  send_all(&channel, {1}, &sent);
+  ASSERT_EQ(received.size(), 1u);
+  EXPECT_EQ(received[0], 1);
+  EXPECT_EQ(sent, std::vector<bool>{true});
+  EXPECT_EQ(channel.size(), 0u);
+
+  // 发送方先到
+  sent.clear();
+  send_all(&channel, {2}, &sent);
+  EXPECT_TRUE(sent.empty());
+  EXPECT_EQ(channel.size(), 0u);
+  recv_n(&channel, 1, &received);
+  ASSERT_EQ(received.size(), 2u);
+  EXPECT_EQ(received[1], 2);
+  EXPECT_EQ(sent, std::vector<bool>{true});
+}
+
+/**
+ * @brief 容量为 1：第二个元素让发送方挂起，接收方取走一个后把挂起的元素放进缓冲区并唤醒发送方
+ */
+TEST(CHANNEL_TEST, CAPACITY_ONE)
+{
+  Channel<int>      channel(nullptr, 1);
+  std::vector<bool> sent;
+  send_all(&channel, {1, 2, 3}, &sent);
+  EXPECT_EQ(sent, std::vector<bool>{true});
+  EXPECT_EQ(channel.size(), 1u);
+
+  std::vector<std::optional<int>> received;
+  recv_n(&channel, 1, &received);
+  EXPECT_EQ(received, std::vector<std::optional<int>>{1});
+  // 2 进了缓冲区，发送方恢复后又在 3 上挂起
+  EXPECT_EQ(sent.size(), 2u);
+  EXPECT_EQ(channel.size(), 1u);
+
+  recv_n(&channel, 2, &received);
+  EXPECT_EQ(received, (std::vector<std::optional<int>>{1, 2, 3}));
+  EXPECT_EQ(sent, (std::vector<bool>{true, true, true}));
+  EXPECT_EQ(channel.size(), 0u);
+}
+
+/**
+ * @brief 容量为 N：前 N 个不挂起，按 FIFO 取出
+ */
+TEST(CHANNEL_TEST, CAPACITY_N)
+{
+  constexpr int     N = 8;
+  Channel<int>      channel(nullptr, N);
+  std::vector<int>  values;
+  std::vector<bool> sent;
+  for (int i = 0; i < N + 1; i++) {
+    values.push_back(i);
+  }
+  send_all(&channel, values, &sent);
+  EXPECT_EQ(sent.size(), static_cast<size_t>(N));
+  EXPECT_EQ(channel.size(), static_cast<size_t>(N));
+
+  std::vector<std::optional<int>> received;
+  recv_n(&channel, N + 1, &received);
+  ASSERT_EQ(received.size(), static_cast<size_t>(N + 1));
+  for (int i = 0; i < N + 1; i++) {
+    EXPECT_EQ(received[i], i);
+  }
+  EXPECT_EQ(sent.size(), static_cast<size_t>(N + 1));
+  EXPECT_EQ(channel.size(), 0u);
+}
+
+/**
+ * @brief close() 唤醒挂起的接收方，它们拿到 std::nullopt
+ */
+TEST(CHANNEL_TEST, CLOSE_WAKES_RECEIVERS)
+{
+  Channel<int>                    channel(nullptr, 4);
+  std::vector<std::optional<int>> first;
+  std::vector<std::optional<int>> second;
+  recv_n(&channel, 1, &first);
+  recv_n(&channel, 1, &second);
+  EXPECT_TRUE(first.empty());
+  EXPECT_TRUE(second.empty());
+
+  channel.close();
+  EXPECT_TRUE(channel.closed());
+  EXPECT_EQ(first, std::vector<std::optional<int>>{std::nullopt});
+  EXPECT_EQ(second, std::vector<std::optional<int>>{std::nullopt});
+
+  // 重复 close 无害，之后的 recv 不挂起
+  channel.close();
+  std::vector<std::optional<int>> late;
+  recv_n(&channel, 1, &late);
+  EXPECT_EQ(late, std::vector<std::optional<int>>{std::nullopt});
+}
+
+/**
+ * @brief close() 唤醒挂起的发送方，send 返回 false、元素被丢弃；缓冲区里已有的元素仍能取完
+ */
+TEST(CHANNEL_TEST, CLOSE_WAKES_SENDERS)
+{
+  Channel<int>      channel(nullptr, 1);
+  std::vector<bool> first;
+  std::vector<bool> second;
+  send_all(&channel, {1, 2}, &first);
+  send_all(&channel, {3}, &second);
+  EXPECT_EQ(first, std::vector<bool>{true});
+  EXPECT_TRUE(second.empty());
+
+  channel.close();
+  EXPECT_EQ(first, (std::vector<bool>{true, false}));
+  EXPECT_EQ(second, std::vector<bool>{false});
+
+  std::vector<bool> late;
+  send_all(&channel, {4}, &late);
+  EXPECT_EQ(late, std::vector<bool>{false});
+
+  std::vector<std::optional<int>> received;
+  recv_n(&channel, 2, &received);
+  EXPECT_EQ(received, (std::vector<std::optional<int>>{1, std::nullopt}));
+}
+
+/**
+ * @brief 先 set 再 wait 不挂起并清除置位；之后的 wait 要等下一次 set，多次 set 只唤醒一次
+ */
+TEST(ASYNC_EVENT_TEST, SET_BEFORE_WAIT)
+{
+  AsyncEvent event(nullptr);
+  int        woken = 0;
+
+  event.set();
+  event.set();
+  wait_event(&event, &woken);
+  EXPECT_EQ(woken, 1);
+
+  wait_event(&event, &woken);
+  EXPECT_EQ(woken, 1);
+  event.set();
+  EXPECT_EQ(woken, 2);
+
+  // 上一次 set 已经交给了等待者，没有留下置位
+  wait_event(&event, &woken);
+  EXPECT_EQ(woken, 2);
+  event.set();
+  EXPECT_EQ(woken, 3);
+}
+
+/**
+ * @brief 生产者线程的 set 和协程重新进入 wait 来回竞争，不管谁先到都不能丢失唤醒
+ */
+TEST(ASYNC_EVENT_TEST, SET_WAIT_RACE)
+{
+  ThreadPoolExecutor executor;
+  ASSERT_EQ(executor.init("event-test", 2, 2, 60 * 1000), 0);
+
+  constexpr int      ROUNDS = 20000;
+  AsyncEvent         event(&executor);
+  std::atomic<int>   rounds{0};
+  std::promise<void> done;
+  std::future<void>  finished = done.get_future();
+  wait_rounds(&executor, &event, &rounds, ROUNDS, &done);
+
+  std::thread producer([&] {
+    for (int i = 0; i < ROUNDS; i++) {
+      event.set();
+      // 等协程消费掉这一次再 set，否则两次 set 会合并成一次
+      while (rounds.load(std::memory_order_acquire) <= i) {
+        std::this_thread::yield();
+      }
+    }
+  });
+  producer.join();
+
+  EXPECT_EQ(finished.wait_for(std::chrono::seconds(30)), std::future_status::ready);
+  EXPECT_EQ(rounds.load(), ROUNDS);
+  executor.shutdown();
+  executor.await_termination();
+}
+
+/**
+ * @brief 多个发送方、多个接收方在线程池上通过一个小容量通道交换元素，每个元素恰好被收到一次
+ */
+TEST(CHANNEL_TEST, MPMC_STRESS)
+{
+  ThreadPoolExecutor executor;
+  ASSERT_EQ(executor.init("channel-test", 4, 4, 60 * 1000), 0);
+
+  constexpr int PRODUCERS = 4;
+  constexpr int CONSUMERS = 4;
+  constexpr int PER_PRODUCER = 20000;
+
+  Channel<int> channel(&executor, 8);
+  Stress       stress{&executor, &channel, {PRODUCERS}, {CONSUMERS}, {}};
+  std::future<void> finished = stress.done.get_future();
+
+  std::vector<std::vector<int>> received(CONSUMERS);
+  for (int i = 0; i < CONSUMERS; i++) {
+    consume(&stress, &received[i]);
+  }
+  for (int i = 0; i < PRODUCERS; i++) {
+    produce(&stress, i * PER_PRODUCER, PER_PRODUCER);
+  }
+
+  ASSERT_EQ(finished.wait_for(std::chrono::seconds(60)), std::future_status::ready);
+  executor.shutdown();
+  executor.await_termination();
+
+  std::vector<int> seen(PRODUCERS * PER_PRODUCER, 0);
+  for (const auto &values : received) {
+    // 同一个发送方的元素在一个接收方里保持发送顺序
+    std::vector<int> last(PRODUCERS, -1);
+    for (int value : values) {
+      seen[value]++;
+      EXPECT_GT(value, last[value / PER_PRODUCER]);
+      last[value / PER_PRODUCER] = value;
+    }
+  }
+  for (size_t i = 0; i < seen.size(); i++) {
+    ASSERT_EQ(seen[i], 1) << "value " << i;
+  }
+  EXPECT_EQ(channel.size(), 0u);
+}
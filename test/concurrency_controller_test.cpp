@@ -0,0 +1,133 @@
+//
+// Created by Coonger on 2024/12/18.
+//
+#include <gtest/gtest.h>
+
+#include <chrono>
+
+#include "common/concurrency_controller.h"
+
+using common::ConcurrencyController;
+using namespace std::chrono_literals;
+
+namespace {
+
+/**
+ * @brief 用虚拟时钟驱动 ConcurrencyController，每次前进一个 100ms 的采样区间
+ */
+struct Driver
+{
+  ConcurrencyController                    controller;
+  ConcurrencyController::Clock::time_point now{};
+  uint64                                   completed = 0;
+
+  Driver(int min_workers, int max_workers) : controller(min_workers, max_workers, 100ms)
+  {
+    EXPECT_FALSE(controller.update(0, 0, now));
+  }
+
+  /**
+   * @param throughput 这个区间的吞吐（条/秒）
+   * @param backlog    区间内 worker 是否有积压
+   * @param unwritten  区间结束时还没写出的 batch 数
+   * @return 调整后的并发度
+   */
+  int run(uint64 throughput, bool backlog = true, uint64 unwritten = 0)
+  {
+    now += 100ms;
+    completed += throughput / 10;
+    controller.observe_backlog(backlog);
+    controller.update(completed, unwritten, now);
+    return controller.limit();
+  }
+};
+
+}  // namespace
+
+/**
+ * @brief 吞吐连续上升时沿同一方向走，步长翻倍，上限是 (max - min) / 4，不会超过 max_workers
+ */
+TEST(CONCURRENCY_CONTROLLER_TEST, CLIMB)
+{
+  Driver driver(1, 32);
+  EXPECT_EQ(driver.controller.limit(), 1);
+
+  // 不满一个采样区间不调整
+  EXPECT_FALSE(driver.controller.update(100, 0, driver.now + 50ms));
+
+  EXPECT_EQ(driver.run(1000), 2);  // 没有基线，往上试探
+  EXPECT_EQ(driver.run(2000), 4);
+  EXPECT_EQ(driver.run(4000), 8);
+  EXPECT_EQ(driver.run(8000), 15);  // 步长 8 被限制在 7
+  EXPECT_EQ(driver.run(16000), 22);
+  EXPECT_EQ(driver.run(32000), 29);
+  EXPECT_EQ(driver.run(64000), 32);
+  EXPECT_EQ(driver.run(128000), 32);
+  EXPECT_DOUBLE_EQ(driver.controller.throughput(), 128000);
+  EXPECT_DOUBLE_EQ(driver.controller.worker_throughput(), 4000);
+}
+
+/**
+ * @brief 吞吐下降时掉头，步长回到 1；掉头之后吞吐回升就沿新方向继续走
+ */
+TEST(CONCURRENCY_CONTROLLER_TEST, REVERSAL)
+{
+  Driver driver(1, 32);
+  EXPECT_EQ(driver.run(1000), 2);
+  EXPECT_EQ(driver.run(2000), 4);
+  EXPECT_EQ(driver.run(1000), 3);  // 加到 4 个反而变慢，掉头
+  EXPECT_EQ(driver.run(1500), 1);  // 减线程后变快，继续减，步长翻倍
+  EXPECT_EQ(driver.run(1000), 2);  // 在下限处变慢，再掉头
+}
+
+/**
+ * @brief 吞吐持平：刚加过线程就退回加之前的并发度，否则减一个；已经在下限时加一个试探
+ */
+TEST(CONCURRENCY_CONTROLLER_TEST, PLATEAU_REVERT)
+{
+  Driver driver(1, 32);
+  EXPECT_EQ(driver.run(1000), 2);
+  EXPECT_EQ(driver.run(2000), 4);
+  EXPECT_EQ(driver.run(4000), 8);
+  EXPECT_EQ(driver.run(4100), 4);  // 从 4 加到 8 没有带来吞吐，直接退回 4
+  EXPECT_EQ(driver.run(4100), 3);  // 仍然持平，一个一个往下减
+
+  Driver at_min(2, 8);
+  EXPECT_EQ(at_min.run(1000), 3);
+  EXPECT_EQ(at_min.run(1000), 2);  // 退回下限
+  EXPECT_EQ(at_min.run(1000), 3);  // 在下限持平，往上试探
+}
+
+/**
+ * @brief 写线程是瓶颈时不管吞吐都减一个线程；积压不再增长后重新从没有基线开始试探
+ */
+TEST(CONCURRENCY_CONTROLLER_TEST, WRITER_BOUND_BACKOFF)
+{
+  Driver driver(1, 32);
+  EXPECT_EQ(driver.run(1000), 2);
+  EXPECT_EQ(driver.run(2000), 4);
+  EXPECT_EQ(driver.run(4000), 8);
+
+  EXPECT_EQ(driver.run(8000, true, 10), 7);   // 等待写出的 batch 在增长，且比 worker 多
+  EXPECT_EQ(driver.run(8000, true, 20), 6);   // 步长不翻倍
+  EXPECT_EQ(driver.run(8000, false, 30), 5);  // 没有积压也要减
+  EXPECT_EQ(driver.run(8000, true, 30), 6);   // 不再增长：没有基线，往上试探
+
+  // 等待写出的 batch 在增长，但比 worker 少，不算写瓶颈
+  Driver few(1, 32);
+  EXPECT_EQ(few.run(1000, true, 0), 2);
+  EXPECT_EQ(few.run(2000, true, 2), 4);
+}
+
+/**
+ * @brief 区间内 worker 没有积压时保持不动，并丢掉基线，下一个有积压的区间重新试探
+ */
+TEST(CONCURRENCY_CONTROLLER_TEST, IDLE_KEEPS_LIMIT)
+{
+  Driver driver(1, 32);
+  EXPECT_EQ(driver.run(1000), 2);
+  EXPECT_EQ(driver.run(2000), 4);
+  EXPECT_EQ(driver.run(500, false), 4);
+  EXPECT_EQ(driver.run(100, false), 4);
+  EXPECT_EQ(driver.run(400), 5);  // 吞吐比空闲前低，但没有基线可比，仍然往上试探
+}
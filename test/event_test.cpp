@@ -230,7 +230,7 @@ TEST(ROWS_EVENT_FORMAT_TEST, WRITE_EVENT) {
   std::vector<uint8> rows_null{0};
   insertRow->set_rows_after(std::move(rows));
   insertRow->set_null_after(std::move(rows_null));
-  insertRow->write_data_after(&data1, MYSQL_TYPE_LONG, 4, 0, 0, 0);
+  insertRow->write_data_after((uchar *)&data1, MYSQL_TYPE_LONG, 4, 0, 0, 0);
 
 
   binlog->write_event_to_binlog(insertRow.get());
@@ -278,14 +278,14 @@ TEST(ROWS_EVENT_FORMAT_TEST, UPDATE_EVENT) {
   std::vector<uint8> rows_null_after{0};
   updateRow->set_rows_after(std::move(rows_after));
   updateRow->set_null_after(std::move(rows_null_after));
-  updateRow->write_data_after(&newData1, MYSQL_TYPE_LONG, 4, 0, 0, 0);
+  updateRow->write_data_after((uchar *)&newData1, MYSQL_TYPE_LONG, 4, 0, 0, 0);
 
   int conditionData = 1;
   std::vector<int> rows_before{1};
   std::vector<uint8> rows_null_before{0};
   updateRow->set_rows_before(std::move(rows_before));
   updateRow->set_null_before(std::move(rows_null_before));
-  updateRow->write_data_before(&conditionData, MYSQL_TYPE_LONG, 4, 0, 0, 0);
+  updateRow->write_data_before((uchar *)&conditionData, MYSQL_TYPE_LONG, 4, 0, 0, 0);
 
 
   binlog->write_event_to_binlog(updateRow.get());
@@ -333,7 +333,7 @@ TEST(ROWS_EVENT_FORMAT_TEST, DELETE_EVENT) {
   std::vector<uint8> rows_null_before{0};
   deleteRow->set_rows_before(std::move(rows_before));
   deleteRow->set_null_before(std::move(rows_null_before));
-  deleteRow->write_data_before(&conditionData, MYSQL_TYPE_LONG, 4, 0, 0, 0);
+  deleteRow->write_data_before((uchar *)&conditionData, MYSQL_TYPE_LONG, 4, 0, 0, 0);
 
   binlog->close();
 }
@@ -386,3 +386,124 @@ TEST(CONTROL_EVENT_FORMAT_TEST, ROTATE_EVENT) {
     binlog->close();
 }
 
+
+/**
+ * @brief write_to_iovec() 拼起来的字节必须和 write_to_buffer() 完全一致
+ */
+static std::vector<uchar> serialize_to_buffer(AbstractEvent *event) {
+    std::vector<uchar> buffer(LOG_EVENT_HEADER_LEN + event->get_data_size(), 0);
+    event->write_to_buffer(buffer.data());
+    return buffer;
+}
+
+static std::vector<uchar> serialize_to_iovec(AbstractEvent *event) {
+    EventIovec iov;
+    EXPECT_TRUE(event->write_to_iovec(iov));
+    EXPECT_EQ(iov.size(), LOG_EVENT_HEADER_LEN + event->get_data_size());
+    return iov.to_vector();
+}
+
+static std::unique_ptr<Rows_event> make_update_row(const Table_id &tid, uint64 ts) {
+    auto updateRow = std::make_unique<Rows_event>(tid, 2, 1, UPDATE_ROWS_EVENT, ts);
+    int newData1 = 10;
+    const char *newData2 = "hello";
+    updateRow->set_rows_after(std::vector<int>{1, 2});
+    updateRow->set_null_after(std::vector<uint8>{0, 0});
+    updateRow->write_data_after((uchar *)&newData1, MYSQL_TYPE_LONG, 4, 0, 0, 0);
+    updateRow->write_data_after((uchar *)newData2, MYSQL_TYPE_VARCHAR, 20, strlen(newData2), 0, 0);
+
+    int conditionData = 1;
+    updateRow->set_rows_before(std::vector<int>{1, 2});
+    updateRow->set_null_before(std::vector<uint8>{0, 1});
+    updateRow->write_data_before((uchar *)&conditionData, MYSQL_TYPE_LONG, 4, 0, 0, 0);
+    return updateRow;
+}
+
+TEST(EVENT_SERIALIZE_TEST, IOVEC_EQUALS_BUFFER) {
+    uint64 ts = 1722493961117679;
+    Table_id tid(13);
+
+    // Gtid / Xid 走默认实现，整个 event 写进 scratch
+    auto ge1 = std::make_unique<Gtid_event>(30, 31, true, ts, ts, ORIGINAL_SERVER_VERSION, IMMEDIATE_SERVER_VERSION);
+    auto ge2 = std::make_unique<Gtid_event>(30, 31, true, ts, ts, ORIGINAL_SERVER_VERSION, IMMEDIATE_SERVER_VERSION);
+    EXPECT_EQ(serialize_to_buffer(ge1.get()), serialize_to_iovec(ge2.get()));
+
+    auto xe1 = std::make_unique<Xid_event>(31, ts);
+    auto xe2 = std::make_unique<Xid_event>(31, ts);
+    EXPECT_EQ(serialize_to_buffer(xe1.get()), serialize_to_iovec(xe2.get()));
+
+    const char *query = "create table t1 (id int)";
+    auto make_query = [&] {
+        return std::make_unique<Query_event>(query, "t1", "t1", 31, strlen(query), 10000, 0, 0, 0, 0, 0, 0, ts);
+    };
+    auto qe1 = make_query();
+    auto qe2 = make_query();
+    EXPECT_EQ(serialize_to_buffer(qe1.get()), serialize_to_iovec(qe2.get()));
+
+    std::vector<mysql::FieldRef> field_vec;
+    field_vec.emplace_back(mysql::make_field("a1", 0, false, false, 0, MYSQL_TYPE_LONG, 0, 0));
+    field_vec.emplace_back(mysql::make_field("a2", 20, true, false, 0, MYSQL_TYPE_VARCHAR, 0, 0));
+    auto tm1 = std::make_unique<Table_map_event>(tid, 2, "t1", 2, "t1", 2, field_vec, ts);
+    auto tm2 = std::make_unique<Table_map_event>(tid, 2, "t1", 2, "t1", 2, field_vec, ts);
+    EXPECT_EQ(serialize_to_buffer(tm1.get()), serialize_to_iovec(tm2.get()));
+
+    auto row1 = make_update_row(tid, ts);
+    auto row2 = make_update_row(tid, ts);
+    EXPECT_EQ(serialize_to_buffer(row1.get()), serialize_to_iovec(row2.get()));
+}
+
+/**
+ * @brief DATETIME(6) / TIMESTAMP(6) / TIME(6) 按列的小数位数打包微秒，table map 里写 *2 类型和 1 字节的小数位数；
+ *         值的小数位比列精度多时截断，不会触发打包函数里的断言
+ */
+TEST(ROWS_EVENT_FORMAT_TEST, TEMPORAL_FRACTION) {
+    uint64 ts = 1722493961117679;
+    Table_id tid(13);
+
+    struct Case {
+        enum_field_types type;
+        const char      *value;
+        size_t           base_size;
+    };
+    const Case cases[] = {
+        {MYSQL_TYPE_DATETIME, "2024-08-01 14:32:41.000054", 5},
+        {MYSQL_TYPE_TIMESTAMP, "2024-08-01 14:32:41.000054", 4},
+        {MYSQL_TYPE_TIME, "14:32:41.000054", 3},
+    };
+    for (const Case &c : cases) {
+        size_t sizes[DATETIME_MAX_DECIMALS + 1];
+        for (uint dec = 0; dec <= DATETIME_MAX_DECIMALS; dec++) {
+            auto field = mysql::make_field("a1", 26, false, false, 0, c.type, 0, dec);
+            EXPECT_EQ(field->decimals(), dec);
+            uchar meta = 0xff;
+            EXPECT_EQ(field->save_field_metadata(&meta), 1);
+            EXPECT_EQ(meta, dec);
+
+            auto row = std::make_unique<Rows_event>(tid, 1, 1, WRITE_ROWS_EVENT, ts);
+            row->set_rows_after(std::vector<int>{1});
+            row->set_null_after(std::vector<uint8>{0});
+            row->setBefore(false);
+            row->writeData((uchar *)c.value, field->type(), field->pack_length(), strlen(c.value), field->decimals());
+            sizes[dec] = row->get_data_size();
+        }
+        // 小数位每 2 位多 1 个字节
+        EXPECT_EQ(sizes[1] - sizes[0], 1u) << c.type;
+        EXPECT_EQ(sizes[3] - sizes[0], 2u) << c.type;
+        EXPECT_EQ(sizes[6] - sizes[0], 3u) << c.type;
+
+        // 值在 event 的最后；6 位精度时最后 3 个字节就是微秒数 54，大端
+        auto field = mysql::make_field("a1", 26, false, false, 0, c.type, 0, 6);
+        auto row = std::make_unique<Rows_event>(tid, 1, 1, WRITE_ROWS_EVENT, ts);
+        row->set_rows_after(std::vector<int>{1});
+        row->set_null_after(std::vector<uint8>{0});
+        row->setBefore(false);
+        row->writeData((uchar *)c.value, field->type(), field->pack_length(), strlen(c.value), field->decimals());
+        std::vector<uchar> buffer = serialize_to_buffer(row.get());
+        ASSERT_GE(buffer.size(), 3u);
+        EXPECT_EQ(std::vector<uchar>(buffer.end() - 3, buffer.end()), (std::vector<uchar>{0x00, 0x00, 0x36})) << c.type;
+    }
+
+    EXPECT_EQ(mysql::make_field("a1", 26, false, false, 0, MYSQL_TYPE_DATETIME, 0, 6)->binlog_type(), MYSQL_TYPE_DATETIME2);
+    EXPECT_EQ(mysql::make_field("a1", 26, false, false, 0, MYSQL_TYPE_TIMESTAMP, 0, 6)->binlog_type(), MYSQL_TYPE_TIMESTAMP2);
+    EXPECT_EQ(mysql::make_field("a1", 26, false, false, 0, MYSQL_TYPE_TIME, 0, 6)->binlog_type(), MYSQL_TYPE_TIME2);
+}
@@ -0,0 +1,115 @@
+//
+// Created by Coonger on 2024/12/18.
+//
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include "common/memory_budget.h"
+
+using common::MemoryBudget;
+using namespace std::chrono_literals;
+
+/**
+ * @brief 预算不足时 acquire 等到超时返回 false，不占用 credit，并记一次 stall
+ */
+TEST(MEMORY_BUDGET_TEST, ACQUIRE_TIMEOUT)
+{
+  MemoryBudget budget(100);
+  EXPECT_TRUE(budget.acquire(80, 10ms));
+  EXPECT_EQ(budget.used(), 80);
+
+  auto start = std::chrono::steady_clock::now();
+  EXPECT_FALSE(budget.acquire(30, 50ms));
+  EXPECT_GE(std::chrono::steady_clock::now() - start, 50ms);
+  EXPECT_EQ(budget.used(), 80);
+  EXPECT_EQ(budget.stalls(), 1);
+
+  // 另一个线程归还 credit 后，等待中的 acquire 成功
+  auto waiter = std::async(std::launch::async, [&budget] { return budget.acquire(30, 5000ms); });
+  std::this_thread::sleep_for(20ms);
+  budget.release(50);
+  EXPECT_TRUE(waiter.get());
+  EXPECT_EQ(budget.used(), 60);
+  EXPECT_EQ(budget.peak(), 80);
+}
+
+/**
+ * @brief try_acquire 不等待；比整个预算还大的申请只在预算空闲时放行
+ */
+TEST(MEMORY_BUDGET_TEST, TRY_ACQUIRE)
+{
+  MemoryBudget budget(100);
+  EXPECT_TRUE(budget.try_acquire(60));
+  EXPECT_FALSE(budget.try_acquire(50));
+  EXPECT_TRUE(budget.try_acquire(40));
+  EXPECT_EQ(budget.used(), 100);
+  EXPECT_EQ(budget.stalls(), 0);
+
+  budget.release(100);
+  EXPECT_TRUE(budget.try_acquire(500));
+  EXPECT_FALSE(budget.try_acquire(1));
+  budget.release(500);
+
+  // capacity 为 0 时只记账
+  MemoryBudget unlimited(0);
+  EXPECT_TRUE(unlimited.try_acquire(1ULL << 40));
+  EXPECT_EQ(unlimited.used(), 1ULL << 40);
+}
+
+/**
+ * @brief force_acquire 可以超出预算，超出期间生产者申请失败，归还到预算以内后恢复
+ */
+TEST(MEMORY_BUDGET_TEST, FORCE_ACQUIRE_OVERSHOOT)
+{
+  MemoryBudget budget(100);
+  EXPECT_TRUE(budget.try_acquire(90));
+  budget.force_acquire(50);
+  EXPECT_EQ(budget.used(), 140);
+  EXPECT_EQ(budget.peak(), 140);
+
+  EXPECT_FALSE(budget.try_acquire(1));
+  EXPECT_FALSE(budget.acquire(1, 10ms));
+
+  budget.release(90);
+  EXPECT_EQ(budget.used(), 50);
+  EXPECT_TRUE(budget.try_acquire(50));
+  EXPECT_EQ(budget.peak(), 140);
+}
+
+/**
+ * @brief close() 唤醒所有阻塞的生产者，之后的申请立即失败
+ */
+TEST(MEMORY_BUDGET_TEST, CLOSE_WAKES_PRODUCERS)
+{
+  MemoryBudget budget(100);
+  EXPECT_TRUE(budget.try_acquire(100));
+
+  constexpr int            kProducers = 4;
+  std::atomic<int>         failed{0};
+  std::vector<std::thread> producers;
+  auto                     start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kProducers; i++) {
+    producers.emplace_back([&] {
+      if (!budget.acquire(10, 10000ms)) {
+        failed++;
+      }
+    });
+  }
+  std::this_thread::sleep_for(20ms);
+  budget.close();
+  for (auto &producer : producers) {
+    producer.join();
+  }
+  EXPECT_EQ(failed.load(), kProducers);
+  EXPECT_LT(std::chrono::steady_clock::now() - start, 5000ms);
+  EXPECT_EQ(budget.used(), 100);
+
+  budget.release(100);
+  EXPECT_FALSE(budget.try_acquire(1));
+  EXPECT_FALSE(budget.acquire(1, 10ms));
+}
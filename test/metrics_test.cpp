@@ -0,0 +1,226 @@
+//
+// Created by Coonger on 2024/12/18.
+//
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "common/metrics.h"
+
+using common::Histogram;
+using common::MetricsRegistry;
+using common::MetricType;
+
+namespace {
+
+constexpr uint64 MAX = std::numeric_limits<uint64>::max();
+
+std::string read_file(const std::string &path)
+{
+  std::ifstream in(path);
+  return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+bool exists(const std::string &path)
+{
+  struct stat st;
+  return stat(path.c_str(), &st) == 0;
+}
+
+}  // namespace
+
+/**
+ * @brief 小于 16 的值各占一个桶，16 开始每个 2 的幂区间分 16 个桶，UINT64_MAX 落在最后一个桶
+ */
+TEST(HISTOGRAM_TEST, BUCKET_EDGES)
+{
+  EXPECT_EQ(Histogram::bucket_of(0), 0u);
+  EXPECT_EQ(Histogram::bucket_of(15), 15u);
+  EXPECT_EQ(Histogram::bucket_upper(15), 16u);
+  EXPECT_EQ(Histogram::bucket_of(16), 16u);
+  EXPECT_EQ(Histogram::bucket_upper(16), 17u);
+  EXPECT_EQ(Histogram::bucket_of(31), 31u);
+  EXPECT_EQ(Histogram::bucket_upper(31), 32u);
+  // 32 开始桶宽是 2
+  EXPECT_EQ(Histogram::bucket_of(32), 32u);
+  EXPECT_EQ(Histogram::bucket_of(33), 32u);
+  EXPECT_EQ(Histogram::bucket_upper(32), 34u);
+
+  EXPECT_EQ(Histogram::bucket_of(MAX), Histogram::BUCKETS - 1);
+  EXPECT_EQ(Histogram::bucket_upper(Histogram::BUCKETS - 1), MAX);
+  EXPECT_EQ(Histogram::bucket_of(1ULL << 63), Histogram::BUCKETS - Histogram::SUB_BUCKETS);
+
+  // 每个 2 的幂都是一个桶的下界，前一个桶的上界正好是它
+  for (int e = Histogram::SUB_BUCKET_BITS; e < 64; e++) {
+    uint64 power  = 1ULL << e;
+    size_t bucket = Histogram::bucket_of(power);
+    EXPECT_EQ(bucket, Histogram::SUB_BUCKETS * (e - Histogram::SUB_BUCKET_BITS + 1)) << "e=" << e;
+    EXPECT_EQ(Histogram::bucket_of(power - 1), bucket - 1) << "e=" << e;
+    EXPECT_EQ(Histogram::bucket_upper(bucket - 1), power) << "e=" << e;
+  }
+
+  // 桶的上下界包住值，桶宽不超过下界的 1/16
+  for (int e = 0; e < 64; e++) {
+    for (uint64 value : {(1ULL << e) - 1, 1ULL << e, (1ULL << e) + 1, (1ULL << e) + (1ULL << e) / 3}) {
+      size_t bucket = Histogram::bucket_of(value);
+      uint64 lower  = bucket == 0 ? 0 : Histogram::bucket_upper(bucket - 1);
+      uint64 upper  = Histogram::bucket_upper(bucket);
+      EXPECT_LE(lower, value);
+      EXPECT_GT(upper, value);
+      if (value >= Histogram::SUB_BUCKETS && upper != MAX) {
+        EXPECT_LE(upper - lower, lower / Histogram::SUB_BUCKETS) << "value=" << value;
+      }
+    }
+  }
+}
+
+/**
+ * @brief 分位数返回所在桶里的最大值，q=0 取最小的样本，没有样本时为 0
+ */
+TEST(HISTOGRAM_TEST, PERCENTILE)
+{
+  Histogram empty;
+  EXPECT_EQ(empty.percentile(0.5), 0u);
+
+  Histogram h;
+  for (uint64 v = 1; v <= 100; v++) {
+    h.record(v);
+  }
+  EXPECT_EQ(h.count(), 100u);
+  EXPECT_EQ(h.sum(), 5050u);
+  EXPECT_EQ(h.percentile(0), 1u);
+  EXPECT_EQ(h.percentile(0.1), 10u);
+  EXPECT_EQ(h.percentile(0.5), 51u);   // [50, 52)
+  EXPECT_EQ(h.percentile(1), 103u);    // [100, 104)
+
+  Histogram extreme;
+  extreme.record(0);
+  extreme.record(MAX);
+  EXPECT_EQ(extreme.percentile(0.5), 0u);
+  EXPECT_EQ(extreme.percentile(1), MAX - 1);
+}
+
+/**
+ * @brief count_below_power(e) 统计 [0, 2^e)，边界上的值算在下一个区间
+ */
+TEST(HISTOGRAM_TEST, COUNT_BELOW_POWER)
+{
+  Histogram h;
+  for (uint64 v : {uint64{0}, uint64{1}, uint64{15}, uint64{16}, uint64{31}, uint64{32}, uint64{1} << 40, MAX}) {
+    h.record(v);
+  }
+  EXPECT_EQ(h.count_below_power(0), 1u);
+  EXPECT_EQ(h.count_below_power(1), 2u);
+  EXPECT_EQ(h.count_below_power(4), 3u);
+  EXPECT_EQ(h.count_below_power(5), 5u);
+  EXPECT_EQ(h.count_below_power(6), 6u);
+  EXPECT_EQ(h.count_below_power(40), 6u);
+  EXPECT_EQ(h.count_below_power(41), 7u);
+  EXPECT_EQ(h.count_below_power(63), 7u);
+  EXPECT_EQ(h.count_below_power(64), 8u);
+}
+
+/**
+ * @brief 标签值转义反斜杠、换行和双引号，HELP 只转义反斜杠和换行；直方图按 2 的幂输出累计桶
+ */
+TEST(METRICS_REGISTRY_TEST, PROMETHEUS_TEXT)
+{
+  MetricsRegistry registry;
+  registry.counter("loft_test_total", "a \"quoted\" help\\n\nline", {{"path", "a\"b\\c\nd"}, {"stage", "write"}})->add(3);
+  registry.gauge("loft_test_gauge", "gauge")->set(-2);
+  registry.callback("loft_test_callback", "callback", MetricType::GAUGE, [] { return 1.5; });
+  Histogram *h = registry.histogram("loft_test_seconds", "histogram", 1e-9, {{"stage", "write"}});
+  h->record(1);
+  h->record(1000);
+
+  std::string text = registry.to_prometheus();
+  EXPECT_NE(text.find("# HELP loft_test_total a \"quoted\" help\\\\n\\nline\n"), std::string::npos) << text;
+  EXPECT_NE(text.find("# TYPE loft_test_total counter\n"), std::string::npos);
+  EXPECT_NE(text.find("loft_test_total{path=\"a\\\"b\\\\c\\nd\",stage=\"write\"} 3\n"), std::string::npos) << text;
+  EXPECT_NE(text.find("loft_test_gauge -2\n"), std::string::npos);
+  EXPECT_NE(text.find("loft_test_callback 1.5\n"), std::string::npos);
+
+  EXPECT_NE(text.find("# TYPE loft_test_seconds histogram\n"), std::string::npos);
+  EXPECT_NE(text.find("loft_test_seconds_bucket{stage=\"write\",le=\"1e-09\"} 0\n"), std::string::npos) << text;
+  EXPECT_NE(text.find("loft_test_seconds_bucket{stage=\"write\",le=\"2e-09\"} 1\n"), std::string::npos);
+  EXPECT_NE(text.find("loft_test_seconds_bucket{stage=\"write\",le=\"1.024e-06\"} 2\n"), std::string::npos);
+  EXPECT_NE(text.find("loft_test_seconds_bucket{stage=\"write\",le=\"+Inf\"} 2\n"), std::string::npos);
+  EXPECT_NE(text.find("loft_test_seconds_sum{stage=\"write\"} 1.001e-06\n"), std::string::npos);
+  EXPECT_NE(text.find("loft_test_seconds_count{stage=\"write\"} 2\n"), std::string::npos);
+
+  // family 按名字排序输出
+  EXPECT_LT(text.find("loft_test_callback"), text.find("loft_test_gauge"));
+  EXPECT_LT(text.find("loft_test_gauge"), text.find("loft_test_seconds"));
+}
+
+/**
+ * @brief 同名同标签返回同一个指标；同名不同类型返回 nullptr，原来的指标不受影响
+ */
+TEST(METRICS_REGISTRY_TEST, TYPE_MISMATCH)
+{
+  MetricsRegistry  registry;
+  common::Counter *counter = registry.counter("loft_test_total", "help");
+  ASSERT_NE(counter, nullptr);
+  EXPECT_EQ(registry.counter("loft_test_total", "help"), counter);
+  common::Counter *labeled = registry.counter("loft_test_total", "help", {{"stage", "write"}});
+  ASSERT_NE(labeled, nullptr);
+  EXPECT_NE(labeled, counter);
+
+  EXPECT_EQ(registry.gauge("loft_test_total", "help"), nullptr);
+  EXPECT_EQ(registry.histogram("loft_test_total", "help"), nullptr);
+  EXPECT_FALSE(registry.callback("loft_test_total", "help", MetricType::GAUGE, [] { return 1.0; }));
+  // 同类型的回调也不能顶替已有的指标
+  EXPECT_FALSE(registry.callback("loft_test_total", "help", MetricType::COUNTER, [] { return 1.0; }));
+  EXPECT_FALSE(registry.callback("loft_test_hist", "help", MetricType::HISTOGRAM, [] { return 1.0; }));
+
+  counter->add();
+  std::string text = registry.to_prometheus();
+  EXPECT_NE(text.find("# TYPE loft_test_total counter\n"), std::string::npos);
+  EXPECT_NE(text.find("loft_test_total 1\n"), std::string::npos);
+  EXPECT_EQ(text.find("loft_test_hist"), std::string::npos);
+}
+
+/**
+ * @brief 先写 path.tmp 再 rename：已经打开旧文件的读者读到的是完整的旧内容，写不了 tmp 时旧文件保持不变
+ */
+TEST(METRICS_REGISTRY_TEST, WRITE_TEXTFILE)
+{
+  std::string path = "/tmp/loft-metrics-test.prom";
+  std::string tmp  = path + ".tmp";
+  std::remove(path.c_str());
+  rmdir(tmp.c_str());
+
+  MetricsRegistry  registry;
+  common::Counter *counter = registry.counter("loft_test_total", "help");
+  counter->add();
+  ASSERT_EQ(registry.write_textfile(path), RC::SUCCESS);
+  std::string first = registry.to_prometheus();
+  EXPECT_EQ(read_file(path), first);
+  EXPECT_FALSE(exists(tmp));
+
+  // rename 换的是目录项，旧文件的内容不会被截断重写
+  std::ifstream reader(path);
+  counter->add();
+  ASSERT_EQ(registry.write_textfile(path), RC::SUCCESS);
+  std::string old_content((std::istreambuf_iterator<char>(reader)), std::istreambuf_iterator<char>());
+  EXPECT_EQ(old_content, first);
+  EXPECT_EQ(read_file(path), registry.to_prometheus());
+  EXPECT_FALSE(exists(tmp));
+
+  // tmp 被一个目录占住时打不开，原文件保持上一次的内容
+  std::string second = read_file(path);
+  ASSERT_EQ(mkdir(tmp.c_str(), 0755), 0);
+  counter->add();
+  EXPECT_EQ(registry.write_textfile(path), RC::FILE_OPEN);
+  EXPECT_EQ(read_file(path), second);
+  rmdir(tmp.c_str());
+
+  EXPECT_EQ(registry.write_textfile("/nonexistent-dir/loft.prom"), RC::FILE_OPEN);
+  std::remove(path.c_str());
+}
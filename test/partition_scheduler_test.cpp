@@ -0,0 +1,199 @@
+//
+// Created by Coonger on 2024/12/18.
+//
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "common/init_setting.h"
+#include "common/mysql_constant_def.h"
+#include "binlog_inspect.h"
+#include "log_file.h"
+#include "redo_builder.h"
+
+using loft::RedoRecordBuilder;
+
+namespace {
+
+constexpr const char *DB_NAME = "loft";
+constexpr int         TABLES  = 4;
+
+constexpr const char *TEMP_PREFIX = "loft-partition";
+
+/// 读出唯一的 binlog 文件，并把来自系统时间的时间戳置零
+std::vector<char> read_binlog(const std::filesystem::path &dir)
+{
+  std::vector<std::filesystem::path> files = loft::binlog_files(dir);
+  EXPECT_EQ(files.size(), 1u);
+  if (files.empty()) {
+    return {};
+  }
+  std::vector<char> data = loft::read_file(files.front());
+  loft::normalize_binlog(data);
+  return data;
+}
+
+/**
+ * @brief 构造一个多表混合的 batch：建库、建表，三段 DML 之间分别夹一条单表 DDL 和一条没有表名的全局 DDL
+ * @param scn_of 第 i 条记录的 scn
+ */
+template <typename ScnOf>
+std::vector<Task> make_batch(ScnOf &&scn_of)
+{
+  const std::vector<RedoRecordBuilder::Column> columns = {
+      {"id", "BIGINT", 20, 0},
+      {"c1", "INT", 11, 0},
+      {"c2", "VARCHAR", 32, 0},
+  };
+
+  RedoRecordBuilder  builder;
+  std::vector<Task>  tasks;
+  std::vector<int64> next_id(TABLES, 1);
+
+  auto header = [&] {
+    int64                     index = static_cast<int64>(tasks.size());
+    RedoRecordBuilder::Header h;
+    h.scn         = scn_of(index);
+    h.seq         = 1;
+    h.lsn         = index + 1;
+    h.last_commit = index;
+    h.tx_seq      = index + 1;
+    h.tx_time     = RedoRecordBuilder::format_time(1722470400000000LL + index * 1000);
+    h.msg_time    = h.tx_time;
+    h.check_point = std::to_string(index);
+    return h;
+  };
+  auto add_ddl = [&](const std::string &table, const std::string &sql, const char *type) {
+    auto h = header();
+    tasks.emplace_back(builder.ddl(h, table.empty() ? "" : DB_NAME, table, sql, type), true);
+  };
+  auto add_dml = [&](int i) {
+    int         t     = (i * 7 + i / 3) % TABLES;
+    std::string table = "t" + std::to_string(t);
+    const char *op    = next_id[t] == 1 || i % 4 != 3 ? "I" : (i % 8 == 3 ? "U" : "D");
+
+    RedoRecordBuilder::Row keys;
+    RedoRecordBuilder::Row data;
+    int64                  id = op[0] == 'I' ? next_id[t]++ : next_id[t] - 1;
+    if (op[0] != 'I') {
+      keys.emplace_back(0, RedoRecordBuilder::Value::of_long(id));
+    }
+    if (op[0] != 'D') {
+      data.emplace_back(0, RedoRecordBuilder::Value::of_long(id));
+      data.emplace_back(1, RedoRecordBuilder::Value::of_long(i * 31));
+      data.emplace_back(2, RedoRecordBuilder::Value::of_string(RedoRecordBuilder::encode_string("v" + std::to_string(i))));
+    }
+    auto h = header();
+    tasks.emplace_back(builder.dml(h, DB_NAME, table, op, columns, keys, data), false);
+  };
+
+  add_ddl("", std::string("create database ") + DB_NAME, "CREATE DATABASE");
+  for (int t = 0; t < TABLES; t++) {
+    std::string table = "t" + std::to_string(t);
+    add_ddl(table, "create table " + table + " (id bigint primary key, c1 int, c2 varchar(32))", "CREATE TABLE");
+  }
+  for (int i = 0; i < 40; i++) {
+    add_dml(i);
+  }
+  add_ddl("t1", "alter table t1 add column c3 int", "ALTER TABLE");
+  for (int i = 40; i < 80; i++) {
+    add_dml(i);
+  }
+  add_ddl("", "create database loft_archive", "CREATE DATABASE");
+  for (int i = 80; i < 120; i++) {
+    add_dml(i);
+  }
+  return tasks;
+}
+
+/**
+ * @brief 把 tasks 作为一个 batch 提交并等它写完；batch 上限大于记录数，收集线程一次取走全部
+ */
+void run(const std::vector<Task> &tasks, SchedulerType scheduler, uint32 partitions, const std::filesystem::path &dir)
+{
+  LogFileOptions options;
+  options.scheduler             = scheduler;
+  options.partitions            = partitions;
+  options.min_workers           = 4;
+  options.max_workers           = 4;
+  options.autoscale_interval_ms = 0;
+  options.batch_min_size        = 1024;
+  options.batch_max_size        = 1024;
+
+  auto manager = std::make_unique<LogFileManager>(options);
+  ASSERT_EQ(manager->init(dir.c_str(), DEFAULT_BINLOG_FILE_NAME_PREFIX, DEFAULT_BINLOG_FILE_SIZE), RC::SUCCESS);
+  manager->last_file(*manager->get_file_writer());
+
+  std::vector<Task> batch = tasks;
+  BatchHandle       handle = manager->transformBatch(batch);
+  manager->flush();
+  EXPECT_EQ(handle->wait(), RC::SUCCESS);
+  manager.reset();
+}
+
+}  // namespace
+
+/**
+ * @brief 多表混合、夹着单表 DDL 和全局 DDL 的 batch，scn 单调时 PARTITIONED 的输出与 FIFO 逐字节相同
+ */
+TEST(PARTITION_SCHEDULER_TEST, MIXED_BATCH_MATCHES_FIFO)
+{
+  std::vector<Task> tasks = make_batch([](int64 index) { return 1000 + index * 3; });
+
+  std::filesystem::path fifo_dir = loft::make_temp_dir(TEMP_PREFIX);
+  run(tasks, SchedulerType::FIFO, 0, fifo_dir);
+  std::vector<char> expected = read_binlog(fifo_dir);
+  ASSERT_GT(expected.size(), static_cast<size_t>(BINLOG_MAGIC_SIZE));
+
+  for (uint32 partitions : {1U, 3U, 4U, 16U}) {
+    std::filesystem::path dir = loft::make_temp_dir(TEMP_PREFIX);
+    run(tasks, SchedulerType::PARTITIONED, partitions, dir);
+    std::vector<char> actual = read_binlog(dir);
+    EXPECT_EQ(actual.size(), expected.size()) << "partitions " << partitions;
+    EXPECT_TRUE(actual == expected) << "partitions " << partitions;
+    std::filesystem::remove_all(dir);
+  }
+  std::filesystem::remove_all(fifo_dir);
+}
+
+/**
+ * @brief batch 内 scn 不单调（包括一条 scn 比前面 DML 小的 DDL）：PARTITIONED 按 (scn, 到达顺序) 归并，
+ * 输出与 FIFO 转换按 scn 稳定排序后的同一批记录逐字节相同
+ */
+TEST(PARTITION_SCHEDULER_TEST, NON_MONOTONIC_SCN)
+{
+  // 每 10 条一组倒序，组与组之间交错，scn 相同的记录保持到达顺序
+  std::vector<Task> tasks = make_batch([](int64 index) { return 1000 + (index / 10) * 5 + (9 - index % 10) / 2; });
+
+  std::vector<size_t> order(tasks.size());
+  for (size_t i = 0; i < order.size(); i++) {
+    order[i] = i;
+  }
+  auto scn_of = [&tasks](size_t i) {
+    return tasks[i].is_ddl_ ? GetDDL(tasks[i].data_.data())->scn() : GetDML(tasks[i].data_.data())->scn();
+  };
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return scn_of(a) < scn_of(b); });
+  ASSERT_FALSE(std::is_sorted(order.begin(), order.end()));
+
+  std::vector<Task> sorted;
+  for (size_t i : order) {
+    sorted.push_back(tasks[i]);
+  }
+
+  std::filesystem::path fifo_dir = loft::make_temp_dir(TEMP_PREFIX);
+  run(sorted, SchedulerType::FIFO, 0, fifo_dir);
+  std::vector<char> expected = read_binlog(fifo_dir);
+
+  for (uint32 partitions : {1U, 4U}) {
+    std::filesystem::path dir = loft::make_temp_dir(TEMP_PREFIX);
+    run(tasks, SchedulerType::PARTITIONED, partitions, dir);
+    std::vector<char> actual = read_binlog(dir);
+    EXPECT_EQ(actual.size(), expected.size()) << "partitions " << partitions;
+    EXPECT_TRUE(actual == expected) << "partitions " << partitions;
+    std::filesystem::remove_all(dir);
+  }
+  std::filesystem::remove_all(fifo_dir);
+}
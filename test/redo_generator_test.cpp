@@ -0,0 +1,125 @@
+//
+// Created by Coonger on 2024/12/18.
+//
+#include <gtest/gtest.h>
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "format/dml_generated.h"
+#include "redo_generator.h"
+#include "utils/base64.h"
+
+using loft::RedoGenerator;
+using loft::RedoGeneratorOptions;
+
+/**
+ * @brief DELETE 多、倾斜大时，UPDATE / DELETE 只会选到还存在的行，INSERT 的主键不会重复
+ */
+TEST(REDO_GENERATOR_TEST, NEVER_TOUCHES_DELETED_ROWS)
+{
+  RedoGeneratorOptions options;
+  options.seed       = 3;
+  options.tables     = 3;
+  options.records    = 20000;
+  options.op_mix     = "I:40,U:20,D:40";
+  options.skew       = 0.8;
+  options.column_mix = "int:1";
+
+  RedoGenerator generator(options);
+  ASSERT_EQ(generator.init(), RC::SUCCESS);
+
+  std::map<std::string, std::set<int64>> live;
+  std::vector<uint8>                     record;
+  bool                                   is_ddl  = false;
+  uint64                                 deletes = 0;
+  while (generator.next(record, is_ddl)) {
+    if (is_ddl) {
+      continue;
+    }
+    const loft::DML *dml   = loft::GetDML(record.data());
+    std::string      table = dml->table_()->str();
+    std::string      op    = dml->op_type()->str();
+    auto            &rows  = live[table];
+    if (op == "I") {
+      int64 id = dml->new_data()->Get(0)->value_as_LongVal()->value();
+      ASSERT_TRUE(rows.insert(id).second) << table << " id " << id;
+      continue;
+    }
+    int64 id = dml->keys()->Get(0)->value_as_LongVal()->value();
+    ASSERT_TRUE(rows.count(id) > 0) << op << " on deleted row " << table << " id " << id;
+    if (op == "D") {
+      rows.erase(id);
+      deletes++;
+    }
+  }
+  EXPECT_GE(generator.dml_count(), options.records);
+  EXPECT_GT(deletes, options.records / 4);
+}
+
+/**
+ * @brief output_bytes 和 records 都为 0 时流不会结束，next() 可以一直取；写文件需要一个上限
+ */
+TEST(REDO_GENERATOR_TEST, UNBOUNDED_STREAM)
+{
+  RedoGeneratorOptions options;
+  RedoGenerator        generator(options);
+  ASSERT_EQ(generator.init(), RC::SUCCESS);
+
+  std::vector<uint8> record;
+  bool               is_ddl = false;
+  for (int i = 0; i < 10000; i++) {
+    ASSERT_TRUE(generator.next(record, is_ddl)) << i;
+  }
+
+  RedoGenerator unbounded(options);
+  ASSERT_EQ(unbounded.init(), RC::SUCCESS);
+  EXPECT_EQ(unbounded.write("/tmp/loft-redo-generator-unbounded"), RC::INVALID_ARGUMENT);
+}
+
+/**
+ * @brief DATETIME / TIMESTAMP 列的精度是 6，值带微秒，转换时要按 6 位小数打包
+ */
+TEST(REDO_GENERATOR_TEST, MICROSECOND_TEMPORALS)
+{
+  RedoGeneratorOptions options;
+  options.seed       = 5;
+  options.records    = 2000;
+  options.op_mix     = "I:1";
+  options.column_mix = "datetime:1,timestamp:1";
+
+  RedoGenerator generator(options);
+  ASSERT_EQ(generator.init(), RC::SUCCESS);
+
+  std::vector<uint8> record;
+  bool               is_ddl     = false;
+  uint64             temporals  = 0;
+  uint64             fractional = 0;
+  while (generator.next(record, is_ddl)) {
+    if (is_ddl) {
+      continue;
+    }
+    const loft::DML *dml = loft::GetDML(record.data());
+    for (const auto *field : *dml->fields()) {
+      std::string type = field->meta()->data_type()->str();
+      if (type == "DATETIME" || type == "TIMESTAMP") {
+        EXPECT_EQ(field->meta()->precision(), 6) << type;
+      }
+    }
+    for (const auto *value : *dml->new_data()) {
+      if (value->value_as_StringVal() == nullptr) {
+        continue;
+      }
+      std::vector<uchar> decoded = base64_decode(value->value_as_StringVal()->value()->str());
+      std::string        text(decoded.begin(), decoded.end());
+      ASSERT_EQ(text.size(), 26u) << text;  // YYYY-MM-DD HH:MM:SS.ffffff
+      ASSERT_EQ(text[19], '.') << text;
+      temporals++;
+      fractional += text.substr(20) != "000000" ? 1 : 0;
+    }
+  }
+  EXPECT_GT(temporals, options.records);
+  EXPECT_GT(fractional, temporals * 9 / 10);
+}
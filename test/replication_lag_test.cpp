@@ -0,0 +1,208 @@
+//
+// Created by Coonger on 2024/12/18.
+//
+#include <gtest/gtest.h>
+
+#include "common/metrics.h"
+#include "replication_lag.h"
+
+using common::Histogram;
+using common::MetricsRegistry;
+using loft::ReplicationLagTracker;
+using loft::SourceProgress;
+
+namespace {
+
+constexpr uint64 SECOND_US = 1000000;
+
+/**
+ * @brief 一个 batch 的源端进度：记录在 age_s 秒之前提交，最大 scn 为 scn
+ */
+SourceProgress progress(int64 scn, uint64 age_s = 10)
+{
+  SourceProgress p;
+  p.add(ReplicationLagTracker::now_us() - age_s * SECOND_US, scn);
+  return p;
+}
+
+Histogram *lag_histogram(MetricsRegistry &registry)
+{
+  return registry.histogram("loft_replication_lag_seconds", "", 1e-6);
+}
+
+}  // namespace
+
+/**
+ * @brief SourceProgress 只统计非 0 的提交时间，merge 之后是两者的并集
+ */
+TEST(REPLICATION_LAG_TEST, SOURCE_PROGRESS)
+{
+  SourceProgress a;
+  a.add(0, 5);
+  EXPECT_EQ(a.oldest_commit_us, 0u);
+  EXPECT_EQ(a.max_scn, 5);
+  a.add(300, 7);
+  a.add(100, 6);
+  EXPECT_EQ(a.oldest_commit_us, 100u);
+  EXPECT_EQ(a.newest_commit_us, 300u);
+  EXPECT_EQ(a.max_scn, 7);
+
+  SourceProgress b;
+  b.add(50, 3);
+  b.add(500, 9);
+  a.merge(b);
+  EXPECT_EQ(a.oldest_commit_us, 50u);
+  EXPECT_EQ(a.newest_commit_us, 500u);
+  EXPECT_EQ(a.max_scn, 9);
+
+  SourceProgress no_time;
+  no_time.add(0, 20);
+  a.merge(no_time);
+  EXPECT_EQ(a.oldest_commit_us, 50u);
+  EXPECT_EQ(a.max_scn, 20);
+}
+
+/**
+ * @brief 完成顺序和 begin 不同：written_scn 只在连续完成的前缀上推进，每个完成的 batch 都记一次延迟
+ */
+TEST(REPLICATION_LAG_TEST, OUT_OF_ORDER_COMPLETION)
+{
+  MetricsRegistry       registry;
+  ReplicationLagTracker tracker(registry);
+  Histogram            *lag = lag_histogram(registry);
+
+  tracker.begin(1, progress(10));
+  tracker.begin(2, progress(20));
+  tracker.begin(3, progress(30));
+
+  tracker.complete(3, RC::SUCCESS, false);
+  EXPECT_EQ(tracker.written_scn(), 0);
+  EXPECT_EQ(lag->count(), 1u);
+
+  tracker.complete(1, RC::SUCCESS, false);
+  EXPECT_EQ(tracker.written_scn(), 10);
+
+  tracker.complete(2, RC::SUCCESS, false);
+  EXPECT_EQ(tracker.written_scn(), 30);
+  EXPECT_EQ(lag->count(), 3u);
+  // 记录的是每个 batch 里最早一条记录的延迟，大约 10 秒
+  EXPECT_GE(lag->sum(), 3 * 10 * SECOND_US);
+  EXPECT_LT(lag->sum(), 3 * 20 * SECOND_US);
+
+  // 已经完成或不认识的序号忽略
+  tracker.complete(2, RC::SUCCESS, true);
+  tracker.complete(99, RC::SUCCESS, true);
+  EXPECT_EQ(tracker.written_scn(), 30);
+  EXPECT_EQ(tracker.durable_scn(), 0);
+  EXPECT_EQ(lag->count(), 3u);
+
+  // scn 不单调时水位不回退
+  tracker.begin(4, progress(25));
+  tracker.complete(4, RC::SUCCESS, false);
+  EXPECT_EQ(tracker.written_scn(), 30);
+}
+
+/**
+ * @brief durable_scn 只在前缀末尾的 batch 落盘时推进，推进到当时的 written_scn；之后没落盘的 batch 不影响它
+ */
+TEST(REPLICATION_LAG_TEST, WRITTEN_AND_DURABLE_PREFIX)
+{
+  MetricsRegistry       registry;
+  ReplicationLagTracker tracker(registry);
+
+  tracker.begin(1, progress(10));
+  tracker.begin(2, progress(20));
+  tracker.begin(3, progress(30));
+  tracker.begin(4, progress(40));
+
+  tracker.complete(1, RC::SUCCESS, false);
+  EXPECT_EQ(tracker.written_scn(), 10);
+  EXPECT_EQ(tracker.durable_scn(), 0);
+
+  // 3 先落盘，但 2 还没写完，两个水位都停在 10
+  tracker.complete(3, RC::SUCCESS, true);
+  EXPECT_EQ(tracker.written_scn(), 10);
+  EXPECT_EQ(tracker.durable_scn(), 0);
+
+  // 2 写完：前缀推进到 3，3 落过盘，durable 跟着到 30
+  tracker.complete(2, RC::SUCCESS, false);
+  EXPECT_EQ(tracker.written_scn(), 30);
+  EXPECT_EQ(tracker.durable_scn(), 30);
+
+  tracker.complete(4, RC::SUCCESS, false);
+  EXPECT_EQ(tracker.written_scn(), 40);
+  EXPECT_EQ(tracker.durable_scn(), 30);
+}
+
+/**
+ * @brief 有 batch 写失败后 binlog 里有空洞：之后的 batch 照常出队，但两个水位都不再推进，失败的 batch 不记延迟
+ */
+TEST(REPLICATION_LAG_TEST, STALL_AFTER_FAILED_BATCH)
+{
+  MetricsRegistry       registry;
+  ReplicationLagTracker tracker(registry);
+  Histogram            *lag = lag_histogram(registry);
+
+  tracker.begin(1, progress(10));
+  tracker.begin(2, progress(20));
+  tracker.begin(3, progress(30));
+
+  tracker.complete(1, RC::SUCCESS, true);
+  EXPECT_EQ(tracker.written_scn(), 10);
+  EXPECT_EQ(tracker.durable_scn(), 10);
+
+  tracker.complete(3, RC::SUCCESS, true);
+  tracker.complete(2, RC::IOERR_WRITE, true);
+  EXPECT_EQ(tracker.written_scn(), 10);
+  EXPECT_EQ(tracker.durable_scn(), 10);
+  EXPECT_EQ(lag->count(), 2u);
+
+  tracker.begin(4, progress(40));
+  tracker.complete(4, RC::SUCCESS, true);
+  EXPECT_EQ(tracker.written_scn(), 10);
+  EXPECT_EQ(tracker.durable_scn(), 10);
+  // 出队的 batch 不会留在在途列表里拉高当前延迟
+  EXPECT_LT(tracker.current_lag_us(), 20 * SECOND_US);
+}
+
+/**
+ * @brief 当前延迟：在途 batch 里最早的记录和已写出的最新记录中取较大的；写线程卡住时随时间增长
+ */
+TEST(REPLICATION_LAG_TEST, CURRENT_LAG)
+{
+  MetricsRegistry       registry;
+  ReplicationLagTracker tracker(registry);
+  EXPECT_EQ(tracker.current_lag_us(), 0u);
+
+  tracker.begin(1, progress(10, 100));
+  tracker.begin(2, progress(20, 5));
+  EXPECT_GE(tracker.current_lag_us(), 100 * SECOND_US);
+
+  // 1 写完：已写出的最新记录是 100 秒前提交的，比在途的 2 落后得多
+  tracker.complete(1, RC::SUCCESS, false);
+  uint64 lag = tracker.current_lag_us();
+  EXPECT_GE(lag, 100 * SECOND_US);
+  EXPECT_LT(lag, 150 * SECOND_US);
+
+  tracker.complete(2, RC::SUCCESS, false);
+  lag = tracker.current_lag_us();
+  EXPECT_GE(lag, 5 * SECOND_US);
+  EXPECT_LT(lag, 50 * SECOND_US);
+
+  // 没有提交时间的 batch 不参与
+  SourceProgress no_time;
+  no_time.add(0, 30);
+  tracker.begin(3, no_time);
+  lag = tracker.current_lag_us();
+  EXPECT_GE(lag, 5 * SECOND_US);
+  EXPECT_LT(lag, 50 * SECOND_US);
+  tracker.complete(3, RC::SUCCESS, false);
+  EXPECT_EQ(tracker.written_scn(), 30);
+
+  // 源端时钟比本机快时按 0 记
+  SourceProgress future;
+  future.add(ReplicationLagTracker::now_us() + 60 * SECOND_US, 40);
+  tracker.begin(4, future);
+  tracker.complete(4, RC::SUCCESS, false);
+  EXPECT_EQ(tracker.current_lag_us(), 0u);
+}
@@ -0,0 +1,136 @@
+//
+// Created by Coonger on 2024/12/18.
+//
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "common/task_group.h"
+#include "common/thread_pool_executor.h"
+
+using common::TaskGroup;
+using common::ThreadPoolExecutor;
+using namespace std::chrono_literals;
+
+namespace {
+
+/**
+ * @brief 测试用的线程池，析构时关闭并等待线程退出
+ */
+struct Pool
+{
+  ThreadPoolExecutor executor;
+
+  explicit Pool(int threads) { EXPECT_EQ(executor.init("group-test", threads, threads, 60 * 1000), 0); }
+
+  ~Pool() { stop(); }
+
+  void stop()
+  {
+    if (executor.shutdown() == 0) {
+      executor.await_termination();
+    }
+  }
+};
+
+}  // namespace
+
+/**
+ * @brief wait 返回时组内已提交的任务都执行完了，执行器不用关闭，可以继续提交下一组
+ */
+TEST(TASK_GROUP_TEST, WAIT)
+{
+  Pool pool(2);
+
+  for (int round = 0; round < 3; round++) {
+    std::atomic<int> finished{0};
+    TaskGroup        group(&pool.executor);
+    for (int i = 0; i < 16; i++) {
+      ASSERT_EQ(group.run([&finished] {
+        std::this_thread::sleep_for(1ms);
+        finished++;
+      }),
+          0);
+    }
+    group.wait();
+    EXPECT_EQ(finished.load(), 16);
+    EXPECT_EQ(group.pending(), 0);
+  }
+}
+
+/**
+ * @brief wait_for 在任务没执行完时超时返回 false，任务结束后返回 true；空的组立即返回 true
+ */
+TEST(TASK_GROUP_TEST, WAIT_FOR)
+{
+  Pool      pool(1);
+  TaskGroup group(&pool.executor);
+  EXPECT_TRUE(group.wait_for(0ms));
+
+  std::promise<void>       gate;
+  std::shared_future<void> opened = gate.get_future().share();
+  ASSERT_EQ(group.run([opened] { opened.wait(); }), 0);
+  EXPECT_EQ(group.pending(), 1);
+  EXPECT_FALSE(group.wait_for(20ms));
+  EXPECT_EQ(group.pending(), 1);
+
+  gate.set_value();
+  EXPECT_TRUE(group.wait_for(10s));
+  EXPECT_EQ(group.pending(), 0);
+}
+
+/**
+ * @brief 执行器拒绝时 run 返回非 0，任务不计入组内，捕获的资源随之释放，wait 不会卡住
+ */
+TEST(TASK_GROUP_TEST, REJECTED_TASK_ROLLS_BACK)
+{
+  Pool      pool(1);
+  TaskGroup group(&pool.executor);
+  pool.stop();
+
+  auto resource = std::make_shared<int>(0);
+  EXPECT_NE(group.run([resource] { (*resource)++; }), 0);
+  EXPECT_EQ(group.pending(), 0);
+  EXPECT_EQ(resource.use_count(), 1);
+  EXPECT_EQ(*resource, 0);
+  EXPECT_TRUE(group.wait_for(0ms));
+  group.wait();
+}
+
+/**
+ * @brief submit 的 future 带回任务的返回值或抛出的异常；执行器已关闭时 future 里是 std::runtime_error
+ */
+TEST(EXECUTOR_TEST, SUBMIT)
+{
+  Pool pool(2);
+
+  std::future<int> value = pool.executor.submit([] { return 42; });
+  EXPECT_EQ(value.get(), 42);
+
+  std::future<std::string> text = pool.executor.submit([prefix = std::string("loft")] { return prefix + "-binlog"; });
+  EXPECT_EQ(text.get(), "loft-binlog");
+
+  std::atomic<bool> ran{false};
+  std::future<void> done = pool.executor.submit([&ran] { ran = true; });
+  done.get();
+  EXPECT_TRUE(ran.load());
+
+  std::future<int> failed = pool.executor.submit([]() -> int { throw std::invalid_argument("bad batch"); });
+  try {
+    failed.get();
+    FAIL() << "exception expected";
+  } catch (const std::invalid_argument &e) {
+    EXPECT_STREQ(e.what(), "bad batch");
+  }
+
+  pool.stop();
+  std::future<int> rejected = pool.executor.submit([] { return 1; });
+  ASSERT_EQ(rejected.wait_for(0ms), std::future_status::ready);
+  EXPECT_THROW(rejected.get(), std::runtime_error);
+}
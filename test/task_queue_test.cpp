@@ -0,0 +1,208 @@
+//
+// Created by Coonger on 2024/12/18.
+//
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "common/task_queue.h"
+
+using namespace std::chrono_literals;
+
+/**
+ * @brief 容量向上取整到 2 的幂；try_push_bulk 满了只写入前缀，pop_bulk 按 max_count 截断
+ */
+TEST(TASK_QUEUE_TEST, PARTIAL_BULK)
+{
+  TaskQueue<int64> queue(5);
+  EXPECT_EQ(queue.capacity(), 8);
+
+  std::vector<int64> items(12);
+  for (int64 i = 0; i < 12; i++) {
+    items[i] = i;
+  }
+  EXPECT_EQ(queue.try_push_bulk(items.data(), items.size()), 8);
+  EXPECT_EQ(queue.size(), 8);
+  EXPECT_EQ(queue.try_push_bulk(items.data() + 8, 4), 0);
+  int64 extra = 100;
+  EXPECT_FALSE(queue.try_write(std::move(extra)));
+
+  std::vector<int64> out;
+  EXPECT_EQ(queue.pop_bulk(out, 3), 3);
+  EXPECT_EQ(queue.try_push_bulk(items.data() + 8, 4), 3);
+  EXPECT_EQ(queue.pop_bulk(out, 100), 8);
+  ASSERT_EQ(out.size(), 11);
+  for (int64 i = 0; i < 11; i++) {
+    EXPECT_EQ(out[i], i);
+  }
+  int64 item = 0;
+  EXPECT_FALSE(queue.try_read(item));
+  EXPECT_EQ(queue.size(), 0);
+}
+
+/**
+ * @brief 小容量队列上反复绕圈，单生产者单消费者时保持 FIFO，槽位 sequence 回绕后仍然正确
+ */
+TEST(TASK_QUEUE_TEST, WRAP_AROUND)
+{
+  constexpr int64 kItems = 100000;
+
+  TaskQueue<int64> queue(4);
+  std::thread      producer([&] {
+    std::vector<int64> chunk;
+    for (int64 i = 0; i < kItems;) {
+      // 每次写入 1~7 个，块的大小和容量错开，覆盖跨越环尾的 bulk 写入
+      int64 n = std::min<int64>(1 + i % 7, kItems - i);
+      chunk.clear();
+      for (int64 k = 0; k < n; k++) {
+        chunk.push_back(i + k);
+      }
+      queue.push_bulk(chunk.data(), chunk.size());
+      i += n;
+    }
+  });
+
+  std::vector<int64> out;
+  int64              expected = 0;
+  while (expected < kItems) {
+    out.clear();
+    if (queue.pop_bulk(out, 3) == 0) {
+      std::this_thread::yield();
+      continue;
+    }
+    for (int64 item : out) {
+      ASSERT_EQ(item, expected);
+      expected++;
+    }
+  }
+  producer.join();
+  EXPECT_EQ(queue.size(), 0);
+}
+
+/**
+ * @brief 多生产者 push_bulk、多消费者 pop_bulk，每个元素恰好被取走一次，且同一生产者的元素被同一消费者按序看到
+ */
+TEST(TASK_QUEUE_TEST, MPMC_BULK)
+{
+  constexpr int   kProducers   = 4;
+  constexpr int   kConsumers   = 3;
+  constexpr int64 kPerProducer = 50000;
+  constexpr int64 kTotal       = kProducers * kPerProducer;
+
+  TaskQueue<int64>              queue(64);
+  std::vector<std::atomic<int>> seen(kTotal);
+  std::atomic<int64>            consumed{0};
+  std::atomic<bool>             ordered{true};
+  std::vector<std::thread>      threads;
+
+  for (int p = 0; p < kProducers; p++) {
+    threads.emplace_back([&, p] {
+      std::vector<int64> chunk;
+      for (int64 i = 0; i < kPerProducer;) {
+        int64 n = std::min<int64>(1 + (i + p) % 13, kPerProducer - i);
+        chunk.clear();
+        for (int64 k = 0; k < n; k++) {
+          chunk.push_back(p * kPerProducer + i + k);
+        }
+        queue.push_bulk(chunk.data(), chunk.size());
+        i += n;
+      }
+    });
+  }
+  for (int c = 0; c < kConsumers; c++) {
+    threads.emplace_back([&] {
+      std::vector<int64> last(kProducers, -1);
+      std::vector<int64> out;
+      while (consumed.load(std::memory_order_relaxed) < kTotal) {
+        out.clear();
+        size_t n = queue.pop_bulk(out, 16);
+        if (n == 0) {
+          std::this_thread::yield();
+          continue;
+        }
+        for (int64 item : out) {
+          seen[item]++;
+          int64 producer = item / kPerProducer;
+          if (item <= last[producer]) {
+            ordered = false;
+          }
+          last[producer] = item;
+        }
+        consumed += n;
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_EQ(consumed.load(), kTotal);
+  EXPECT_TRUE(ordered.load());
+  for (int64 i = 0; i < kTotal; i++) {
+    ASSERT_EQ(seen[i].load(), 1) << "item " << i;
+  }
+  EXPECT_EQ(queue.size(), 0);
+}
+
+/**
+ * @brief 消费者在空队列上休眠，写入后被唤醒；生产者在满队列上休眠，腾出空位后被唤醒
+ */
+TEST(TASK_QUEUE_TEST, PARK_UNPARK)
+{
+  TaskQueue<int64> queue(2);
+
+  std::atomic<bool> got{false};
+  int64             value = 0;
+  std::thread       consumer([&] {
+    queue.read(value);
+    got = true;
+  });
+  // 足够让消费者自旋、yield 完进入休眠
+  std::this_thread::sleep_for(50ms);
+  EXPECT_FALSE(got.load());
+  queue.write(42);
+  consumer.join();
+  EXPECT_TRUE(got.load());
+  EXPECT_EQ(value, 42);
+
+  queue.write(1);
+  queue.write(2);
+  std::atomic<bool> written{false};
+  std::thread       producer([&] {
+    queue.write(3);
+    written = true;
+  });
+  std::this_thread::sleep_for(50ms);
+  EXPECT_FALSE(written.load());
+  int64 item = 0;
+  EXPECT_TRUE(queue.try_read(item));
+  EXPECT_EQ(item, 1);
+  producer.join();
+  EXPECT_TRUE(written.load());
+
+  std::vector<int64> out;
+  EXPECT_EQ(queue.pop_bulk(out, 10), 2);
+  EXPECT_EQ(out, (std::vector<int64>{2, 3}));
+
+  // 大于容量的 push_bulk 要靠消费者边取边腾位置才能完成
+  std::vector<int64> big(100);
+  for (int64 i = 0; i < 100; i++) {
+    big[i] = i;
+  }
+  std::atomic<size_t> pushed{0};
+  std::thread         bulk_producer([&] { queue.push_bulk(big.data(), big.size(), [&](size_t n) { pushed += n; }); });
+  out.clear();
+  while (out.size() < 100) {
+    if (queue.pop_bulk(out, 100) == 0) {
+      std::this_thread::sleep_for(1ms);
+    }
+  }
+  bulk_producer.join();
+  EXPECT_EQ(pushed.load(), 100);
+  for (int64 i = 0; i < 100; i++) {
+    EXPECT_EQ(out[i], i);
+  }
+}
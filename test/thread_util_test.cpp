@@ -0,0 +1,58 @@
+//
+// Created by Coonger on 2024/12/18.
+//
+#include <gtest/gtest.h>
+
+#include <sched.h>
+#include <string>
+#include <vector>
+
+#include "common/thread_util.h"
+
+using common::parse_cpu_list;
+
+/**
+ * @brief 单个编号、范围、空项混在一起，按出现顺序展开
+ */
+TEST(PARSE_CPU_LIST_TEST, VALID)
+{
+  std::vector<int> cpus;
+  EXPECT_EQ(parse_cpu_list("0-3,8", cpus), 0);
+  EXPECT_EQ(cpus, (std::vector<int>{0, 1, 2, 3, 8}));
+
+  EXPECT_EQ(parse_cpu_list("5", cpus), 0);
+  EXPECT_EQ(cpus, (std::vector<int>{5}));
+
+  EXPECT_EQ(parse_cpu_list("2-2,,10-11,", cpus), 0);
+  EXPECT_EQ(cpus, (std::vector<int>{2, 10, 11}));
+
+  // 空串是合法的空列表，上一次的结果被清掉
+  EXPECT_EQ(parse_cpu_list("", cpus), 0);
+  EXPECT_TRUE(cpus.empty());
+
+  EXPECT_EQ(parse_cpu_list("0-" + std::to_string(CPU_SETSIZE - 1), cpus), 0);
+  EXPECT_EQ(cpus.size(), static_cast<size_t>(CPU_SETSIZE));
+}
+
+/**
+ * @brief 范围颠倒、负数、多余字符、超出 CPU_SETSIZE 都返回 -1，并清空输出
+ */
+TEST(PARSE_CPU_LIST_TEST, INVALID)
+{
+  const std::vector<std::string> inputs = {
+      "3-1",
+      "-1",
+      "-1-3",
+      "0-3x",
+      "0-3,8 garbage",
+      "1-",
+      "abc",
+      "0-100000000",
+      std::to_string(CPU_SETSIZE),
+  };
+  for (const auto &input : inputs) {
+    std::vector<int> cpus = {7};
+    EXPECT_EQ(parse_cpu_list(input, cpus), -1) << input;
+    EXPECT_TRUE(cpus.empty()) << input;
+  }
+}
@@ -0,0 +1,100 @@
+//
+// Created by Coonger on 2024/12/18.
+//
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/trace.h"
+
+using common::Tracer;
+
+namespace {
+
+/// 统计输出里 "ph":"X" 的 span 数和出现过的 tid
+void read_trace(const std::string &path, size_t &spans, std::set<std::string> &tids)
+{
+  std::ifstream in(path);
+  std::string   text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  spans = 0;
+  tids.clear();
+  for (size_t pos = text.find("\"ph\":\"X\""); pos != std::string::npos; pos = text.find("\"ph\":\"X\"", pos + 1)) {
+    spans++;
+    size_t tid = text.find("\"tid\":", pos) + 6;
+    tids.insert(text.substr(tid, text.find(',', tid) - tid));
+  }
+}
+
+}  // namespace
+
+/**
+ * @brief 线程一个接一个地创建、记录、退出，缓冲区被复用，不会每个线程分配一个；退出线程的 span 都还在
+ */
+TEST(TRACER_TEST, RECYCLE_ON_THREAD_EXIT)
+{
+  Tracer &tracer = Tracer::instance();
+  tracer.start(1024);
+
+  constexpr int THREADS = 64;
+  for (int i = 0; i < THREADS; i++) {
+    std::thread([&tracer, i] {
+      uint64 now = Tracer::now_ns();
+      tracer.record("span", "test", now, now + 1000, i);
+      tracer.record("span", "test", now, now + 2000, i);
+    }).join();
+  }
+  EXPECT_EQ(tracer.buffer_count(), 1u);
+  EXPECT_EQ(tracer.dropped(), 0u);
+
+  std::string path = "/tmp/loft-trace-test.json";
+  ASSERT_EQ(tracer.write_chrome_json(path), RC::SUCCESS);
+  size_t                spans = 0;
+  std::set<std::string> tids;
+  read_trace(path, spans, tids);
+  EXPECT_EQ(spans, THREADS * 2u);
+  EXPECT_EQ(tids.size(), static_cast<size_t>(THREADS));
+
+  // 复用的缓冲区写满后照样丢弃计数
+  tracer.start(4);
+  for (int i = 0; i < 3; i++) {
+    std::thread([&tracer] {
+      uint64 now = Tracer::now_ns();
+      tracer.record("span", "test", now, now + 1000);
+      tracer.record("span", "test", now, now + 1000);
+    }).join();
+  }
+  EXPECT_EQ(tracer.buffer_count(), 1u);
+  EXPECT_EQ(tracer.dropped(), 2u);
+  ASSERT_EQ(tracer.write_chrome_json(path), RC::SUCCESS);
+  read_trace(path, spans, tids);
+  EXPECT_EQ(spans, 4u);
+  EXPECT_EQ(tids.size(), 2u);
+
+  // 同时存在的线程各用各的缓冲区
+  tracer.start(16);
+  std::vector<std::thread> threads;
+  std::atomic<int>         recorded{0};
+  for (int i = 0; i < 3; i++) {
+    threads.emplace_back([&tracer, &recorded] {
+      uint64 now = Tracer::now_ns();
+      tracer.record("span", "test", now, now + 1000);
+      recorded++;
+      while (recorded.load() < 3) {
+        std::this_thread::yield();
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(tracer.buffer_count(), 3u);
+  tracer.stop();
+  std::remove(path.c_str());
+}
@@ -0,0 +1,141 @@
+//
+// Created by Coonger on 2024/12/18.
+//
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "common/work_stealing_deque.h"
+#include "common/work_stealing_executor.h"
+
+using common::WorkStealingDeque;
+using common::WorkStealingExecutor;
+
+/**
+ * @brief owner 每次只放入一个元素再立即取回，窃取者同时不停地 steal，
+ * 队列里最多只有一个元素，pop 和 steal 一直在争抢最后一个元素，每个元素必须恰好被一方拿到
+ */
+TEST(WORK_STEALING_DEQUE_TEST, POP_STEAL_RACE_ON_LAST_ELEMENT)
+{
+  constexpr int64 kItems = 200000;
+
+  WorkStealingDeque<int64>      deque(2);
+  std::vector<std::atomic<int>> seen(kItems);
+  std::atomic<bool>             running{true};
+  std::atomic<int64>            stolen{0};
+
+  std::thread thief([&] {
+    int64 item = 0;
+    while (running.load(std::memory_order_acquire)) {
+      if (deque.steal(item)) {
+        seen[item]++;
+        stolen++;
+      }
+    }
+  });
+
+  int64 popped = 0;
+  for (int64 i = 0; i < kItems; i++) {
+    deque.push(i);
+    int64 item = 0;
+    if (deque.pop(item)) {
+      EXPECT_EQ(item, i);
+      seen[item]++;
+      popped++;
+    }
+  }
+  running.store(false, std::memory_order_release);
+  thief.join();
+
+  EXPECT_EQ(popped + stolen.load(), kItems);
+  for (int64 i = 0; i < kItems; i++) {
+    ASSERT_EQ(seen[i].load(), 1) << "item " << i;
+  }
+  int64 left = 0;
+  EXPECT_FALSE(deque.pop(left));
+}
+
+/**
+ * @brief 从很小的容量开始扩容，扩容期间窃取者并发读旧数组，每个元素恰好被取走一次
+ */
+TEST(WORK_STEALING_DEQUE_TEST, GROWTH_WITH_CONCURRENT_STEALS)
+{
+  constexpr int64 kItems   = 200000;
+  constexpr int   kThieves = 3;
+
+  WorkStealingDeque<int64>        deque(2);
+  std::vector<std::atomic<int>>   seen(kItems);
+  std::atomic<bool>               producing{true};
+  std::vector<std::thread>        thieves;
+  for (int i = 0; i < kThieves; i++) {
+    thieves.emplace_back([&] {
+      int64 item = 0;
+      while (producing.load(std::memory_order_acquire) || deque.size() > 0) {
+        if (deque.steal(item)) {
+          seen[item]++;
+        }
+      }
+    });
+  }
+
+  // owner 每放入 8 个取回 1 个，队列在增长的同时两端都有消费
+  for (int64 i = 0; i < kItems; i++) {
+    deque.push(i);
+    int64 item = 0;
+    if (i % 8 == 7 && deque.pop(item)) {
+      seen[item]++;
+    }
+  }
+  int64 item = 0;
+  while (deque.pop(item)) {
+    seen[item]++;
+  }
+  producing.store(false, std::memory_order_release);
+  for (auto &thief : thieves) {
+    thief.join();
+  }
+
+  for (int64 i = 0; i < kItems; i++) {
+    ASSERT_EQ(seen[i].load(), 1) << "item " << i;
+  }
+  EXPECT_EQ(deque.size(), 0);
+}
+
+/**
+ * @brief 外部线程提交任务的同时 shutdown：execute 返回 0 的任务都必须被执行，不能被遗留在注入队列里
+ */
+TEST(WORK_STEALING_EXECUTOR_TEST, SHUTDOWN_DOES_NOT_STRAND_TASKS)
+{
+  constexpr int kRounds     = 50;
+  constexpr int kSubmitters = 4;
+
+  for (int r = 0; r < kRounds; r++) {
+    WorkStealingExecutor executor;
+    ASSERT_EQ(executor.init("ws-test", 2), 0);
+
+    std::atomic<int64>       accepted{0};
+    std::atomic<int64>       executed{0};
+    std::atomic<bool>        start{false};
+    std::vector<std::thread> submitters;
+    for (int i = 0; i < kSubmitters; i++) {
+      submitters.emplace_back([&] {
+        while (!start.load(std::memory_order_acquire)) {}
+        while (executor.execute([&executed] { executed++; }) == 0) {
+          accepted++;
+        }
+      });
+    }
+    start.store(true, std::memory_order_release);
+    std::this_thread::sleep_for(std::chrono::microseconds(200 + r * 20));
+    executor.shutdown();
+    for (auto &submitter : submitters) {
+      submitter.join();
+    }
+    executor.await_termination();
+
+    ASSERT_EQ(executed.load(), accepted.load()) << "round " << r;
+    EXPECT_EQ(executor.queue_size(), 0);
+  }
+}
@@ -0,0 +1,209 @@
+//
+// Created by Coonger on 2024/12/18.
+//
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "redo_builder.h"
+#include "writeset_tracker.h"
+
+using loft::RedoRecordBuilder;
+using loft::WritesetTracker;
+
+namespace {
+
+using Value = RedoRecordBuilder::Value;
+using Row   = RedoRecordBuilder::Row;
+
+const std::vector<RedoRecordBuilder::Column> COLUMNS = {
+    {"id", "BIGINT", 20, 0},
+    {"c1", "INT", 11, 0},
+    {"c2", "VARCHAR", 32, 0},
+};
+
+/**
+ * @brief 按顺序拼一组记录，scn 默认按到达顺序递增
+ */
+class Batch
+{
+public:
+  Batch &insert(const std::string &table, int64 id, int64 scn = 0)
+  {
+    return dml(table, "I", {}, {{0, Value::of_long(id)}, {1, Value::of_long(id * 10)}}, scn);
+  }
+
+  Batch &update(const std::string &table, int64 id, int64 scn = 0)
+  {
+    return dml(table, "U", {{0, Value::of_long(id)}}, {{1, Value::of_long(id * 10 + 1)}}, scn);
+  }
+
+  Batch &remove(const std::string &table, int64 id, int64 scn = 0)
+  {
+    return dml(table, "D", {{0, Value::of_long(id)}}, {}, scn);
+  }
+
+  Batch &dml(const std::string &table, const char *op, const Row &keys, const Row &data, int64 scn = 0)
+  {
+    tasks.emplace_back(builder_.dml(header(scn), "loft", table, op, COLUMNS, keys, data), false);
+    return *this;
+  }
+
+  Batch &ddl(const std::string &table, int64 scn = 0)
+  {
+    tasks.emplace_back(builder_.ddl(header(scn), "loft", table, "alter table " + table + " add c3 int", "ALTER TABLE"),
+        true);
+    return *this;
+  }
+
+  /// 每条记录的 (last_committed, sequence_number)
+  std::vector<std::pair<int64, int64>> track(WritesetTracker &tracker, bool scn_order = false)
+  {
+    tracker.track(tasks, scn_order);
+    std::vector<std::pair<int64, int64>> clocks;
+    for (const Task &task : tasks) {
+      clocks.emplace_back(task.last_committed_, task.sequence_number_);
+    }
+    return clocks;
+  }
+
+  std::vector<Task> tasks;
+
+private:
+  RedoRecordBuilder::Header header(int64 scn)
+  {
+    RedoRecordBuilder::Header h;
+    h.scn    = scn != 0 ? scn : static_cast<int64>(tasks.size()) + 1;
+    h.seq    = 1;
+    h.lsn    = static_cast<int64>(tasks.size()) + 1;
+    h.tx_seq = h.lsn;
+    return h;
+  }
+
+  RedoRecordBuilder builder_;
+};
+
+using Clocks = std::vector<std::pair<int64, int64>>;
+
+}  // namespace
+
+/**
+ * @brief 还不知道键列时 INSERT 之间互不依赖；之后学到键列的 UPDATE 至少排在最后一个这样的 INSERT 后面
+ */
+TEST(WRITESET_TRACKER_TEST, KEYLESS_INSERT_THEN_UPDATE)
+{
+  WritesetTracker tracker(1024);
+  Batch           batch;
+  batch.insert("t1", 1).insert("t1", 2).insert("t2", 1).update("t1", 1).update("t1", 1).update("t1", 5).update("t2", 1);
+
+  EXPECT_EQ(batch.track(tracker), (Clocks{{0, 1}, {0, 2}, {0, 3}, {2, 4}, {4, 5}, {2, 6}, {3, 7}}));
+
+  // 键列已经学到，新的 INSERT 有 writeset，只和写过同一行的事务冲突
+  Batch next;
+  next.remove("t1", 7).insert("t1", 7).insert("t1", 8);
+  EXPECT_EQ(next.track(tracker), (Clocks{{2, 8}, {8, 9}, {0, 10}}));
+}
+
+/**
+ * @brief 换了一组键列，或者 UPDATE 的后镜像只带了部分键列，都算不出可比的 writeset，按串行处理
+ */
+TEST(WRITESET_TRACKER_TEST, KEY_COLUMN_CHANGE_FORCES_SERIAL)
+{
+  WritesetTracker tracker(1024);
+  Batch           batch;
+  batch.update("t1", 1)
+      .update("t1", 2)
+      .dml("t1", "D", {{1, Value::of_long(20)}}, {})  // 键列从 id 换成 c1
+      .dml("t1", "D", {{1, Value::of_long(30)}}, {})  // 新键列上的并行
+      .update("t1", 2);                               // 又换回 id
+  EXPECT_EQ(batch.track(tracker), (Clocks{{0, 1}, {0, 2}, {2, 3}, {3, 4}, {4, 5}}));
+  EXPECT_EQ(tracker.history_size(), 0u);
+
+  // 复合键 (id, c1)，后镜像改了 id 但没带 c1，新键算不出来
+  WritesetTracker composite(1024);
+  Batch           keys;
+  keys.dml("t1", "U", {{0, Value::of_long(1)}, {1, Value::of_long(10)}}, {{2, Value::of_string("YQ==")}})
+      .dml("t1", "U", {{0, Value::of_long(2)}, {1, Value::of_long(20)}}, {{0, Value::of_long(3)}})
+      .dml("t1", "U", {{0, Value::of_long(4)}, {1, Value::of_long(40)}}, {{0, Value::of_long(5)}, {1, Value::of_long(50)}})
+      .dml("t1", "D", {{0, Value::of_long(5)}, {1, Value::of_long(50)}}, {});
+  EXPECT_EQ(keys.track(composite), (Clocks{{0, 1}, {1, 2}, {2, 3}, {3, 4}}));
+}
+
+/**
+ * @brief 键值为 NULL 时没有 writeset，按串行处理并清空 history
+ */
+TEST(WRITESET_TRACKER_TEST, NULL_KEY)
+{
+  WritesetTracker tracker(1024);
+  Batch           batch;
+  batch.update("t1", 1)
+      .update("t1", 2)
+      .dml("t1", "D", {{0, Value()}}, {})
+      .update("t1", 3)
+      .update("t1", 1);
+  EXPECT_EQ(batch.track(tracker), (Clocks{{0, 1}, {0, 2}, {2, 3}, {3, 4}, {3, 5}}));
+}
+
+/**
+ * @brief DDL 是屏障：排在之前所有事务后面，之后的事务都排在它后面，并且忘掉学过的键列
+ */
+TEST(WRITESET_TRACKER_TEST, DDL_BARRIER)
+{
+  WritesetTracker tracker(1024);
+  Batch           batch;
+  batch.update("t1", 1).update("t2", 1).ddl("t3").update("t1", 2).insert("t1", 9).insert("t1", 10).update("t1", 9);
+  // DDL 之后 t1 的键列要重新学：update(t1, 2) 重新学到 id，所以之后的 INSERT 有 writeset
+  EXPECT_EQ(batch.track(tracker), (Clocks{{0, 1}, {0, 2}, {2, 3}, {3, 4}, {3, 5}, {3, 6}, {5, 7}}));
+
+  WritesetTracker fresh(1024);
+  Batch           keyless;
+  keyless.update("t1", 1).ddl("t1").insert("t1", 1).insert("t1", 2).update("t1", 1);
+  // DDL 之后 t1 的 INSERT 又变回没有键列的 INSERT
+  EXPECT_EQ(keyless.track(fresh), (Clocks{{0, 1}, {1, 2}, {2, 3}, {2, 4}, {4, 5}}));
+}
+
+/**
+ * @brief history 放不下时清空，之后的事务最早只能依赖到清空它的事务
+ */
+TEST(WRITESET_TRACKER_TEST, HISTORY_OVERFLOW_RESET)
+{
+  WritesetTracker tracker(2);
+  Batch           batch;
+  batch.update("t1", 1).update("t1", 2);
+  EXPECT_EQ(batch.track(tracker), (Clocks{{0, 1}, {0, 2}}));
+  EXPECT_EQ(tracker.history_size(), 2u);
+
+  Batch overflow;
+  overflow.update("t1", 3).update("t1", 4).update("t1", 1).update("t1", 4);
+  // 第 3 个事务让 history 超出上限：它自己仍按 writeset 计算，然后清空 history
+  EXPECT_EQ(overflow.track(tracker), (Clocks{{0, 3}, {3, 4}, {3, 5}, {4, 6}}));
+  // 和 MySQL 一样按 history 大小加 writeset 大小预判，最后一个事务写的行虽然已经在 history 里，也会触发清空
+  EXPECT_EQ(tracker.history_size(), 0u);
+
+  Batch after;
+  after.update("t1", 4).update("t1", 4);
+  EXPECT_EQ(after.track(tracker), (Clocks{{6, 7}, {7, 8}}));
+  EXPECT_EQ(tracker.history_size(), 1u);
+}
+
+/**
+ * @brief PARTITIONED 调度按 (scn, 到达顺序) 输出，逻辑时钟也按这个顺序分配
+ */
+TEST(WRITESET_TRACKER_TEST, PARTITIONED_SCN_ORDER)
+{
+  auto make = [] {
+    Batch batch;
+    batch.update("t1", 1, 30).update("t1", 1, 10).update("t2", 1, 20).update("t2", 1, 20).update("t1", 1, 5);
+    return batch;
+  };
+
+  WritesetTracker fifo(1024);
+  Batch           arrival = make();
+  EXPECT_EQ(arrival.track(fifo, false), (Clocks{{0, 1}, {1, 2}, {0, 3}, {3, 4}, {2, 5}}));
+
+  // scn 顺序：5、10、20、20、30，scn 相同的保持到达顺序
+  WritesetTracker partitioned(1024);
+  Batch           by_scn = make();
+  EXPECT_EQ(by_scn.track(partitioned, true), (Clocks{{2, 5}, {1, 2}, {0, 3}, {3, 4}, {0, 1}}));
+}